@@ -16,7 +16,8 @@ extern "C" {
         MULT       = 1 << 2, // Flag for multiplication capability
         DIV        = 1 << 3, // Flag for division capability
         CONCAT     = 1 << 4, // Flag for string concatenation capability
-        FIND_START = 1 << 5 // Flag for finding the start of a substring
+        FIND_START = 1 << 5, // Flag for finding the start of a substring
+        FIND_ANY   = 1 << 6  // Flag for registering pattern sets and searching for any of their patterns
     };
 
     // @brief Verifies if the given bitmask of execution capabilities is valid.
@@ -26,10 +27,69 @@ extern "C" {
 
     // --------------------------- SERVER API ---------------------------
 
+    /// @brief Sets an optional server setting. Must be called before `serverInitialize`.
+    ///
+    /// Supported settings:
+    /// - "pattern_cache_mb": memory budget for compiled FIND_ANY pattern sets (default 64).
+    /// - "trace_dir": directory for Chrome trace dumps of PROFILE_APPLICATION builds (default ".").
+    /// - "min_threads": smallest worker pool; the pool grows up to `threads` under load (default 0, a fixed pool).
+    /// - "pool_grow_wait_us": start a worker when the oldest queued job waited this long (default 500).
+    /// - "pool_grow_depth": start a worker when this many jobs are queued (default 8).
+    /// - "pool_idle_ms": idle time after which a worker above `min_threads` exits (default 5000).
+    /// - "router_cpus", "worker_cpus", "io_cpus": CPU lists such as "0-3,8" for the ROUTER loop, the
+    ///   AlgoRunner workers and the ZeroMQ I/O thread (default empty, left to the scheduler).
+    /// - "router_sched_fifo": SCHED_FIFO priority 1..99 for the ROUTER loop (default 0, SCHED_OTHER).
+    /// - "numa_node": node the router and workers allocate on; roles without a CPU list also run there (default -1, off).
+    /// - "busy_poll_us": the ROUTER loop spins on non-blocking receives this long before blocking; pair it
+    ///   with "router_cpus" to give it a dedicated core (default 0, off).
+    /// - "frontend": "zmq" for the ROUTER socket (default), "tcp" for an epoll loop serving 4-byte little-endian
+    ///   length-prefixed frames on the same address and port, "unix:<path>" for the same on a Unix socket, or
+    ///   "inproc:<name>" for a ROUTER that only clients of the same process reach, see `serverStart`. An inproc
+    ///   server binds no port and starts no ZeroMQ I/O thread; address and port are ignored.
+    /// - "op_plugins": comma-separated shared objects whose operations are added to the registry, see
+    ///   includes/ipc_ops.h; clients call them with OpCallArgs (default empty).
+    /// - "client_weights": NONBLOCKING jobs are queued per client connection and the queues share the workers
+    ///   by deficit round robin; "name=weight,..." (1..1000) sets the share by FirstHandshake client_name,
+    ///   "*" for unlisted names (default empty, every client weighs 1).
+    /// - "client_rates": token-bucket submit limits per connection, "name=rate[:burst],..." in submits per
+    ///   second, "*" for unlisted names; submits over the limit get ST_ERROR_RATE_LIMITED (default empty, none).
+    /// - "class_threads": separate worker pools per operation class, "math=N,string=N,bulk=N": math covers
+    ///   MathArgs and numeric expressions, string StrArgs, FIND_ANY and expressions with a string op, bulk
+    ///   ReduceArgs and plugin calls. A burst in one
+    ///   class then only queues behind its own workers. Unlisted classes get `threads`; "min_threads" and the
+    ///   pool_* settings apply to every pool (default empty, all classes share one pool of `threads`).
+    /// - "reduce_parallel_min": ReduceArgs arrays of at least this many int32 are split across the
+    ///   workers, the submitting thread included (default 262144, 0 never splits).
+    /// - "inline_max_cost": NONBLOCKING submits whose estimated cost (about their input bytes; math counts 1)
+    ///   is at most this run on the router thread and are answered with their result instead of a ticket
+    ///   (default 0, every NONBLOCKING submit is queued). Clients must accept a final status from submitNonBlocking.
+    /// - "offload_min_cost": BLOCKING submits of at least this cost run on a worker, and the router serves
+    ///   other clients until the reply is ready (default 65536, 0 runs every BLOCKING submit on the router).
+    /// - "capture_dir": record every received handshake and request with its arrival time and client id
+    ///   into memory-mapped files in this existing directory, for `ipc_replay` (default empty, off).
+    /// - "capture_file_mb": size of each capture file; a full file is trimmed and the next one started (default 64).
+    ///   The file's blocks are reserved when it is started, so a full disk stops the capture instead of the server.
+    /// - "capture_max_files": capture files written before recording stops; later frames are counted as dropped (default 16).
+    /// - "slow_request_us": keep the context of submits slower than this, "op=us,..." by op name (add sub mult
+    ///   div concat find findany expr call reduce), "*" for unlisted ops. A record holds the op, payload size,
+    ///   client, queue depth at enqueue, worker and the queue and execution times; queued jobs count from
+    ///   enqueue to result, inline ones their execution. Read it with a SlowLogRequest or `slowLogHandleServer`
+    ///   (default empty, off).
+    /// - "slow_log_size": slow requests kept; the oldest are overwritten (default 256).
+    /// - "spill_dir": results of NONBLOCKING tickets that finished "spill_after_ms" ago and were not fetched
+    ///   leave the heap for a memory-mapped file in this existing directory; a later get reads them back
+    ///   from it. The file is removed on shutdown (default empty, results stay in memory).
+    /// - "spill_file_mb": size of the spill file; once it is full further results stay in memory (default 256).
+    /// - "spill_after_ms": age of a finished, unfetched result before it is spilled (default 1000).
+    /// @param name The name of the setting.
+    /// @param value The value of the setting as a string.
+    /// @return An error code; 0 for success, non-zero for an unknown setting or invalid value.
+    int serverSetOption(const char* name, const char* value);
+
     /// @brief Initializes the server at the specified address and port.
     /// @param address Starts the server at 0.0.0.0 or localhost.
     /// @param port The port number to bind the server to.
-    /// @param threads The number of threads the server will use to handle requests.
+    /// @param threads The number of threads the server will use to handle requests, the pool maximum.
     /// @return An error code; 0 for success, non-zero for failure.
     int serverInitialize(
         const char* address,
@@ -41,7 +101,24 @@ extern "C" {
     /// @return An error code; 0 for success, non-zero for failure.
     int serverRun(void);
 
-    /// @brief Stops the server and deallocates all its resources.
+    /// @brief Runs `serverRun` on a background thread and returns at once, to embed the server in another
+    /// program such as a test or a benchmark. Pair it with the "inproc:<name>" frontend and clients using the
+    /// "transport" "inproc:<name>", linked statically into the same binary (servercore and clientipc_static).
+    /// @return An error code; 0 for success, non-zero for failure.
+    int serverStart(void);
+
+    /// @brief Stops a server started with `serverStart` and waits for its thread. Call `serverDeinitialize`
+    /// afterwards; `serverInitialize` and `serverStart` may then run the server again. Close the sessions
+    /// first: requests they send to a stopped server are not answered.
+    /// @return The result of `serverRun`; 0 for success.
+    int serverStop(void);
+
+    /// @brief A non-blocking signal handler (e.g. for SIGUSR1) that makes the server write its slow-request
+    /// log to the server log, see the "slow_request_us" setting.
+    /// @param signo The signal number.
+    void slowLogHandleServer(int signo);
+
+    /// @brief Stops the server and deallocates all its resources, so `serverInitialize` can create it anew.
     /// @return An error code; 0 for success, non-zero for failure.
     int serverDeinitialize(void);
 
@@ -55,6 +132,26 @@ extern "C" {
     /// @param signo The signal number (e.g., SIGINT, SIGTERM).
     void stopHandleClient(int signo);
 
+    /// @brief Sets an optional client setting. Must be called before `clientInitialize`.
+    ///
+    /// Supported settings:
+    /// - "wire": "protobuf" (default) or "compact", the frame encoding negotiated in the FirstHandshake.
+    /// - "busy_poll_us": spin on non-blocking receives this long before blocking (default 0, off).
+    /// - "transport": "zmq" (default), "tcp", "unix:<path>" or "inproc:<name>"; must match the server's "frontend".
+    /// - "name": client_name sent in the FirstHandshake, which selects the server's "client_weights" and
+    ///   "client_rates" entries (default empty, the random connection identity).
+    /// - "ops": comma-separated registry op ids the client may call on top of its ExecFunFlags, such as
+    ///   plugin ops (see includes/ipc_ops.h) or the reductions 7..11 (sum, min, max, dot, prefix sum; default empty).
+    /// - "hedge": "host:port,..." of other servers; a BLOCKING submit that is slower than "hedge_percentile" of
+    ///   the recent ones is sent to the next of them too and the first reply wins. Needs the "zmq" transport;
+    ///   while set, every request is numbered and sent protobuf-encoded (default empty, off).
+    /// - "hedge_percentile": 1..100, the hedge delay as a percentile of the latest 256 BLOCKING submits (default 95).
+    /// - "hedge_budget_pct": 1..100, at most this many hedges per 100 BLOCKING submits (default 5).
+    /// @param name The name of the setting.
+    /// @param value The value of the setting as a string.
+    /// @return An error code; 0 for success, non-zero for an unknown setting or invalid value.
+    int clientSetOption(const char* name, const char* value);
+
     /// @brief Registers the functions the client can call on the server.
     /// @return An error code; 0 for success, non-zero for failure.
     int clientRegisterFunctions(void);
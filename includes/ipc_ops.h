@@ -0,0 +1,84 @@
+#pragma once
+#include "stddef.h"
+#include "stdint.h"
+
+// C interface between the server's operation registry and operation kernels. Built-in operations use
+// it internally; extensions are shared objects loaded with the "op_plugins" server setting that export
+// IPC_OPS_ENTRY. A kernel only sees plain values, so it needs neither protobuf nor the server headers.
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+    // Bumped whenever a struct below changes layout. The server refuses plugins built against another version.
+#define IPC_OPS_ABI_VERSION 1
+
+    // Number of operation ids; also the width of the capability bitmap in the FirstHandshake.
+#define IPC_OPS_MAX 256
+    // Ids below this are reserved for built-in operations; plugins use IPC_OPS_FIRST_PLUGIN..IPC_OPS_MAX-1.
+#define IPC_OPS_FIRST_PLUGIN 64
+
+    // Kernel return codes, equal to the ipc.Status values of the same name.
+    enum IpcOpStatus {
+        IPC_OP_SUCCESS            = 0,
+        IPC_OP_INVALID_INPUT      = 1,
+        IPC_OP_DIV_BY_ZERO        = 2,
+        IPC_OP_SUBSTR_NOT_FOUND   = 3,
+        IPC_OP_STRING_TOO_LONG    = 4,
+        IPC_OP_INTERNAL           = 5
+    };
+
+    // What a kernel left in IpcOpResult.
+    enum IpcOpResultKind {
+        IPC_OP_RESULT_NONE     = 0,
+        IPC_OP_RESULT_INT      = 1,
+        IPC_OP_RESULT_POSITION = 2, // An int that is a position in a string argument.
+        IPC_OP_RESULT_STR      = 3
+    };
+
+    typedef struct IpcBytes {
+        const char* data;
+        size_t size;
+    } IpcBytes;
+
+    // Arguments of one call. The counts always match the descriptor, the registry checks them first.
+    typedef struct IpcOpArgs {
+        const int32_t* ints;
+        size_t intCount;
+        const IpcBytes* strs;
+        size_t strCount;
+    } IpcOpArgs;
+
+    // Where a kernel writes its result. String results go to `str`, at most `strCapacity` bytes;
+    // a kernel that needs more returns IPC_OP_STRING_TOO_LONG.
+    typedef struct IpcOpResult {
+        int32_t kind; // IpcOpResultKind
+        int32_t intValue;
+        char* str;
+        size_t strCapacity;
+        size_t strSize;
+    } IpcOpResult;
+
+    // Runs one operation. Must be thread safe: worker threads call it concurrently.
+    // @return An IpcOpStatus.
+    typedef int32_t (*IpcOpKernel)(const IpcOpArgs* args, IpcOpResult* result);
+
+    typedef struct IpcOpDescriptor {
+        uint32_t id;          // Stable id, the bit clients set in their capability bitmap.
+        const char* name;     // Unique, shown by ListOps.
+        uint32_t intArgs;     // Number of int32 arguments.
+        uint32_t strArgs;     // Number of string arguments.
+        IpcOpKernel kernel;
+    } IpcOpDescriptor;
+
+    // Name of the function a plugin exports, of type IpcRegisterOpsFn.
+#define IPC_OPS_ENTRY "ipcRegisterOps"
+
+    // Called once after dlopen. Sets `ops` to an array of `count` descriptors that stays valid
+    // until the plugin is unloaded.
+    // @param abiVersion IPC_OPS_ABI_VERSION of the server.
+    // @return 0 on success.
+    typedef int (*IpcRegisterOpsFn)(uint32_t abiVersion, const IpcOpDescriptor** ops, size_t* count);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
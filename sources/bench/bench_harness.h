@@ -0,0 +1,169 @@
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+#include <atomic>
+
+/// @brief A small in-tree benchmark harness.
+///
+/// Every case is run for a warm-up pass and then `repetitions` timed passes of
+/// `iterations` calls each. The median and minimum ns/op over the passes are reported,
+/// which is stable enough to compare two builds side by side on the same machine.
+namespace bench {
+
+    /// @brief Prevents the compiler from optimizing away a value.
+    template<typename T>
+    inline void doNotOptimize(const T& value) {
+        asm volatile("" : : "r,m"(value) : "memory");
+    }
+
+    /// @brief Forces the compiler to assume memory was read and written.
+    inline void clobberMemory() {
+        asm volatile("" : : : "memory");
+    }
+
+    struct Result {
+        std::string name;
+        uint64_t iterations = 0;
+        double medianNs = 0.0; ///< Median ns per iteration over all repetitions.
+        double minNs = 0.0;    ///< Fastest repetition, ns per iteration.
+        double maxNs = 0.0;    ///< Slowest repetition, ns per iteration.
+    };
+
+    /// @brief Runs `fn` `iterations` times per repetition and collects per-iteration timings.
+    template<typename Fn>
+    Result measure(const std::string& name, uint64_t iterations, int repetitions, Fn&& fn) {
+        using clock = std::chrono::steady_clock;
+        for (uint64_t i = 0; i < iterations / 10 + 1; ++i) {
+            fn();
+        }
+        std::vector<double> perIteration;
+        perIteration.reserve(repetitions);
+        for (int r = 0; r < repetitions; ++r) {
+            const auto start = clock::now();
+            for (uint64_t i = 0; i < iterations; ++i) {
+                fn();
+            }
+            const auto stop = clock::now();
+            const double ns = static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(stop - start).count());
+            perIteration.push_back(ns / static_cast<double>(iterations));
+        }
+        std::sort(perIteration.begin(), perIteration.end());
+        Result result;
+        result.name = name;
+        result.iterations = iterations;
+        result.medianNs = perIteration[perIteration.size() / 2];
+        result.minNs = perIteration.front();
+        result.maxNs = perIteration.back();
+        return result;
+    }
+
+    /// @brief Like `measure`, but `threads` threads call `fn(threadIndex)` concurrently.
+    ///
+    /// All threads are released together and the repetition ends when the last one finishes.
+    /// The reported time is wall time divided by the total number of calls, i.e. the inverse
+    /// of the aggregate throughput.
+    template<typename Fn>
+    Result measureParallel(const std::string& name, int threads, uint64_t iterations, int repetitions, Fn&& fn) {
+        using clock = std::chrono::steady_clock;
+        std::vector<double> perIteration;
+        perIteration.reserve(repetitions);
+        for (int r = -1; r < repetitions; ++r) { // r == -1 is the warm-up pass.
+            const uint64_t calls = (r < 0) ? iterations / 10 + 1 : iterations;
+            std::atomic<int> ready{0};
+            std::atomic<bool> go{false};
+            std::vector<std::thread> pool;
+            pool.reserve(threads);
+            for (int t = 0; t < threads; ++t) {
+                pool.emplace_back([&, t] {
+                    ready.fetch_add(1);
+                    while (go.load(std::memory_order_acquire) == false) {
+                        std::this_thread::yield();
+                    }
+                    for (uint64_t i = 0; i < calls; ++i) {
+                        fn(t);
+                    }
+                });
+            }
+            while (ready.load() != threads) {
+                std::this_thread::yield();
+            }
+            const auto start = clock::now();
+            go.store(true, std::memory_order_release);
+            for (std::thread& t : pool) {
+                t.join();
+            }
+            const auto stop = clock::now();
+            if (r >= 0) {
+                const double ns = static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(stop - start).count());
+                perIteration.push_back(ns / static_cast<double>(calls * threads));
+            }
+        }
+        std::sort(perIteration.begin(), perIteration.end());
+        Result result;
+        result.name = name;
+        result.iterations = iterations * threads;
+        result.medianNs = perIteration[perIteration.size() / 2];
+        result.minNs = perIteration.front();
+        result.maxNs = perIteration.back();
+        return result;
+    }
+
+    /// @brief Latency percentiles of a set of samples, in microseconds.
+    struct LatencySummary {
+        uint64_t count = 0;
+        double meanUs = 0.0;
+        double p50Us = 0.0;
+        double p99Us = 0.0;
+        double p999Us = 0.0;
+        double maxUs = 0.0;
+    };
+
+    /// @brief Summarizes latency samples given in nanoseconds. Sorts `samplesNs` in place.
+    inline LatencySummary summarize(std::vector<uint64_t>& samplesNs) {
+        LatencySummary summary;
+        summary.count = samplesNs.size();
+        if (samplesNs.empty()) {
+            return summary;
+        }
+        std::sort(samplesNs.begin(), samplesNs.end());
+        long double sum = 0;
+        for (uint64_t ns : samplesNs) {
+            sum += ns;
+        }
+        // Nearest-rank percentiles: the smallest sample with at least p of the samples at or below it.
+        auto at = [&] (double p) {
+            std::size_t rank = static_cast<std::size_t>(p * static_cast<double>(samplesNs.size()) + 0.999999);
+            rank = std::clamp<std::size_t>(rank, 1, samplesNs.size());
+            return static_cast<double>(samplesNs[rank - 1]) / 1000.0;
+        };
+        summary.meanUs = static_cast<double>(sum / samplesNs.size()) / 1000.0;
+        summary.p50Us = at(0.50);
+        summary.p99Us = at(0.99);
+        summary.p999Us = at(0.999);
+        summary.maxUs = static_cast<double>(samplesNs.back()) / 1000.0;
+        return summary;
+    }
+
+    inline void printText(const std::vector<Result>& results) {
+        printf("%-40s %12s %12s %12s %12s\n", "case", "iterations", "median ns", "min ns", "max ns");
+        for (const Result& r : results) {
+            printf("%-40s %12llu %12.1f %12.1f %12.1f\n",
+                r.name.c_str(), (unsigned long long)r.iterations, r.medianNs, r.minNs, r.maxNs);
+        }
+    }
+
+    inline void printJson(const std::vector<Result>& results, FILE* out) {
+        fprintf(out, "{\"results\":[");
+        for (std::size_t i = 0; i < results.size(); ++i) {
+            const Result& r = results[i];
+            fprintf(out, "%s{\"name\":\"%s\",\"iterations\":%llu,\"median_ns\":%.2f,\"min_ns\":%.2f,\"max_ns\":%.2f}",
+                i == 0 ? "" : ",", r.name.c_str(), (unsigned long long)r.iterations, r.medianNs, r.minNs, r.maxNs);
+        }
+        fprintf(out, "]}\n");
+    }
+} // namespace bench
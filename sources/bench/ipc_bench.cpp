@@ -0,0 +1,609 @@
+#include "bench_harness.h"
+#include "client/session.h"
+#include "affinity.h"
+#include "framing.h"
+#include "error_handling.h"
+#include "ipc.h"
+#include "cxxopts.hpp"
+#include <google/protobuf/stubs/common.h>
+#include <spdlog/spdlog.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <cstring>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <thread>
+
+/// Load generator for a running `server`.
+///
+/// Every connection is one thread with its own `client::Session`. In closed-loop mode each
+/// connection sends its next request as soon as the previous one completed, which measures
+/// peak throughput. In open-loop mode requests are scheduled at a fixed total rate and latency
+/// is measured from the scheduled send time, so a stalled server shows up in the tail instead
+/// of silently lowering the offered load. Each size in `--sizes` is a separate run.
+
+namespace {
+
+    enum class BenchOp : int {
+        ADD = 0,
+        SUB,
+        MULT,
+        DIV,
+        CONCAT,
+        FIND,
+        FINDANY,
+        COUNT
+    };
+
+    constexpr int kOps = static_cast<int>(BenchOp::COUNT);
+    constexpr const char* kOpNames[kOps] = {"add", "sub", "mult", "div", "concat", "find", "findany"};
+    constexpr int kStages = 5;
+    constexpr const char* kStageNames[kStages] = {"network", "router", "queue", "exec", "reply"};
+    constexpr std::size_t kMaxConcatPart = 16; // The server rejects concatenations longer than 32 bytes.
+
+    struct BenchConfig {
+        std::string address;
+        int port = 24737;
+        int connections = 4;
+        double durationS = 5.0;
+        double warmupS = 1.0;
+        bool openLoop = false;
+        double rate = 10000.0;       ///< Total requests per second in open-loop mode.
+        double nonblockRatio = 0.0;  ///< Share of requests sent NONBLOCKING and fetched with get.
+        std::vector<std::size_t> sizes;
+        double weights[kOps] = {};
+        client::Options options;
+        int receiveTimeoutMs = 3000;
+        std::vector<int> cpus;       ///< Connection i runs on cpus[i % size]; empty leaves it to the scheduler.
+    };
+
+    /// Samples of one connection for one run, merged after the threads are joined.
+    struct ThreadSamples {
+        std::vector<uint64_t> latencyNs[kOps];
+        std::vector<uint64_t> stageNs[kStages]; ///< With --trace, indexed like kStageNames.
+        uint64_t errors[kOps] = {};
+        busypoll::Counters poll;
+        client::HedgeCounters hedge;
+    };
+
+    void addPoll(busypoll::Counters& into, const busypoll::Counters& from) {
+        into.hits += from.hits;
+        into.misses += from.misses;
+        into.spinNs += from.spinNs;
+    }
+
+    /// Sums the counters of several sessions; the delay is the largest one, as a rough indication.
+    void addHedge(client::HedgeCounters& into, const client::HedgeCounters& from) {
+        into.requests += from.requests;
+        into.hedged += from.hedged;
+        into.wins += from.wins;
+        into.denied += from.denied;
+        into.stale += from.stale;
+        into.delayNs = std::max(into.delayNs, from.delayNs);
+    }
+
+    struct RunResult {
+        std::size_t size = 0;
+        double elapsedS = 0.0;
+        bench::LatencySummary all;
+        uint64_t allErrors = 0;
+        bench::LatencySummary ops[kOps];
+        uint64_t errors[kOps] = {};
+        busypoll::Counters poll; ///< Receive spinning of every connection, warmup included.
+        bench::LatencySummary stages[kStages]; ///< Empty unless --trace.
+        client::HedgeCounters hedge;           ///< Zero unless --hedge.
+    };
+
+    /// Adds the breakdown of the session's last round trip, if the server returned one.
+    void addBreakdown(client::RequestBreakdown& into, const client::Session& session) {
+        if (const client::RequestBreakdown* last = session.lastBreakdown()) {
+            into += *last;
+        }
+    }
+
+    void pushStages(ThreadSamples& samples, const client::RequestBreakdown& b) {
+        const int64_t stages[kStages] = {b.networkNs, b.routerNs, b.queueNs, b.execNs, b.replyNs};
+        for (int i = 0; i < kStages; ++i) {
+            samples.stageNs[i].push_back(static_cast<uint64_t>(stages[i]));
+        }
+    }
+
+    std::atomic<bool> sigStop{false};
+
+    void onSignal(int) {
+        sigStop.store(true, std::memory_order_relaxed);
+    }
+
+    constexpr const char* kEmbeddedEndpoint = "inproc:ipc_bench";
+
+    /// Starts a server inside this process that the connections reach over inproc, so a run
+    /// measures the request path without the TCP loopback.
+    int startEmbedded(const int threads) {
+        int result = serverSetOption("frontend", kEmbeddedEndpoint);
+        RETURN_IF_ERROR(ErrorType::DEFAULT, result, "Invalid embedded frontend");
+        result = serverInitialize("embedded", 0, threads);
+        RETURN_IF_ERROR(ErrorType::DEFAULT, result, "Failed to initialize the embedded server");
+        return serverStart();
+    }
+
+    int parseMix(const std::string& mix, double (&weights)[kOps]) {
+        std::stringstream ss(mix);
+        std::string item;
+        while (std::getline(ss, item, ',')) {
+            const std::size_t eq = item.find('=');
+            const std::string name = item.substr(0, eq);
+            const double weight = (eq == std::string::npos) ? 1.0 : std::atof(item.c_str() + eq + 1);
+            int op = 0;
+            while (op < kOps && name != kOpNames[op]) {
+                ++op;
+            }
+            if (op == kOps || weight < 0.0) {
+                spdlog::error("Invalid mix entry: {}", item);
+                return EC_FAILURE;
+            }
+            weights[op] = weight;
+        }
+        for (double w : weights) {
+            if (w > 0.0) {
+                return EC_SUCCESS;
+            }
+        }
+        spdlog::error("The mix must give at least one op a positive weight");
+        return EC_FAILURE;
+    }
+
+    int parseSizes(const std::string& list, std::vector<std::size_t>& sizes) {
+        std::stringstream ss(list);
+        std::string item;
+        while (std::getline(ss, item, ',')) {
+            char* end = nullptr;
+            const unsigned long long size = std::strtoull(item.c_str(), &end, 10);
+            if (end == item.c_str() || *end != '\0' || size == 0) {
+                spdlog::error("Invalid size: {}", item);
+                return EC_FAILURE;
+            }
+            sizes.push_back(static_cast<std::size_t>(size));
+        }
+        return sizes.empty() ? EC_FAILURE : EC_SUCCESS;
+    }
+
+    /// Requests of one size, built once per connection and reused for every send.
+    struct RequestSet {
+        ipc::SubmitRequest requests[kOps];
+
+        RequestSet(std::size_t size, uint64_t patternHandle) {
+            const std::string part(std::min(size, kMaxConcatPart), 'c');
+            // The needle sits at the very end, so the whole haystack is scanned.
+            const std::string haystack = std::string(size > 4 ? size - 4 : 0, 'x') + "abcd";
+            requests[static_cast<int>(BenchOp::ADD)] = client::makeMath(ipc::MATH_ADD, 1234, 5678);
+            requests[static_cast<int>(BenchOp::SUB)] = client::makeMath(ipc::MATH_SUB, 1234, 5678);
+            requests[static_cast<int>(BenchOp::MULT)] = client::makeMath(ipc::MATH_MUL, 1234, 56);
+            requests[static_cast<int>(BenchOp::DIV)] = client::makeMath(ipc::MATH_DIV, 123456, 7);
+            requests[static_cast<int>(BenchOp::CONCAT)] = client::makeStr(ipc::STR_CONCAT, part, part);
+            requests[static_cast<int>(BenchOp::FIND)] = client::makeStr(ipc::STR_FIND_START, haystack, "abcd");
+            requests[static_cast<int>(BenchOp::FINDANY)] = client::makeFindAny(patternHandle, haystack, false);
+        }
+    };
+
+    /// Sends one request and, for NONBLOCKING, polls for its result.
+    /// @param breakdown Summed over the round trips of the request when the session traces.
+    /// @return true if the server answered with ST_SUCCESS.
+    bool issue(
+        client::Session& session,
+        const ipc::SubmitRequest& request,
+        bool nonblocking,
+        int& transportError,
+        client::RequestBreakdown& breakdown
+    ) {
+        ipc::SubmitResponse submitted;
+        if (nonblocking == false) {
+            transportError = session.submitBlocking(request, submitted);
+            addBreakdown(breakdown, session);
+            return transportError == EC_SUCCESS && submitted.status() == ipc::ST_SUCCESS;
+        }
+        transportError = session.submitNonBlocking(request, submitted);
+        addBreakdown(breakdown, session);
+        if (transportError != EC_SUCCESS || submitted.status() != ipc::ST_NOT_FINISHED) {
+            // A cheap request the server ran inline comes back finished, without a ticket.
+            return transportError == EC_SUCCESS && submitted.status() == ipc::ST_SUCCESS;
+        }
+        ipc::GetResponse got;
+        do {
+            got.Clear();
+            transportError = session.getResult(submitted.ticket(), ipc::WAIT_UP_TO, 1000, got);
+            addBreakdown(breakdown, session);
+        } while (transportError == EC_SUCCESS && got.status() == ipc::ST_NOT_FINISHED && sigStop.load() == false);
+        return transportError == EC_SUCCESS && got.status() == ipc::ST_SUCCESS;
+    }
+
+    std::unique_ptr<client::Session> connect(zmq::context_t& ctx, const BenchConfig& config, uint64_t& patternHandle) {
+        const uint8_t caps = ExecFunFlags::ADD | ExecFunFlags::SUB | ExecFunFlags::MULT | ExecFunFlags::DIV |
+            ExecFunFlags::CONCAT | ExecFunFlags::FIND_START | ExecFunFlags::FIND_ANY;
+        auto session = std::make_unique<client::Session>(
+            ctx, sigStop, config.address.c_str(), config.port, config.receiveTimeoutMs, caps, config.options);
+        if (session->init() != EC_SUCCESS) {
+            return nullptr;
+        }
+        if (config.weights[static_cast<int>(BenchOp::FINDANY)] > 0.0) {
+            ipc::RegisterPatternsResponse registered;
+            if (session->registerPatterns({"abcd", "wxyz", "qq"}, registered) != EC_SUCCESS ||
+                registered.status() != ipc::ST_SUCCESS) {
+                spdlog::error("Failed to register the findany pattern set");
+                return nullptr;
+            }
+            patternHandle = registered.handle();
+        }
+        return session;
+    }
+
+    void connectionLoop(
+        zmq::context_t& ctx,
+        const BenchConfig& config,
+        std::size_t size,
+        int index,
+        ThreadSamples& samples,
+        std::atomic<int>& failed
+    ) {
+        using clock = std::chrono::steady_clock;
+        if (config.cpus.empty() == false) {
+            affinity::Placement placement;
+            placement.cpus = {config.cpus[static_cast<std::size_t>(index) % config.cpus.size()]};
+            if (affinity::applyToCurrentThread(placement, "connection") != EC_SUCCESS) {
+                failed.fetch_add(1);
+                return;
+            }
+        }
+        uint64_t patternHandle = 0;
+        std::unique_ptr<client::Session> session = connect(ctx, config, patternHandle);
+        if (session == nullptr) {
+            failed.fetch_add(1);
+            return;
+        }
+        RequestSet requests(size, patternHandle);
+        std::mt19937_64 rng(0x9E3779B97F4A7C15ull + static_cast<uint64_t>(index));
+        std::discrete_distribution<int> pickOp(std::begin(config.weights), std::end(config.weights));
+        std::bernoulli_distribution pickNonblocking(config.nonblockRatio);
+
+        const auto start = clock::now();
+        const auto measureFrom = start + std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(config.warmupS));
+        const auto stopAt = measureFrom + std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(config.durationS));
+        // Connections are staggered so the open-loop arrivals are spread evenly over each interval.
+        const auto interval = std::chrono::duration_cast<clock::duration>(
+            std::chrono::duration<double>(config.connections / config.rate));
+        auto scheduled = start + interval * index / config.connections;
+
+        while (sigStop.load(std::memory_order_relaxed) == false) {
+            auto sendAt = clock::now();
+            if (config.openLoop) {
+                if (scheduled > sendAt) {
+                    std::this_thread::sleep_until(scheduled);
+                }
+                sendAt = scheduled;
+                scheduled += interval;
+            }
+            if (sendAt >= stopAt) {
+                break;
+            }
+            const int op = pickOp(rng);
+            int transportError = EC_SUCCESS;
+            client::RequestBreakdown breakdown;
+            const bool ok = issue(*session, requests.requests[op], pickNonblocking(rng), transportError, breakdown);
+            const auto done = clock::now();
+            if (sendAt >= measureFrom) {
+                samples.latencyNs[op].push_back(static_cast<uint64_t>(
+                    std::chrono::duration_cast<std::chrono::nanoseconds>(done - sendAt).count()));
+                if (config.options.trace) {
+                    pushStages(samples, breakdown);
+                }
+                if (ok == false) {
+                    ++samples.errors[op];
+                }
+            }
+            if (transportError != EC_SUCCESS) {
+                // A late reply would be read as the answer to the next request, so start over on a fresh socket.
+                addPoll(samples.poll, session->pollCounters());
+                addHedge(samples.hedge, session->hedgeCounters());
+                session = connect(ctx, config, patternHandle);
+                if (session == nullptr) {
+                    failed.fetch_add(1);
+                    return;
+                }
+            }
+        }
+        addPoll(samples.poll, session->pollCounters());
+        addHedge(samples.hedge, session->hedgeCounters());
+    }
+
+    int runOnce(zmq::context_t& ctx, const BenchConfig& config, std::size_t size, RunResult& result) {
+        std::vector<ThreadSamples> samples(config.connections);
+        std::vector<std::thread> threads;
+        std::atomic<int> failed{0};
+        threads.reserve(config.connections);
+        for (int i = 0; i < config.connections; ++i) {
+            threads.emplace_back(connectionLoop, std::ref(ctx), std::cref(config), size, i, std::ref(samples[i]), std::ref(failed));
+        }
+        for (std::thread& t : threads) {
+            t.join();
+        }
+        if (failed.load() != 0) {
+            spdlog::error("{} connection(s) failed", failed.load());
+            return EC_FAILURE;
+        }
+
+        result.size = size;
+        result.elapsedS = config.durationS;
+        std::vector<uint64_t> all;
+        for (int op = 0; op < kOps; ++op) {
+            std::vector<uint64_t> merged;
+            for (ThreadSamples& s : samples) {
+                merged.insert(merged.end(), s.latencyNs[op].begin(), s.latencyNs[op].end());
+                result.errors[op] += s.errors[op];
+            }
+            all.insert(all.end(), merged.begin(), merged.end());
+            result.allErrors += result.errors[op];
+            result.ops[op] = bench::summarize(merged);
+        }
+        result.all = bench::summarize(all);
+        for (int stage = 0; stage < kStages; ++stage) {
+            std::vector<uint64_t> merged;
+            for (ThreadSamples& s : samples) {
+                merged.insert(merged.end(), s.stageNs[stage].begin(), s.stageNs[stage].end());
+            }
+            result.stages[stage] = bench::summarize(merged);
+        }
+        for (const ThreadSamples& s : samples) {
+            addPoll(result.poll, s.poll);
+            addHedge(result.hedge, s.hedge);
+        }
+        return EC_SUCCESS;
+    }
+
+    void printRow(const char* name, std::size_t size, const bench::LatencySummary& s, uint64_t errors, double elapsedS) {
+        printf("%-8s %8zu %10llu %8llu %12.0f %10.1f %10.1f %10.1f %10.1f\n",
+            name, size, (unsigned long long)s.count, (unsigned long long)errors,
+            static_cast<double>(s.count) / elapsedS, s.p50Us, s.p99Us, s.p999Us, s.maxUs);
+    }
+
+    double hitRate(const busypoll::Counters& poll) {
+        const uint64_t total = poll.hits + poll.misses;
+        return total == 0 ? 0.0 : static_cast<double>(poll.hits) / static_cast<double>(total);
+    }
+
+    void printText(const BenchConfig& config, const std::vector<RunResult>& results) {
+        printf("%-8s %8s %10s %8s %12s %10s %10s %10s %10s\n",
+            "op", "size", "requests", "errors", "req/s", "p50 us", "p99 us", "p99.9 us", "max us");
+        for (const RunResult& r : results) {
+            printRow("all", r.size, r.all, r.allErrors, r.elapsedS);
+            for (int op = 0; op < kOps; ++op) {
+                if (r.ops[op].count != 0) {
+                    printRow(kOpNames[op], r.size, r.ops[op], r.errors[op], r.elapsedS);
+                }
+            }
+        }
+        if (config.options.busyPollUs > 0) {
+            for (const RunResult& r : results) {
+                printf("busy-poll size=%zu hits=%llu misses=%llu hit_rate=%.1f%% spin=%.1fms\n", r.size,
+                    (unsigned long long)r.poll.hits, (unsigned long long)r.poll.misses,
+                    hitRate(r.poll) * 100.0, r.poll.spinNs / 1e6);
+            }
+        }
+        if (config.options.hedge.empty() == false) {
+            for (const RunResult& r : results) {
+                printf("hedge size=%zu requests=%llu hedged=%llu wins=%llu denied=%llu stale=%llu delay=%.1fus\n", r.size,
+                    (unsigned long long)r.hedge.requests, (unsigned long long)r.hedge.hedged,
+                    (unsigned long long)r.hedge.wins, (unsigned long long)r.hedge.denied,
+                    (unsigned long long)r.hedge.stale, r.hedge.delayNs / 1e3);
+            }
+        }
+        if (config.options.trace) {
+            printf("\n%-8s %8s %10s %10s %10s %10s %10s\n",
+                "stage", "size", "mean us", "p50 us", "p99 us", "p99.9 us", "max us");
+            for (const RunResult& r : results) {
+                for (int stage = 0; stage < kStages; ++stage) {
+                    const bench::LatencySummary& s = r.stages[stage];
+                    printf("%-8s %8zu %10.1f %10.1f %10.1f %10.1f %10.1f\n",
+                        kStageNames[stage], r.size, s.meanUs, s.p50Us, s.p99Us, s.p999Us, s.maxUs);
+                }
+            }
+        }
+    }
+
+    void printSummaryJson(FILE* out, const bench::LatencySummary& s, uint64_t errors, double elapsedS) {
+        fprintf(out, "\"requests\":%llu,\"errors\":%llu,\"throughput_rps\":%.1f,\"mean_us\":%.3f,"
+            "\"p50_us\":%.3f,\"p99_us\":%.3f,\"p999_us\":%.3f,\"max_us\":%.3f",
+            (unsigned long long)s.count, (unsigned long long)errors, static_cast<double>(s.count) / elapsedS,
+            s.meanUs, s.p50Us, s.p99Us, s.p999Us, s.maxUs);
+    }
+
+    void printJson(FILE* out, const BenchConfig& config, const std::vector<RunResult>& results) {
+        fprintf(out, "{\"config\":{\"connections\":%d,\"mode\":\"%s\",\"rate\":%.1f,\"duration_s\":%.3f,"
+            "\"nonblock_ratio\":%.3f,\"wire\":\"%s\",\"transport\":\"%s\",\"busy_poll_us\":%u,\"trace\":%s,"
+            "\"hedge\":%zu,\"hedge_percentile\":%u,\"hedge_budget_pct\":%u},\"runs\":[",
+            config.connections, config.openLoop ? "open" : "closed", config.openLoop ? config.rate : 0.0,
+            config.durationS, config.nonblockRatio, ipc::WireFormat_Name(config.options.wireFormat).c_str(),
+            framing::transportName(config.options.transport.transport),
+            config.options.busyPollUs, config.options.trace ? "true" : "false", config.options.hedge.size(),
+            config.options.hedgePercentile, config.options.hedgeBudgetPct);
+        for (std::size_t i = 0; i < results.size(); ++i) {
+            const RunResult& r = results[i];
+            fprintf(out, "%s{\"size\":%zu,", i == 0 ? "" : ",", r.size);
+            printSummaryJson(out, r.all, r.allErrors, r.elapsedS);
+            fprintf(out, ",\"busy_poll\":{\"hits\":%llu,\"misses\":%llu,\"hit_rate\":%.4f,\"spin_ms\":%.3f}",
+                (unsigned long long)r.poll.hits, (unsigned long long)r.poll.misses, hitRate(r.poll), r.poll.spinNs / 1e6);
+            fprintf(out, ",\"hedge\":{\"requests\":%llu,\"hedged\":%llu,\"wins\":%llu,\"denied\":%llu,"
+                "\"stale\":%llu,\"delay_us\":%.3f}", (unsigned long long)r.hedge.requests,
+                (unsigned long long)r.hedge.hedged, (unsigned long long)r.hedge.wins,
+                (unsigned long long)r.hedge.denied, (unsigned long long)r.hedge.stale, r.hedge.delayNs / 1e3);
+            fprintf(out, ",\"ops\":[");
+            bool first = true;
+            for (int op = 0; op < kOps; ++op) {
+                if (r.ops[op].count == 0) {
+                    continue;
+                }
+                fprintf(out, "%s{\"op\":\"%s\",", first ? "" : ",", kOpNames[op]);
+                printSummaryJson(out, r.ops[op], r.errors[op], r.elapsedS);
+                fprintf(out, "}");
+                first = false;
+            }
+            fprintf(out, "]");
+            if (config.options.trace) {
+                fprintf(out, ",\"stages\":[");
+                for (int stage = 0; stage < kStages; ++stage) {
+                    const bench::LatencySummary& s = r.stages[stage];
+                    fprintf(out, "%s{\"stage\":\"%s\",\"mean_us\":%.3f,\"p50_us\":%.3f,\"p99_us\":%.3f,"
+                        "\"p999_us\":%.3f,\"max_us\":%.3f}", stage == 0 ? "" : ",", kStageNames[stage],
+                        s.meanUs, s.p50Us, s.p99Us, s.p999Us, s.maxUs);
+                }
+                fprintf(out, "]");
+            }
+            fprintf(out, "}");
+        }
+        fprintf(out, "]}\n");
+    }
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    cxxopts::Options options("ipc_bench", "Load generator for the IPC server:");
+    options.add_options()
+        ("address", "Host name of the server", cxxopts::value<std::string>()->default_value("127.0.0.1"), "STR")
+        ("port", "Port number of the server", cxxopts::value<int>()->default_value("24737"), "PORT")
+        ("c,connections", "Number of connections, one thread each", cxxopts::value<int>()->default_value("4"), "INT")
+        ("d,duration", "Measured seconds per run", cxxopts::value<double>()->default_value("5"), "SEC")
+        ("warmup", "Unmeasured seconds before each run", cxxopts::value<double>()->default_value("1"), "SEC")
+        ("mode", "closed (send on completion) or open (fixed arrival rate)", cxxopts::value<std::string>()->default_value("closed"), "MODE")
+        ("rate", "Total requests per second in open mode", cxxopts::value<double>()->default_value("10000"), "RPS")
+        ("mix", "Weighted ops, e.g. add=2,concat=1,find=1 (add sub mult div concat find findany)",
+            cxxopts::value<std::string>()->default_value("add,sub,mult,div,concat,find,findany"), "LIST")
+        ("nonblock", "Share of requests sent NONBLOCKING and fetched with get, 0..1", cxxopts::value<double>()->default_value("0"), "RATIO")
+        ("sizes", "Haystack sizes to sweep, one run each (concat parts are capped at 16 bytes)",
+            cxxopts::value<std::string>()->default_value("16"), "LIST")
+        ("wire", "Wire format: protobuf or compact", cxxopts::value<std::string>()->default_value("protobuf"), "FORMAT")
+        ("transport", "zmq, tcp or unix:<path>; must match the server's --frontend", cxxopts::value<std::string>()->default_value("zmq"), "KIND")
+        ("embedded", "Run a server with this many threads inside the benchmark over inproc, 0 uses an external one",
+            cxxopts::value<int>()->default_value("0"), "THREADS")
+        ("embedded-restart", "Stop and start the embedded server again before every run after the first")
+        ("busy-poll-us", "Spin on non-blocking receives this long before blocking, 0 disables", cxxopts::value<uint32_t>()->default_value("0"), "US")
+        ("trace", "Ask the server for per-request timings and break the latency down into stages")
+        ("hedge", "Servers to hedge slow BLOCKING submits to, e.g. 10.0.0.2:24737,10.0.0.3:24737 (zmq transport)",
+            cxxopts::value<std::string>()->default_value(""), "LIST")
+        ("hedge-percentile", "Hedge a submit once it is slower than this percentile of the recent ones",
+            cxxopts::value<uint32_t>()->default_value("95"), "PCT")
+        ("hedge-budget-pct", "At most this many hedges per 100 BLOCKING submits", cxxopts::value<uint32_t>()->default_value("5"), "PCT")
+        ("cpus", "CPU list for the connection threads, one CPU each round-robin, e.g. 2-5", cxxopts::value<std::string>()->default_value(""), "LIST")
+        ("json", "Also write the results as JSON to this file ('-' for stdout)", cxxopts::value<std::string>(), "PATH")
+        ("h,help", "Print usage");
+
+    auto parsed = options.parse(argc, argv);
+    if (parsed.count("help")) {
+        printf("%s\n", options.help().c_str());
+        return 0;
+    }
+    GOOGLE_PROTOBUF_VERIFY_VERSION;
+
+    BenchConfig config;
+    config.address = parsed["address"].as<std::string>();
+    config.port = parsed["port"].as<int>();
+    config.connections = parsed["connections"].as<int>();
+    config.durationS = parsed["duration"].as<double>();
+    config.warmupS = parsed["warmup"].as<double>();
+    config.rate = parsed["rate"].as<double>();
+    config.nonblockRatio = parsed["nonblock"].as<double>();
+    const std::string mode = parsed["mode"].as<std::string>();
+    const std::string wire = parsed["wire"].as<std::string>();
+    if (mode != "closed" && mode != "open") {
+        spdlog::error("Invalid mode: {}", mode);
+        return EC_FAILURE;
+    }
+    config.openLoop = mode == "open";
+    if (wire != "protobuf" && wire != "compact") {
+        spdlog::error("Invalid wire format: {}", wire);
+        return EC_FAILURE;
+    }
+    config.options.wireFormat = wire == "compact" ? ipc::WIRE_COMPACT : ipc::WIRE_PROTOBUF;
+    config.options.busyPollUs = parsed["busy-poll-us"].as<uint32_t>();
+    config.options.trace = parsed.count("trace") != 0;
+    config.options.hedgePercentile = parsed["hedge-percentile"].as<uint32_t>();
+    config.options.hedgeBudgetPct = parsed["hedge-budget-pct"].as<uint32_t>();
+    if (client::parseHedgeEndpoints(parsed["hedge"].as<std::string>(), config.options.hedge) != EC_SUCCESS ||
+        config.options.hedgePercentile < 1 || config.options.hedgePercentile > 100 ||
+        config.options.hedgeBudgetPct < 1 || config.options.hedgeBudgetPct > 100) {
+        spdlog::error("Invalid --hedge, --hedge-percentile or --hedge-budget-pct");
+        return EC_FAILURE;
+    }
+    const int embedded = parsed["embedded"].as<int>();
+    const std::string transport = embedded > 0 ? std::string(kEmbeddedEndpoint) : parsed["transport"].as<std::string>();
+    if (embedded < 0 || framing::parseEndpoint(transport, config.options.transport) != EC_SUCCESS) {
+        spdlog::error("Invalid --transport or --embedded: {}", transport);
+        return EC_FAILURE;
+    }
+    if (affinity::parseCpuList(parsed["cpus"].as<std::string>(), config.cpus) != EC_SUCCESS) {
+        spdlog::error("Invalid --cpus: {}", parsed["cpus"].as<std::string>());
+        return EC_FAILURE;
+    }
+    if (config.connections <= 0 || config.durationS <= 0.0 || config.warmupS < 0.0 || config.rate <= 0.0 ||
+        config.nonblockRatio < 0.0 || config.nonblockRatio > 1.0) {
+        spdlog::error("Invalid connections, duration, warmup, rate or nonblock ratio");
+        return EC_FAILURE;
+    }
+    int result = parseMix(parsed["mix"].as<std::string>(), config.weights);
+    RETURN_IF_ERROR(ErrorType::DEFAULT, result, "Invalid --mix");
+    result = parseSizes(parsed["sizes"].as<std::string>(), config.sizes);
+    RETURN_IF_ERROR(ErrorType::DEFAULT, result, "Invalid --sizes");
+
+    std::signal(SIGINT, onSignal);
+    std::signal(SIGTERM, onSignal);
+
+    if (embedded > 0) {
+        result = startEmbedded(embedded);
+        RETURN_IF_ERROR(ErrorType::DEFAULT, result, "Failed to start the embedded server");
+    }
+    zmq::context_t ctx(1);
+    std::vector<RunResult> results;
+    const bool restart = embedded > 0 && parsed.count("embedded-restart") > 0;
+    for (std::size_t size : config.sizes) {
+        if (sigStop.load()) {
+            break;
+        }
+        if (restart && results.empty() == false) {
+            result = serverStop();
+            result = (result == EC_SUCCESS) ? serverDeinitialize() : result;
+            result = (result == EC_SUCCESS) ? startEmbedded(embedded) : result;
+            if (result != EC_SUCCESS) {
+                spdlog::error("Failed to restart the embedded server");
+                return EC_FAILURE;
+            }
+        }
+        RunResult run;
+        result = runOnce(ctx, config, size, run);
+        if (result != EC_SUCCESS) {
+            break;
+        }
+        results.push_back(run);
+    }
+    if (embedded > 0) {
+        // Every session of runOnce is closed by now.
+        serverStop();
+        serverDeinitialize();
+    }
+    RETURN_IF_ERROR(ErrorType::DEFAULT, result, "Benchmark run failed");
+
+    printText(config, results);
+    if (parsed.count("json")) {
+        const std::string path = parsed["json"].as<std::string>();
+        FILE* out = (path == "-") ? stdout : std::fopen(path.c_str(), "w");
+        if (out == nullptr) {
+            spdlog::error("Cannot open {}", path);
+            return EC_FAILURE;
+        }
+        printJson(out, config, results);
+        if (out != stdout) {
+            std::fclose(out);
+        }
+    }
+    google::protobuf::ShutdownProtobufLibrary();
+    return EC_SUCCESS;
+}
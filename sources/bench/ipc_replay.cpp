@@ -0,0 +1,403 @@
+#include "bench_harness.h"
+#include "capture_file.h"
+#include "client/session.h"
+#include "framing.h"
+#include "error_handling.h"
+#include "wire_format.h"
+#include "ipc.h"
+#include "cxxopts.hpp"
+#include <google/protobuf/stubs/common.h>
+#include <spdlog/spdlog.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <map>
+#include <memory>
+#include <thread>
+#include <unordered_map>
+
+/// @brief Re-issues a capture recorded with the server's `capture_dir` option.
+///
+/// Every captured client gets its own connection, set up from its captured FirstHandshake, and
+/// sends its requests in their captured order at their captured offsets, scaled by `--speed`
+/// (0 sends as fast as the server answers). The clients are spread over `--threads` threads;
+/// each thread sends the requests of its clients merged in captured order, so a slow reply to
+/// one client delays the others on its thread and shows up as late requests. Tickets and pattern
+/// set handles the original server handed out are mapped to the ones the replay server hands out.
+///
+/// Replayed requests are traced, and the report compares, per request kind, the captured
+/// service time with the replay server's own, both measured on the router from reading the
+/// frame to sending the reply; the client round trip is shown next to them. `--compare` instead
+/// compares the service times of two captures, e.g. of the same traffic replayed against two
+/// builds of a server that captures as well.
+
+namespace {
+
+    std::atomic<bool> sigStop{false};
+
+    void onSignal(int) {
+        sigStop.store(true, std::memory_order_relaxed);
+    }
+
+    /// The captured traffic of one client connection.
+    struct ClientTrace {
+        std::string id;
+        client::Options options;
+        uint8_t execFunFlags = ExecFunFlags::ADD | ExecFunFlags::SUB | ExecFunFlags::MULT | ExecFunFlags::DIV |
+            ExecFunFlags::CONCAT | ExecFunFlags::FIND_START | ExecFunFlags::FIND_ANY;
+        std::vector<const capture::Record*> requests;
+    };
+
+    /// Latencies of one request kind, in ns.
+    struct KindSamples {
+        std::vector<uint64_t> capturedNs;
+        std::vector<uint64_t> replayedNs; ///< Service time the replay server reported.
+        std::vector<uint64_t> roundTripNs;
+        uint64_t errors = 0;
+    };
+
+    using KindMap = std::map<std::string, KindSamples>;
+
+    struct ReplayConfig {
+        std::string address;
+        int port = 24737;
+        framing::Endpoint transport;
+        double speed = 1.0;          ///< 0 replays as fast as possible.
+        int receiveTimeoutMs = 3000;
+        std::size_t threads = 16;
+    };
+
+    /// @return "submit/math", "get", "get_many", ... for the report.
+    std::string kindOf(const ipc::EnvelopeReq& request) {
+        const auto* field = request.GetDescriptor()->FindFieldByNumber(request.req_case());
+        if (field == nullptr) {
+            return "unknown";
+        }
+        std::string kind = field->name();
+        if (request.has_submit()) {
+            const auto* payload = request.submit().GetDescriptor()->FindFieldByNumber(request.submit().payload_case());
+            kind += "/" + (payload == nullptr ? std::string("none") : payload->name());
+        }
+        return kind;
+    }
+
+    bool decode(const capture::Record& record, ipc::EnvelopeReq& request) {
+        if (record.header.wireFormat == ipc::WIRE_COMPACT) {
+            return wire::decodeRequest(record.payload.data(), record.payload.size(), request);
+        }
+        return request.ParseFromString(record.payload);
+    }
+
+    /// @brief Groups the records by client and reads each client's session settings from its handshake.
+    /// @return The time of the first record, the origin of every schedule.
+    uint64_t splitByClient(const std::vector<capture::Record>& records, std::vector<ClientTrace>& clients) {
+        std::unordered_map<std::string, std::size_t> index;
+        uint64_t origin = 0;
+        for (const capture::Record& record : records) {
+            auto [it, added] = index.emplace(record.clientId, clients.size());
+            if (added) {
+                clients.emplace_back();
+                clients.back().id = record.clientId;
+                clients.back().options.wireFormat = static_cast<ipc::WireFormat>(record.header.wireFormat);
+            }
+            ClientTrace& trace = clients[it->second];
+            if (static_cast<capture::RecordKind>(record.header.kind) == capture::RecordKind::HANDSHAKE) {
+                ipc::FirstHandshake handshake;
+                if (handshake.ParseFromString(record.payload)) {
+                    trace.options.name = handshake.client_name();
+                    trace.execFunFlags = static_cast<uint8_t>(handshake.exec_functions());
+                    for (int word = 0; word < handshake.capabilities_size(); ++word) {
+                        for (uint32_t bit = 0; bit < 64; ++bit) {
+                            if ((handshake.capabilities(word) >> bit) & 1u) {
+                                trace.options.ops.push_back(static_cast<uint32_t>(word) * 64 + bit);
+                            }
+                        }
+                    }
+                }
+                continue;
+            }
+            origin = (origin == 0) ? record.header.arrivalNs : std::min(origin, record.header.arrivalNs);
+            trace.requests.push_back(&record);
+        }
+        return origin;
+    }
+
+    /// @brief Replaces the captured tickets and handles in `request` with the replay's own.
+    void remapIds(ipc::EnvelopeReq& request, const std::unordered_map<uint64_t, uint64_t>& ids) {
+        auto remap = [&] (uint64_t id) {
+            auto it = ids.find(id);
+            return it == ids.end() ? id : it->second;
+        };
+        switch (request.req_case()) {
+        case ipc::EnvelopeReq::kGet:
+            request.mutable_get()->mutable_ticket()->set_req_id(remap(request.get().ticket().req_id()));
+            break;
+        case ipc::EnvelopeReq::kGetMany:
+            for (ipc::Ticket& ticket : *request.mutable_get_many()->mutable_tickets()) {
+                ticket.set_req_id(remap(ticket.req_id()));
+            }
+            break;
+        case ipc::EnvelopeReq::kStream:
+            if (request.stream().has_chunk()) {
+                ipc::Ticket* ticket = request.mutable_stream()->mutable_chunk()->mutable_ticket();
+                ticket->set_req_id(remap(ticket->req_id()));
+            }
+            break;
+        case ipc::EnvelopeReq::kSubmit:
+            if (request.submit().has_find_any()) {
+                ipc::FindAnyArgs* args = request.mutable_submit()->mutable_find_any();
+                args->set_handle(remap(args->handle()));
+            }
+            break;
+        default:
+            break;
+        }
+    }
+
+    /// @return The ticket or handle the replay server handed out, matching `RecordHeader::issuedId`.
+    uint64_t issuedId(const ipc::EnvelopeResp& response) {
+        switch (response.resp_case()) {
+        case ipc::EnvelopeResp::kSubmit:
+            return response.submit().ticket().req_id();
+        case ipc::EnvelopeResp::kStream:
+            return response.stream().ticket().req_id();
+        case ipc::EnvelopeResp::kPatterns:
+            return response.patterns().handle();
+        default:
+            return 0;
+        }
+    }
+
+    /// @brief Replays the clients of one thread, their requests merged in captured order.
+    void replayClients(
+        zmq::context_t& ctx,
+        const ReplayConfig& config,
+        const std::vector<const ClientTrace*>& traces,
+        const uint64_t origin,
+        const std::chrono::steady_clock::time_point start,
+        KindMap& samples,
+        std::atomic<uint64_t>& late
+    ) {
+        using clock = std::chrono::steady_clock;
+        struct Replayed {
+            std::unique_ptr<client::Session> session;
+            std::unordered_map<uint64_t, uint64_t> ids;
+        };
+        auto connect = [&] (const ClientTrace& trace) {
+            client::Options options = trace.options;
+            options.transport = config.transport;
+            auto session = std::make_unique<client::Session>(
+                ctx, sigStop, config.address.c_str(), config.port, config.receiveTimeoutMs, trace.execFunFlags, options);
+            return session->init() == EC_SUCCESS ? std::move(session) : nullptr;
+        };
+        std::vector<Replayed> replayed(traces.size());
+        std::vector<std::pair<const capture::Record*, std::size_t>> schedule;
+        for (std::size_t c = 0; c < traces.size(); ++c) {
+            replayed[c].session = connect(*traces[c]);
+            for (const capture::Record* record : traces[c]->requests) {
+                schedule.emplace_back(record, c);
+            }
+        }
+        // Stable, so one client's requests keep their captured order on equal arrival times.
+        std::stable_sort(schedule.begin(), schedule.end(), [] (const auto& a, const auto& b) {
+            return a.first->header.arrivalNs < b.first->header.arrivalNs;
+        });
+
+        for (const auto& [record, c] : schedule) {
+            std::unique_ptr<client::Session>& session = replayed[c].session;
+            std::unordered_map<uint64_t, uint64_t>& ids = replayed[c].ids;
+            ipc::EnvelopeReq request;
+            if (decode(*record, request) == false) {
+                ++samples["undecodable"].errors;
+                continue;
+            }
+            KindSamples& kind = samples[kindOf(request)];
+            // Replies the server parked have no captured service time; leave them out on both sides.
+            const bool measured = record->header.serviceUs != capture::kServiceDeferred;
+            if (measured) {
+                kind.capturedNs.push_back(uint64_t{record->header.serviceUs} * 1000);
+            }
+            if (session == nullptr || sigStop.load(std::memory_order_relaxed)) {
+                ++kind.errors;
+                continue;
+            }
+            if (config.speed > 0.0) {
+                const auto offset = std::chrono::duration<double, std::nano>(
+                    static_cast<double>(record->header.arrivalNs - origin) / config.speed);
+                const auto scheduled = start + std::chrono::duration_cast<clock::duration>(offset);
+                if (clock::now() > scheduled + std::chrono::milliseconds(1)) {
+                    late.fetch_add(1, std::memory_order_relaxed);
+                } else {
+                    std::this_thread::sleep_until(scheduled);
+                }
+            }
+            remapIds(request, ids);
+            request.set_trace(true);
+            ipc::EnvelopeResp response;
+            const auto sentAt = clock::now();
+            if (session->call(request, response) != EC_SUCCESS) {
+                ++kind.errors;
+                // A late reply would be read as the answer to the next request, so start over on a fresh socket.
+                session = connect(*traces[c]);
+                continue;
+            }
+            kind.roundTripNs.push_back(static_cast<uint64_t>(
+                std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - sentAt).count()));
+            // The capture measures from reading the frame to handing back the reply, as send_ns does.
+            const ipc::RequestTiming& timing = response.timing();
+            if (measured && timing.send_ns() >= timing.recv_ns() && timing.recv_ns() != 0) {
+                kind.replayedNs.push_back(timing.send_ns() - timing.recv_ns());
+            }
+            if (record->header.issuedId != 0) {
+                ids[record->header.issuedId] = issuedId(response);
+            }
+        }
+    }
+
+    int loadCapture(const std::string& dir, std::vector<capture::Record>& records) {
+        std::vector<std::string> files;
+        int result = capture::listFiles(dir, files);
+        RETURN_IF_ERROR(ErrorType::DEFAULT, result, "Cannot list the capture");
+        if (files.empty()) {
+            spdlog::error("No {} files in {}", capture::kExtension, dir);
+            return EC_FAILURE;
+        }
+        for (const std::string& file : files) {
+            result = capture::readFile(file, records);
+            RETURN_IF_ERROR(ErrorType::DEFAULT, result, "Cannot read the capture");
+        }
+        return EC_SUCCESS;
+    }
+
+    /// @brief Collects the captured service times of `records` by request kind into `samples[kind].*field`.
+    void serviceTimes(const std::vector<capture::Record>& records, KindMap& samples, std::vector<uint64_t> KindSamples::* field) {
+        for (const capture::Record& record : records) {
+            if (static_cast<capture::RecordKind>(record.header.kind) != capture::RecordKind::ENVELOPE) {
+                continue;
+            }
+            ipc::EnvelopeReq request;
+            if (decode(record, request) == false) {
+                continue;
+            }
+            if (record.header.serviceUs != capture::kServiceDeferred) {
+                (samples[kindOf(request)].*field).push_back(uint64_t{record.header.serviceUs} * 1000);
+            }
+        }
+    }
+
+    /// @param roundTrips Adds the replay's client round trips, which include the network and the client.
+    void printReport(KindMap& samples, const char* before, const char* after, const bool roundTrips) {
+        printf("%-18s %9s %7s %12s %12s %12s %12s %10s %10s", "kind", "requests", "errors",
+            (std::string(before) + " p50").c_str(), (std::string(before) + " p99").c_str(),
+            (std::string(after) + " p50").c_str(), (std::string(after) + " p99").c_str(), "d p50 us", "d p99 us");
+        printf(roundTrips ? " %12s %12s\n" : "\n", "rtt p50", "rtt p99");
+        for (auto& [name, kind] : samples) {
+            const bench::LatencySummary a = bench::summarize(kind.capturedNs);
+            const bench::LatencySummary b = bench::summarize(kind.replayedNs);
+            printf("%-18s %9llu %7llu %12.1f %12.1f %12.1f %12.1f %+10.1f %+10.1f", name.c_str(),
+                (unsigned long long)std::max(a.count, b.count), (unsigned long long)kind.errors,
+                a.p50Us, a.p99Us, b.p50Us, b.p99Us, b.p50Us - a.p50Us, b.p99Us - a.p99Us);
+            if (roundTrips) {
+                const bench::LatencySummary rtt = bench::summarize(kind.roundTripNs);
+                printf(" %12.1f %12.1f", rtt.p50Us, rtt.p99Us);
+            }
+            printf("\n");
+        }
+    }
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    cxxopts::Options options("ipc_replay", "Replays traffic captured by the server's --capture-dir:");
+    options.add_options()
+        ("capture", "Directory of the capture to replay", cxxopts::value<std::string>(), "PATH")
+        ("compare", "Instead of replaying, compare the service times of --capture with this capture", cxxopts::value<std::string>(), "PATH")
+        ("address", "Host name of the server", cxxopts::value<std::string>()->default_value("127.0.0.1"), "STR")
+        ("port", "Port number of the server", cxxopts::value<int>()->default_value("24737"), "PORT")
+        ("transport", "zmq, tcp or unix:<path>; must match the server's --frontend", cxxopts::value<std::string>()->default_value("zmq"), "KIND")
+        ("speed", "Replay N times faster than captured (1 keeps the captured pacing), 0 sends as fast as possible",
+            cxxopts::value<double>()->default_value("1"), "N")
+        ("timeout-ms", "Receive timeout per request", cxxopts::value<int>()->default_value("3000"), "MS")
+        ("threads", "Threads the captured clients are spread over", cxxopts::value<int>()->default_value("16"), "N")
+        ("h,help", "Print usage");
+
+    auto parsed = options.parse(argc, argv);
+    if (parsed.count("help") || parsed.count("capture") == 0) {
+        printf("%s\n", options.help().c_str());
+        return parsed.count("help") ? 0 : EC_FAILURE;
+    }
+    GOOGLE_PROTOBUF_VERIFY_VERSION;
+
+    std::vector<capture::Record> records;
+    int result = loadCapture(parsed["capture"].as<std::string>(), records);
+    RETURN_IF_ERROR(ErrorType::DEFAULT, result, "Failed to load the capture");
+
+    KindMap samples;
+    if (parsed.count("compare")) {
+        std::vector<capture::Record> other;
+        result = loadCapture(parsed["compare"].as<std::string>(), other);
+        RETURN_IF_ERROR(ErrorType::DEFAULT, result, "Failed to load the capture to compare with");
+        serviceTimes(records, samples, &KindSamples::capturedNs);
+        serviceTimes(other, samples, &KindSamples::replayedNs);
+        printReport(samples, "base", "other", false);
+        google::protobuf::ShutdownProtobufLibrary();
+        return EC_SUCCESS;
+    }
+
+    ReplayConfig config;
+    config.address = parsed["address"].as<std::string>();
+    config.port = parsed["port"].as<int>();
+    config.speed = parsed["speed"].as<double>();
+    config.receiveTimeoutMs = parsed["timeout-ms"].as<int>();
+    const int threadsArg = parsed["threads"].as<int>();
+    if (framing::parseEndpoint(parsed["transport"].as<std::string>(), config.transport) != EC_SUCCESS ||
+        config.transport.transport == framing::Transport::INPROC) {
+        spdlog::error("Invalid --transport: {}", parsed["transport"].as<std::string>());
+        return EC_FAILURE;
+    }
+    if (config.speed < 0.0 || config.receiveTimeoutMs <= 0 || threadsArg <= 0) {
+        spdlog::error("Invalid --speed, --timeout-ms or --threads");
+        return EC_FAILURE;
+    }
+    config.threads = static_cast<std::size_t>(threadsArg);
+
+    std::vector<ClientTrace> clients;
+    const uint64_t origin = splitByClient(records, clients);
+    std::signal(SIGINT, onSignal);
+    std::signal(SIGTERM, onSignal);
+
+    zmq::context_t ctx(1);
+    const std::size_t threadCount = std::max<std::size_t>(1, std::min(config.threads, clients.size()));
+    std::vector<std::vector<const ClientTrace*>> shards(threadCount);
+    for (std::size_t i = 0; i < clients.size(); ++i) {
+        shards[i % threadCount].push_back(&clients[i]);
+    }
+    std::vector<KindMap> perThread(threadCount);
+    std::vector<std::thread> threads;
+    std::atomic<uint64_t> late{0};
+    // A short lead so every connection is up before the first scheduled request.
+    const auto start = std::chrono::steady_clock::now() + std::chrono::milliseconds(100);
+    for (std::size_t i = 0; i < threadCount; ++i) {
+        threads.emplace_back(replayClients, std::ref(ctx), std::cref(config), std::cref(shards[i]), origin, start,
+            std::ref(perThread[i]), std::ref(late));
+    }
+    for (std::thread& t : threads) {
+        t.join();
+    }
+    const double elapsedS = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    for (KindMap& shard : perThread) {
+        for (auto& [name, kind] : shard) {
+            KindSamples& into = samples[name];
+            into.capturedNs.insert(into.capturedNs.end(), kind.capturedNs.begin(), kind.capturedNs.end());
+            into.replayedNs.insert(into.replayedNs.end(), kind.replayedNs.begin(), kind.replayedNs.end());
+            into.roundTripNs.insert(into.roundTripNs.end(), kind.roundTripNs.begin(), kind.roundTripNs.end());
+            into.errors += kind.errors;
+        }
+    }
+    printf("replayed %zu client(s) on %zu thread(s) in %.2f s at speed %g, %llu request(s) sent late\n",
+        clients.size(), threadCount, elapsedS, config.speed, (unsigned long long)late.load());
+    printReport(samples, "captured", "replay", true);
+    google::protobuf::ShutdownProtobufLibrary();
+    return EC_SUCCESS;
+}
@@ -0,0 +1,229 @@
+#include <google/protobuf/stubs/common.h>
+#include "bench_harness.h"
+#include "cxxopts.hpp"
+#include "error_handling.h"
+#include "ipc.pb.h"
+#include "server/algorithm_runner.h"
+#include "server/reduce.h"
+#include <spdlog/spdlog.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+// Component-level numbers for the server: AlgoRunner calls, envelope (de)serialization,
+// the error-check macros and the worker queue. Run two builds with the same options on the
+// same machine and compare the median columns.
+
+static ipc::SubmitRequest makeSubmit(ipc::SubmitMode mode) {
+    ipc::SubmitRequest req;
+    req.set_mode(mode);
+    req.mutable_math()->set_op(ipc::MATH_ADD);
+    req.mutable_math()->set_a(1234);
+    req.mutable_math()->set_b(5678);
+    return req;
+}
+
+static ipc::SubmitRequest makeFind(ipc::SubmitMode mode) {
+    ipc::SubmitRequest req;
+    req.set_mode(mode);
+    req.mutable_str()->set_op(ipc::STR_FIND_START);
+    req.mutable_str()->set_s1("the quick brown fox jumps over the lazy dog");
+    req.mutable_str()->set_s2("lazy");
+    return req;
+}
+
+static ipc::SubmitRequest makeReduceSum(std::size_t n) {
+    ipc::SubmitRequest req;
+    req.set_mode(ipc::BLOCKING);
+    req.mutable_reduce()->set_op(ipc::REDUCE_SUM);
+    req.mutable_reduce()->set_wide(true);
+    std::string* values = req.mutable_reduce()->mutable_values();
+    values->resize(n * 4);
+    for (std::size_t i = 0; i < n; ++i) {
+        const int32_t v = static_cast<int32_t>(i);
+        std::memcpy(values->data() + 4 * i, &v, sizeof(v));
+    }
+    return req;
+}
+
+[[gnu::noinline]] static int checkedCall(int status) {
+    RETURN_IF_ERROR(ErrorType::DEFAULT, status, "never taken in this benchmark");
+    return status;
+}
+
+[[gnu::noinline]] static int uncheckedCall(int status) {
+    return status;
+}
+
+/// Adds the worker queue hand-off (enqueue until a worker picks the job up) recorded by
+/// the runner's STATS counters since the last reset. The percentiles are reported in the
+/// median column, min/max carry the same value.
+static void addHandoff(const server::AlgoRunner& runner, int threads, std::vector<bench::Result>& results) {
+    ipc::StatsRequest request;
+    request.set_reset(true);
+    ipc::StatsResponse stats;
+    runner.stats(request, stats);
+    for (const ipc::OpStats& op : stats.ops()) {
+        if (op.op() != "add" || op.queue_wait().count() == 0) {
+            continue;
+        }
+        const std::pair<const char*, uint64_t> percentiles[] = {
+            {"p50", op.queue_wait().p50_ns()},
+            {"p99", op.queue_wait().p99_ns()},
+        };
+        for (const auto& [label, ns] : percentiles) {
+            bench::Result r;
+            r.name = "queue/handoff-" + std::string(label) + "/" + std::to_string(threads) + "threads";
+            r.iterations = op.queue_wait().count();
+            r.medianNs = r.minNs = r.maxNs = static_cast<double>(ns);
+            results.push_back(r);
+        }
+    }
+}
+
+int main(int argc, char* argv[]) {
+    cxxopts::Options options("micro_bench", "Server component microbenchmarks:");
+    options.add_options()
+        ("iterations", "Iterations per repetition", cxxopts::value<uint64_t>()->default_value("200000"), "INT")
+        ("repetitions", "Timed repetitions per case", cxxopts::value<int>()->default_value("7"), "INT")
+        ("workers", "AlgoRunner worker threads", cxxopts::value<int>()->default_value("4"), "INT")
+        ("max-threads", "Largest number of submitting threads, doubled from 1", cxxopts::value<int>()->default_value("8"), "INT")
+        ("json", "Print results as JSON", cxxopts::value<bool>()->default_value("false"))
+        ("h,help", "Print usage");
+    auto resultParser = options.parse(argc, argv);
+    if (resultParser.count("help")) {
+        printf("%s\n", options.help().c_str());
+        return 0;
+    }
+    GOOGLE_PROTOBUF_VERIFY_VERSION;
+    spdlog::set_level(spdlog::level::warn);
+    const uint64_t iterations = resultParser["iterations"].as<uint64_t>();
+    const int repetitions = resultParser["repetitions"].as<int>();
+    const int workers = resultParser["workers"].as<int>();
+    const int maxThreads = resultParser["max-threads"].as<int>();
+    if (iterations == 0 || repetitions <= 0 || workers <= 0 || maxThreads <= 0) {
+        spdlog::error("iterations, repetitions, workers and max-threads must be positive");
+        return EC_FAILURE;
+    }
+
+    std::vector<bench::Result> results;
+
+    // ----- error-check macros on the success path -----
+    volatile int success = EC_SUCCESS;
+    results.push_back(bench::measure("errorCheck/unchecked-call", iterations * 10, repetitions, [&] {
+        bench::doNotOptimize(uncheckedCall(success));
+    }));
+    results.push_back(bench::measure("errorCheck/RETURN_IF_ERROR-success", iterations * 10, repetitions, [&] {
+        bench::doNotOptimize(checkedCall(success));
+    }));
+
+    // ----- envelope serialization -----
+    {
+        ipc::EnvelopeReq request;
+        *request.mutable_submit() = makeFind(ipc::BLOCKING);
+        ipc::EnvelopeResp response;
+        response.mutable_submit()->set_status(ipc::ST_SUCCESS);
+        response.mutable_submit()->mutable_result()->set_position(35);
+        std::string reqBuf;
+        std::string respBuf;
+        request.SerializeToString(&reqBuf);
+        response.SerializeToString(&respBuf);
+        results.push_back(bench::measure("envelope/req/encode", iterations, repetitions, [&] {
+            request.SerializeToString(&reqBuf);
+            bench::doNotOptimize(reqBuf.data());
+        }));
+        results.push_back(bench::measure("envelope/req/decode", iterations, repetitions, [&] {
+            ipc::EnvelopeReq decoded;
+            bench::doNotOptimize(decoded.ParseFromString(reqBuf));
+        }));
+        results.push_back(bench::measure("envelope/resp/encode", iterations, repetitions, [&] {
+            response.SerializeToString(&respBuf);
+            bench::doNotOptimize(respBuf.data());
+        }));
+        results.push_back(bench::measure("envelope/resp/decode", iterations, repetitions, [&] {
+            ipc::EnvelopeResp decoded;
+            bench::doNotOptimize(decoded.ParseFromString(respBuf));
+        }));
+    }
+
+    // ----- AlgoRunner -----
+    server::AlgoRunner runner;
+    int result = runner.init(workers, server::Config{});
+    RETURN_IF_ERROR(ErrorType::DEFAULT, result, "Failed to initialize AlgoRunner");
+
+    const ipc::SubmitRequest blockingAdd = makeSubmit(ipc::BLOCKING);
+    const ipc::SubmitRequest blockingFind = makeFind(ipc::BLOCKING);
+    results.push_back(bench::measure("algo/run-blocking/add", iterations, repetitions, [&] {
+        ipc::SubmitResponse response;
+        runner.run(blockingAdd, response);
+        bench::doNotOptimize(response.status());
+    }));
+    results.push_back(bench::measure("algo/run-blocking/find", iterations, repetitions, [&] {
+        ipc::SubmitResponse response;
+        runner.run(blockingFind, response);
+        bench::doNotOptimize(response.status());
+    }));
+
+    // Reduction kernels on 64Ki elements, portable vs the ones picked for this CPU, then a
+    // 1Mi element sum through the runner, which splits it across the workers.
+    {
+        const ipc::SubmitRequest sum = makeReduceSum(1u << 20);
+        const std::string& values = sum.reduce().values();
+        const std::size_t n = 1u << 16;
+        for (const server::reduce::Kernels* k : {&server::reduce::genericKernels(), &server::reduce::kernels()}) {
+            const std::string prefix = std::string("reduce/") + k->isa;
+            results.push_back(bench::measure(prefix + "/sum64/64Ki", std::max<uint64_t>(iterations / 10, 1), repetitions, [&] {
+                bench::doNotOptimize(k->sum64(values.data(), n));
+            }));
+            results.push_back(bench::measure(prefix + "/dot32/64Ki", std::max<uint64_t>(iterations / 10, 1), repetitions, [&] {
+                bench::doNotOptimize(k->dot32(values.data(), values.data(), n));
+            }));
+            std::string out(n * 8, '\0');
+            results.push_back(bench::measure(prefix + "/prefix64/64Ki", std::max<uint64_t>(iterations / 10, 1), repetitions, [&] {
+                k->prefix64(values.data(), n, 0, out.data());
+                bench::doNotOptimize(out[8 * (n - 1)]);
+            }));
+        }
+        results.push_back(bench::measure("algo/run-blocking/reduce-sum-1Mi", std::max<uint64_t>(iterations / 100, 1), repetitions, [&] {
+            ipc::SubmitResponse response;
+            runner.run(sum, response);
+            bench::doNotOptimize(response.status());
+        }));
+    }
+
+    // Every submitting thread waits for its own ticket, so this is the full enqueue ->
+    // worker -> condvar -> get round trip under increasing contention on the queue.
+    const ipc::SubmitRequest nonblockingAdd = makeSubmit(ipc::NONBLOCKING);
+    for (int threads = 1; threads <= maxThreads; threads *= 2) {
+        ipc::StatsRequest reset;
+        reset.set_reset(true);
+        ipc::StatsResponse ignored;
+        runner.stats(reset, ignored);
+        results.push_back(bench::measureParallel(
+            "algo/enqueue+get/" + std::to_string(threads) + "threads",
+            threads, iterations / threads, repetitions, [&] (int) {
+            ipc::SubmitResponse submitted;
+            runner.run(nonblockingAdd, submitted);
+            ipc::GetRequest get;
+            *get.mutable_ticket() = submitted.ticket();
+            get.set_wait_mode(ipc::WAIT_UP_TO);
+            get.set_timeout_ms(1000);
+            ipc::GetResponse response;
+            runner.get(get, response);
+            bench::doNotOptimize(response.status());
+        }));
+        addHandoff(runner, threads, results);
+    }
+
+    result = runner.deinit();
+    RETURN_IF_ERROR(ErrorType::DEFAULT, result, "Failed to deinitialize AlgoRunner");
+
+    if (resultParser["json"].as<bool>()) {
+        bench::printJson(results, stdout);
+    } else {
+        bench::printText(results);
+    }
+    google::protobuf::ShutdownProtobufLibrary();
+    return 0;
+}
@@ -0,0 +1,134 @@
+#include <google/protobuf/stubs/common.h>
+#include <google/protobuf/arena.h>
+#include "bench_harness.h"
+#include "cxxopts.hpp"
+#include "ipc.pb.h"
+#include "wire_format.h"
+#include <cstdio>
+
+// Compares encode+decode cost of the compact wire format against the protobuf encoding in ipc.pb.h.
+
+static ipc::EnvelopeReq makeMathRequest() {
+    ipc::EnvelopeReq env;
+    ipc::SubmitRequest* submit = env.mutable_submit();
+    submit->set_mode(ipc::BLOCKING);
+    submit->mutable_math()->set_op(ipc::MATH_SUB);
+    submit->mutable_math()->set_a(-123456);
+    submit->mutable_math()->set_b(-7);
+    return env;
+}
+
+static ipc::EnvelopeReq makeStrRequest() {
+    ipc::EnvelopeReq env;
+    ipc::SubmitRequest* submit = env.mutable_submit();
+    submit->set_mode(ipc::NONBLOCKING);
+    submit->mutable_str()->set_op(ipc::STR_FIND_START);
+    submit->mutable_str()->set_s1("the quick brown fox jumps over the lazy dog");
+    submit->mutable_str()->set_s2("lazy");
+    return env;
+}
+
+static ipc::EnvelopeReq makeGetRequest() {
+    ipc::EnvelopeReq env;
+    ipc::GetRequest* get = env.mutable_get();
+    get->mutable_ticket()->set_req_id(0x1234567890ABCDEFull);
+    get->set_wait_mode(ipc::WAIT_UP_TO);
+    get->set_timeout_ms(500);
+    return env;
+}
+
+static ipc::EnvelopeResp makeIntResponse() {
+    ipc::EnvelopeResp env;
+    env.mutable_submit()->set_status(ipc::ST_SUCCESS);
+    env.mutable_submit()->mutable_result()->set_int_result(-123449);
+    return env;
+}
+
+int main(int argc, char* argv[]) {
+    cxxopts::Options options("wire_bench", "Compact wire format vs protobuf:");
+    options.add_options()
+        ("iterations", "Iterations per repetition", cxxopts::value<uint64_t>()->default_value("1000000"), "INT")
+        ("repetitions", "Timed repetitions per case", cxxopts::value<int>()->default_value("7"), "INT")
+        ("json", "Print results as JSON", cxxopts::value<bool>()->default_value("false"))
+        ("h,help", "Print usage");
+    auto resultParser = options.parse(argc, argv);
+    if (resultParser.count("help")) {
+        printf("%s\n", options.help().c_str());
+        return 0;
+    }
+    GOOGLE_PROTOBUF_VERIFY_VERSION;
+    const uint64_t iterations = resultParser["iterations"].as<uint64_t>();
+    const int repetitions = resultParser["repetitions"].as<int>();
+
+    alignas(8) static char scratch[4096];
+    std::vector<bench::Result> results;
+
+    struct RequestCase {
+        const char* name;
+        ipc::EnvelopeReq request;
+    };
+    const RequestCase requestCases[] = {
+        {"math", makeMathRequest()},
+        {"str", makeStrRequest()},
+        {"get", makeGetRequest()},
+    };
+    for (const RequestCase& c : requestCases) {
+        std::string buf;
+        results.push_back(bench::measure(std::string("protobuf/req/") + c.name, iterations, repetitions, [&] {
+            c.request.SerializeToString(&buf);
+            google::protobuf::ArenaOptions arenaOptions;
+            arenaOptions.initial_block = scratch;
+            arenaOptions.initial_block_size = sizeof(scratch);
+            google::protobuf::Arena arena(arenaOptions);
+            ipc::EnvelopeReq* decoded = google::protobuf::Arena::CreateMessage<ipc::EnvelopeReq>(&arena);
+            bench::doNotOptimize(decoded->ParseFromString(buf));
+        }));
+        results.push_back(bench::measure(std::string("compact/req/") + c.name, iterations, repetitions, [&] {
+            wire::encodeRequest(c.request, buf);
+            google::protobuf::ArenaOptions arenaOptions;
+            arenaOptions.initial_block = scratch;
+            arenaOptions.initial_block_size = sizeof(scratch);
+            google::protobuf::Arena arena(arenaOptions);
+            ipc::EnvelopeReq* decoded = google::protobuf::Arena::CreateMessage<ipc::EnvelopeReq>(&arena);
+            bench::doNotOptimize(wire::decodeRequest(buf.data(), buf.size(), *decoded));
+        }));
+    }
+
+    {
+        std::string buf;
+        wire::encodeRequest(makeMathRequest(), buf);
+        results.push_back(bench::measure("compact/req/math-view-only", iterations, repetitions, [&] {
+            wire::MathView view;
+            bench::doNotOptimize(wire::decodeMath(buf.data(), buf.size(), view));
+            bench::doNotOptimize(view);
+        }));
+    }
+
+    const ipc::EnvelopeResp response = makeIntResponse();
+    {
+        std::string buf;
+        results.push_back(bench::measure("protobuf/resp/int", iterations, repetitions, [&] {
+            response.SerializeToString(&buf);
+            ipc::EnvelopeResp decoded;
+            bench::doNotOptimize(decoded.ParseFromString(buf));
+        }));
+        results.push_back(bench::measure("compact/resp/int", iterations, repetitions, [&] {
+            wire::encodeResponse(response, buf);
+            ipc::EnvelopeResp decoded;
+            bench::doNotOptimize(wire::decodeResponse(buf.data(), buf.size(), decoded));
+        }));
+    }
+
+    std::string protoBuf;
+    std::string compactBuf;
+    makeMathRequest().SerializeToString(&protoBuf);
+    wire::encodeRequest(makeMathRequest(), compactBuf);
+    if (resultParser["json"].as<bool>()) {
+        bench::printJson(results, stdout);
+    } else {
+        printf("MathArgs with negative operands: protobuf %zu bytes, compact %zu bytes\n", protoBuf.size(), compactBuf.size());
+        bench::printText(results);
+    }
+    google::protobuf::ShutdownProtobufLibrary();
+    return 0;
+}
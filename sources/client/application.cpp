@@ -4,36 +4,22 @@
 #include <zmq.hpp>
 #include "ipc.pb.h"
 #include "error_handling.h"
-#include <random>
-#include <zmq_addon.hpp> // For zmq::recv_multipart
 #include <cctype>
+#include <cerrno>
+#include <climits>
 #include <unordered_map>
 
 using namespace client;
 
-static std::string random_identity(std::size_t n = 8) {
-    static const char chars[] =
-        "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789";
-    thread_local std::mt19937_64 rng{std::random_device{}()};
-    std::uniform_int_distribution<std::size_t> dist(0, sizeof(chars) - 2);
-    std::string id; id.reserve(n);
-    for (std::size_t i = 0; i < n; ++i) id.push_back(chars[dist(rng)]);
-    return id;
-}
-
 Application::Application(
     const std::atomic<bool>& sigStop,
     const char* address,
     const int port,
     const int receiveTimeoutMs,
-    const uint8_t execFunFlags
+    const uint8_t execFunFlags,
+    const Options& options
 ) : mCtx(1)
-, mSocket(mCtx, zmq::socket_type::dealer)
-, mIdentity(random_identity())
-, mEndpoint(address)
-, mReceiveTimeoutMs(receiveTimeoutMs)
-, mPort(port)
-, mExecFunFlags(execFunFlags)
+, mSession(mCtx, sigStop, address, port, receiveTimeoutMs, execFunFlags, options)
 , mSigStop(sigStop) {}
 
 static std::shared_ptr<client::Application> appPtr = nullptr;
@@ -48,7 +34,8 @@ int Application::create(
     const char* address,
     const int port,
     const int receiveTimeoutMs,
-    const uint8_t execFunFlags
+    const uint8_t execFunFlags,
+    const Options& options
 ) noexcept {
     static int instanceCount = 0;
     if (instanceCount >= 1) {
@@ -66,139 +53,37 @@ int Application::create(
             address,
             port,
             receiveTimeoutMs,
-            execFunFlags
+            execFunFlags,
+            options
         )
     );
     return EC_SUCCESS;
 }
 
 int Application::init() {
-    const std::string endpoint = fmt::format("tcp://{}:{}", mEndpoint, mPort);
-    try {
-        mSocket.set(zmq::sockopt::routing_id, mIdentity);
-        mSocket.set(zmq::sockopt::linger, 100);
-        mSocket.set(zmq::sockopt::rcvtimeo, mReceiveTimeoutMs);
-        mSocket.connect(endpoint);
-        int result = sendFirstHandshake();
-        RETURN_IF_ERROR(ErrorType::DEFAULT, result, "Failed to send first handshake");
-    } catch (const zmq::error_t& e) {
-        spdlog::error("Failed to connect to {}: {}", endpoint, e.what());
-        return EC_FAILURE;
-    }
-    return EC_SUCCESS;
+    return mSession.init();
 }
 
 int Application::deinit() {
-    mSocket.close(); // ZMQ handles the context cleanup, safe if called multiple times.
-    return EC_SUCCESS;
+    return mSession.deinit();
 }
 
 Application::~Application() {
     deinit();
 }
 
-int Application::sendFirstHandshake() {
-    ipc::FirstHandshake handshake;
-    handshake.set_client_name(mIdentity);
-    uint32_t funcFlags = static_cast<uint32_t>(mExecFunFlags);
-    handshake.set_exec_functions(funcFlags);
-    std::string buf;
-    if (handshake.SerializeToString(&buf) == false) {
-        spdlog::error("Failed to serialize FirstHandshake");
-        return EC_FAILURE;
-    }
-    zmq::message_t frame(buf.size());
-    memcpy(frame.data(), buf.data(), buf.size());
-    zmq::send_result_t result = mSocket.send(frame, zmq::send_flags::none);
-    RETURN_IF_ERROR(ErrorType::ZMQ_SEND, result, "Failed to send message");
-    return EC_SUCCESS;
-}
-
-int Application::sendEnvelope(const ipc::EnvelopeReq& env) {
-    std::string buf;
-    if (env.SerializeToString(&buf) == false) {
-        spdlog::error("Failed to serialize EnvelopeReq");
-        return EC_FAILURE;
-    }
-    zmq::message_t frame(buf.size());
-    memcpy(frame.data(), buf.data(), buf.size());
-    zmq::send_result_t result = mSocket.send(frame, zmq::send_flags::none);
-    RETURN_IF_ERROR(ErrorType::ZMQ_SEND, result, "Failed to send message");
-    return EC_SUCCESS;
-}
-
-int Application::recvEnvelope(ipc::EnvelopeResp& out) {
-    std::vector<zmq::message_t> frames;
-    zmq::recv_result_t ok = zmq::recv_multipart(mSocket, std::back_inserter(frames));
-    if (ok.has_value() == false || frames.empty()) {
-        spdlog::warn("Timeout or receive error");
-        return EC_FAILURE;
-    }
-
-    const zmq::message_t& frame = frames.back();
-    if (!out.ParseFromArray(frame.data(), static_cast<int>(frame.size()))) {
-        spdlog::error("Failed to parse EnvelopeResp (sz={})", (int)frame.size());
-        return EC_FAILURE;
-    }
-    return EC_SUCCESS;
-}
-
 int Application::submitBlocking(
     const ipc::SubmitRequest& req,
     ipc::SubmitResponse& out
 ) {
-    ipc::EnvelopeReq env;
-    ipc::SubmitRequest toSend = req;
-    toSend.set_mode(ipc::BLOCKING);
-    *env.mutable_submit() = std::move(toSend);
-    int result = sendEnvelope(env);
-    if (result != EC_SUCCESS) {
-        out.set_status(ipc::ST_ERROR_INTERNAL);
-        spdlog::error("Failed to send EnvelopeReq");
-        return EC_FAILURE;
-    }
-
-    ipc::EnvelopeResp resp;
-    result = recvEnvelope(resp);
-    if (result != EC_SUCCESS) {
-        out.set_status(ipc::ST_ERROR_INTERNAL);
-        spdlog::error("Timeout or receive error (EnvelopeResp)");
-        return EC_FAILURE;
-    }
-
-    if (resp.has_submit() == false) {
-        out.set_status(ipc::ST_ERROR_INTERNAL);
-        spdlog::error("Protocol error: missing submit in EnvelopeResp");
-        return EC_FAILURE;
-    }
-    out = std::move(resp.submit());
-    return EC_SUCCESS;
+    return mSession.submitBlocking(req, out);
 }
 
 int Application::submitNonBlocking(
     const ipc::SubmitRequest& req,
     ipc::SubmitResponse& out
 ) {
-    ipc::EnvelopeReq env;
-    ipc::SubmitRequest toSend = req;
-    toSend.set_mode(ipc::NONBLOCKING);
-    *env.mutable_submit() = std::move(toSend);
-    sendEnvelope(env);
-
-    ipc::EnvelopeResp resp;
-    int result = recvEnvelope(resp);
-    if (result != EC_SUCCESS) {
-        out.set_status(ipc::ST_ERROR_INTERNAL);
-        spdlog::error("Timeout or receive error (EnvelopeResp)");
-        return EC_FAILURE;
-    }
-    if (resp.has_submit() == false) {
-        out.set_status(ipc::ST_ERROR_INTERNAL);
-        spdlog::error("Protocol error: missing submit in EnvelopeResp");
-        return EC_FAILURE;
-    }
-    out = std::move(resp.submit());
-    return EC_SUCCESS;
+    return mSession.submitNonBlocking(req, out);
 }
 
 int Application::getResult(
@@ -207,27 +92,63 @@ int Application::getResult(
     const uint32_t timeoutMs,
     ipc::GetResponse& out
 ) {
-    ipc::EnvelopeReq env;
-    ipc::GetRequest& g = *env.mutable_get();
-    *g.mutable_ticket() = ticket;
-    g.set_wait_mode(waitMode);
-    if (waitMode == ipc::WAIT_UP_TO) {
-        g.set_timeout_ms(timeoutMs);
-    }
+    return mSession.getResult(ticket, waitMode, timeoutMs, out);
+}
 
-    int result = sendEnvelope(env);
-    RETURN_IF_ERROR(ErrorType::DEFAULT, result, "Failed to send EnvelopeReq");
+int Application::getMany(
+    const std::vector<ipc::Ticket>& tickets,
+    const ipc::GetManyWaitMode waitMode,
+    const uint32_t timeoutMs,
+    ipc::GetManyResponse& out
+) {
+    return mSession.getMany(tickets, waitMode, timeoutMs, out);
+}
 
-    ipc::EnvelopeResp resp;
-    result = recvEnvelope(resp);
-    RETURN_IF_ERROR(ErrorType::DEFAULT, result, "Timeout or receive error (EnvelopeResp)");
+int Application::registerPatterns(
+    const std::vector<std::string>& patterns,
+    ipc::RegisterPatternsResponse& out
+) {
+    return mSession.registerPatterns(patterns, out);
+}
 
-    if (resp.has_get() == false) {
-        spdlog::error("Protocol error: missing get in EnvelopeResp");
-        return EC_FAILURE;
-    }
-    out = resp.get();
-    return EC_SUCCESS;
+int Application::stats(
+    const bool reset,
+    ipc::StatsResponse& out
+) {
+    return mSession.stats(reset, out);
+}
+
+int Application::dumpTrace(ipc::TraceDumpResponse& out) {
+    return mSession.dumpTrace(out);
+}
+
+int Application::slowLog(ipc::SlowLogResponse& out) {
+    return mSession.slowLog(out);
+}
+
+int Application::listOps(ipc::ListOpsResponse& out) {
+    return mSession.listOps(out);
+}
+
+uint32_t Application::busyPollUs() const {
+    return mSession.options().busyPollUs;
+}
+
+const busypoll::Counters& Application::pollCounters() const {
+    return mSession.pollCounters();
+}
+
+HedgeCounters Application::hedgeCounters() const {
+    return mSession.hedgeCounters();
+}
+
+int Application::streamFind(
+    const std::string& needle,
+    const std::function<std::size_t(char*, std::size_t)>& read,
+    const std::size_t chunkSize,
+    ipc::StreamResponse& out
+) {
+    return mSession.streamFind(needle, read, chunkSize, out);
 }
 
 static bool insensitiveEquals(const char* a, const char* b) {
@@ -252,6 +173,91 @@ static bool isBlockToken(const char* s) {
         insensitiveEquals(s, "sync");
 }
 
+static void printMatches(const ipc::Matches& matches) {
+    printf("Result: Matches=");
+    for (const ipc::Match& m : matches.matches()) {
+        printf("%d:%u ", m.position(), m.pattern());
+    }
+    printf("\n");
+}
+
+// Prints packed little-endian integers of `width` bytes, the first 16 of them.
+static void printPacked(const std::string& bytes, std::size_t width) {
+    const std::size_t count = bytes.size() / width;
+    printf("Result: Values=");
+    for (std::size_t i = 0; i < count && i < 16; ++i) {
+        uint64_t v = 0;
+        for (std::size_t byte = 0; byte < width; ++byte) {
+            v |= static_cast<uint64_t>(static_cast<unsigned char>(bytes[i * width + byte])) << (8 * byte);
+        }
+        const long long value = width == 4 ? static_cast<int32_t>(v) : static_cast<int64_t>(v);
+        printf("%s%lld", i == 0 ? "" : ",", value);
+    }
+    printf("%s (%zu values)\n", count > 16 ? ",..." : "", count);
+}
+
+static void printHistogram(const char* name, const ipc::LatencyHistogram& h) {
+    if (h.count() == 0) {
+        return;
+    }
+    printf("    %-10s n=%llu mean=%.1fus p50=%.1fus p90=%.1fus p99=%.1fus p99.9=%.1fus max=%.1fus\n",
+        name,
+        (unsigned long long)h.count(),
+        static_cast<double>(h.sum_ns()) / static_cast<double>(h.count()) / 1000.0,
+        h.p50_ns() / 1000.0, h.p90_ns() / 1000.0, h.p99_ns() / 1000.0, h.p999_ns() / 1000.0, h.max_ns() / 1000.0);
+}
+
+static void printPoll(const char* who, uint32_t budgetUs, uint64_t hits, uint64_t misses, uint64_t spinNs) {
+    const uint64_t total = hits + misses;
+    printf("  %s busy_poll=%uus hits=%llu misses=%llu hit_rate=%.1f%% spin=%.1fms\n", who, budgetUs,
+        (unsigned long long)hits, (unsigned long long)misses,
+        total == 0 ? 0.0 : 100.0 * static_cast<double>(hits) / static_cast<double>(total), spinNs / 1e6);
+}
+
+static void printStats(const ipc::StatsResponse& stats) {
+    printf("Stats: window=%llums clients=%u workers=%u utilization=%.1f%% queue=%u jobs=%u streams=%u\n",
+        (unsigned long long)stats.window_ms(), stats.clients(), stats.workers(),
+        stats.worker_utilization() * 100.0, stats.queue_depth(), stats.jobs_retained(), stats.open_streams());
+    if (stats.results_spilled() > 0 || stats.spill_rejected() > 0) {
+        printf("  spill results=%u bytes=%llu rejected=%llu\n", stats.results_spilled(),
+            (unsigned long long)stats.spill_bytes(), (unsigned long long)stats.spill_rejected());
+    }
+    printf("  pool min=%u max=%u peak=%u grows=%llu retires=%llu",
+        stats.workers_min(), stats.workers_max(), stats.workers_peak(),
+        (unsigned long long)stats.pool_grows(), (unsigned long long)stats.pool_retires());
+    for (const ipc::PoolResize& resize : stats.pool_resizes()) {
+        printf(" %llums:%u", (unsigned long long)resize.at_ms(), resize.workers());
+    }
+    printf("\n");
+    for (const ipc::ClassPoolStats& pool : stats.class_pools()) {
+        printf("  class %s workers=%u max=%u peak=%u queue=%u utilization=%.1f%%\n", pool.name().c_str(),
+            pool.workers(), pool.workers_max(), pool.workers_peak(), pool.queue_depth(), pool.utilization() * 100.0);
+    }
+    const ipc::DispatchStats& dispatch = stats.dispatch();
+    printf("  dispatch inline=%llu inline_nonblocking=%llu queued=%llu offloaded=%llu\n",
+        (unsigned long long)dispatch.inline_blocking(), (unsigned long long)dispatch.inline_nonblocking(),
+        (unsigned long long)dispatch.queued(), (unsigned long long)dispatch.offloaded());
+    if (stats.router_poll().budget_us() > 0) {
+        const ipc::BusyPollStats& poll = stats.router_poll();
+        printPoll("router", poll.budget_us(), poll.hits(), poll.misses(), poll.spin_ns());
+    }
+    for (const ipc::ClientQueueStats& c : stats.client_queues()) {
+        printf("  client %s flow=%llu weight=%u queued=%u submitted=%llu served=%llu rate_limited=%llu\n",
+            c.name().c_str(), (unsigned long long)c.flow(), c.weight(), c.queued(), (unsigned long long)c.submitted(),
+            (unsigned long long)c.served(), (unsigned long long)c.rate_limited());
+    }
+    for (const ipc::OpStats& op : stats.ops()) {
+        printf("  %s count=%llu", op.op().c_str(), (unsigned long long)op.count());
+        for (const ipc::StatusCount& sc : op.statuses()) {
+            printf(" %s=%llu", ipc::Status_Name(sc.status()).c_str(), (unsigned long long)sc.count());
+        }
+        printf("\n");
+        printHistogram("queue_wait", op.queue_wait());
+        printHistogram("exec", op.exec());
+        printHistogram("total", op.total());
+    }
+}
+
 static void printSubmit(const ipc::SubmitResponse& response) {
     PRINT_ERROR_NO_RET(ErrorType::IPC, response.status(), "Error in response");
     if (response.has_ticket()) {
@@ -269,6 +275,21 @@ static void printSubmit(const ipc::SubmitResponse& response) {
         case ipc::Result::kStrResult:
             printf("Result: Str=%s\n", value.str_result().c_str());
             break;
+        case ipc::Result::kOffset:
+            printf("Result: Offset=%lld\n", (long long)value.offset());
+            break;
+        case ipc::Result::kMatches:
+            printMatches(value.matches());
+            break;
+        case ipc::Result::kLongResult:
+            printf("Result: Long=%lld\n", (long long)value.long_result());
+            break;
+        case ipc::Result::kValues:
+            printPacked(value.values(), 4);
+            break;
+        case ipc::Result::kLongValues:
+            printPacked(value.long_values(), 8);
+            break;
         case ipc::Result::VALUE_NOT_SET:
         default:
             printf("No result set\n");
@@ -277,17 +298,7 @@ static void printSubmit(const ipc::SubmitResponse& response) {
     }
 }
 
-static void printGet(const ipc::GetResponse& response) {
-    PRINT_ERROR_NO_RET(ErrorType::IPC, response.status(), "Error in response");
-    if (!response.has_result()) {
-        if (response.status() == ipc::ST_NOT_FINISHED) {
-            printf("Result: NOT FINISHED\n");
-        } else {
-            printf("No result payload\n");
-        }
-        return;
-    }
-    const ipc::Result& value = response.result();
+static void printResult(const ipc::Result& value) {
     switch (value.value_case()) {
     case ipc::Result::kIntResult:
         printf("Result: Int=%d\n", value.int_result());
@@ -298,12 +309,52 @@ static void printGet(const ipc::GetResponse& response) {
     case ipc::Result::kStrResult:
         printf("Result: Str=%s\n", value.str_result().c_str());
         break;
+    case ipc::Result::kOffset:
+        printf("Result: Offset=%lld\n", (long long)value.offset());
+        break;
+    case ipc::Result::kMatches:
+        printMatches(value.matches());
+        break;
+    case ipc::Result::kLongResult:
+        printf("Result: Long=%lld\n", (long long)value.long_result());
+        break;
+    case ipc::Result::kValues:
+        printPacked(value.values(), 4);
+        break;
+    case ipc::Result::kLongValues:
+        printPacked(value.long_values(), 8);
+        break;
     case ipc::Result::VALUE_NOT_SET:
     default:
         break;
     }
 }
 
+static void printGet(const ipc::GetResponse& response) {
+    PRINT_ERROR_NO_RET(ErrorType::IPC, response.status(), "Error in response");
+    if (!response.has_result()) {
+        if (response.status() == ipc::ST_NOT_FINISHED) {
+            printf("Result: NOT FINISHED\n");
+        } else {
+            printf("No result payload\n");
+        }
+        return;
+    }
+    printResult(response.result());
+}
+
+static void printGetMany(const ipc::GetManyResponse& response) {
+    for (const ipc::TicketResult& ticket : response.results()) {
+        printf("ticket=%llu ", (unsigned long long)ticket.ticket().req_id());
+        if (ticket.has_result() && ticket.result().value_case() != ipc::Result::VALUE_NOT_SET) {
+            printResult(ticket.result());
+        } else {
+            printf("Status: %s\n", ipc::Status_Name(ticket.status()).c_str());
+        }
+    }
+    printf("Finished: %d Pending: %d\n", response.results_size(), response.pending_size());
+}
+
 static void printHelp() {
     printf(
         "Commands:\n"
@@ -313,40 +364,25 @@ static void printHelp() {
         "  block/non-block div a b        \n"
         "  block/non-block concat s1 s2   \n"
         "  block/non-block find hay needle\n"
+        "  block/non-block findany <handle> hay [all]\n"
+        "  block/non-block expr <postfix>     (one request, e.g. expr 2 3 add 4 mult; other words are strings)\n"
+        "  block/non-block call <id> args...  (registry op by id; integers are ints, other words are strings)\n"
+        "  block/non-block reduce <sum|min|max|dot|prefix> [wide] (v1 v2 ... [| w1 w2 ...] | seq <n>)\n"
+        "                                     (int32 array reduction; wide accumulates in 64 bits, dot takes a second array)\n"
+        "  ops                                (list the server's registry ops)\n"
+        "  patterns p1 [p2 ...]               (register a pattern set for findany)\n"
         "  get <ticket> [nowait | wait <ms>]  (retrieve result for non-blocking ticket)\n"
+        "  getmany [nowait | any <ms> | all <ms>]\n"
+        "                                     (retrieve every pending ticket in one request, waiting for one or all)\n"
+        "  stream <file> <needle>             (upload a file in chunks and find the needle)\n"
         "  list                               (list pending tickets)\n"
+        "  stats [reset]                      (server counters and latencies, optionally start a new window)\n"
+        "  trace                              (write the server's profiling probes as a Chrome trace)\n"
+        "  slowlog                            (submits the server found slower than its slow_request_us)\n"
         "  quit | exit\n"
     );
 }
 
-namespace client {
-    ipc::SubmitRequest makeMath(
-        ipc::MathOp op,
-        int32_t a,
-        int32_t b
-    ) {
-        ipc::SubmitRequest s;
-        auto* m = s.mutable_math();
-        m->set_op(op);
-        m->set_a(a);
-        m->set_b(b);
-        return s;
-    }
-
-    ipc::SubmitRequest makeStr(
-        ipc::StrOp op,
-        const std::string& s1,
-        const std::string& s2
-    ) {
-        ipc::SubmitRequest s;
-        auto* st = s.mutable_str();
-        st->set_op(op);
-        st->set_s1(s1);
-        st->set_s2(s2);
-        return s;
-    }
-};
-
 int Application::run() {
     client::Application& app = client::Application::get();
     std::unordered_map<uint64_t, ipc::Ticket> pending;
@@ -436,6 +472,174 @@ int Application::run() {
             continue;
         }
 
+        // ----- GETMANY COMMAND -----
+        if (insensitiveEquals(tok1, "getmany")) {
+            char waitTok[32] = {0};
+            unsigned ms = 0;
+            const int n = std::sscanf(buf, "%*31s %31s %u", waitTok, &ms);
+            ipc::GetManyWaitMode mode = ipc::GET_MANY_NO_WAIT;
+            if (n >= 1 && insensitiveEquals(waitTok, "any")) {
+                mode = ipc::WAIT_ANY;
+            } else if (n >= 1 && insensitiveEquals(waitTok, "all")) {
+                mode = ipc::WAIT_ALL;
+            } else if (n >= 1 && insensitiveEquals(waitTok, "nowait") == false) {
+                printf("Usage: getmany [nowait | any <ms> | all <ms>]\n");
+                continue;
+            }
+            if (pending.empty()) {
+                printf("No pending tickets.\n");
+                continue;
+            }
+            std::vector<ipc::Ticket> tickets;
+            tickets.reserve(pending.size());
+            for (const auto& kv : pending) {
+                tickets.push_back(kv.second);
+            }
+            ipc::GetManyResponse gres;
+            if (app.getMany(tickets, mode, n >= 2 ? ms : 0u, gres) != EC_SUCCESS) {
+                printf("Error getting results (transport)\n");
+                continue;
+            }
+            PRINT_ERROR_NO_RET(ErrorType::IPC, gres.status(), "Error in response");
+            printGetMany(gres);
+            for (const ipc::TicketResult& ticket : gres.results()) {
+                pending.erase(ticket.ticket().req_id());
+            }
+            continue;
+        }
+
+        // ----- STREAM COMMAND -----
+        if (insensitiveEquals(tok1, "stream")) {
+            char path[256] = {0};
+            char needle[128] = {0};
+            if (std::sscanf(buf, "%*31s %255s %127s", path, needle) != 2) {
+                printf("Usage: stream <file> <needle>\n");
+                continue;
+            }
+            FILE* file = std::fopen(path, "rb");
+            if (file == nullptr) {
+                printf("Cannot open file: %s\n", path);
+                continue;
+            }
+            const std::size_t chunkSize = 1024u * 1024u;
+            ipc::StreamResponse stresp;
+            int rc = app.streamFind(needle, [file] (char* out, std::size_t size) {
+                return std::fread(out, 1, size, file);
+            }, chunkSize, stresp);
+            std::fclose(file);
+            if (rc != EC_SUCCESS) {
+                printf("Error streaming file (transport)\n");
+                continue;
+            }
+            PRINT_ERROR_NO_RET(ErrorType::IPC, stresp.status(), "Error in response");
+            if (stresp.has_result() && stresp.result().has_offset()) {
+                printf("Result: Offset=%lld\n", (long long)stresp.result().offset());
+            }
+            continue;
+        }
+
+        // ----- PATTERNS COMMAND -----
+        if (insensitiveEquals(tok1, "patterns")) {
+            std::vector<std::string> patterns;
+            char* save = nullptr;
+            char* tok = strtok_r(buf, " \t", &save); // skips the command itself
+            while ((tok = strtok_r(nullptr, " \t", &save)) != nullptr) {
+                patterns.emplace_back(tok);
+            }
+            if (patterns.empty()) {
+                printf("Usage: patterns p1 [p2 ...]\n");
+                continue;
+            }
+            ipc::RegisterPatternsResponse presp;
+            if (app.registerPatterns(patterns, presp) != EC_SUCCESS) {
+                printf("Error registering patterns (transport)\n");
+                continue;
+            }
+            PRINT_ERROR_NO_RET(ErrorType::IPC, presp.status(), "Error in response");
+            if (presp.status() == ipc::ST_SUCCESS) {
+                printf("handle=%llu\n", (unsigned long long)presp.handle());
+            }
+            continue;
+        }
+
+        // ----- STATS COMMAND -----
+        if (insensitiveEquals(tok1, "stats")) {
+            char resetTok[32] = {0};
+            const bool reset = std::sscanf(buf, "%*31s %31s", resetTok) == 1 && insensitiveEquals(resetTok, "reset");
+            ipc::StatsResponse stresp;
+            if (app.stats(reset, stresp) != EC_SUCCESS) {
+                printf("Error fetching stats (transport)\n");
+                continue;
+            }
+            printStats(stresp);
+            if (app.busyPollUs() > 0) {
+                const busypoll::Counters& poll = app.pollCounters();
+                printPoll("client", app.busyPollUs(), poll.hits, poll.misses, poll.spinNs);
+            }
+            const HedgeCounters hedge = app.hedgeCounters();
+            if (hedge.requests > 0) {
+                printf("  client hedge requests=%llu hedged=%llu wins=%llu denied=%llu stale=%llu delay=%.1fus\n",
+                    (unsigned long long)hedge.requests, (unsigned long long)hedge.hedged, (unsigned long long)hedge.wins,
+                    (unsigned long long)hedge.denied, (unsigned long long)hedge.stale, hedge.delayNs / 1e3);
+            }
+            continue;
+        }
+
+        // ----- TRACE COMMAND -----
+        if (insensitiveEquals(tok1, "trace")) {
+            ipc::TraceDumpResponse tresp;
+            if (app.dumpTrace(tresp) != EC_SUCCESS) {
+                printf("Error requesting trace (transport)\n");
+                continue;
+            }
+            if (tresp.status() == ipc::ST_ERROR_INVALID_INPUT) {
+                printf("Server was built without PROFILE_APPLICATION\n");
+                continue;
+            }
+            PRINT_ERROR_NO_RET(ErrorType::IPC, tresp.status(), "Error in response");
+            if (tresp.status() == ipc::ST_SUCCESS) {
+                printf("Trace: %s (%llu events)\n", tresp.path().c_str(), (unsigned long long)tresp.events());
+            }
+            continue;
+        }
+
+        // ----- SLOWLOG COMMAND -----
+        if (insensitiveEquals(tok1, "slowlog")) {
+            ipc::SlowLogResponse sresp;
+            if (app.slowLog(sresp) != EC_SUCCESS) {
+                printf("Error fetching the slow-request log (transport)\n");
+                continue;
+            }
+            if (sresp.status() == ipc::ST_ERROR_INVALID_INPUT) {
+                printf("Slow-request log is off on the server (slow_request_us)\n");
+                continue;
+            }
+            PRINT_ERROR_NO_RET(ErrorType::IPC, sresp.status(), "Error in response");
+            printf("Slow requests: %llu recorded, %d kept\n", (unsigned long long)sresp.recorded(), sresp.requests_size());
+            for (const ipc::SlowRequest& r : sresp.requests()) {
+                printf("  %-8s %s client=%s bytes=%u queue_depth=%u worker=%s queue=%.1fus exec=%.1fus total=%.1fus at_ms=%lld\n",
+                    r.op().c_str(), ipc::Status_Name(r.status()).c_str(), r.client().c_str(), r.payload_bytes(),
+                    r.queue_depth(), r.worker().c_str(), r.queue_ns() / 1e3, r.exec_ns() / 1e3, r.total_ns() / 1e3,
+                    (long long)r.at_ms());
+            }
+            continue;
+        }
+
+        // ----- OPS COMMAND -----
+        if (insensitiveEquals(tok1, "ops")) {
+            ipc::ListOpsResponse oresp;
+            if (app.listOps(oresp) != EC_SUCCESS) {
+                printf("Error listing ops (transport)\n");
+                continue;
+            }
+            PRINT_ERROR_NO_RET(ErrorType::IPC, oresp.status(), "Error in response");
+            for (const ipc::OpInfo& info : oresp.ops()) {
+                printf("  %3u %-16s ints=%u strs=%u%s\n", info.id(), info.name().c_str(),
+                    info.int_args(), info.str_args(), info.builtin() ? "" : " (plugin)");
+            }
+            continue;
+        }
+
         // ----- LIST COMMAND -----
         if (insensitiveEquals(tok1, "list")) {
             if (pending.empty()) {
@@ -538,6 +742,152 @@ int Application::run() {
             } else {
                 printf("Error sending request\n");
             }
+        } else if (insensitiveEquals(op, "findany")) {
+            char handleStr[32] = {0}, hay[256] = {0}, allTok[16] = {0};
+            int n = std::sscanf(buf, "%*31s %*31s %31s %255s %15s", handleStr, hay, allTok);
+            if (n < 2) {
+                printf("Usage: %s findany <handle> hay [all]\n", mode);
+                continue;
+            }
+            const uint64_t handle = std::strtoull(handleStr, nullptr, 10);
+            const bool all = (n == 3) && insensitiveEquals(allTok, "all");
+            ipc::SubmitRequest req = client::makeFindAny(handle, hay, all);
+            if (isBlocking) {
+                result = app.submitBlocking(req, sresp);
+            } else {
+                result = app.submitNonBlocking(req, sresp);
+            }
+            if (result == EC_SUCCESS) {
+                printSubmit(sresp);
+                if (isNonBlocking && sresp.has_ticket()) {
+                    pending[sresp.ticket().req_id()] = sresp.ticket();
+                }
+            } else {
+                printf("Error sending request\n");
+            }
+        } else if (insensitiveEquals(op, "expr")) {
+            std::vector<std::string> tokens;
+            char* save = nullptr;
+            strtok_r(buf, " \t", &save); // skips the mode
+            strtok_r(nullptr, " \t", &save); // and the op
+            for (char* tok = nullptr; (tok = strtok_r(nullptr, " \t", &save)) != nullptr;) {
+                tokens.emplace_back(tok);
+            }
+            if (tokens.empty()) {
+                printf("Usage: %s expr <postfix>\n", mode);
+                continue;
+            }
+            ipc::SubmitRequest req = client::makeExpr(tokens);
+            if (isBlocking) {
+                result = app.submitBlocking(req, sresp);
+            } else {
+                result = app.submitNonBlocking(req, sresp);
+            }
+            if (result == EC_SUCCESS) {
+                printSubmit(sresp);
+                if (isNonBlocking && sresp.has_ticket()) {
+                    pending[sresp.ticket().req_id()] = sresp.ticket();
+                }
+            } else {
+                printf("Error sending request\n");
+            }
+        } else if (insensitiveEquals(op, "call")) {
+            std::vector<std::string> tokens;
+            char* save = nullptr;
+            strtok_r(buf, " \t", &save); // skips the mode
+            strtok_r(nullptr, " \t", &save); // and the op
+            const char* idTok = strtok_r(nullptr, " \t", &save);
+            char* end = nullptr;
+            const unsigned long id = idTok != nullptr ? std::strtoul(idTok, &end, 10) : 0;
+            if (idTok == nullptr || *end != '\0' || id > UINT32_MAX) {
+                printf("Usage: %s call <id> args...\n", mode);
+                continue;
+            }
+            for (char* tok = nullptr; (tok = strtok_r(nullptr, " \t", &save)) != nullptr;) {
+                tokens.emplace_back(tok);
+            }
+            ipc::SubmitRequest req = client::makeCall(static_cast<uint32_t>(id), tokens);
+            if (isBlocking) {
+                result = app.submitBlocking(req, sresp);
+            } else {
+                result = app.submitNonBlocking(req, sresp);
+            }
+            if (result == EC_SUCCESS) {
+                printSubmit(sresp);
+                if (isNonBlocking && sresp.has_ticket()) {
+                    pending[sresp.ticket().req_id()] = sresp.ticket();
+                }
+            } else {
+                printf("Error sending request\n");
+            }
+        } else if (insensitiveEquals(op, "reduce")) {
+            static const std::pair<const char*, ipc::ReduceOp> reduceOps[] = {
+                {"sum", ipc::REDUCE_SUM}, {"min", ipc::REDUCE_MIN}, {"max", ipc::REDUCE_MAX},
+                {"dot", ipc::REDUCE_DOT}, {"prefix", ipc::REDUCE_PREFIX_SUM},
+            };
+            std::vector<std::string> tokens;
+            char* save = nullptr;
+            strtok_r(buf, " \t", &save); // skips the mode
+            strtok_r(nullptr, " \t", &save); // and the op
+            for (char* tok = nullptr; (tok = strtok_r(nullptr, " \t", &save)) != nullptr;) {
+                tokens.emplace_back(tok);
+            }
+            std::size_t next = 0;
+            const ipc::ReduceOp* reduceOp = nullptr;
+            for (const auto& [name, rop] : reduceOps) {
+                if (tokens.empty() == false && insensitiveEquals(tokens[0].c_str(), name)) {
+                    reduceOp = &rop;
+                    next = 1;
+                }
+            }
+            const bool wide = next < tokens.size() && insensitiveEquals(tokens[next].c_str(), "wide");
+            next += wide ? 1 : 0;
+            std::vector<int32_t> values;
+            std::vector<int32_t> other;
+            bool valid = reduceOp != nullptr;
+            if (valid && next + 2 == tokens.size() && insensitiveEquals(tokens[next].c_str(), "seq")) {
+                // seq <n>: the values 1..n, and the same array as the second operand of dot.
+                char* end = nullptr;
+                const unsigned long n = std::strtoul(tokens[next + 1].c_str(), &end, 10);
+                valid = *end == '\0' && n <= 4u * 1024u * 1024u;
+                for (unsigned long i = 1; valid && i <= n; ++i) {
+                    values.push_back(static_cast<int32_t>(i));
+                }
+                if (*reduceOp == ipc::REDUCE_DOT) {
+                    other = values;
+                }
+            } else {
+                std::vector<int32_t>* into = &values;
+                for (std::size_t i = next; valid && i < tokens.size(); ++i) {
+                    if (tokens[i] == "|" && into == &values) {
+                        into = &other;
+                        continue;
+                    }
+                    char* end = nullptr;
+                    errno = 0;
+                    const long v = std::strtol(tokens[i].c_str(), &end, 10);
+                    valid = *end == '\0' && errno == 0 && v >= INT32_MIN && v <= INT32_MAX;
+                    into->push_back(static_cast<int32_t>(v));
+                }
+            }
+            if (valid == false) {
+                printf("Usage: %s reduce <sum|min|max|dot|prefix> [wide] (v1 v2 ... [| w1 w2 ...] | seq <n>)\n", mode);
+                continue;
+            }
+            ipc::SubmitRequest req = client::makeReduce(*reduceOp, wide, values, other);
+            if (isBlocking) {
+                result = app.submitBlocking(req, sresp);
+            } else {
+                result = app.submitNonBlocking(req, sresp);
+            }
+            if (result == EC_SUCCESS) {
+                printSubmit(sresp);
+                if (isNonBlocking && sresp.has_ticket()) {
+                    pending[sresp.ticket().req_id()] = sresp.ticket();
+                }
+            } else {
+                printf("Error sending request\n");
+            }
         } else {
             printf("Unknown op. Type 'help'\n");
         }
@@ -3,31 +3,25 @@
 #include "zmq.hpp"
 #include "ipc.pb.h"
 #include <vector>
+#include <functional>
+#include "session.h"
 
 namespace client {
 
     // The `Application` struct encapsulates the client-side logic. It's a singleton
-    // designed to manage a single client's connection and interactions with a server.
+    // designed to manage a single client's connection (a `Session`) and the interactive REPL.
     // The functions are not marked `const` because ZeroMQ's socket operations
     // (like `send` and `recv`) modify the socket state internally.
     struct Application {
     private:
-        // Helper function to send the initial handshake message to the server. Which tells the server which functions
-        // Can be requested by this client.
-        // This message contains the client's unique identity and its execution capabilities.
-        int sendFirstHandshake();
-
-        int sendEnvelope(const ipc::EnvelopeReq& env);
-
-        int recvEnvelope(ipc::EnvelopeResp& out);
-
         // Private constructor to enforce the singleton pattern.
         explicit Application(
             const std::atomic<bool>& sigStop,
             const char* endpoint,
             const int port,
             const int receiveTimeoutMs,
-            const uint8_t execFunFlags
+            const uint8_t execFunFlags,
+            const Options& options
         );
 
     public:
@@ -42,7 +36,8 @@ namespace client {
             const char* address,
             const int port,
             const int receiveTimeoutMs,
-            const uint8_t execFunFlags
+            const uint8_t execFunFlags,
+            const Options& options
         ) noexcept;
 
         // Destructor. Responsible for cleaning up resources, such as the ZeroMQ socket.
@@ -80,14 +75,59 @@ namespace client {
             ipc::GetResponse& out
         );
 
+        // Retrieves the results of several tickets in one round trip. WAIT_ANY returns once one of them is
+        // finished, WAIT_ALL once all are, either at the latest after `timeoutMs`. `out.pending` lists the rest.
+        int getMany(
+            const std::vector<ipc::Ticket>& tickets,
+            const ipc::GetManyWaitMode waitMode,
+            const uint32_t timeoutMs,
+            ipc::GetManyResponse& out
+        );
+
+        // Registers a FIND_ANY pattern set on the server. The returned handle is passed in FindAnyArgs,
+        // the server shares compiled sets between clients and may evict them (ST_ERROR_UNKNOWN_HANDLE).
+        int registerPatterns(
+            const std::vector<std::string>& patterns,
+            ipc::RegisterPatternsResponse& out
+        );
+
+        // Fetches the server statistics (per-operation counts and latencies, queue gauges).
+        // With `reset` the server starts a new window after taking the snapshot.
+        int stats(
+            const bool reset,
+            ipc::StatsResponse& out
+        );
+
+        // Asks the server to write its PROFILE_APPLICATION probes as a Chrome trace file on the server host.
+        int dumpTrace(ipc::TraceDumpResponse& out);
+
+        // Fetches the server's slow-request log, see the "slow_request_us" server setting.
+        int slowLog(ipc::SlowLogResponse& out);
+
+        // Lists the operations of the server's registry.
+        int listOps(ipc::ListOpsResponse& out);
+
+        // Receive spinning of this client, see the "busy_poll_us" option.
+        uint32_t busyPollUs() const;
+        const busypoll::Counters& pollCounters() const;
+
+        // Hedging of this client's BLOCKING submits, see the "hedge" option; `requests` is 0 without it.
+        HedgeCounters hedgeCounters() const;
+
+        // Searches for `needle` in a haystack that is uploaded in chunks of `chunkSize` bytes under one ticket,
+        // so the haystack never has to be held in memory at once. `read` fills a buffer with the next bytes and
+        // returns how many were written; a short read marks the end of the haystack. Stops as soon as the server
+        // reports a match.
+        int streamFind(
+            const std::string& needle,
+            const std::function<std::size_t(char*, std::size_t)>& read,
+            const std::size_t chunkSize,
+            ipc::StreamResponse& out
+        );
+
     private:
         zmq::context_t mCtx;                     // The ZeroMQ context for the client.
-        zmq::socket_t mSocket;                   // The main ZeroMQ socket for communication.
-        const std::string mIdentity;             // A unique, randomly generated ID for the client.
-        const char* mEndpoint;                   // The server's address.
-        const int mReceiveTimeoutMs;             // The timeout for receiving messages.
-        const int mPort;                         // The server's port.
-        const uint8_t mExecFunFlags;             // The bitmask of functions the client can perform.
+        Session mSession;                        // The connection all calls are delegated to.
         const std::atomic<bool>& mSigStop;       // A reference to a flag for graceful shutdown.
     };
 } // namespace client
\ No newline at end of file
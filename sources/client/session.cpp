@@ -0,0 +1,813 @@
+#include "session.h"
+#include "spdlog/spdlog.h"
+#include "fmt/format.h"
+#include "error_handling.h"
+#include "log.h"
+#include "wire_format.h"
+#include "inproc.h"
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <utility>
+
+using namespace client;
+
+// True if the whole token is a decimal int32.
+static bool parseInt32(const std::string& token, int32_t& out) {
+    char* end = nullptr;
+    errno = 0;
+    const long value = std::strtol(token.c_str(), &end, 10);
+    if (token.empty() || *end != '\0' || errno != 0 || value < INT32_MIN || value > INT32_MAX) {
+        return false;
+    }
+    out = static_cast<int32_t>(value);
+    return true;
+}
+
+/// Latencies the hedge delay is taken from, and how many must be seen before hedging starts.
+static constexpr std::size_t kHedgeWindow = 256;
+static constexpr uint64_t kHedgeMinSamples = 32;
+/// The hedge delay is taken again after this many samples.
+static constexpr uint64_t kHedgeRefresh = 32;
+/// Unused budget carries over up to this many hedges, so a burst of slow submits can be hedged.
+static constexpr double kMaxHedgeCredit = 10.0;
+
+int client::parseHedgeEndpoints(const std::string& list, std::vector<HedgeEndpoint>& out) {
+    out.clear();
+    std::size_t start = 0;
+    while (start < list.size()) {
+        std::size_t end = list.find(',', start);
+        if (end == std::string::npos) {
+            end = list.size();
+        }
+        const std::string item = list.substr(start, end - start);
+        const std::size_t colon = item.rfind(':');
+        int32_t port = 0;
+        if (colon == std::string::npos || colon == 0 || parseInt32(item.substr(colon + 1), port) == false ||
+            port <= 0 || port > 65535) {
+            spdlog::error("Invalid hedge endpoint: {} (host:port)", item);
+            return EC_FAILURE;
+        }
+        out.push_back(HedgeEndpoint{item.substr(0, colon), port});
+        start = end + 1;
+    }
+    return EC_SUCCESS;
+}
+
+/// A hedge server that lacks the client's state (a pattern set handle, its rate allowance) answers with an
+/// error the primary would not give; such a reply must not win over the primary's.
+static bool hedgeReplyUsable(const ipc::EnvelopeResp& resp) {
+    if (resp.has_submit() == false) {
+        return false;
+    }
+    const ipc::Status status = resp.submit().status();
+    return status != ipc::ST_ERROR_UNKNOWN_HANDLE && status != ipc::ST_ERROR_RATE_LIMITED &&
+        status != ipc::ST_ERROR_INTERNAL;
+}
+
+static int64_t monotonicNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static std::string random_identity(std::size_t n = 8) {
+    static const char chars[] =
+        "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789";
+    thread_local std::mt19937_64 rng{std::random_device{}()};
+    std::uniform_int_distribution<std::size_t> dist(0, sizeof(chars) - 2);
+    std::string id; id.reserve(n);
+    for (std::size_t i = 0; i < n; ++i) id.push_back(chars[dist(rng)]);
+    return id;
+}
+
+Session::Session(
+    zmq::context_t& ctx,
+    const std::atomic<bool>& sigStop,
+    const char* address,
+    const int port,
+    const int receiveTimeoutMs,
+    const uint8_t execFunFlags,
+    const Options& options
+) : mSocket(framing::isStream(options.transport.transport)
+    ? zmq::socket_t()
+    : zmq::socket_t(options.transport.transport == framing::Transport::INPROC ? inproc::context() : ctx,
+        zmq::socket_type::dealer))
+, mIdentity(random_identity())
+, mEndpoint(address)
+, mReceiveTimeoutMs(receiveTimeoutMs)
+, mPort(port)
+, mExecFunFlags(execFunFlags)
+, mOptions(options)
+, mSigStop(sigStop) {
+    Options hedgeOptions = options;
+    hedgeOptions.hedge.clear();
+    for (const HedgeEndpoint& target : mOptions.hedge) {
+        mHedges.push_back(std::make_unique<Session>(
+            ctx, sigStop, target.address.c_str(), target.port, receiveTimeoutMs, execFunFlags, hedgeOptions));
+    }
+}
+
+Session::~Session() {
+    deinit();
+}
+
+int Session::init() {
+    if (mHedges.empty() == false) {
+        if (mOptions.transport.transport != framing::Transport::ZMQ) {
+            spdlog::error("Hedging needs the zmq transport");
+            return EC_FAILURE;
+        }
+        for (const std::unique_ptr<Session>& hedge : mHedges) {
+            int result = hedge->init();
+            RETURN_IF_ERROR(ErrorType::DEFAULT, result, "Failed to connect a hedge endpoint");
+        }
+        mHedgeSamples.reserve(kHedgeWindow);
+    }
+    if (framing::isStream(mOptions.transport.transport)) {
+        int result = mStream.connect(mOptions.transport, mEndpoint, mPort, mReceiveTimeoutMs);
+        RETURN_IF_ERROR(ErrorType::DEFAULT, result, "Failed to connect the stream transport");
+        result = sendFirstHandshake();
+        RETURN_IF_ERROR(ErrorType::DEFAULT, result, "Failed to send first handshake");
+        return EC_SUCCESS;
+    }
+    const std::string endpoint = (mOptions.transport.transport == framing::Transport::INPROC)
+        ? inproc::address(mOptions.transport.inprocName)
+        : fmt::format("tcp://{}:{}", mEndpoint, mPort);
+    try {
+        mSocket.set(zmq::sockopt::routing_id, mIdentity);
+        mSocket.set(zmq::sockopt::linger, 100);
+        mSocket.set(zmq::sockopt::rcvtimeo, mReceiveTimeoutMs);
+        mSocket.connect(endpoint);
+        int result = sendFirstHandshake();
+        RETURN_IF_ERROR(ErrorType::DEFAULT, result, "Failed to send first handshake");
+    } catch (const zmq::error_t& e) {
+        spdlog::error("Failed to connect to {}: {}", endpoint, e.what());
+        return EC_FAILURE;
+    }
+    return EC_SUCCESS;
+}
+
+int Session::deinit() {
+    for (const std::unique_ptr<Session>& hedge : mHedges) {
+        hedge->deinit();
+    }
+    mSocket.close(); // ZMQ handles the context cleanup, safe if called multiple times.
+    mStream.close();
+    return EC_SUCCESS;
+}
+
+int Session::sendFirstHandshake() {
+    ipc::FirstHandshake handshake;
+    handshake.set_client_name(mOptions.name.empty() ? mIdentity : mOptions.name);
+    uint32_t funcFlags = static_cast<uint32_t>(mExecFunFlags);
+    handshake.set_exec_functions(funcFlags);
+    handshake.set_wire_format(mOptions.wireFormat);
+    for (uint32_t op : mOptions.ops) {
+        const int word = static_cast<int>(op / 64);
+        while (handshake.capabilities_size() <= word) {
+            handshake.add_capabilities(0);
+        }
+        handshake.set_capabilities(word, handshake.capabilities(word) | (uint64_t{1} << (op % 64)));
+    }
+    std::string buf;
+    if (handshake.SerializeToString(&buf) == false) {
+        spdlog::error("Failed to serialize FirstHandshake");
+        return EC_FAILURE;
+    }
+    return sendFrame(buf);
+}
+
+int Session::sendFrame(const std::string& buf) {
+    if (framing::isStream(mOptions.transport.transport)) {
+        return mStream.sendFrame(buf);
+    }
+    zmq::message_t frame(buf.size());
+    memcpy(frame.data(), buf.data(), buf.size());
+    zmq::send_result_t result = mSocket.send(frame, zmq::send_flags::none);
+    RETURN_IF_ERROR(ErrorType::ZMQ_SEND, result, "Failed to send message");
+    return EC_SUCCESS;
+}
+
+RequestBreakdown& RequestBreakdown::operator+=(const RequestBreakdown& other) {
+    totalNs += other.totalNs;
+    networkNs += other.networkNs;
+    routerNs += other.routerNs;
+    queueNs += other.queueNs;
+    execNs += other.execNs;
+    replyNs += other.replyNs;
+    return *this;
+}
+
+/// Splits one round trip; `sendNs` and `recvNs` are client times, `timing` is on the server's clock.
+static RequestBreakdown breakdownOf(const int64_t sendNs, const int64_t recvNs, const ipc::RequestTiming& timing) {
+    auto span = [] (uint64_t from, uint64_t to) {
+        return (from != 0 && to > from) ? static_cast<int64_t>(to - from) : int64_t{0};
+    };
+    RequestBreakdown out;
+    out.totalNs = recvNs - sendNs;
+    out.networkNs = std::max<int64_t>(out.totalNs - span(timing.recv_ns(), timing.send_ns()), 0);
+    out.routerNs = span(timing.recv_ns(), timing.dispatch_ns());
+    out.queueNs = span(timing.enqueue_ns(), timing.exec_start_ns());
+    out.execNs = span(timing.exec_start_ns(), timing.exec_end_ns());
+    out.replyNs = span(std::max(timing.dispatch_ns(), timing.exec_end_ns()), timing.send_ns());
+    return out;
+}
+
+int Session::sendEnvelope(ipc::EnvelopeReq& env) {
+    if (mOptions.trace) {
+        env.set_trace(true);
+    }
+    if (mHedges.empty() == false) {
+        // A hedged submit may leave a late reply on any of the connections, so every request is numbered.
+        env.set_correlation_id(++mNextCorrelation);
+    }
+    return sendEncoded(env);
+}
+
+int Session::sendEncoded(const ipc::EnvelopeReq& env) {
+    std::string buf;
+    const bool encoded = (mOptions.wireFormat == ipc::WIRE_COMPACT)
+        ? wire::encodeRequest(env, buf)
+        : env.SerializeToString(&buf);
+    if (encoded == false) {
+        spdlog::error("Failed to serialize EnvelopeReq");
+        return EC_FAILURE;
+    }
+    mHasBreakdown = false;
+    mTracedSendNs = env.trace() ? monotonicNs() : 0;
+    mAwaitCorrelation = env.correlation_id();
+    return sendFrame(buf);
+}
+
+int Session::recvEnvelope(ipc::EnvelopeResp& out) {
+    int64_t recvNs = 0;
+    while (true) {
+        int result = recvDecoded(out, recvNs);
+        if (result != EC_SUCCESS) {
+            return result;
+        }
+        if (mAwaitCorrelation == 0 || out.correlation_id() == mAwaitCorrelation) {
+            break;
+        }
+        ++mHedgeCounters.stale;
+        out.Clear();
+    }
+    noteReply(out, recvNs);
+    return EC_SUCCESS;
+}
+
+void Session::noteReply(
+    const ipc::EnvelopeResp& out,
+    const int64_t recvNs
+) {
+    if (recvNs != 0 && out.has_timing()) {
+        mBreakdown = breakdownOf(mTracedSendNs, recvNs, out.timing());
+        mHasBreakdown = true;
+    }
+    mTracedSendNs = 0;
+}
+
+int Session::recvDecoded(
+    ipc::EnvelopeResp& out,
+    int64_t& recvNs
+) {
+    const int64_t busyPollNs = static_cast<int64_t>(mOptions.busyPollUs) * 1000;
+    std::vector<zmq::message_t> frames;
+    const void* data = nullptr;
+    std::size_t size = 0;
+    if (framing::isStream(mOptions.transport.transport)) {
+        int result = mStream.recvFrame(mRecvBuffer, busyPollNs, mPollCounters);
+        RETURN_IF_ERROR(ErrorType::DEFAULT, result, "Timeout or receive error");
+        data = mRecvBuffer.data();
+        size = mRecvBuffer.size();
+    } else {
+        zmq::recv_result_t ok = busypoll::recvMultipart(mSocket, frames, busyPollNs, mPollCounters);
+        if (ok.has_value() == false || frames.empty()) {
+            IPC_LOG_RATE_LIMITED(1000, spdlog::level::warn, "Timeout or receive error");
+            return EC_FAILURE;
+        }
+        data = frames.back().data();
+        size = frames.back().size();
+    }
+    recvNs = (mTracedSendNs != 0) ? monotonicNs() : 0;
+
+    const bool decoded = (mOptions.wireFormat == ipc::WIRE_COMPACT)
+        ? wire::decodeResponse(data, size, out)
+        : out.ParseFromArray(data, static_cast<int>(size));
+    if (decoded == false) {
+        spdlog::error("Failed to parse EnvelopeResp (sz={})", (int)size);
+        return EC_FAILURE;
+    }
+    return EC_SUCCESS;
+}
+
+void Session::addHedgeSample(const int64_t ns) {
+    if (mHedgeSamples.size() < kHedgeWindow) {
+        mHedgeSamples.push_back(ns);
+    } else {
+        mHedgeSamples[mHedgeSampleNext] = ns;
+    }
+    mHedgeSampleNext = (mHedgeSampleNext + 1) % kHedgeWindow;
+    ++mHedgeSamplesSeen;
+    if (mHedgeSamplesSeen < kHedgeMinSamples || mHedgeSamplesSeen % kHedgeRefresh != 0) {
+        return;
+    }
+    std::vector<int64_t> sorted = mHedgeSamples;
+    const std::size_t rank = std::min(sorted.size() - 1, sorted.size() * mOptions.hedgePercentile / 100);
+    std::nth_element(sorted.begin(), sorted.begin() + static_cast<std::ptrdiff_t>(rank), sorted.end());
+    mHedgeCounters.delayNs = sorted[rank];
+}
+
+int Session::submitHedged(
+    ipc::EnvelopeReq& env,
+    ipc::EnvelopeResp& out
+) {
+    using clock = std::chrono::steady_clock;
+    const auto start = clock::now();
+    const auto deadline = start + std::chrono::milliseconds(mReceiveTimeoutMs);
+    ++mHedgeCounters.requests;
+    mHedgeCredit = std::min(mHedgeCredit + mOptions.hedgeBudgetPct / 100.0, kMaxHedgeCredit);
+    int result = sendEnvelope(env);
+    RETURN_IF_ERROR(ErrorType::DEFAULT, result, "Failed to send EnvelopeReq");
+
+    const uint64_t id = env.correlation_id();
+    auto hedgeAt = (mHedgeCounters.delayNs > 0)
+        ? start + std::chrono::nanoseconds(mHedgeCounters.delayNs)
+        : clock::time_point::max();
+    Session* hedge = nullptr;
+    try {
+        while (mSigStop.load(std::memory_order_relaxed) == false) {
+            const auto now = clock::now();
+            if (hedge == nullptr && now >= hedgeAt) {
+                hedgeAt = clock::time_point::max();
+                if (mHedgeCredit < 1.0) {
+                    ++mHedgeCounters.denied;
+                } else {
+                    mHedgeCredit -= 1.0;
+                    Session* target = mHedges[mNextHedge++ % mHedges.size()].get();
+                    if (target->sendEncoded(env) == EC_SUCCESS) {
+                        hedge = target;
+                        ++mHedgeCounters.hedged;
+                    }
+                }
+            }
+            if (now >= deadline) {
+                break;
+            }
+            // zmq_poll counts whole milliseconds; rounding up never hedges before the delay.
+            const auto waitMs = std::chrono::ceil<std::chrono::milliseconds>(std::min(deadline, hedgeAt) - now);
+            zmq::pollitem_t items[] = {
+                {mSocket.handle(), 0, ZMQ_POLLIN, 0},
+                {hedge != nullptr ? hedge->mSocket.handle() : nullptr, 0, ZMQ_POLLIN, 0}
+            };
+            const int polled = (hedge != nullptr) ? 2 : 1;
+            zmq::poll(items, polled, waitMs);
+            for (int i = 0; i < polled; ++i) {
+                if ((items[i].revents & ZMQ_POLLIN) == 0) {
+                    continue;
+                }
+                Session& from = (i == 0) ? *this : *hedge;
+                int64_t recvNs = 0;
+                result = from.recvDecoded(out, recvNs);
+                RETURN_IF_ERROR(ErrorType::DEFAULT, result, "Receive error (EnvelopeResp)");
+                if (out.correlation_id() != id) {
+                    ++from.mHedgeCounters.stale;
+                    out.Clear();
+                    continue;
+                }
+                if (&from != this && hedgeReplyUsable(out) == false) {
+                    hedge = nullptr; // Keep waiting for the primary.
+                    out.Clear();
+                    continue;
+                }
+                from.noteReply(out, recvNs);
+                if (&from != this) {
+                    ++mHedgeCounters.wins;
+                    mHasBreakdown = from.mHasBreakdown;
+                    mBreakdown = from.mBreakdown;
+                }
+                addHedgeSample(std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - start).count());
+                return EC_SUCCESS;
+            }
+        }
+    } catch (const zmq::error_t& e) {
+        spdlog::error("Hedged receive failed: {}", e.what());
+        return EC_FAILURE;
+    }
+    IPC_LOG_RATE_LIMITED(1000, spdlog::level::warn, "Timeout or receive error");
+    return EC_FAILURE;
+}
+
+HedgeCounters Session::hedgeCounters() const {
+    HedgeCounters counters = mHedgeCounters;
+    for (const std::unique_ptr<Session>& hedge : mHedges) {
+        counters.stale += hedge->mHedgeCounters.stale;
+    }
+    return counters;
+}
+
+int Session::submitBlocking(
+    const ipc::SubmitRequest& req,
+    ipc::SubmitResponse& out
+) {
+    ipc::EnvelopeReq env;
+    ipc::SubmitRequest toSend = req;
+    toSend.set_mode(ipc::BLOCKING);
+    *env.mutable_submit() = std::move(toSend);
+    ipc::EnvelopeResp resp;
+    if (mHedges.empty() == false) {
+        if (submitHedged(env, resp) != EC_SUCCESS) {
+            out.set_status(ipc::ST_ERROR_INTERNAL);
+            return EC_FAILURE;
+        }
+    } else {
+        int result = sendEnvelope(env);
+        if (result != EC_SUCCESS) {
+            out.set_status(ipc::ST_ERROR_INTERNAL);
+            spdlog::error("Failed to send EnvelopeReq");
+            return EC_FAILURE;
+        }
+        result = recvEnvelope(resp);
+        if (result != EC_SUCCESS) {
+            out.set_status(ipc::ST_ERROR_INTERNAL);
+            spdlog::error("Timeout or receive error (EnvelopeResp)");
+            return EC_FAILURE;
+        }
+    }
+
+    if (resp.has_submit() == false) {
+        out.set_status(ipc::ST_ERROR_INTERNAL);
+        spdlog::error("Protocol error: missing submit in EnvelopeResp");
+        return EC_FAILURE;
+    }
+    out = std::move(resp.submit());
+    return EC_SUCCESS;
+}
+
+int Session::submitNonBlocking(
+    const ipc::SubmitRequest& req,
+    ipc::SubmitResponse& out
+) {
+    ipc::EnvelopeReq env;
+    ipc::SubmitRequest toSend = req;
+    toSend.set_mode(ipc::NONBLOCKING);
+    *env.mutable_submit() = std::move(toSend);
+    int result = sendEnvelope(env);
+    if (result != EC_SUCCESS) {
+        out.set_status(ipc::ST_ERROR_INTERNAL);
+        spdlog::error("Failed to send EnvelopeReq");
+        return EC_FAILURE;
+    }
+
+    ipc::EnvelopeResp resp;
+    result = recvEnvelope(resp);
+    if (result != EC_SUCCESS) {
+        out.set_status(ipc::ST_ERROR_INTERNAL);
+        spdlog::error("Timeout or receive error (EnvelopeResp)");
+        return EC_FAILURE;
+    }
+    if (resp.has_submit() == false) {
+        out.set_status(ipc::ST_ERROR_INTERNAL);
+        spdlog::error("Protocol error: missing submit in EnvelopeResp");
+        return EC_FAILURE;
+    }
+    out = std::move(resp.submit());
+    return EC_SUCCESS;
+}
+
+int Session::getResult(
+    const ipc::Ticket& ticket,
+    const ipc::GetWaitMode waitMode,
+    const uint32_t timeoutMs,
+    ipc::GetResponse& out
+) {
+    ipc::EnvelopeReq env;
+    ipc::GetRequest& g = *env.mutable_get();
+    *g.mutable_ticket() = ticket;
+    g.set_wait_mode(waitMode);
+    if (waitMode == ipc::WAIT_UP_TO) {
+        g.set_timeout_ms(timeoutMs);
+    }
+
+    int result = sendEnvelope(env);
+    RETURN_IF_ERROR(ErrorType::DEFAULT, result, "Failed to send EnvelopeReq");
+
+    ipc::EnvelopeResp resp;
+    result = recvEnvelope(resp);
+    RETURN_IF_ERROR(ErrorType::DEFAULT, result, "Timeout or receive error (EnvelopeResp)");
+
+    if (resp.has_get() == false) {
+        spdlog::error("Protocol error: missing get in EnvelopeResp");
+        return EC_FAILURE;
+    }
+    out = resp.get();
+    return EC_SUCCESS;
+}
+
+int Session::getMany(
+    const std::vector<ipc::Ticket>& tickets,
+    const ipc::GetManyWaitMode waitMode,
+    const uint32_t timeoutMs,
+    ipc::GetManyResponse& out
+) {
+    ipc::EnvelopeReq env;
+    ipc::GetManyRequest& g = *env.mutable_get_many();
+    for (const ipc::Ticket& ticket : tickets) {
+        *g.add_tickets() = ticket;
+    }
+    g.set_wait_mode(waitMode);
+    g.set_timeout_ms(timeoutMs);
+
+    int result = sendEnvelope(env);
+    RETURN_IF_ERROR(ErrorType::DEFAULT, result, "Failed to send EnvelopeReq");
+
+    ipc::EnvelopeResp resp;
+    result = recvEnvelope(resp);
+    RETURN_IF_ERROR(ErrorType::DEFAULT, result, "Timeout or receive error (EnvelopeResp)");
+
+    if (resp.has_get_many() == false) {
+        spdlog::error("Protocol error: missing get_many in EnvelopeResp");
+        return EC_FAILURE;
+    }
+    out = std::move(*resp.mutable_get_many());
+    return EC_SUCCESS;
+}
+
+int Session::registerPatterns(
+    const std::vector<std::string>& patterns,
+    ipc::RegisterPatternsResponse& out
+) {
+    ipc::EnvelopeReq env;
+    ipc::RegisterPatternsRequest* req = env.mutable_patterns();
+    for (const std::string& p : patterns) {
+        req->add_patterns(p);
+    }
+    int result = sendEnvelope(env);
+    RETURN_IF_ERROR(ErrorType::DEFAULT, result, "Failed to send RegisterPatternsRequest");
+
+    ipc::EnvelopeResp resp;
+    result = recvEnvelope(resp);
+    RETURN_IF_ERROR(ErrorType::DEFAULT, result, "Timeout or receive error (EnvelopeResp)");
+    if (resp.has_patterns() == false) {
+        spdlog::error("Protocol error: missing patterns in EnvelopeResp");
+        return EC_FAILURE;
+    }
+    out = std::move(*resp.mutable_patterns());
+    return EC_SUCCESS;
+}
+
+int Session::stats(
+    const bool reset,
+    ipc::StatsResponse& out
+) {
+    ipc::EnvelopeReq env;
+    env.mutable_stats()->set_reset(reset);
+    int result = sendEnvelope(env);
+    RETURN_IF_ERROR(ErrorType::DEFAULT, result, "Failed to send StatsRequest");
+
+    ipc::EnvelopeResp resp;
+    result = recvEnvelope(resp);
+    RETURN_IF_ERROR(ErrorType::DEFAULT, result, "Timeout or receive error (EnvelopeResp)");
+    if (resp.has_stats() == false) {
+        spdlog::error("Protocol error: missing stats in EnvelopeResp");
+        return EC_FAILURE;
+    }
+    out = std::move(*resp.mutable_stats());
+    return EC_SUCCESS;
+}
+
+int Session::dumpTrace(ipc::TraceDumpResponse& out) {
+    ipc::EnvelopeReq env;
+    env.mutable_trace_dump();
+    int result = sendEnvelope(env);
+    RETURN_IF_ERROR(ErrorType::DEFAULT, result, "Failed to send TraceDumpRequest");
+
+    ipc::EnvelopeResp resp;
+    result = recvEnvelope(resp);
+    RETURN_IF_ERROR(ErrorType::DEFAULT, result, "Timeout or receive error (EnvelopeResp)");
+    if (resp.has_trace_dump() == false) {
+        spdlog::error("Protocol error: missing trace_dump in EnvelopeResp");
+        return EC_FAILURE;
+    }
+    out = std::move(*resp.mutable_trace_dump());
+    return EC_SUCCESS;
+}
+
+int Session::slowLog(ipc::SlowLogResponse& out) {
+    ipc::EnvelopeReq env;
+    env.mutable_slow_log();
+    int result = sendEnvelope(env);
+    RETURN_IF_ERROR(ErrorType::DEFAULT, result, "Failed to send SlowLogRequest");
+
+    ipc::EnvelopeResp resp;
+    result = recvEnvelope(resp);
+    RETURN_IF_ERROR(ErrorType::DEFAULT, result, "Timeout or receive error (EnvelopeResp)");
+    if (resp.has_slow_log() == false) {
+        spdlog::error("Protocol error: missing slow_log in EnvelopeResp");
+        return EC_FAILURE;
+    }
+    out = std::move(*resp.mutable_slow_log());
+    return EC_SUCCESS;
+}
+
+int Session::listOps(ipc::ListOpsResponse& out) {
+    ipc::EnvelopeReq env;
+    env.mutable_list_ops();
+    int result = sendEnvelope(env);
+    RETURN_IF_ERROR(ErrorType::DEFAULT, result, "Failed to send ListOpsRequest");
+
+    ipc::EnvelopeResp resp;
+    result = recvEnvelope(resp);
+    RETURN_IF_ERROR(ErrorType::DEFAULT, result, "Timeout or receive error (EnvelopeResp)");
+    if (resp.has_list_ops() == false) {
+        spdlog::error("Protocol error: missing list_ops in EnvelopeResp");
+        return EC_FAILURE;
+    }
+    out = std::move(*resp.mutable_list_ops());
+    return EC_SUCCESS;
+}
+
+int Session::call(
+    const ipc::EnvelopeReq& req,
+    ipc::EnvelopeResp& out
+) {
+    int result = sendEncoded(req);
+    RETURN_IF_ERROR(ErrorType::DEFAULT, result, "Failed to send EnvelopeReq");
+    result = recvEnvelope(out);
+    RETURN_IF_ERROR(ErrorType::DEFAULT, result, "Timeout or receive error (EnvelopeResp)");
+    return EC_SUCCESS;
+}
+
+int Session::streamFind(
+    const std::string& needle,
+    const std::function<std::size_t(char*, std::size_t)>& read,
+    const std::size_t chunkSize,
+    ipc::StreamResponse& out
+) {
+    ipc::EnvelopeReq env;
+    env.mutable_stream()->mutable_open()->set_needle(needle);
+    int result = sendEnvelope(env);
+    RETURN_IF_ERROR(ErrorType::DEFAULT, result, "Failed to send StreamOpen");
+
+    ipc::EnvelopeResp resp;
+    result = recvEnvelope(resp);
+    RETURN_IF_ERROR(ErrorType::DEFAULT, result, "Timeout or receive error (StreamOpen)");
+    if (resp.has_stream() == false) {
+        spdlog::error("Protocol error: missing stream in EnvelopeResp");
+        return EC_FAILURE;
+    }
+    if (resp.stream().status() != ipc::ST_NOT_FINISHED) {
+        out = std::move(*resp.mutable_stream());
+        return EC_SUCCESS;
+    }
+    const ipc::Ticket ticket = resp.stream().ticket();
+
+    std::string buffer(chunkSize, '\0');
+    while (mSigStop.load(std::memory_order_relaxed) == false) {
+        const std::size_t n = read(buffer.data(), buffer.size());
+        ipc::StreamChunk* chunk = env.mutable_stream()->mutable_chunk();
+        *chunk->mutable_ticket() = ticket;
+        chunk->set_data(buffer.data(), n);
+        chunk->set_last(n < buffer.size());
+
+        result = sendEnvelope(env);
+        RETURN_IF_ERROR(ErrorType::DEFAULT, result, "Failed to send StreamChunk");
+        resp.Clear();
+        result = recvEnvelope(resp);
+        RETURN_IF_ERROR(ErrorType::DEFAULT, result, "Timeout or receive error (StreamChunk)");
+        if (resp.has_stream() == false) {
+            spdlog::error("Protocol error: missing stream in EnvelopeResp");
+            return EC_FAILURE;
+        }
+        if (resp.stream().status() != ipc::ST_NOT_FINISHED || chunk->last()) {
+            out = std::move(*resp.mutable_stream());
+            return EC_SUCCESS;
+        }
+    }
+    return EC_FAILURE;
+}
+
+namespace client {
+    ipc::SubmitRequest makeMath(
+        ipc::MathOp op,
+        int32_t a,
+        int32_t b
+    ) {
+        ipc::SubmitRequest s;
+        auto* m = s.mutable_math();
+        m->set_op(op);
+        m->set_a(a);
+        m->set_b(b);
+        return s;
+    }
+
+    ipc::SubmitRequest makeStr(
+        ipc::StrOp op,
+        const std::string& s1,
+        const std::string& s2
+    ) {
+        ipc::SubmitRequest s;
+        auto* st = s.mutable_str();
+        st->set_op(op);
+        st->set_s1(s1);
+        st->set_s2(s2);
+        return s;
+    }
+
+    ipc::SubmitRequest makeFindAny(
+        uint64_t handle,
+        const std::string& haystack,
+        bool allMatches
+    ) {
+        ipc::SubmitRequest s;
+        auto* f = s.mutable_find_any();
+        f->set_handle(handle);
+        f->set_haystack(haystack);
+        f->set_all_matches(allMatches);
+        return s;
+    }
+
+    ipc::SubmitRequest makeExpr(const std::vector<std::string>& tokens) {
+        static const std::pair<const char*, ipc::MathOp> mathOps[] = {
+            {"add", ipc::MATH_ADD}, {"sub", ipc::MATH_SUB}, {"mult", ipc::MATH_MUL}, {"div", ipc::MATH_DIV},
+        };
+        static const std::pair<const char*, ipc::StrOp> strOps[] = {
+            {"concat", ipc::STR_CONCAT}, {"find", ipc::STR_FIND_START},
+        };
+        ipc::SubmitRequest s;
+        ipc::ExprArgs* expr = s.mutable_expr();
+        for (const std::string& token : tokens) {
+            ipc::ExprNode* node = expr->add_nodes();
+            int32_t value = 0;
+            if (parseInt32(token, value)) {
+                node->set_int_value(value);
+                continue;
+            }
+            bool isOp = false;
+            for (const auto& [name, op] : mathOps) {
+                if (token == name) {
+                    node->set_math(op);
+                    isOp = true;
+                }
+            }
+            for (const auto& [name, op] : strOps) {
+                if (token == name) {
+                    node->set_str(op);
+                    isOp = true;
+                }
+            }
+            if (isOp == false) {
+                node->set_str_value(token);
+            }
+        }
+        return s;
+    }
+
+    ipc::SubmitRequest makeCall(
+        uint32_t op,
+        const std::vector<std::string>& tokens
+    ) {
+        ipc::SubmitRequest s;
+        ipc::OpCallArgs* call = s.mutable_call();
+        call->set_op(op);
+        for (const std::string& token : tokens) {
+            int32_t value = 0;
+            if (parseInt32(token, value)) {
+                call->add_ints(value);
+            } else {
+                call->add_strs(token);
+            }
+        }
+        return s;
+    }
+
+    // Packs int32s as ReduceArgs expects them: little-endian, whatever the host order.
+    static std::string packInt32s(const std::vector<int32_t>& values) {
+        std::string out(values.size() * 4, '\0');
+        for (std::size_t i = 0; i < values.size(); ++i) {
+            const uint32_t v = static_cast<uint32_t>(values[i]);
+            for (std::size_t byte = 0; byte < 4; ++byte) {
+                out[4 * i + byte] = static_cast<char>((v >> (8 * byte)) & 0xFF);
+            }
+        }
+        return out;
+    }
+
+    ipc::SubmitRequest makeReduce(
+        ipc::ReduceOp op,
+        bool wide,
+        const std::vector<int32_t>& values,
+        const std::vector<int32_t>& other
+    ) {
+        ipc::SubmitRequest s;
+        ipc::ReduceArgs* reduce = s.mutable_reduce();
+        reduce->set_op(op);
+        reduce->set_wide(wide);
+        reduce->set_values(packInt32s(values));
+        reduce->set_other(packInt32s(other));
+        return s;
+    }
+} // namespace client
@@ -0,0 +1,257 @@
+#pragma once
+#include <atomic>
+#include "zmq.hpp"
+#include "ipc.pb.h"
+#include "busy_poll.h"
+#include "framing.h"
+#include "stream_transport.h"
+#include <vector>
+#include <functional>
+#include <memory>
+#include <string>
+
+namespace client {
+
+    // Another server, or another path to the same one, that slow BLOCKING submits are duplicated to.
+    struct HedgeEndpoint {
+        std::string address;
+        int port = 0;
+    };
+
+    // Parses "host:port[,host:port...]" into `out`.
+    int parseHedgeEndpoints(const std::string& list, std::vector<HedgeEndpoint>& out);
+
+    // Optional client settings. They are collected through `clientSetOption` before
+    // `clientInitialize` and passed to the Application when it is created.
+    struct Options {
+        ipc::WireFormat wireFormat = ipc::WIRE_PROTOBUF; // Encoding requested in the FirstHandshake.
+        uint32_t busyPollUs = 0;                         // Spin on non-blocking receives this long before blocking.
+        framing::Endpoint transport;                     // DEALER socket over tcp (default) or inproc, or a TCP / Unix stream to the server's stream frontend.
+        std::vector<uint32_t> ops;                       // Registry op ids requested on top of the ExecFunFlags, e.g. plugin ops.
+        std::string name;                                // FirstHandshake client_name, picks the server-side queue weight; empty sends the identity.
+        bool trace = false;                              // Ask for the server's RequestTiming on every request, see `Session::lastBreakdown`.
+        std::vector<HedgeEndpoint> hedge;                // Where slow BLOCKING submits are duplicated to; empty disables hedging. DEALER transport only.
+        uint32_t hedgePercentile = 95;                   // Hedge a BLOCKING submit once it is slower than this percentile of the recent ones.
+        uint32_t hedgeBudgetPct = 5;                     // At most this many hedges per 100 BLOCKING submits.
+    };
+
+    // What hedging did on a session, see `Options::hedge`.
+    struct HedgeCounters {
+        uint64_t requests = 0; // BLOCKING submits that could be hedged.
+        uint64_t hedged = 0;   // Duplicates sent.
+        uint64_t wins = 0;     // Duplicates that answered first.
+        uint64_t denied = 0;   // Submits past the hedge delay that the budget did not allow to hedge.
+        uint64_t stale = 0;    // Replies of the losers, discarded when they arrived.
+        int64_t delayNs = 0;   // Current hedge delay, 0 until enough submits were seen.
+    };
+
+    // Where the time of a traced round trip went, from the client's send and receive times and the
+    // server's RequestTiming. Durations in ns, 0 for stages the request did not go through. Only
+    // intervals on the same clock are taken, so client and server need not share a clock.
+    struct RequestBreakdown {
+        int64_t totalNs = 0;   // Client send to client receive.
+        int64_t networkNs = 0; // Total minus the server's receive-to-send time: both transfers and socket queues.
+        int64_t routerNs = 0;  // Server receive to dispatch: decoding and admission on the router.
+        int64_t queueNs = 0;   // Enqueue to execution start of the job behind the reply.
+        int64_t execNs = 0;    // Execution of that job.
+        int64_t replyNs = 0;   // Result (or dispatch, if nothing ran in between) to send: waiting in a get or parked.
+
+        // Adds another round trip of the same request, such as the get after a NONBLOCKING submit.
+        RequestBreakdown& operator+=(const RequestBreakdown& other);
+    };
+
+    // One connection to the server (a DEALER socket or a `StreamTransport`) and the request/response calls made over it.
+    // Unlike `Application` it is not a singleton: load generators and tests open as many
+    // sessions as they need on a shared ZeroMQ context. A session must only be used by one
+    // thread at a time. The functions are not marked `const` because ZeroMQ's socket
+    // operations modify the socket state internally.
+    struct Session {
+    private:
+        // Helper function to send the initial handshake message to the server. Which tells the server which functions
+        // Can be requested by this client.
+        // This message contains the client's unique identity and its execution capabilities.
+        int sendFirstHandshake();
+
+        // Marks the request as traced when `Options::trace` is set, then sends it.
+        int sendEnvelope(ipc::EnvelopeReq& env);
+
+        // Encodes and sends the request as it is, noting the send time of a traced one.
+        int sendEncoded(const ipc::EnvelopeReq& env);
+
+        // Sends one encoded frame over whichever transport the session uses.
+        int sendFrame(const std::string& buf);
+
+        // Receives replies until the one for the last request sent, dropping the late replies of hedging.
+        int recvEnvelope(ipc::EnvelopeResp& out);
+
+        // Receives and decodes one frame; `recvNs` is its arrival time if the last request was traced, else 0.
+        int recvDecoded(
+            ipc::EnvelopeResp& out,
+            int64_t& recvNs
+        );
+
+        // Computes the breakdown of a traced round trip once its reply is in.
+        void noteReply(
+            const ipc::EnvelopeResp& out,
+            const int64_t recvNs
+        );
+
+        // Sends a BLOCKING submit and duplicates it on a hedge connection once it takes longer than the
+        // hedge delay and the budget allows; the first reply wins.
+        int submitHedged(
+            ipc::EnvelopeReq& env,
+            ipc::EnvelopeResp& out
+        );
+
+        // Adds a BLOCKING submit's latency to the window the hedge delay is taken from.
+        void addHedgeSample(const int64_t ns);
+
+    public:
+        // `ctx` and `address` must outlive the session. `sigStop` interrupts long transfers such as `streamFind`.
+        // An inproc transport ignores `ctx`, `address` and `port` and uses the context shared with the embedded server.
+        Session(
+            zmq::context_t& ctx,
+            const std::atomic<bool>& sigStop,
+            const char* address,
+            const int port,
+            const int receiveTimeoutMs,
+            const uint8_t execFunFlags,
+            const Options& options
+        );
+
+        Session(const Session&) = delete;
+        Session& operator=(const Session&) = delete;
+
+        // Closes the socket.
+        ~Session();
+
+        // Connects to the server and sends the FirstHandshake.
+        int init();
+
+        // Closes the socket or stream, safe to call more than once.
+        int deinit();
+
+        // Submits a blocking request to the server. The function will wait for a
+        // response from the server before returning.
+        int submitBlocking(
+            const ipc::SubmitRequest& req,
+            ipc::SubmitResponse& out
+        );
+
+        // Submits a non-blocking request to the server. The server will respond
+        // immediately with a ticket ID, and the actual result must be retrieved later.
+        // A server with inline_max_cost set answers cheap requests with their result and no ticket instead.
+        int submitNonBlocking(
+            const ipc::SubmitRequest& req,
+            ipc::SubmitResponse& out
+        );
+
+        // Retrieves the result for a previously submitted non-blocking request using its ticket ID.
+        // Supports different waiting modes (e.g., no wait, wait up to a timeout).
+        int getResult(
+            const ipc::Ticket& ticket,
+            const ipc::GetWaitMode waitMode,
+            const uint32_t timeoutMs,
+            ipc::GetResponse& out
+        );
+
+        // Retrieves the results of several tickets in one round trip. WAIT_ANY returns once one of them is
+        // finished, WAIT_ALL once all are, either at the latest after `timeoutMs`. `out.pending` lists the rest.
+        int getMany(
+            const std::vector<ipc::Ticket>& tickets,
+            const ipc::GetManyWaitMode waitMode,
+            const uint32_t timeoutMs,
+            ipc::GetManyResponse& out
+        );
+
+        // Registers a FIND_ANY pattern set on the server. The returned handle is passed in FindAnyArgs,
+        // the server shares compiled sets between clients and may evict them (ST_ERROR_UNKNOWN_HANDLE).
+        int registerPatterns(
+            const std::vector<std::string>& patterns,
+            ipc::RegisterPatternsResponse& out
+        );
+
+        // Fetches the server statistics (per-operation counts and latencies, queue gauges).
+        // With `reset` the server starts a new window after taking the snapshot.
+        int stats(
+            const bool reset,
+            ipc::StatsResponse& out
+        );
+
+        // Asks the server to write its PROFILE_APPLICATION probes as a Chrome trace file on the server host.
+        int dumpTrace(ipc::TraceDumpResponse& out);
+
+        // Fetches the server's slow-request log, see the "slow_request_us" server setting.
+        int slowLog(ipc::SlowLogResponse& out);
+
+        // Lists the operations of the server's registry, the ids `makeCall` takes.
+        int listOps(ipc::ListOpsResponse& out);
+
+        // Sends any request as it is and waits for its response, whatever its kind. Used by `ipc_replay`
+        // to re-issue captured traffic; the typed calls above are the ones to use otherwise.
+        int call(
+            const ipc::EnvelopeReq& req,
+            ipc::EnvelopeResp& out
+        );
+
+        // Searches for `needle` in a haystack that is uploaded in chunks of `chunkSize` bytes under one ticket,
+        // so the haystack never has to be held in memory at once. `read` fills a buffer with the next bytes and
+        // returns how many were written; a short read marks the end of the haystack. Stops as soon as the server
+        // reports a match.
+        int streamFind(
+            const std::string& needle,
+            const std::function<std::size_t(char*, std::size_t)>& read,
+            const std::size_t chunkSize,
+            ipc::StreamResponse& out
+        );
+
+        // The settings the session was created with.
+        const Options& options() const { return mOptions; }
+
+        // Receive spinning of this session, see `Options::busyPollUs`.
+        const busypoll::Counters& pollCounters() const { return mPollCounters; }
+
+        // The breakdown of the last round trip, or nullptr if it was not traced or the server sent no timing.
+        const RequestBreakdown* lastBreakdown() const { return mHasBreakdown ? &mBreakdown : nullptr; }
+
+        // Hedging of this session, the late replies on its hedge connections included.
+        HedgeCounters hedgeCounters() const;
+
+    private:
+        zmq::socket_t mSocket;                   // The DEALER socket of this connection, not created for stream transports.
+        StreamTransport mStream;                 // The connection when `mOptions.transport` is tcp or unix.
+        std::string mRecvBuffer;                 // Last frame received over `mStream`, reused between replies.
+        const std::string mIdentity;             // A unique, randomly generated ID for the client.
+        const char* mEndpoint;                   // The server's address.
+        const int mReceiveTimeoutMs;             // The timeout for receiving messages.
+        const int mPort;                         // The server's port.
+        const uint8_t mExecFunFlags;             // The bitmask of functions the client can perform.
+        const Options mOptions;                  // Optional settings, e.g. the negotiated wire format.
+        const std::atomic<bool>& mSigStop;       // A reference to a flag for graceful shutdown.
+        busypoll::Counters mPollCounters;        // Spin hits and misses of `recvEnvelope`.
+        int64_t mTracedSendNs = 0;               // Send time of the traced request awaiting its reply, else 0.
+        RequestBreakdown mBreakdown;             // Of the last traced round trip, valid if `mHasBreakdown`.
+        bool mHasBreakdown = false;
+        std::vector<std::unique_ptr<Session>> mHedges; // Connections to `Options::hedge`.
+        std::size_t mNextHedge = 0;              // Hedges go round robin over `mHedges`.
+        uint64_t mNextCorrelation = 0;           // Last correlation id sent; ids are only set with hedging.
+        uint64_t mAwaitCorrelation = 0;          // Reply `recvEnvelope` waits for, 0 takes the next one.
+        std::vector<int64_t> mHedgeSamples;      // Latest BLOCKING submit latencies, a ring.
+        std::size_t mHedgeSampleNext = 0;        // Slot of the next sample.
+        uint64_t mHedgeSamplesSeen = 0;
+        double mHedgeCredit = 0;                 // Hedges the budget allows right now.
+        HedgeCounters mHedgeCounters;            // Of this connection; `stale` only counts its own replies.
+    };
+
+    // Request builders shared by the REPL and the load generator.
+    ipc::SubmitRequest makeMath(ipc::MathOp op, int32_t a, int32_t b);
+    ipc::SubmitRequest makeStr(ipc::StrOp op, const std::string& s1, const std::string& s2);
+    ipc::SubmitRequest makeFindAny(uint64_t handle, const std::string& haystack, bool allMatches);
+    // Builds an ExprArgs program from postfix tokens: integers are int values, add/sub/mult/div/concat/find
+    // are operators and any other token is a string value, e.g. {"2", "3", "add", "4", "mult"}.
+    ipc::SubmitRequest makeExpr(const std::vector<std::string>& tokens);
+    // Builds an OpCallArgs request for registry op `op`: integer tokens are ints, any other token is a string.
+    ipc::SubmitRequest makeCall(uint32_t op, const std::vector<std::string>& tokens);
+    // Builds a ReduceArgs request; `other` is the second operand of REDUCE_DOT and empty otherwise.
+    ipc::SubmitRequest makeReduce(ipc::ReduceOp op, bool wide, const std::vector<int32_t>& values, const std::vector<int32_t>& other);
+} // namespace client
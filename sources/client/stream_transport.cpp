@@ -0,0 +1,159 @@
+#include "stream_transport.h"
+#include "spdlog/spdlog.h"
+#include "error_handling.h"
+#include "log.h"
+#include <cerrno>
+#include <cstring>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+using namespace client;
+
+StreamTransport::~StreamTransport() {
+    close();
+}
+
+int StreamTransport::connect(
+    const framing::Endpoint& endpoint,
+    const char* address,
+    const int port,
+    const int timeoutMs
+) {
+    close();
+    if (endpoint.transport == framing::Transport::UNIX) {
+        sockaddr_un addr{};
+        addr.sun_family = AF_UNIX;
+        std::strncpy(addr.sun_path, endpoint.unixPath.c_str(), sizeof(addr.sun_path) - 1);
+        mFd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (mFd < 0 || ::connect(mFd, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr)) != 0) {
+            spdlog::error("Failed to connect to unix:{}: {}", endpoint.unixPath, std::strerror(errno));
+            close();
+            return EC_FAILURE;
+        }
+    } else {
+        addrinfo hints{};
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+        addrinfo* info = nullptr;
+        const std::string service = std::to_string(port);
+        const int rc = getaddrinfo(address, service.c_str(), &hints, &info);
+        if (rc != 0) {
+            spdlog::error("Cannot resolve {}: {}", address, gai_strerror(rc));
+            return EC_FAILURE;
+        }
+        int error = 0;
+        for (addrinfo* it = info; it != nullptr; it = it->ai_next) {
+            mFd = socket(it->ai_family, SOCK_STREAM | SOCK_CLOEXEC, 0);
+            if (mFd >= 0 && ::connect(mFd, it->ai_addr, it->ai_addrlen) == 0) {
+                break;
+            }
+            error = errno;
+            close();
+        }
+        freeaddrinfo(info);
+        if (mFd < 0) {
+            spdlog::error("Failed to connect to {}:{}: {}", address, port, std::strerror(error));
+            return EC_FAILURE;
+        }
+        const int one = 1;
+        setsockopt(mFd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    }
+    timeval timeout{};
+    timeout.tv_sec = timeoutMs / 1000;
+    timeout.tv_usec = (timeoutMs % 1000) * 1000;
+    setsockopt(mFd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    setsockopt(mFd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+    return EC_SUCCESS;
+}
+
+void StreamTransport::close() {
+    if (mFd >= 0) {
+        ::close(mFd);
+        mFd = -1;
+    }
+}
+
+int StreamTransport::sendFrame(const std::string& payload) {
+    if (mFd < 0) {
+        spdlog::error("Not connected");
+        return EC_FAILURE;
+    }
+    mOut.clear();
+    framing::appendHeader(mOut, static_cast<uint32_t>(payload.size()));
+    mOut.append(payload);
+    std::size_t sent = 0;
+    while (sent < mOut.size()) {
+        const ssize_t n = send(mFd, mOut.data() + sent, mOut.size() - sent, MSG_NOSIGNAL);
+        if (n >= 0) {
+            sent += static_cast<std::size_t>(n);
+            continue;
+        }
+        if (errno == EINTR) {
+            continue;
+        }
+        spdlog::error("Failed to send a frame: {}", std::strerror(errno));
+        close();
+        return EC_FAILURE;
+    }
+    return EC_SUCCESS;
+}
+
+int StreamTransport::recvFrame(
+    std::string& payload,
+    const int64_t busyPollNs,
+    busypoll::Counters& pollCounters
+) {
+    if (mFd < 0) {
+        spdlog::error("Not connected");
+        return EC_FAILURE;
+    }
+    if (busyPollNs > 0) {
+        busypoll::spin(busyPollNs, pollCounters, [&] {
+            char probe;
+            // Data, the end of the stream and errors all end the spin; recvExact tells them apart.
+            return recv(mFd, &probe, 1, MSG_PEEK | MSG_DONTWAIT) >= 0 || (errno != EAGAIN && errno != EWOULDBLOCK);
+        });
+    }
+    char header[framing::kHeaderBytes];
+    int result = recvExact(header, sizeof(header));
+    RETURN_IF_ERROR(ErrorType::DEFAULT, result, "Failed to receive a frame header");
+    const uint32_t size = framing::readHeader(header);
+    if (size > framing::kMaxFrameBytes) {
+        spdlog::error("Frame of {} bytes exceeds the limit", size);
+        close();
+        return EC_FAILURE;
+    }
+    payload.resize(size);
+    result = recvExact(payload.data(), size);
+    RETURN_IF_ERROR(ErrorType::DEFAULT, result, "Failed to receive a frame");
+    return EC_SUCCESS;
+}
+
+int StreamTransport::recvExact(char* data, std::size_t size) {
+    std::size_t received = 0;
+    while (received < size) {
+        const ssize_t n = recv(mFd, data + received, size - received, 0);
+        if (n > 0) {
+            received += static_cast<std::size_t>(n);
+            continue;
+        }
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n == 0) {
+            spdlog::error("The server closed the connection");
+        } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            IPC_LOG_RATE_LIMITED(1000, spdlog::level::warn, "Timeout waiting for the server, closing the connection");
+        } else {
+            spdlog::error("Receive failed: {}", std::strerror(errno));
+        }
+        close();
+        return EC_FAILURE;
+    }
+    return EC_SUCCESS;
+}
@@ -0,0 +1,53 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include "framing.h"
+#include "busy_poll.h"
+
+namespace client {
+
+    // A blocking TCP or Unix stream connection carrying `framing` frames, the client side of the
+    // server's stream frontend. `Session` uses it instead of the DEALER socket when
+    // `Options::transport` is not zmq. Requests and replies strictly alternate, so a receive reads
+    // exactly one frame and never buffers ahead.
+    struct StreamTransport {
+        StreamTransport() = default;
+        StreamTransport(const StreamTransport&) = delete;
+        StreamTransport& operator=(const StreamTransport&) = delete;
+
+        // Closes the socket.
+        ~StreamTransport();
+
+        // Connects to address:port (tcp) or the endpoint's socket path (unix). Receives and sends
+        // give up after `timeoutMs`.
+        int connect(
+            const framing::Endpoint& endpoint,
+            const char* address,
+            const int port,
+            const int timeoutMs
+        );
+
+        // Closes the socket, safe to call more than once.
+        void close();
+
+        // Sends `payload` as one frame.
+        int sendFrame(const std::string& payload);
+
+        // Receives one frame into `payload`, spinning `busyPollNs` first (see `busypoll`).
+        // A timeout or a broken frame closes the connection, since the stream could no longer
+        // be told apart from the next reply.
+        int recvFrame(
+            std::string& payload,
+            const int64_t busyPollNs,
+            busypoll::Counters& pollCounters
+        );
+
+    private:
+        // Reads exactly `size` bytes.
+        int recvExact(char* data, std::size_t size);
+
+        int mFd = -1;
+        std::string mOut; // Header and payload of the frame being sent, reused between requests.
+    };
+
+} // namespace client
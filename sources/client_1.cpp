@@ -11,6 +11,11 @@ int main(int argc, char *argv[]) {
     options.add_options()
         ("address", "Host name to connect to the server", cxxopts::value<std::string>()->default_value("ipc-server"), "STR")
         ("port", "Port number to connect to the server", cxxopts::value<int>()->default_value("24737"), "PORT")
+        ("wire", "Wire format: protobuf or compact", cxxopts::value<std::string>()->default_value("protobuf"), "FORMAT")
+        ("busy-poll-us", "Spin on non-blocking receives this long before blocking, 0 disables", cxxopts::value<std::string>()->default_value("0"), "US")
+        ("transport", "zmq, tcp or unix:<path>; must match the server's --frontend", cxxopts::value<std::string>()->default_value("zmq"), "KIND")
+        ("ops", "Comma-separated registry op ids to request on top of the built-in set: 7-11 are the reductions, 64+ plugin ops", cxxopts::value<std::string>()->default_value("7,8,9,10,11"), "IDS")
+        ("name", "Client name for the server's per-client queue weights and rate limits", cxxopts::value<std::string>()->default_value("client_1"), "NAME")
         ("l,logging", "Directory to save the logging file", cxxopts::value<std::string>()->default_value("./client_log_1"), "PATH")
         ("h,help", "Print usage");
 
@@ -41,6 +46,24 @@ int main(int argc, char *argv[]) {
     std::signal(SIGINT, stopHandleClient);
     std::signal(SIGTERM, stopHandleClient);
 
+    result = clientSetOption("wire", resultParser["wire"].as<std::string>().c_str());
+    if (result == EC_SUCCESS) {
+        result = clientSetOption("busy_poll_us", resultParser["busy-poll-us"].as<std::string>().c_str());
+    }
+    if (result == EC_SUCCESS) {
+        result = clientSetOption("transport", resultParser["transport"].as<std::string>().c_str());
+    }
+    if (result == EC_SUCCESS) {
+        result = clientSetOption("ops", resultParser["ops"].as<std::string>().c_str());
+    }
+    if (result == EC_SUCCESS) {
+        result = clientSetOption("name", resultParser["name"].as<std::string>().c_str());
+    }
+    if (result != EC_SUCCESS) {
+        deinitializeLogging();
+        return result;
+    }
+
     const int receiveTimeoutMs = 3000;
     const uint8_t execFunc = ExecFunFlags::ADD | ExecFunFlags::MULT | ExecFunFlags::CONCAT;
 
@@ -23,6 +23,7 @@ namespace fs = std::experimental::filesystem;
 
 
 using fnClientInitialize = int (*)(const char*, const int, const int, const uint8_t);
+using fnClientSetOption = int (*)(const char*, const char*);
 using fnClientStart = int (*)(void);
 using fnClientDeinitialize = int (*)(void);
 using fnStopHandle = void (*)(int);
@@ -47,6 +48,11 @@ int main(int argc, char *argv[]) {
         ("address", "Host name to connect to the server", cxxopts::value<std::string>()->default_value("ipc-server"), "STR")
         ("port", "Port number to connect to the server", cxxopts::value<int>()->default_value("24737"), "PORT")
         ("so_path", "Path to the shared object file", cxxopts::value<std::string>()->default_value("./libclientipc.so"), "PATH")
+        ("wire", "Wire format: protobuf or compact", cxxopts::value<std::string>()->default_value("protobuf"), "FORMAT")
+        ("busy-poll-us", "Spin on non-blocking receives this long before blocking, 0 disables", cxxopts::value<std::string>()->default_value("0"), "US")
+        ("transport", "zmq, tcp or unix:<path>; must match the server's --frontend", cxxopts::value<std::string>()->default_value("zmq"), "KIND")
+        ("ops", "Comma-separated registry op ids to request on top of the built-in set, e.g. plugin ops", cxxopts::value<std::string>()->default_value(""), "IDS")
+        ("name", "Client name for the server's per-client queue weights and rate limits", cxxopts::value<std::string>()->default_value("client_2"), "NAME")
         ("l,logging", "Directory to save the logging file", cxxopts::value<std::string>()->default_value("./client_log_2"), "PATH")
         ("h,help", "Print usage");
 
@@ -73,6 +79,7 @@ int main(int argc, char *argv[]) {
         return EC_FAILURE;
     }
     auto clientInitialize = mustSym<fnClientInitialize>(handle, "clientInitialize");
+    auto clientSetOption = mustSym<fnClientSetOption>(handle, "clientSetOption");
     auto clientStart = mustSym<fnClientStart>(handle, "clientStart");
     auto clientDeinitialize = mustSym<fnClientDeinitialize>(handle, "clientDeinitialize");
     auto stopHandle = mustSym<fnStopHandle>(handle, "stopHandleClient");
@@ -97,8 +104,27 @@ int main(int argc, char *argv[]) {
     std::signal(SIGINT, stopHandle);
     std::signal(SIGTERM, stopHandle);
 
+    result = clientSetOption("wire", resultParser["wire"].as<std::string>().c_str());
+    if (result == EC_SUCCESS) {
+        result = clientSetOption("busy_poll_us", resultParser["busy-poll-us"].as<std::string>().c_str());
+    }
+    if (result == EC_SUCCESS) {
+        result = clientSetOption("transport", resultParser["transport"].as<std::string>().c_str());
+    }
+    if (result == EC_SUCCESS) {
+        result = clientSetOption("ops", resultParser["ops"].as<std::string>().c_str());
+    }
+    if (result == EC_SUCCESS) {
+        result = clientSetOption("name", resultParser["name"].as<std::string>().c_str());
+    }
+    if (result != EC_SUCCESS) {
+        deinitializeLogging();
+        dlclose(handle);
+        return result;
+    }
+
     const int receiveTimeoutMs = 3000;
-    const uint8_t execFunc = ExecFunFlags::SUB | ExecFunFlags::DIV | ExecFunFlags::FIND_START;
+    const uint8_t execFunc = ExecFunFlags::SUB | ExecFunFlags::DIV | ExecFunFlags::FIND_START | ExecFunFlags::FIND_ANY;
 
     result = clientInitialize(address, port, receiveTimeoutMs, execFunc);
     if (result == EC_SUCCESS) {
@@ -0,0 +1,131 @@
+#include "affinity.h"
+#include "error_handling.h"
+#include <spdlog/spdlog.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <utility>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <linux/mempolicy.h>
+
+static bool parseNumber(const std::string& text, std::size_t& pos, int& out) {
+    const std::size_t start = pos;
+    long value = 0;
+    while (pos < text.size() && text[pos] >= '0' && text[pos] <= '9') {
+        value = value * 10 + (text[pos] - '0');
+        if (value >= CPU_SETSIZE) {
+            return false;
+        }
+        ++pos;
+    }
+    out = static_cast<int>(value);
+    return pos > start;
+}
+
+int affinity::parseCpuList(const std::string& text, std::vector<int>& out) {
+    std::vector<int> cpus;
+    std::size_t pos = 0;
+    while (pos < text.size()) {
+        int first = 0;
+        if (parseNumber(text, pos, first) == false) {
+            return EC_FAILURE;
+        }
+        int last = first;
+        if (pos < text.size() && text[pos] == '-') {
+            ++pos;
+            if (parseNumber(text, pos, last) == false || last < first) {
+                return EC_FAILURE;
+            }
+        }
+        for (int cpu = first; cpu <= last; ++cpu) {
+            cpus.push_back(cpu);
+        }
+        if (pos < text.size()) {
+            if (text[pos] != ',' || pos + 1 == text.size()) {
+                return EC_FAILURE;
+            }
+            ++pos;
+        }
+    }
+    std::sort(cpus.begin(), cpus.end());
+    cpus.erase(std::unique(cpus.begin(), cpus.end()), cpus.end());
+    out = std::move(cpus);
+    return EC_SUCCESS;
+}
+
+std::string affinity::formatCpuList(const std::vector<int>& cpus) {
+    std::string out;
+    for (std::size_t i = 0; i < cpus.size();) {
+        std::size_t j = i;
+        while (j + 1 < cpus.size() && cpus[j + 1] == cpus[j] + 1) {
+            ++j;
+        }
+        if (out.empty() == false) {
+            out += ',';
+        }
+        out += std::to_string(cpus[i]);
+        if (j > i) {
+            out += '-';
+            out += std::to_string(cpus[j]);
+        }
+        i = j + 1;
+    }
+    return out;
+}
+
+int affinity::nodeCpus(int node, std::vector<int>& cpus) {
+    std::ifstream in("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+    std::string line;
+    if (node < 0 || std::getline(in, line).fail()) {
+        spdlog::error("NUMA node {} does not exist", node);
+        return EC_FAILURE;
+    }
+    line.erase(line.find_last_not_of(" \n\r\t") + 1);
+    return parseCpuList(line, cpus);
+}
+
+int affinity::applyToCurrentThread(const Placement& placement, const char* role) {
+    int result = EC_SUCCESS;
+    if (placement.cpus.empty() == false) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        for (int cpu : placement.cpus) {
+            CPU_SET(cpu, &set);
+        }
+        const int rc = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+        if (rc != 0) {
+            spdlog::error("Cannot pin the {} thread to CPUs {}: {}", role, formatCpuList(placement.cpus), std::strerror(rc));
+            result = EC_FAILURE;
+        }
+    }
+    if (placement.numaNode >= 0) {
+        // Prefer, not bind: when the node runs out of memory the allocation still succeeds elsewhere.
+        unsigned long mask[CPU_SETSIZE / (8 * sizeof(unsigned long))] = {};
+        const unsigned long bits = 8 * sizeof(unsigned long);
+        mask[placement.numaNode / bits] = 1ul << (placement.numaNode % bits);
+        if (syscall(SYS_set_mempolicy, MPOL_PREFERRED, mask, sizeof(mask) * 8) != 0) {
+            spdlog::error("Cannot prefer NUMA node {} for the {} thread: {}", placement.numaNode, role, std::strerror(errno));
+            result = EC_FAILURE;
+        }
+    }
+    if (placement.fifoPriority > 0) {
+        sched_param param{};
+        param.sched_priority = placement.fifoPriority;
+        const int rc = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+        if (rc != 0) {
+            spdlog::error("Cannot run the {} thread as SCHED_FIFO {}: {}{}", role, placement.fifoPriority, std::strerror(rc),
+                rc == EPERM ? " (needs CAP_SYS_NICE or an RLIMIT_RTPRIO)" : "");
+            result = EC_FAILURE;
+        }
+    }
+    if (result == EC_SUCCESS && (placement.cpus.empty() == false || placement.numaNode >= 0 || placement.fifoPriority > 0)) {
+        spdlog::info("Placed the {} thread: cpus={} numa={} fifo={}", role,
+            placement.cpus.empty() ? "any" : formatCpuList(placement.cpus), placement.numaNode, placement.fifoPriority);
+    }
+    return result;
+}
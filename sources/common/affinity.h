@@ -0,0 +1,35 @@
+#pragma once
+#include <string>
+#include <vector>
+
+/// @brief CPU and NUMA placement for the calling thread.
+///
+/// Linux only. NUMA support goes through the `set_mempolicy` system call, so it needs no
+/// libnuma; on a single-node machine node 0 is the only valid node.
+namespace affinity {
+
+    /// @brief Where a thread role runs and allocates.
+    struct Placement {
+        std::vector<int> cpus; ///< Allowed CPUs; empty leaves the thread to the scheduler.
+        int numaNode = -1;     ///< Preferred node for new pages the thread touches, -1 for the default policy.
+        int fifoPriority = 0;  ///< SCHED_FIFO priority 1..99, 0 keeps SCHED_OTHER.
+    };
+
+    /// @brief Parses a Linux CPU list such as "0-3,8,10-11".
+    /// @param cpus Receives the sorted, de-duplicated CPU numbers; left untouched on failure.
+    /// @return EC_SUCCESS, or EC_FAILURE for malformed text or CPUs beyond CPU_SETSIZE.
+    int parseCpuList(const std::string& text, std::vector<int>& cpus);
+
+    /// @return The list in the same notation, e.g. "0-3,8".
+    std::string formatCpuList(const std::vector<int>& cpus);
+
+    /// @brief Reads the CPUs of a NUMA node from sysfs.
+    /// @return EC_SUCCESS, or EC_FAILURE if the node does not exist.
+    int nodeCpus(int node, std::vector<int>& cpus);
+
+    /// @brief Applies the placement to the calling thread.
+    /// @param role Used in log messages, e.g. "router".
+    /// @return EC_SUCCESS, or EC_FAILURE if any part was rejected by the kernel (it is logged).
+    int applyToCurrentThread(const Placement& placement, const char* role);
+
+} // namespace affinity
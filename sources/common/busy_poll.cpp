@@ -0,0 +1,57 @@
+#include "busy_poll.h"
+#include <zmq_addon.hpp> // For zmq::recv_multipart
+#include <chrono>
+#include <iterator>
+#include <sched.h>
+
+/// Polls between clock reads; a DONTWAIT receive on an empty socket is far cheaper than a clock read.
+static constexpr uint32_t kPollsPerClockRead = 16;
+/// Gives up the core every this many polls, so a spinning thread that shares its core lets others run.
+static constexpr uint32_t kPollsPerYield = 1024;
+
+bool busypoll::spin(
+    int64_t budgetNs,
+    Counters& counters,
+    const std::function<bool()>& poll
+) {
+    const auto start = std::chrono::steady_clock::now();
+    int64_t spentNs = 0;
+    for (uint32_t polls = 1;; ++polls) {
+        if (poll()) {
+            counters.hits += 1;
+            counters.spinNs += static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - start).count());
+            return true;
+        }
+        relax();
+        if (polls % kPollsPerYield == 0) {
+            sched_yield();
+        }
+        if (polls % kPollsPerClockRead == 0) {
+            spentNs = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+            if (spentNs >= budgetNs) {
+                break;
+            }
+        }
+    }
+    counters.misses += 1;
+    counters.spinNs += static_cast<uint64_t>(spentNs);
+    return false;
+}
+
+zmq::recv_result_t busypoll::recvMultipart(
+    zmq::socket_t& socket,
+    std::vector<zmq::message_t>& frames,
+    int64_t budgetNs,
+    Counters& counters
+) {
+    zmq::recv_result_t result;
+    // Multipart messages are delivered atomically, so once the first part is there the rest is too.
+    if (budgetNs > 0 && spin(budgetNs, counters, [&] {
+            result = zmq::recv_multipart(socket, std::back_inserter(frames), zmq::recv_flags::dontwait);
+            return result.has_value();
+        })) {
+        return result;
+    }
+    return zmq::recv_multipart(socket, std::back_inserter(frames));
+}
@@ -0,0 +1,50 @@
+#pragma once
+#include "zmq.hpp"
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+/// @brief Spin-then-block receive for latency-critical deployments.
+///
+/// Polling the socket with ZMQ_DONTWAIT avoids the kernel wakeup on every message at the cost
+/// of a busy core, so the spinning thread should be pinned to a core of its own (server:
+/// `router_cpus`, ipc_bench: `--cpus`). After the budget the receive blocks as usual.
+namespace busypoll {
+
+    /// @brief Outcome counters of one receiving thread; the thread is the only writer.
+    struct Counters {
+        uint64_t hits = 0;   ///< Messages that arrived while spinning.
+        uint64_t misses = 0; ///< Receives that used up the budget and blocked.
+        uint64_t spinNs = 0; ///< Time spent spinning, hits and misses.
+    };
+
+    /// @brief CPU hint for a spin-wait loop; lets the sibling hyper-thread run and saves power.
+    inline void relax() {
+#if defined(__x86_64__) || defined(__i386__)
+        __builtin_ia32_pause();
+#elif defined(__aarch64__)
+        asm volatile("yield" ::: "memory");
+#endif
+    }
+
+    /// @brief Calls `poll` until it reports readiness or `budgetNs` is used up, and counts the outcome.
+    /// @param poll A non-blocking readiness check, e.g. a ZMQ_DONTWAIT receive or a zero-timeout epoll_wait.
+    /// @return true on a hit, false when the caller has to block.
+    bool spin(
+        int64_t budgetNs,
+        Counters& counters,
+        const std::function<bool()>& poll
+    );
+
+    /// @brief Receives one multipart message into `frames`.
+    /// @param budgetNs How long to poll before blocking; 0 blocks right away and counts nothing.
+    /// @return The result of the receive that completed, empty on timeout (e.g. ZMQ_RCVTIMEO,
+    /// which starts once the spin budget is used up).
+    zmq::recv_result_t recvMultipart(
+        zmq::socket_t& socket,
+        std::vector<zmq::message_t>& frames,
+        int64_t budgetNs,
+        Counters& counters
+    );
+
+} // namespace busypoll
@@ -0,0 +1,81 @@
+#include "capture_file.h"
+#include "error_handling.h"
+#include <spdlog/spdlog.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+int capture::listFiles(const std::string& dir, std::vector<std::string>& files) {
+    DIR* handle = opendir(dir.c_str());
+    if (handle == nullptr) {
+        spdlog::error("Cannot open capture directory {}: {}", dir, std::strerror(errno));
+        return EC_FAILURE;
+    }
+    const std::size_t extension = std::strlen(kExtension);
+    std::vector<std::string> found;
+    while (const dirent* entry = readdir(handle)) {
+        const std::string name = entry->d_name;
+        if (name.size() > extension && name.compare(name.size() - extension, extension, kExtension) == 0) {
+            found.push_back(name);
+        }
+    }
+    closedir(handle);
+    // The names carry a zero-padded start time and sequence, so they sort in write order.
+    std::sort(found.begin(), found.end());
+    for (const std::string& name : found) {
+        files.push_back(dir + "/" + name);
+    }
+    return EC_SUCCESS;
+}
+
+int capture::readFile(const std::string& path, std::vector<Record>& records) {
+    const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        spdlog::error("Cannot open capture file {}: {}", path, std::strerror(errno));
+        return EC_FAILURE;
+    }
+    struct stat st{};
+    if (fstat(fd, &st) != 0 || static_cast<std::size_t>(st.st_size) < sizeof(FileHeader)) {
+        spdlog::error("Capture file {} is too short", path);
+        ::close(fd);
+        return EC_FAILURE;
+    }
+    const std::size_t size = static_cast<std::size_t>(st.st_size);
+    void* mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (mapped == MAP_FAILED) {
+        spdlog::error("Cannot map capture file {}: {}", path, std::strerror(errno));
+        return EC_FAILURE;
+    }
+    const char* base = static_cast<const char*>(mapped);
+    if (std::memcmp(base, kMagic, sizeof(kMagic)) != 0) {
+        spdlog::error("{} is not a capture file", path);
+        munmap(mapped, size);
+        return EC_FAILURE;
+    }
+    std::size_t offset = sizeof(FileHeader);
+    while (offset + sizeof(RecordHeader) <= size) {
+        Record record;
+        std::memcpy(&record.header, base + offset, sizeof(RecordHeader));
+        if (record.header.arrivalNs == 0) {
+            break; // The zeroed tail of a file the server did not close.
+        }
+        const std::size_t bytes = recordBytes(record.header.clientIdSize, record.header.payloadSize);
+        if (offset + bytes > size) {
+            spdlog::warn("Truncated record at offset {} in {}", offset, path);
+            break;
+        }
+        const char* body = base + offset + sizeof(RecordHeader);
+        record.clientId.assign(body, record.header.clientIdSize);
+        record.payload.assign(body + record.header.clientIdSize, record.header.payloadSize);
+        records.push_back(std::move(record));
+        offset += bytes;
+    }
+    munmap(mapped, size);
+    return EC_SUCCESS;
+}
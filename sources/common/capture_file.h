@@ -0,0 +1,63 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/// @brief On-disk layout of the server's traffic capture, shared by the writer and `ipc_replay`.
+///
+/// A capture is a set of files `capture-<start>-<seq>.ipccap` in the capture directory. Each file
+/// is a `FileHeader` followed by records, every record a `RecordHeader`, the client id, the frame
+/// payload exactly as it arrived, and zero padding to 8 bytes. The writer fills preallocated,
+/// zeroed files, so a record header with `arrivalNs == 0` marks the end of a file that was not
+/// closed cleanly. Integers are in host byte order; captures are replayed on the same kind of machine.
+namespace capture {
+
+    constexpr char kMagic[8] = {'I', 'P', 'C', 'C', 'A', 'P', '0', '1'};
+    constexpr const char* kExtension = ".ipccap";
+    /// `RecordHeader::serviceUs` of a request whose reply was sent later, e.g. a parked GetMany.
+    constexpr uint32_t kServiceDeferred = UINT32_MAX;
+
+    enum class RecordKind : uint8_t {
+        ENVELOPE = 0,  ///< An EnvelopeReq in the client's wire format.
+        HANDSHAKE = 1  ///< The client's FirstHandshake.
+    };
+
+    struct FileHeader {
+        char magic[8];
+        uint64_t sequence; ///< Position of the file in the capture, from 0.
+    };
+
+    struct RecordHeader {
+        uint64_t arrivalNs;   ///< Monotonic time the router read the frame.
+        uint64_t issuedId;    ///< Ticket or pattern set handle the reply carried, 0 for none.
+        uint32_t serviceUs;   ///< Arrival to reply on the router, or kServiceDeferred.
+        uint32_t payloadSize;
+        uint16_t clientIdSize;
+        uint8_t kind;         ///< A RecordKind.
+        uint8_t wireFormat;   ///< ipc::WireFormat of an ENVELOPE payload.
+        uint32_t reserved;
+    };
+    static_assert(sizeof(FileHeader) == 16 && sizeof(RecordHeader) == 32);
+
+    /// @return The record's size in the file, padding included.
+    inline std::size_t recordBytes(const std::size_t clientIdSize, const std::size_t payloadSize) {
+        return (sizeof(RecordHeader) + clientIdSize + payloadSize + 7) & ~std::size_t{7};
+    }
+
+    /// @brief One record read back from a capture.
+    struct Record {
+        RecordHeader header;
+        std::string clientId;
+        std::string payload;
+    };
+
+    /// @brief Lists the capture files in `dir` in the order they were written.
+    /// @return EC_SUCCESS, or EC_FAILURE if the directory cannot be read.
+    int listFiles(const std::string& dir, std::vector<std::string>& files);
+
+    /// @brief Appends the records of one capture file to `records`.
+    /// @return EC_SUCCESS, or EC_FAILURE if the file cannot be read or is not a capture.
+    int readFile(const std::string& path, std::vector<Record>& records);
+
+} // namespace capture
@@ -1,4 +1,5 @@
 #include "error_handling.h"
+#include "log.h"
 #include "spdlog/spdlog.h"
 #include "ipc.pb.h"
 #include "zmq.hpp"
@@ -12,16 +13,18 @@ static const char* statusToStr(ipc::Status s) {
     case ipc::ST_ERROR_STRING_TOO_LONG:  return "ERROR_STRING_TOO_LONG";
     case ipc::ST_ERROR_INTERNAL:         return "ERROR_INTERNAL";
     case ipc::ST_NOT_FINISHED:           return "NOT_FINISHED";
+    case ipc::ST_ERROR_UNKNOWN_HANDLE:   return "ERROR_UNKNOWN_HANDLE";
+    case ipc::ST_ERROR_RATE_LIMITED:     return "ERROR_RATE_LIMITED";
     default: return "UNKNOWN";
     }
 }
 
-int handleIpcError(ipc::Status status) {
+[[gnu::cold]] int handleIpcError(ipc::Status status) {
     if (status != ipc::ST_SUCCESS) {
         const char* errorName = statusToStr(status);
         if (status == ipc::ST_NOT_FINISHED) {
             printf("IPC Info: [%s]\n", errorName);
-            spdlog::info("IPC Error: [{}]", errorName);
+            IPC_LOG_DEBUG("IPC Info: [{}]", errorName);
             return EC_SUCCESS;
         } else {
             printf("IPC Error: [%s]\n", errorName);
@@ -33,7 +36,7 @@ int handleIpcError(ipc::Status status) {
     return EC_SUCCESS;
 }
 
-int handleZmqSendError(zmq::send_result_t status, const char* file, int line, const char* func, const char* msg) {
+[[gnu::cold]] int handleZmqSendError(zmq::send_result_t status, const char* file, int line, const char* func, const char* msg) {
     if (status.has_value() == false) {
         spdlog::error("ZMQ Send Error: [Failed to send message] | File: {} | Line: {} | Function: {} | Message: {}", file, line, func, msg ? msg : "NONE");
         return EC_FAILURE;
@@ -42,7 +45,7 @@ int handleZmqSendError(zmq::send_result_t status, const char* file, int line, co
     return EC_SUCCESS;
 }
 
-int handleRegularError(int status, const char* file, int line, const char* func, const char* msg) {
+[[gnu::cold]] int handleRegularError(int status, const char* file, int line, const char* func, const char* msg) {
     if (status != EC_SUCCESS) {
         spdlog::error("Regular Error: [{}] | File: {} | Line: {} | Function: {} | Message: {}", status, file, line, func, msg ? msg : "NONE");
         return status;
@@ -1,5 +1,6 @@
 #pragma once
 #include <cinttypes>
+#include <type_traits>
 
 // Standard success and failure codes. Using a macro for EC_FAILURE allows for easy modification of the failure value.
 #define EC_SUCCESS (0)
@@ -14,12 +15,30 @@ enum class ErrorType : uint8_t {
     DEFAULT   ///< A generic category for standard integer-based error codes.
 };
 
-/// @brief A template function that serves as the central point for all error checks.
+/// @brief Inline success test used by the macros before anything else is touched.
+///
+/// Only a failed status reaches `errorCheck`, so a successful call costs one compare and
+/// never formats file, line or function strings.
+/// @tparam Type The specific category of the error, defined by the `ErrorType` enum.
+/// @tparam StatusType The data type of the status code being checked.
+/// @param status The status code returned by a function call.
+/// @return true if the status is anything other than success.
+template<ErrorType Type, typename StatusType>
+inline bool isErrorStatus(const StatusType& status) {
+    if constexpr (Type == ErrorType::ZMQ_SEND) {
+        return status.has_value() == false;
+    } else {
+        // Both EC_SUCCESS and ipc::ST_SUCCESS are 0.
+        return static_cast<int>(status) != EC_SUCCESS;
+    }
+}
+
+/// @brief A template function that serves as the central point for all error reporting.
 ///
 /// This function uses a template to provide a uniform interface for checking
 /// different types of status codes. Its implementation relies on `if constexpr`
 /// to select the appropriate error-handling function at compile time based on the `ErrorType`.
-/// This approach ensures a single, flexible entry point without runtime overhead.
+/// It is only reached for failed statuses and is kept out of line in a cold section.
 ///
 /// @tparam Type The specific category of the error, defined by the `ErrorType` enum.
 /// @tparam StatusType The data type of the status code being checked (e.g., `int`, `zmq::send_result_t`, `ipc::Status`).
@@ -30,18 +49,21 @@ enum class ErrorType : uint8_t {
 /// @param msg A custom message to provide additional context for the error.
 /// @return Returns `EC_SUCCESS` on success or an appropriate error code on failure.
 template<ErrorType Type, typename StatusType>
-int errorCheck(StatusType status, const char* file, int line, const char* func, const char* msg);
+[[gnu::cold, gnu::noinline]] int errorCheck(StatusType status, const char* file, int line, const char* func, const char* msg);
 
 /// @brief A macro to check for errors and return upon failure.
 ///
-/// This macro wraps a function call, passes its status to `errorCheck`,
+/// This macro wraps a function call, passes a failed status to `errorCheck`,
 /// and immediately returns the error code if the status indicates a failure.
 /// The `decltype(status)` ensures the macro is type-safe and works with any status type.
-#define RETURN_IF_ERROR(type, status, errMsg)                                                                   \
+#define RETURN_IF_ERROR(type, status, errMsg)                                                               \
     do {                                                                                                    \
-        int errorMsg = errorCheck<type, decltype(status)>(status, __FILE__, __LINE__, __FUNCTION__, errMsg);\
-        if (errorMsg != EC_SUCCESS) {                                                                       \
-            return errorMsg;                                                                                \
+        const auto& ipcStatus_ = (status);                                                                  \
+        if (isErrorStatus<type>(ipcStatus_)) [[unlikely]] {                                                 \
+            int errorMsg = errorCheck<type, std::remove_cvref_t<decltype(status)>>(ipcStatus_, __FILE__, __LINE__, __FUNCTION__, errMsg);\
+            if (errorMsg != EC_SUCCESS) {                                                                   \
+                return errorMsg;                                                                            \
+            }                                                                                               \
         }                                                                                                   \
     } while (0)
 
@@ -52,6 +74,9 @@ int errorCheck(StatusType status, const char* file, int line, const char* func,
 /// cast is used to suppress "unused variable" warnings.
 #define PRINT_ERROR_NO_RET(type, status, errMsg)                                                            \
     do {                                                                                                    \
-        int errorMsg = errorCheck<type, decltype(status)>(status, __FILE__, __LINE__, __FUNCTION__, errMsg);\
-        (void)errorMsg;                                                                                     \
+        const auto& ipcStatus_ = (status);                                                                  \
+        if (isErrorStatus<type>(ipcStatus_)) [[unlikely]] {                                                 \
+            int errorMsg = errorCheck<type, std::remove_cvref_t<decltype(status)>>(ipcStatus_, __FILE__, __LINE__, __FUNCTION__, errMsg);\
+            (void)errorMsg;                                                                                 \
+        }                                                                                                   \
     } while (0)
@@ -0,0 +1,46 @@
+#include "framing.h"
+#include "error_handling.h"
+#include <utility>
+#include <sys/un.h>
+
+int framing::parseEndpoint(const std::string& text, Endpoint& endpoint) {
+    static const std::string unixPrefix = "unix:";
+    static const std::string inprocPrefix = "inproc:";
+    /// Names become part of an inproc:// address; keep them short and printable.
+    static constexpr std::size_t kMaxInprocName = 64;
+    if (text == "zmq") {
+        endpoint = Endpoint{Transport::ZMQ, {}, {}};
+        return EC_SUCCESS;
+    }
+    if (text == "tcp") {
+        endpoint = Endpoint{Transport::TCP, {}, {}};
+        return EC_SUCCESS;
+    }
+    if (text.compare(0, unixPrefix.size(), unixPrefix) == 0) {
+        std::string path = text.substr(unixPrefix.size());
+        if (path.empty() || path.size() >= sizeof(sockaddr_un::sun_path)) {
+            return EC_FAILURE;
+        }
+        endpoint = Endpoint{Transport::UNIX, std::move(path), {}};
+        return EC_SUCCESS;
+    }
+    if (text.compare(0, inprocPrefix.size(), inprocPrefix) == 0) {
+        std::string name = text.substr(inprocPrefix.size());
+        if (name.empty() || name.size() > kMaxInprocName) {
+            return EC_FAILURE;
+        }
+        endpoint = Endpoint{Transport::INPROC, {}, std::move(name)};
+        return EC_SUCCESS;
+    }
+    return EC_FAILURE;
+}
+
+const char* framing::transportName(Transport transport) {
+    switch (transport) {
+    case Transport::ZMQ:  return "zmq";
+    case Transport::TCP:  return "tcp";
+    case Transport::UNIX: return "unix";
+    case Transport::INPROC: return "inproc";
+    }
+    return "unknown";
+}
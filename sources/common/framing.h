@@ -0,0 +1,62 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/// @brief Length-prefixed framing for the stream transports (TCP and Unix sockets).
+///
+/// Every frame is a 4-byte little-endian payload length followed by the payload. The payload is
+/// exactly what the ZeroMQ path carries in its last frame: the FirstHandshake first, then
+/// EnvelopeReq/EnvelopeResp in the negotiated wire format.
+namespace framing {
+
+    constexpr std::size_t kHeaderBytes = 4;
+    /// Larger frames are a protocol error; the connection is closed before anything is allocated.
+    constexpr uint32_t kMaxFrameBytes = 64u * 1024u * 1024u;
+
+    enum class Transport : uint8_t {
+        ZMQ,  ///< ROUTER/DEALER over tcp://address:port.
+        TCP,  ///< Length-prefixed frames over a plain TCP connection to address:port.
+        UNIX, ///< Length-prefixed frames over a Unix stream socket at `Endpoint::unixPath`.
+        INPROC ///< ROUTER/DEALER over inproc://, server and clients in one process, see `inproc::context`.
+    };
+
+    /// @brief How a client reaches the server, or which frontend the server listens on.
+    struct Endpoint {
+        Transport transport = Transport::ZMQ;
+        std::string unixPath;   ///< Socket path for Transport::UNIX.
+        std::string inprocName; ///< Endpoint name for Transport::INPROC.
+    };
+
+    /// @brief Parses "zmq", "tcp", "unix:<path>" or "inproc:<name>".
+    /// @param endpoint Left untouched on failure.
+    /// @return EC_SUCCESS, or EC_FAILURE for anything else.
+    int parseEndpoint(const std::string& text, Endpoint& endpoint);
+
+    /// @return "zmq", "tcp", "unix" or "inproc".
+    const char* transportName(Transport transport);
+
+    /// @return true for the transports that use this framing, false for the ZeroMQ ones.
+    inline bool isStream(Transport transport) {
+        return transport == Transport::TCP || transport == Transport::UNIX;
+    }
+
+    /// @brief Appends the header of a `size` byte frame.
+    inline void appendHeader(std::string& out, uint32_t size) {
+        const char header[kHeaderBytes] = {
+            static_cast<char>(size & 0xff),
+            static_cast<char>((size >> 8) & 0xff),
+            static_cast<char>((size >> 16) & 0xff),
+            static_cast<char>((size >> 24) & 0xff),
+        };
+        out.append(header, kHeaderBytes);
+    }
+
+    /// @return The payload size stored in the `kHeaderBytes` at `data`.
+    inline uint32_t readHeader(const char* data) {
+        const auto* bytes = reinterpret_cast<const unsigned char*>(data);
+        return static_cast<uint32_t>(bytes[0]) | (static_cast<uint32_t>(bytes[1]) << 8) |
+            (static_cast<uint32_t>(bytes[2]) << 16) | (static_cast<uint32_t>(bytes[3]) << 24);
+    }
+
+} // namespace framing
@@ -0,0 +1,12 @@
+#include "inproc.h"
+
+zmq::context_t& inproc::context() {
+    // Leaked on purpose: terminating a context waits for its sockets, and at exit the singletons
+    // holding them may not be destroyed yet. No I/O thread, inproc traffic does not use one.
+    static zmq::context_t* ctx = new zmq::context_t(0);
+    return *ctx;
+}
+
+std::string inproc::address(const std::string& name) {
+    return "inproc://ipc-" + name;
+}
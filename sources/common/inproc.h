@@ -0,0 +1,20 @@
+#pragma once
+#include "zmq.hpp"
+#include <string>
+
+/// @brief The ZeroMQ context behind `inproc://` endpoints.
+///
+/// inproc endpoints only connect sockets created from the same context, so a server embedded
+/// with the "inproc:<name>" frontend and the sessions of its process use this one instead of
+/// their own. Messages between them are handed over in memory: no I/O thread, no TCP stack.
+/// Both the server and the client library compile this file; link them statically into one
+/// binary so there is a single context.
+namespace inproc {
+
+    /// @return The process-wide context, created on first use and never destroyed.
+    zmq::context_t& context();
+
+    /// @return The inproc:// address of an endpoint name.
+    std::string address(const std::string& name);
+
+} // namespace inproc
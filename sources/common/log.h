@@ -0,0 +1,65 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <spdlog/spdlog.h>
+
+/// @brief Logging helpers for hot paths.
+///
+/// Debug statements go through `IPC_LOG_DEBUG`, which is stripped at compile time unless the
+/// build enables `IPC_DEBUG_LOGS` (it maps to `SPDLOG_ACTIVE_LEVEL`). Messages that a client
+/// can trigger on every request use the rate-limited or sampled variants, so a misbehaving
+/// client cannot turn the log into the bottleneck.
+namespace logging {
+
+    /// @brief Allows one event per interval and counts the ones it drops in between.
+    /// Lock-free; one instance lives at each call site.
+    struct RateLimiter {
+        explicit RateLimiter(uint32_t intervalMs) : mIntervalNs(static_cast<int64_t>(intervalMs) * 1000000) {}
+
+        /// @param suppressed Receives the number of events dropped since the last allowed one.
+        /// @return true if the caller should log.
+        bool allow(uint64_t& suppressed) {
+            const int64_t now = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+            int64_t next = mNextNs.load(std::memory_order_relaxed);
+            if (now < next || mNextNs.compare_exchange_strong(next, now + mIntervalNs, std::memory_order_relaxed) == false) {
+                mSuppressed.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            }
+            suppressed = mSuppressed.exchange(0, std::memory_order_relaxed);
+            return true;
+        }
+
+    private:
+        const int64_t mIntervalNs;
+        std::atomic<int64_t> mNextNs{0};
+        std::atomic<uint64_t> mSuppressed{0};
+    };
+
+} // namespace logging
+
+/// Compiled out unless the build defines SPDLOG_ACTIVE_LEVEL <= SPDLOG_LEVEL_DEBUG.
+#define IPC_LOG_DEBUG(...) SPDLOG_DEBUG(__VA_ARGS__)
+
+/// Logs at most once per `intervalMs` from this call site and reports how many messages were dropped.
+#define IPC_LOG_RATE_LIMITED(intervalMs, level, ...)                                                    \
+    do {                                                                                                \
+        static ::logging::RateLimiter ipcLogLimiter_(intervalMs);                                       \
+        uint64_t ipcLogSuppressed_ = 0;                                                                 \
+        if (ipcLogLimiter_.allow(ipcLogSuppressed_)) {                                                  \
+            if (ipcLogSuppressed_ > 0) {                                                                \
+                spdlog::log(level, "({} similar messages suppressed)", ipcLogSuppressed_);              \
+            }                                                                                           \
+            spdlog::log(level, __VA_ARGS__);                                                            \
+        }                                                                                               \
+    } while (0)
+
+/// Logs the first and then every `n`-th message from this call site.
+#define IPC_LOG_EVERY_N(n, level, ...)                                                                  \
+    do {                                                                                                \
+        static std::atomic<uint64_t> ipcLogCount_{0};                                                   \
+        if (ipcLogCount_.fetch_add(1, std::memory_order_relaxed) % (n) == 0) {                          \
+            spdlog::log(level, __VA_ARGS__);                                                            \
+        }                                                                                               \
+    } while (0)
@@ -0,0 +1,176 @@
+#include "trace.h"
+#include "error_handling.h"
+#include <spdlog/spdlog.h>
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <vector>
+#include <pthread.h>
+#include <unistd.h>
+
+namespace {
+
+    struct Span {
+        const char* name;
+        int64_t startNs;
+        int64_t durNs;
+    };
+
+    /// One thread's spans. The owning thread is the only writer; `head` counts every span ever
+    /// written, so a reader can tell which slots were overwritten while it was copying.
+    /// A ring whose thread exited is handed to the next new thread; the spans of its previous
+    /// owner stay readable under that owner's tid until they are overwritten.
+    struct ThreadRing {
+        static constexpr uint64_t kCapacity = 1u << 14;
+
+        Span spans[kCapacity];
+        std::atomic<uint64_t> head{0};
+        uint32_t tid = 0;
+        char name[32] = {};
+        uint64_t ownerSince = 0; ///< First span of the current owner; guarded by `gRingsMtx` like the fields below.
+        uint32_t prevTid = 0;    ///< Previous owner, 0 if none; its spans are [prevSince, ownerSince).
+        uint64_t prevSince = 0;
+        char prevName[32] = {};
+    };
+
+    pthread_mutex_t gRingsMtx = PTHREAD_MUTEX_INITIALIZER;
+    std::vector<std::unique_ptr<ThreadRing>>* gRings = nullptr; ///< Never freed, rings must outlive every thread.
+    std::vector<ThreadRing*>* gFreeRings = nullptr;             ///< Rings of exited threads, reused first.
+    uint32_t gNextTid = 0;
+
+    /// Hands the calling thread's ring back when the thread exits, so a pool that keeps
+    /// replacing its workers does not allocate a ring per thread ever started.
+    struct RingOwner {
+        ThreadRing* ring = nullptr;
+
+        ~RingOwner() {
+            if (ring != nullptr) {
+                pthread_mutex_lock(&gRingsMtx);
+                gFreeRings->push_back(ring);
+                pthread_mutex_unlock(&gRingsMtx);
+            }
+        }
+    };
+
+    ThreadRing& localRing() {
+        thread_local RingOwner owner;
+        if (owner.ring == nullptr) {
+            pthread_mutex_lock(&gRingsMtx);
+            if (gRings == nullptr) {
+                gRings = new std::vector<std::unique_ptr<ThreadRing>>();
+                gFreeRings = new std::vector<ThreadRing*>();
+            }
+            ThreadRing* ring = nullptr;
+            if (gFreeRings->empty() == false) {
+                ring = gFreeRings->back();
+                gFreeRings->pop_back();
+                ring->prevTid = ring->tid;
+                ring->prevSince = ring->ownerSince;
+                std::memcpy(ring->prevName, ring->name, sizeof(ring->name));
+                ring->ownerSince = ring->head.load(std::memory_order_relaxed);
+            } else {
+                gRings->emplace_back(std::make_unique<ThreadRing>());
+                ring = gRings->back().get();
+            }
+            ring->tid = ++gNextTid;
+            std::snprintf(ring->name, sizeof(ring->name), "thread-%u", ring->tid);
+            pthread_mutex_unlock(&gRingsMtx);
+            owner.ring = ring;
+        }
+        return *owner.ring;
+    }
+
+
+    void writeEscaped(FILE* out, const char* s) {
+        for (; *s; ++s) {
+            if (*s == '"' || *s == '\\') {
+                std::fputc('\\', out);
+            }
+            std::fputc(*s, out);
+        }
+    }
+
+    void writeThreadName(FILE* out, int pid, uint32_t tid, const char* name) {
+        std::fprintf(out, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%u,\"args\":{\"name\":\"", pid, tid);
+        writeEscaped(out, name);
+        std::fputs("\"}}", out);
+    }
+
+} // namespace
+
+void trace::setThreadName(const char* name) {
+    ThreadRing& ring = localRing();
+    pthread_mutex_lock(&gRingsMtx);
+    std::snprintf(ring.name, sizeof(ring.name), "%s", name);
+    pthread_mutex_unlock(&gRingsMtx);
+}
+
+void trace::recordSpan(const char* name, int64_t startNs, int64_t endNs) {
+    ThreadRing& ring = localRing();
+    const uint64_t head = ring.head.load(std::memory_order_relaxed);
+    ring.spans[head & (ThreadRing::kCapacity - 1)] = Span{name, startNs, endNs - startNs};
+    ring.head.store(head + 1, std::memory_order_release);
+}
+
+int trace::dumpChromeTrace(const std::string& path, uint64_t& events) {
+    events = 0;
+    FILE* out = std::fopen(path.c_str(), "w");
+    if (out == nullptr) {
+        spdlog::error("Cannot open trace file {}", path);
+        return EC_FAILURE;
+    }
+    const int pid = static_cast<int>(getpid());
+    std::vector<Span> copy;
+    bool first = true;
+    auto separator = [&] () {
+        std::fputs(first ? "\n" : ",\n", out);
+        first = false;
+    };
+
+    std::fputs("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[", out);
+    pthread_mutex_lock(&gRingsMtx);
+    const std::size_t rings = gRings == nullptr ? 0 : gRings->size();
+    for (std::size_t r = 0; r < rings; ++r) {
+        const ThreadRing& ring = *(*gRings)[r];
+        separator();
+        writeThreadName(out, pid, ring.tid, ring.name);
+        if (ring.prevTid != 0) {
+            separator();
+            writeThreadName(out, pid, ring.prevTid, ring.prevName);
+        }
+
+        // Copy without stopping the writer, then drop whatever it may have overwritten meanwhile.
+        const uint64_t end = ring.head.load(std::memory_order_acquire);
+        const uint64_t begin = end > ThreadRing::kCapacity ? end - ThreadRing::kCapacity : 0;
+        copy.clear();
+        for (uint64_t i = begin; i < end; ++i) {
+            copy.push_back(ring.spans[i & (ThreadRing::kCapacity - 1)]);
+        }
+        // The writer fills slot `head` before it publishes `head + 1`, so the slot after the last
+        // published one may be half written too.
+        const uint64_t after = ring.head.load(std::memory_order_acquire);
+        const uint64_t overwritten = after + 1 > ThreadRing::kCapacity ? after + 1 - ThreadRing::kCapacity : 0;
+        const uint64_t first = std::max(overwritten, ring.prevTid != 0 ? ring.prevSince : ring.ownerSince);
+
+        for (uint64_t i = std::max(first, begin); i < end; ++i) {
+            const Span& span = copy[static_cast<std::size_t>(i - begin)];
+            separator();
+            std::fprintf(out, "{\"name\":\"");
+            writeEscaped(out, span.name);
+            std::fprintf(out, "\",\"ph\":\"X\",\"pid\":%d,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+                pid, i >= ring.ownerSince ? ring.tid : ring.prevTid, span.startNs / 1000.0, span.durNs / 1000.0);
+            ++events;
+        }
+    }
+    pthread_mutex_unlock(&gRingsMtx);
+    std::fputs("\n]}\n", out);
+    const bool ok = std::fclose(out) == 0;
+    if (ok == false) {
+        spdlog::error("Failed to write trace file {}", path);
+        return EC_FAILURE;
+    }
+    spdlog::info("Wrote {} trace events to {}", events, path);
+    return EC_SUCCESS;
+}
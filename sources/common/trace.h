@@ -0,0 +1,79 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+/// @brief Scoped timing probes for the request hot path, written as Chrome trace-event JSON.
+///
+/// Every thread records into its own fixed-size ring, so a probe is two clock reads and one
+/// store with no locks; when the ring is full the oldest spans are overwritten. When a thread
+/// exits its ring goes to the next thread started, so the number of rings stays at the peak
+/// thread count; the spans of the exited thread are still dumped until they are overwritten.
+/// Rings are only read by `dumpChromeTrace`, which can run at any time. The result opens in chrome://tracing or https://ui.perfetto.dev.
+///
+/// The probes are only compiled in when the build defines PROFILE_APPLICATION=1 (CMake option
+/// `PROFILE_APPLICATION`); otherwise the IPC_TRACE_* macros expand to nothing and their
+/// arguments are not evaluated.
+namespace trace {
+
+    /// @return true if the probes were compiled in.
+    constexpr bool enabled() {
+#if PROFILE_APPLICATION
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    /// @return Monotonic time in nanoseconds, the time base of every span.
+    inline int64_t nowNs() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    /// @return The same time base for a time point taken elsewhere.
+    inline int64_t toNs(std::chrono::steady_clock::time_point tp) {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(tp.time_since_epoch()).count();
+    }
+
+    /// @brief Names the calling thread in the trace (e.g. "router", "worker-2").
+    void setThreadName(const char* name);
+
+    /// @brief Records a finished span on the calling thread.
+    /// @param name A string literal, it is stored by pointer.
+    void recordSpan(const char* name, int64_t startNs, int64_t endNs);
+
+    /// @brief Writes every recorded span to `path` as Chrome trace-event JSON.
+    /// @param events Receives the number of spans written.
+    /// @return EC_SUCCESS, or EC_FAILURE if the file cannot be written.
+    int dumpChromeTrace(const std::string& path, uint64_t& events);
+
+    /// @brief Records the enclosing scope as one span.
+    struct ScopedProbe {
+        explicit ScopedProbe(const char* name) : mName(name), mStartNs(nowNs()) {}
+        ~ScopedProbe() { recordSpan(mName, mStartNs, nowNs()); }
+
+        ScopedProbe(const ScopedProbe&) = delete;
+        ScopedProbe& operator=(const ScopedProbe&) = delete;
+
+    private:
+        const char* mName;
+        const int64_t mStartNs;
+    };
+
+} // namespace trace
+
+#define IPC_TRACE_CONCAT_INNER(a, b) a##b
+#define IPC_TRACE_CONCAT(a, b) IPC_TRACE_CONCAT_INNER(a, b)
+
+#if PROFILE_APPLICATION
+/// Records the rest of the enclosing scope as a span named `name`.
+#define IPC_TRACE_SCOPE(name) ::trace::ScopedProbe IPC_TRACE_CONCAT(ipcTraceProbe_, __LINE__)(name)
+/// Records a span whose start was taken earlier, possibly on another thread.
+#define IPC_TRACE_SPAN(name, startNs, endNs) ::trace::recordSpan(name, startNs, endNs)
+#define IPC_TRACE_THREAD_NAME(name) ::trace::setThreadName(name)
+#else
+#define IPC_TRACE_SCOPE(name) do {} while (0)
+#define IPC_TRACE_SPAN(name, startNs, endNs) do {} while (0)
+#define IPC_TRACE_THREAD_NAME(name) do {} while (0)
+#endif
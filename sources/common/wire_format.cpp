@@ -0,0 +1,225 @@
+#include "wire_format.h"
+
+using namespace wire;
+
+static FrameHeader makeHeader(FrameKind kind, uint8_t op, uint8_t mode, uint8_t flags) {
+    FrameHeader header;
+    header.kind = static_cast<uint8_t>(kind);
+    header.op = op;
+    header.mode = mode;
+    header.flags = flags;
+    return header;
+}
+
+template<typename Frame>
+static void writeFrame(const Frame& frame, std::string& out, std::size_t extra) {
+    out.resize(sizeof(Frame) + extra);
+    std::memcpy(out.data(), &frame, sizeof(Frame));
+}
+
+static bool encodeProtobuf(const google::protobuf::MessageLite& message, std::string& out) {
+    out.clear();
+    out.push_back(static_cast<char>(FrameKind::PROTOBUF));
+    return message.AppendToString(&out);
+}
+
+static bool fitsCompact(const std::string& s) {
+    return s.size() <= kMaxCompactString;
+}
+
+bool wire::encodeRequest(const ipc::EnvelopeReq& request, std::string& out) {
+    if (request.trace() || request.correlation_id() != 0) {
+        // The fixed frames have no room for these; tracing is a diagnostic and hedging adds its own round trip.
+        return encodeProtobuf(request, out);
+    }
+    if (request.has_submit()) {
+        const ipc::SubmitRequest& submit = request.submit();
+        const uint8_t mode = static_cast<uint8_t>(submit.mode());
+        if (submit.has_math()) {
+            const ipc::MathArgs& math = submit.math();
+            MathFrame frame;
+            frame.header = makeHeader(FrameKind::MATH, static_cast<uint8_t>(math.op()), mode, 0);
+            frame.a = toLittle(math.a());
+            frame.b = toLittle(math.b());
+            writeFrame(frame, out, 0);
+            return true;
+        }
+        if (submit.has_str() && fitsCompact(submit.str().s1()) && fitsCompact(submit.str().s2())) {
+            const ipc::StrArgs& str = submit.str();
+            StrFrame frame;
+            frame.header = makeHeader(FrameKind::STR, static_cast<uint8_t>(str.op()), mode, 0);
+            frame.len1 = toLittle(static_cast<uint16_t>(str.s1().size()));
+            frame.len2 = toLittle(static_cast<uint16_t>(str.s2().size()));
+            writeFrame(frame, out, str.s1().size() + str.s2().size());
+            char* bytes = out.data() + sizeof(StrFrame);
+            std::memcpy(bytes, str.s1().data(), str.s1().size());
+            std::memcpy(bytes + str.s1().size(), str.s2().data(), str.s2().size());
+            return true;
+        }
+    } else if (request.has_get()) {
+        const ipc::GetRequest& get = request.get();
+        GetFrame frame;
+        frame.header = makeHeader(FrameKind::GET, 0, static_cast<uint8_t>(get.wait_mode()), 0);
+        frame.timeoutMs = toLittle(get.timeout_ms());
+        frame.ticket = toLittle(get.ticket().req_id());
+        writeFrame(frame, out, 0);
+        return true;
+    }
+    return encodeProtobuf(request, out);
+}
+
+bool wire::decodeRequest(const void* data, std::size_t size, ipc::EnvelopeReq& out) {
+    switch (peekKind(data, size)) {
+    case FrameKind::PROTOBUF: {
+        if (size == 0) {
+            return false;
+        }
+        return out.ParseFromArray(static_cast<const char*>(data) + 1, static_cast<int>(size - 1));
+    }
+    case FrameKind::MATH: {
+        MathView view;
+        if (decodeMath(data, size, view) == false) {
+            return false;
+        }
+        ipc::SubmitRequest* submit = out.mutable_submit();
+        submit->set_mode(view.mode);
+        ipc::MathArgs* math = submit->mutable_math();
+        math->set_op(view.op);
+        math->set_a(view.a);
+        math->set_b(view.b);
+        return true;
+    }
+    case FrameKind::STR: {
+        StrView view;
+        if (decodeStr(data, size, view) == false) {
+            return false;
+        }
+        ipc::SubmitRequest* submit = out.mutable_submit();
+        submit->set_mode(view.mode);
+        ipc::StrArgs* str = submit->mutable_str();
+        str->set_op(view.op);
+        str->set_s1(view.s1.data(), view.s1.size());
+        str->set_s2(view.s2.data(), view.s2.size());
+        return true;
+    }
+    case FrameKind::GET: {
+        GetView view;
+        if (decodeGet(data, size, view) == false) {
+            return false;
+        }
+        ipc::GetRequest* get = out.mutable_get();
+        get->set_wait_mode(view.waitMode);
+        get->set_timeout_ms(view.timeoutMs);
+        get->mutable_ticket()->set_req_id(view.ticket);
+        return true;
+    }
+    case FrameKind::RESPONSE:
+    default:
+        return false;
+    }
+}
+
+bool wire::encodeResponse(const ipc::EnvelopeResp& response, std::string& out) {
+    ipc::Status status = ipc::ST_SUCCESS;
+    const ipc::Result* result = nullptr;
+    uint8_t flags = 0;
+    uint64_t ticket = 0;
+    if (response.has_timing() || response.correlation_id() != 0) {
+        return encodeProtobuf(response, out);
+    }
+    if (response.has_submit()) {
+        const ipc::SubmitResponse& submit = response.submit();
+        status = submit.status();
+        if (submit.has_ticket()) {
+            flags |= kFlagHasTicket;
+            ticket = submit.ticket().req_id();
+        }
+        result = submit.has_result() ? &submit.result() : nullptr;
+    } else if (response.has_get()) {
+        const ipc::GetResponse& get = response.get();
+        status = get.status();
+        flags |= kFlagGetResponse;
+        result = get.has_result() ? &get.result() : nullptr;
+    } else {
+        return encodeProtobuf(response, out);
+    }
+    if (result != nullptr) {
+        flags |= kFlagHasResult;
+    }
+
+    ResultKind kind = ResultKind::NONE;
+    int32_t value = 0;
+    const std::string* str = nullptr;
+    if (result != nullptr) {
+        switch (result->value_case()) {
+        case ipc::Result::kIntResult: kind = ResultKind::INT;      value = result->int_result(); break;
+        case ipc::Result::kPosition:  kind = ResultKind::POSITION; value = result->position();   break;
+        case ipc::Result::kStrResult:
+            if (fitsCompact(result->str_result()) == false) {
+                return encodeProtobuf(response, out);
+            }
+            kind = ResultKind::STR;
+            str = &result->str_result();
+            break;
+        case ipc::Result::VALUE_NOT_SET:
+            break;
+        default:
+            return encodeProtobuf(response, out);
+        }
+    }
+
+    RespFrame frame;
+    frame.header = makeHeader(FrameKind::RESPONSE, static_cast<uint8_t>(status), static_cast<uint8_t>(kind), flags);
+    frame.strLen = toLittle(static_cast<uint32_t>(str ? str->size() : 0));
+    frame.ticket = toLittle(ticket);
+    frame.value = toLittle(value);
+    frame.reserved = 0;
+    writeFrame(frame, out, str ? str->size() : 0);
+    if (str != nullptr) {
+        std::memcpy(out.data() + sizeof(RespFrame), str->data(), str->size());
+    }
+    return true;
+}
+
+bool wire::decodeResponse(const void* data, std::size_t size, ipc::EnvelopeResp& out) {
+    const FrameKind kind = peekKind(data, size);
+    if (kind == FrameKind::PROTOBUF) {
+        if (size == 0) {
+            return false;
+        }
+        return out.ParseFromArray(static_cast<const char*>(data) + 1, static_cast<int>(size - 1));
+    }
+    RespView view;
+    if (decodeRespFrame(data, size, view) == false) {
+        return false;
+    }
+    if (view.resultKind != ResultKind::NONE && view.hasResult == false) {
+        return false;
+    }
+    ipc::Result* result = nullptr;
+    if (view.isGet) {
+        ipc::GetResponse* get = out.mutable_get();
+        get->set_status(view.status);
+        if (view.hasResult) {
+            result = get->mutable_result();
+        }
+    } else {
+        ipc::SubmitResponse* submit = out.mutable_submit();
+        submit->set_status(view.status);
+        if (view.hasTicket) {
+            submit->mutable_ticket()->set_req_id(view.ticket);
+        }
+        if (view.hasResult) {
+            result = submit->mutable_result();
+        }
+    }
+    switch (view.resultKind) {
+    case ResultKind::INT:      result->set_int_result(view.value); break;
+    case ResultKind::POSITION: result->set_position(view.value);   break;
+    case ResultKind::STR:      result->set_str_result(view.str.data(), view.str.size()); break;
+    case ResultKind::NONE:
+    default:
+        break;
+    }
+    return true;
+}
@@ -0,0 +1,225 @@
+#pragma once
+#include "ipc.pb.h"
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+/// @brief Fixed-layout little-endian frames for the hot operations.
+///
+/// A client selects this format with `FirstHandshake.wire_format = WIRE_COMPACT`.
+/// From then on every frame on that connection starts with a one byte `FrameKind`.
+/// Math ops, small string ops and get-by-ticket have a fixed layout; anything else
+/// is sent as `FrameKind::PROTOBUF` followed by the regular protobuf encoding, and
+/// so are traced requests, requests with a correlation id and their responses.
+/// Decoding is a bounds check plus a `memcpy` into a trivially copyable struct,
+/// strings are returned as views into the received frame, nothing is allocated.
+namespace wire {
+
+    enum class FrameKind : uint8_t {
+        PROTOBUF = 0, ///< The rest of the frame is a protobuf EnvelopeReq/EnvelopeResp.
+        MATH     = 1, ///< MathFrame.
+        STR      = 2, ///< StrFrame followed by s1 and s2 bytes.
+        GET      = 3, ///< GetFrame.
+        RESPONSE = 4  ///< RespFrame, optionally followed by the string result bytes.
+    };
+
+    enum class ResultKind : uint8_t {
+        NONE     = 0,
+        INT      = 1,
+        POSITION = 2,
+        STR      = 3
+    };
+
+    /// Set in `FrameHeader::flags` of a response when `ticket` is valid.
+    constexpr uint8_t kFlagHasTicket = 1 << 0;
+    /// Set in `FrameHeader::flags` of a response that answers a GetRequest.
+    constexpr uint8_t kFlagGetResponse = 1 << 1;
+    /// Set in `FrameHeader::flags` of a response that carries a (possibly empty) Result.
+    constexpr uint8_t kFlagHasResult = 1 << 2;
+
+    /// Longest string (per argument or result) that is sent in a compact frame.
+    /// Longer strings fall back to protobuf.
+    constexpr std::size_t kMaxCompactString = 1024;
+
+    struct FrameHeader {
+        uint8_t kind;  ///< FrameKind.
+        uint8_t op;    ///< MathOp/StrOp for requests, Status for responses.
+        uint8_t mode;  ///< SubmitMode/GetWaitMode for requests, ResultKind for responses.
+        uint8_t flags; ///< kFlag* bits.
+    };
+
+    struct MathFrame {
+        FrameHeader header;
+        int32_t a;
+        int32_t b;
+    };
+
+    struct StrFrame {
+        FrameHeader header;
+        uint16_t len1;
+        uint16_t len2;
+    };
+
+    struct GetFrame {
+        FrameHeader header;
+        uint32_t timeoutMs;
+        uint64_t ticket;
+    };
+
+    struct RespFrame {
+        FrameHeader header;
+        uint32_t strLen;
+        uint64_t ticket;
+        int32_t value;
+        uint32_t reserved;
+    };
+
+    static_assert(sizeof(FrameHeader) == 4 && sizeof(MathFrame) == 12 && sizeof(StrFrame) == 8);
+    static_assert(sizeof(GetFrame) == 16 && sizeof(RespFrame) == 24);
+    static_assert(std::is_trivially_copyable_v<RespFrame> && std::is_trivially_copyable_v<GetFrame>);
+
+    template<typename T>
+    inline T toLittle(T v) {
+        static_assert(std::is_integral_v<T>);
+        if constexpr (std::endian::native == std::endian::little || sizeof(T) == 1) {
+            return v;
+        } else if constexpr (sizeof(T) == 2) {
+            return static_cast<T>(__builtin_bswap16(static_cast<uint16_t>(v)));
+        } else if constexpr (sizeof(T) == 4) {
+            return static_cast<T>(__builtin_bswap32(static_cast<uint32_t>(v)));
+        } else {
+            return static_cast<T>(__builtin_bswap64(static_cast<uint64_t>(v)));
+        }
+    }
+
+    /// @brief Copies a fixed frame out of a buffer after checking its size.
+    /// @return false if the buffer is too small or the kind does not match.
+    template<typename Frame>
+    inline bool readFrame(const void* data, std::size_t size, FrameKind kind, Frame& out) {
+        if (size < sizeof(Frame)) {
+            return false;
+        }
+        std::memcpy(&out, data, sizeof(Frame));
+        return out.header.kind == static_cast<uint8_t>(kind);
+    }
+
+    inline FrameKind peekKind(const void* data, std::size_t size) {
+        if (size == 0) {
+            return FrameKind::PROTOBUF;
+        }
+        return static_cast<FrameKind>(*static_cast<const uint8_t*>(data));
+    }
+
+    struct MathView {
+        ipc::MathOp op;
+        ipc::SubmitMode mode;
+        int32_t a;
+        int32_t b;
+    };
+
+    struct StrView {
+        ipc::StrOp op;
+        ipc::SubmitMode mode;
+        std::string_view s1; ///< Points into the decoded frame.
+        std::string_view s2; ///< Points into the decoded frame.
+    };
+
+    struct GetView {
+        ipc::GetWaitMode waitMode;
+        uint32_t timeoutMs;
+        uint64_t ticket;
+    };
+
+    struct RespView {
+        ipc::Status status;
+        ResultKind resultKind;
+        bool hasTicket;
+        bool isGet;
+        bool hasResult;
+        uint64_t ticket;
+        int32_t value;
+        std::string_view str; ///< Points into the decoded frame.
+    };
+
+    inline bool decodeMath(const void* data, std::size_t size, MathView& out) {
+        MathFrame f;
+        if (readFrame(data, size, FrameKind::MATH, f) == false || size != sizeof(MathFrame)) {
+            return false;
+        }
+        out.op = static_cast<ipc::MathOp>(f.header.op);
+        out.mode = static_cast<ipc::SubmitMode>(f.header.mode);
+        out.a = toLittle(f.a);
+        out.b = toLittle(f.b);
+        return true;
+    }
+
+    inline bool decodeStr(const void* data, std::size_t size, StrView& out) {
+        StrFrame f;
+        if (readFrame(data, size, FrameKind::STR, f) == false) {
+            return false;
+        }
+        const std::size_t len1 = toLittle(f.len1);
+        const std::size_t len2 = toLittle(f.len2);
+        if (size != sizeof(StrFrame) + len1 + len2) {
+            return false;
+        }
+        const char* bytes = static_cast<const char*>(data) + sizeof(StrFrame);
+        out.op = static_cast<ipc::StrOp>(f.header.op);
+        out.mode = static_cast<ipc::SubmitMode>(f.header.mode);
+        out.s1 = std::string_view(bytes, len1);
+        out.s2 = std::string_view(bytes + len1, len2);
+        return true;
+    }
+
+    inline bool decodeGet(const void* data, std::size_t size, GetView& out) {
+        GetFrame f;
+        if (readFrame(data, size, FrameKind::GET, f) == false || size != sizeof(GetFrame)) {
+            return false;
+        }
+        out.waitMode = static_cast<ipc::GetWaitMode>(f.header.mode);
+        out.timeoutMs = toLittle(f.timeoutMs);
+        out.ticket = toLittle(f.ticket);
+        return true;
+    }
+
+    inline bool decodeRespFrame(const void* data, std::size_t size, RespView& out) {
+        RespFrame f;
+        if (readFrame(data, size, FrameKind::RESPONSE, f) == false) {
+            return false;
+        }
+        const std::size_t strLen = toLittle(f.strLen);
+        if (size != sizeof(RespFrame) + strLen || (strLen != 0 && f.header.mode != static_cast<uint8_t>(ResultKind::STR))) {
+            return false;
+        }
+        out.status = static_cast<ipc::Status>(f.header.op);
+        out.resultKind = static_cast<ResultKind>(f.header.mode);
+        out.hasTicket = (f.header.flags & kFlagHasTicket) != 0;
+        out.isGet = (f.header.flags & kFlagGetResponse) != 0;
+        out.hasResult = (f.header.flags & kFlagHasResult) != 0;
+        out.ticket = toLittle(f.ticket);
+        out.value = toLittle(f.value);
+        out.str = std::string_view(static_cast<const char*>(data) + sizeof(RespFrame), strLen);
+        return true;
+    }
+
+    /// @brief Encodes a request in the compact format, falling back to a PROTOBUF frame
+    /// when the request is not one of the hot operations.
+    /// @return false if the protobuf fallback failed to serialize.
+    bool encodeRequest(const ipc::EnvelopeReq& request, std::string& out);
+
+    /// @brief Decodes a compact (or PROTOBUF-kind) request frame into a protobuf message.
+    /// Strings are copied into `out`, so pass a message created on an arena to avoid heap allocations.
+    bool decodeRequest(const void* data, std::size_t size, ipc::EnvelopeReq& out);
+
+    /// @brief Encodes a response in the compact format, falling back to a PROTOBUF frame
+    /// when the result does not fit in a RespFrame.
+    bool encodeResponse(const ipc::EnvelopeResp& response, std::string& out);
+
+    /// @brief Decodes a compact (or PROTOBUF-kind) response frame.
+    bool decodeResponse(const void* data, std::size_t size, ipc::EnvelopeResp& out);
+
+} // namespace wire
@@ -2,6 +2,7 @@
 #include "error_handling.h"
 #include "spdlog/spdlog.h"
 #include "spdlog/sinks/rotating_file_sink.h"
+#include "spdlog/async.h"
 
 extern "C" {
     bool verifyExecCaps(const uint8_t execFunFlags) {
@@ -11,7 +12,8 @@ extern "C" {
             ExecFunFlags::MULT |
             ExecFunFlags::DIV |
             ExecFunFlags::CONCAT |
-            ExecFunFlags::FIND_START;
+            ExecFunFlags::FIND_START |
+            ExecFunFlags::FIND_ANY;
         return (execFunFlags & ~allExecFunFlags) == 0 && execFunFlags > 0;
     }
 
@@ -21,10 +23,16 @@ extern "C" {
             const std::size_t max_size  = 50u * 1024u * 1024u;
             const std::size_t max_files = 2;
 
-            auto logger = spdlog::rotating_logger_mt("Producer", loggingDir, max_size, max_files);
+            // Records are formatted on the calling thread and written by one background thread.
+            // The queue is bounded and drops the oldest record when full, so a slow disk never
+            // stalls the router or the workers.
+            const std::size_t queue_size = 8192;
+            spdlog::init_thread_pool(queue_size, 1);
+            auto logger = spdlog::rotating_logger_mt<spdlog::async_factory_nonblock>("Producer", loggingDir, max_size, max_files);
             spdlog::set_default_logger(logger);
-            spdlog::set_level(spdlog::level::info);
-            logger->flush_on(spdlog::level::info);
+            spdlog::set_level(static_cast<spdlog::level::level_enum>(SPDLOG_ACTIVE_LEVEL));
+            logger->flush_on(spdlog::level::err);
+            spdlog::flush_every(std::chrono::seconds(1));
 
             spdlog::info("START");
             return EC_SUCCESS;
@@ -39,6 +47,7 @@ extern "C" {
             logger->info("Shutting down...");
             logger->flush();
         }
+        // Drains the async queue and stops the writer and the periodic flusher.
         spdlog::shutdown();
         return EC_SUCCESS;
     }
@@ -1,11 +1,92 @@
 #include "ipc.h"
+#include "ipc_ops.h"
 #include "error_handling.h"
 #include "client/application.h"
+#include "framing.h"
 #include "spdlog/spdlog.h"
 #include <atomic>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
 
 static std::atomic<bool> sigStop{false};
+static client::Options clientOptions;
+
 extern "C" {
+    int clientSetOption(const char* name, const char* value) {
+        if (name == nullptr || value == nullptr) {
+            spdlog::error("clientSetOption: name and value must not be null");
+            return EC_FAILURE;
+        }
+        if (std::strcmp(name, "wire") == 0) {
+            if (std::strcmp(value, "protobuf") == 0) {
+                clientOptions.wireFormat = ipc::WIRE_PROTOBUF;
+            } else if (std::strcmp(value, "compact") == 0) {
+                clientOptions.wireFormat = ipc::WIRE_COMPACT;
+            } else {
+                spdlog::error("Invalid wire format: {}", value);
+                return EC_FAILURE;
+            }
+            return EC_SUCCESS;
+        }
+        if (std::strcmp(name, "busy_poll_us") == 0) {
+            char* end = nullptr;
+            errno = 0;
+            const unsigned long long us = std::strtoull(value, &end, 10);
+            if (*value == '\0' || errno != 0 || *end != '\0' || us > 1000000) {
+                spdlog::error("Invalid busy_poll_us: {} (0 disables, at most 1000000)", value);
+                return EC_FAILURE;
+            }
+            clientOptions.busyPollUs = static_cast<uint32_t>(us);
+            return EC_SUCCESS;
+        }
+        if (std::strcmp(name, "transport") == 0) {
+            if (framing::parseEndpoint(value, clientOptions.transport) != EC_SUCCESS) {
+                spdlog::error("Invalid transport: {} (zmq, tcp, unix:<path> or inproc:<name>)", value);
+                return EC_FAILURE;
+            }
+            return EC_SUCCESS;
+        }
+        if (std::strcmp(name, "ops") == 0) {
+            clientOptions.ops.clear();
+            for (const char* it = value; *it != '\0';) {
+                char* end = nullptr;
+                errno = 0;
+                const unsigned long op = std::strtoul(it, &end, 10);
+                if (end == it || errno != 0 || op >= IPC_OPS_MAX || (*end != ',' && *end != '\0')) {
+                    spdlog::error("Invalid ops: {} (comma-separated op ids below {})", value, IPC_OPS_MAX);
+                    return EC_FAILURE;
+                }
+                clientOptions.ops.push_back(static_cast<uint32_t>(op));
+                it = (*end == ',') ? end + 1 : end;
+            }
+            return EC_SUCCESS;
+        }
+        if (std::strcmp(name, "name") == 0) {
+            clientOptions.name = value;
+            return EC_SUCCESS;
+        }
+        if (std::strcmp(name, "hedge") == 0) {
+            return client::parseHedgeEndpoints(value, clientOptions.hedge);
+        }
+        if (std::strcmp(name, "hedge_percentile") == 0 || std::strcmp(name, "hedge_budget_pct") == 0) {
+            char* end = nullptr;
+            errno = 0;
+            const unsigned long pct = std::strtoul(value, &end, 10);
+            if (*value == '\0' || errno != 0 || *end != '\0' || pct == 0 || pct > 100) {
+                spdlog::error("Invalid {}: {} (1..100)", name, value);
+                return EC_FAILURE;
+            }
+            uint32_t& setting = (std::strcmp(name, "hedge_percentile") == 0)
+                ? clientOptions.hedgePercentile
+                : clientOptions.hedgeBudgetPct;
+            setting = static_cast<uint32_t>(pct);
+            return EC_SUCCESS;
+        }
+        spdlog::error("Unknown client option: {}", name);
+        return EC_FAILURE;
+    }
+
     int clientInitialize(
         const char* address,
         const int port,
@@ -22,7 +103,8 @@ extern "C" {
             address,
             port,
             receiveTimeoutMs,
-            execFunFlags
+            execFunFlags,
+            clientOptions
         );
         RETURN_IF_ERROR(ErrorType::DEFAULT, result, "Failed to create the client application");
 
@@ -2,17 +2,372 @@
 #include "error_handling.h"
 #include "server/application.h"
 #include "spdlog/spdlog.h"
+#include "server/config.h"
+#include "server/stats.h"
+#include "affinity.h"
+#include "framing.h"
+#include <algorithm>
 #include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iterator>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include <pthread.h>
+#include <sched.h>
 
 static std::atomic<bool> sigStop{false};
+static server::Config serverConfig;
+static pthread_t embeddedThread;       ///< Runs `serverRun` between `serverStart` and `serverStop`.
+static bool embeddedRunning = false;
+static int embeddedResult = EC_SUCCESS;
+
+static void* embeddedMain(void*) {
+    embeddedResult = serverRun();
+    return nullptr;
+}
+
+static bool parseUnsigned(const char* value, unsigned long long& out) {
+    if (value == nullptr || *value == '\0') {
+        return false;
+    }
+    char* end = nullptr;
+    errno = 0;
+    out = std::strtoull(value, &end, 10);
+    return errno == 0 && end != nullptr && *end == '\0';
+}
+
+/// Splits "name=value,name=value" and hands every pair to `parse`; false on an empty name or value.
+template<typename Parse>
+static bool parseNamedList(const char* value, Parse parse) {
+    const std::string list = value;
+    std::size_t start = 0;
+    while (start < list.size()) {
+        std::size_t end = list.find(',', start);
+        if (end == std::string::npos) {
+            end = list.size();
+        }
+        const std::size_t eq = list.find('=', start);
+        if (eq == std::string::npos || eq >= end || eq == start || eq + 1 == end) {
+            return false;
+        }
+        if (parse(list.substr(start, eq - start), list.substr(eq + 1, end - eq - 1)) == false) {
+            return false;
+        }
+        start = end + 1;
+    }
+    return true;
+}
 
 extern "C" {
+    int serverSetOption(const char* name, const char* value) {
+        if (name == nullptr || value == nullptr) {
+            spdlog::error("serverSetOption: name and value must not be null");
+            return EC_FAILURE;
+        }
+        unsigned long long number = 0;
+        if (std::strcmp(name, "pattern_cache_mb") == 0) {
+            if (parseUnsigned(value, number) == false || number == 0) {
+                spdlog::error("Invalid pattern_cache_mb: {}", value);
+                return EC_FAILURE;
+            }
+            serverConfig.patternCacheBytes = static_cast<std::size_t>(number) * 1024u * 1024u;
+            return EC_SUCCESS;
+        }
+        if (std::strcmp(name, "trace_dir") == 0) {
+            if (*value == '\0') {
+                spdlog::error("Invalid trace_dir: must not be empty");
+                return EC_FAILURE;
+            }
+            serverConfig.traceDir = value;
+            return EC_SUCCESS;
+        }
+        if (std::strcmp(name, "capture_dir") == 0) {
+            serverConfig.captureDir = value;
+            return EC_SUCCESS;
+        }
+        if (std::strcmp(name, "capture_file_mb") == 0) {
+            if (parseUnsigned(value, number) == false || number == 0 || number > 4096) {
+                spdlog::error("Invalid capture_file_mb: {} (1..4096)", value);
+                return EC_FAILURE;
+            }
+            serverConfig.captureFileBytes = static_cast<std::size_t>(number) * 1024u * 1024u;
+            return EC_SUCCESS;
+        }
+        if (std::strcmp(name, "capture_max_files") == 0) {
+            if (parseUnsigned(value, number) == false || number == 0 || number > 100000) {
+                spdlog::error("Invalid capture_max_files: {} (1..100000)", value);
+                return EC_FAILURE;
+            }
+            serverConfig.captureMaxFiles = static_cast<uint32_t>(number);
+            return EC_SUCCESS;
+        }
+        if (std::strcmp(name, "spill_dir") == 0) {
+            serverConfig.spillDir = value;
+            return EC_SUCCESS;
+        }
+        if (std::strcmp(name, "spill_file_mb") == 0) {
+            if (parseUnsigned(value, number) == false || number == 0 || number > 1024u * 1024u) {
+                spdlog::error("Invalid spill_file_mb: {} (1..1048576)", value);
+                return EC_FAILURE;
+            }
+            serverConfig.spillFileBytes = static_cast<std::size_t>(number) * 1024u * 1024u;
+            return EC_SUCCESS;
+        }
+        if (std::strcmp(name, "spill_after_ms") == 0) {
+            if (parseUnsigned(value, number) == false || number > UINT32_MAX) {
+                spdlog::error("Invalid spill_after_ms: {}", value);
+                return EC_FAILURE;
+            }
+            serverConfig.spillAfterMs = static_cast<uint32_t>(number);
+            return EC_SUCCESS;
+        }
+        if (std::strcmp(name, "min_threads") == 0) {
+            if (parseUnsigned(value, number) == false || number > INT32_MAX) {
+                spdlog::error("Invalid min_threads: {}", value);
+                return EC_FAILURE;
+            }
+            serverConfig.minThreads = static_cast<int>(number);
+            return EC_SUCCESS;
+        }
+        if (std::strcmp(name, "pool_grow_wait_us") == 0) {
+            if (parseUnsigned(value, number) == false || number > UINT32_MAX) {
+                spdlog::error("Invalid pool_grow_wait_us: {}", value);
+                return EC_FAILURE;
+            }
+            serverConfig.poolGrowWaitUs = static_cast<uint32_t>(number);
+            return EC_SUCCESS;
+        }
+        if (std::strcmp(name, "pool_grow_depth") == 0) {
+            if (parseUnsigned(value, number) == false || number == 0 || number > UINT32_MAX) {
+                spdlog::error("Invalid pool_grow_depth: {}", value);
+                return EC_FAILURE;
+            }
+            serverConfig.poolGrowDepth = static_cast<uint32_t>(number);
+            return EC_SUCCESS;
+        }
+        if (std::strcmp(name, "pool_idle_ms") == 0) {
+            if (parseUnsigned(value, number) == false || number == 0 || number > UINT32_MAX) {
+                spdlog::error("Invalid pool_idle_ms: {}", value);
+                return EC_FAILURE;
+            }
+            serverConfig.poolIdleMs = static_cast<uint32_t>(number);
+            return EC_SUCCESS;
+        }
+        const std::pair<const char*, std::vector<int>*> cpuLists[] = {
+            {"router_cpus", &serverConfig.routerCpus},
+            {"worker_cpus", &serverConfig.workerCpus},
+            {"io_cpus", &serverConfig.ioCpus},
+        };
+        for (const auto& [option, cpus] : cpuLists) {
+            if (std::strcmp(name, option) == 0) {
+                if (affinity::parseCpuList(value, *cpus) != EC_SUCCESS) {
+                    spdlog::error("Invalid {}: {}", option, value);
+                    return EC_FAILURE;
+                }
+                return EC_SUCCESS;
+            }
+        }
+        if (std::strcmp(name, "router_sched_fifo") == 0) {
+            if (parseUnsigned(value, number) == false || number > 99) {
+                spdlog::error("Invalid router_sched_fifo: {} (0 disables, 1..99 is the priority)", value);
+                return EC_FAILURE;
+            }
+            serverConfig.routerFifoPriority = static_cast<int>(number);
+            return EC_SUCCESS;
+        }
+        if (std::strcmp(name, "busy_poll_us") == 0) {
+            if (parseUnsigned(value, number) == false || number > 1000000) {
+                spdlog::error("Invalid busy_poll_us: {} (0 disables, at most 1000000)", value);
+                return EC_FAILURE;
+            }
+            serverConfig.busyPollUs = static_cast<uint32_t>(number);
+            return EC_SUCCESS;
+        }
+        if (std::strcmp(name, "numa_node") == 0) {
+            if (std::strcmp(value, "-1") == 0) {
+                serverConfig.numaNode = -1;
+                return EC_SUCCESS;
+            }
+            if (parseUnsigned(value, number) == false || number >= CPU_SETSIZE) {
+                spdlog::error("Invalid numa_node: {}", value);
+                return EC_FAILURE;
+            }
+            serverConfig.numaNode = static_cast<int>(number);
+            return EC_SUCCESS;
+        }
+        if (std::strcmp(name, "frontend") == 0) {
+            if (framing::parseEndpoint(value, serverConfig.frontend) != EC_SUCCESS) {
+                spdlog::error("Invalid frontend: {} (zmq, tcp, unix:<path> or inproc:<name>)", value);
+                return EC_FAILURE;
+            }
+            return EC_SUCCESS;
+        }
+        if (std::strcmp(name, "op_plugins") == 0) {
+            serverConfig.opPlugins.clear();
+            const std::string list = value;
+            std::size_t start = 0;
+            while (start < list.size()) {
+                std::size_t end = list.find(',', start);
+                if (end == std::string::npos) {
+                    end = list.size();
+                }
+                if (end == start) {
+                    spdlog::error("Invalid op_plugins: {} (empty path)", value);
+                    return EC_FAILURE;
+                }
+                serverConfig.opPlugins.emplace_back(list, start, end - start);
+                start = end + 1;
+            }
+            return EC_SUCCESS;
+        }
+        if (std::strcmp(name, "client_weights") == 0) {
+            std::unordered_map<std::string, uint32_t> weights;
+            const bool ok = parseNamedList(value, [&] (const std::string& client, const std::string& weight) {
+                unsigned long long w = 0;
+                if (parseUnsigned(weight.c_str(), w) == false || w == 0 || w > 1000) {
+                    return false;
+                }
+                weights[client] = static_cast<uint32_t>(w);
+                return true;
+            });
+            if (ok == false) {
+                spdlog::error("Invalid client_weights: {} (name=weight pairs, weights 1..1000)", value);
+                return EC_FAILURE;
+            }
+            serverConfig.clientWeights = std::move(weights);
+            return EC_SUCCESS;
+        }
+        if (std::strcmp(name, "client_rates") == 0) {
+            std::unordered_map<std::string, server::ClientRate> rates;
+            const bool ok = parseNamedList(value, [&] (const std::string& client, const std::string& spec) {
+                // <per second>[:<burst>], the burst defaults to one second's worth.
+                const std::size_t colon = spec.find(':');
+                unsigned long long perSecond = 0;
+                unsigned long long burst = 0;
+                if (parseUnsigned(spec.substr(0, colon).c_str(), perSecond) == false || perSecond == 0 ||
+                    perSecond > 100000000) {
+                    return false;
+                }
+                burst = perSecond;
+                if (colon != std::string::npos &&
+                    (parseUnsigned(spec.substr(colon + 1).c_str(), burst) == false || burst == 0 || burst > 100000000)) {
+                    return false;
+                }
+                rates[client] = server::ClientRate{static_cast<double>(perSecond), static_cast<double>(burst)};
+                return true;
+            });
+            if (ok == false) {
+                spdlog::error("Invalid client_rates: {} (name=rate[:burst] pairs in submits per second)", value);
+                return EC_FAILURE;
+            }
+            serverConfig.clientRates = std::move(rates);
+            return EC_SUCCESS;
+        }
+        if (std::strcmp(name, "class_threads") == 0) {
+            uint32_t classThreads[static_cast<int>(server::OpClass::COUNT)] = {};
+            const bool ok = parseNamedList(value, [&] (const std::string& cls, const std::string& threads) {
+                unsigned long long n = 0;
+                if (parseUnsigned(threads.c_str(), n) == false || n == 0 || n > 1024) {
+                    return false;
+                }
+                for (int c = 0; c < static_cast<int>(server::OpClass::COUNT); ++c) {
+                    if (cls == server::opClassName(static_cast<server::OpClass>(c))) {
+                        classThreads[c] = static_cast<uint32_t>(n);
+                        return true;
+                    }
+                }
+                return false;
+            });
+            if (ok == false) {
+                spdlog::error("Invalid class_threads: {} (math, string or bulk=threads pairs, 1..1024)", value);
+                return EC_FAILURE;
+            }
+            std::copy(std::begin(classThreads), std::end(classThreads), std::begin(serverConfig.classThreads));
+            return EC_SUCCESS;
+        }
+        if (std::strcmp(name, "slow_request_us") == 0) {
+            std::unordered_map<std::string, uint32_t> thresholds;
+            const bool ok = parseNamedList(value, [&] (const std::string& op, const std::string& us) {
+                unsigned long long n = 0;
+                if (parseUnsigned(us.c_str(), n) == false || n == 0 || n > UINT32_MAX) {
+                    return false;
+                }
+                bool known = op == "*";
+                for (int o = 0; known == false && o <= static_cast<int>(server::StatsOp::REDUCE); ++o) {
+                    known = op == server::statsOpName(static_cast<server::StatsOp>(o));
+                }
+                thresholds[op] = static_cast<uint32_t>(n);
+                return known;
+            });
+            if (ok == false) {
+                spdlog::error("Invalid slow_request_us: {} (op=us pairs for submit ops or *, us > 0)", value);
+                return EC_FAILURE;
+            }
+            serverConfig.slowRequestUs = std::move(thresholds);
+            return EC_SUCCESS;
+        }
+        if (std::strcmp(name, "slow_log_size") == 0) {
+            if (parseUnsigned(value, number) == false || number > 1000000) {
+                spdlog::error("Invalid slow_log_size: {} (at most 1000000)", value);
+                return EC_FAILURE;
+            }
+            serverConfig.slowLogSize = static_cast<std::size_t>(number);
+            return EC_SUCCESS;
+        }
+        if (std::strcmp(name, "reduce_parallel_min") == 0) {
+            if (parseUnsigned(value, number) == false || number > UINT32_MAX) {
+                spdlog::error("Invalid reduce_parallel_min: {}", value);
+                return EC_FAILURE;
+            }
+            serverConfig.reduceParallelMin = static_cast<std::size_t>(number);
+            return EC_SUCCESS;
+        }
+        if (std::strcmp(name, "inline_max_cost") == 0) {
+            if (parseUnsigned(value, number) == false) {
+                spdlog::error("Invalid inline_max_cost: {}", value);
+                return EC_FAILURE;
+            }
+            serverConfig.inlineMaxCost = number;
+            return EC_SUCCESS;
+        }
+        if (std::strcmp(name, "offload_min_cost") == 0) {
+            if (parseUnsigned(value, number) == false) {
+                spdlog::error("Invalid offload_min_cost: {}", value);
+                return EC_FAILURE;
+            }
+            serverConfig.offloadMinCost = number;
+            return EC_SUCCESS;
+        }
+        spdlog::error("Unknown server option: {}", name);
+        return EC_FAILURE;
+    }
+
     int serverInitialize(
         const char* address,
         const int port,
         const int threads
     ) {
-        int result = server::Application::create(sigStop, address, port, threads);
+        if (threads <= 0 || serverConfig.minThreads > threads) {
+            spdlog::error("Invalid thread bounds: min_threads {} must not exceed threads {} (> 0)", serverConfig.minThreads, threads);
+            return EC_FAILURE;
+        }
+        if (serverConfig.numaNode >= 0) {
+            // Roles without an explicit CPU list run on the node they allocate on.
+            std::vector<int> nodeCpus;
+            int result = affinity::nodeCpus(serverConfig.numaNode, nodeCpus);
+            RETURN_IF_ERROR(ErrorType::DEFAULT, result, "Invalid numa_node");
+            for (std::vector<int>* cpus : {&serverConfig.routerCpus, &serverConfig.workerCpus, &serverConfig.ioCpus}) {
+                if (cpus->empty()) {
+                    *cpus = nodeCpus;
+                }
+            }
+        }
+        int result = server::Application::create(sigStop, address, port, threads, serverConfig);
         RETURN_IF_ERROR(ErrorType::DEFAULT, result, "Failed to create the server application");
 
         server::Application& app = server::Application::get();
@@ -29,11 +384,42 @@ extern "C" {
         return EC_SUCCESS;
     }
 
+    int serverStart(void) {
+        if (embeddedRunning) {
+            spdlog::error("The server is already running in the background");
+            return EC_FAILURE;
+        }
+        sigStop.store(false, std::memory_order_relaxed);
+        if (pthread_create(&embeddedThread, nullptr, &embeddedMain, nullptr) != 0) {
+            spdlog::error("Failed to create the server thread");
+            return EC_FAILURE;
+        }
+        embeddedRunning = true;
+        return EC_SUCCESS;
+    }
+
+    int serverStop(void) {
+        if (embeddedRunning == false) {
+            spdlog::error("The server was not started with serverStart");
+            return EC_FAILURE;
+        }
+        sigStop.store(true, std::memory_order_relaxed);
+        server::Application::get().interrupt();
+        pthread_join(embeddedThread, nullptr);
+        embeddedRunning = false;
+        return embeddedResult;
+    }
+
     void stopHandleServer(int signo) {
         (void)signo;
         sigStop.store(true, std::memory_order_relaxed);
     }
 
+    void slowLogHandleServer(int signo) {
+        (void)signo;
+        server::Application::requestSlowLogDump();
+    }
+
     int serverDeinitialize(void) {
         server::Application& app = server::Application::get();
         return app.deinit();
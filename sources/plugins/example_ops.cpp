@@ -0,0 +1,65 @@
+#include "ipc_ops.h"
+#include <cstring>
+
+// Example operation plugin: build it as a shared object and start the server with
+// --op-plugins path/to/libipc_example_ops.so, then call the ops with OpCallArgs,
+// e.g. "block call 64 hello" from a client started with --ops 64,65,66.
+// It only depends on includes/ipc_ops.h.
+
+namespace {
+    // FNV-1a hash of one string, as an int.
+    int32_t fnv1a(const IpcOpArgs* args, IpcOpResult* result) {
+        uint32_t hash = 2166136261u;
+        const IpcBytes& s = args->strs[0];
+        for (size_t i = 0; i < s.size; ++i) {
+            hash ^= static_cast<unsigned char>(s.data[i]);
+            hash *= 16777619u;
+        }
+        result->kind = IPC_OP_RESULT_INT;
+        result->intValue = static_cast<int32_t>(hash);
+        return IPC_OP_SUCCESS;
+    }
+
+    // The string reversed byte by byte.
+    int32_t reverse(const IpcOpArgs* args, IpcOpResult* result) {
+        const IpcBytes& s = args->strs[0];
+        if (s.size > result->strCapacity) {
+            return IPC_OP_STRING_TOO_LONG;
+        }
+        for (size_t i = 0; i < s.size; ++i) {
+            result->str[i] = s.data[s.size - 1 - i];
+        }
+        result->kind = IPC_OP_RESULT_STR;
+        result->strSize = s.size;
+        return IPC_OP_SUCCESS;
+    }
+
+    // clamp(value, low, high).
+    int32_t clamp(const IpcOpArgs* args, IpcOpResult* result) {
+        const int32_t value = args->ints[0];
+        const int32_t low = args->ints[1];
+        const int32_t high = args->ints[2];
+        if (low > high) {
+            return IPC_OP_INVALID_INPUT;
+        }
+        result->kind = IPC_OP_RESULT_INT;
+        result->intValue = value < low ? low : (value > high ? high : value);
+        return IPC_OP_SUCCESS;
+    }
+
+    constexpr IpcOpDescriptor kOps[] = {
+        {IPC_OPS_FIRST_PLUGIN + 0, "fnv1a",   0, 1, &fnv1a},
+        {IPC_OPS_FIRST_PLUGIN + 1, "reverse", 0, 1, &reverse},
+        {IPC_OPS_FIRST_PLUGIN + 2, "clamp",   3, 0, &clamp},
+    };
+}
+
+extern "C" __attribute__((visibility("default")))
+int ipcRegisterOps(uint32_t abiVersion, const IpcOpDescriptor** ops, size_t* count) {
+    if (abiVersion != IPC_OPS_ABI_VERSION) {
+        return 1;
+    }
+    *ops = kOps;
+    *count = sizeof(kOps) / sizeof(kOps[0]);
+    return 0;
+}
@@ -3,6 +3,7 @@
 #include <spdlog/spdlog.h>
 #include "cxxopts.hpp"
 #include <csignal>
+#include <utility>
 #include "ipc.h"
 
 int main(int argc, char *argv[]) {
@@ -10,7 +11,37 @@ int main(int argc, char *argv[]) {
     options.add_options()
         ("port", "Port number to connect to the server", cxxopts::value<int>()->default_value("24737"), "PORT")
         ("l,logging", "Directory to save the logging file", cxxopts::value<std::string>()->default_value("./server_log"), "PATH")
-        ("threads", "Number of worker threads", cxxopts::value<int>()->default_value("4"), "INT")
+        ("threads", "Number of worker threads (the maximum with --min-threads)", cxxopts::value<int>()->default_value("4"), "INT")
+        ("min-threads", "Smallest worker pool, 0 keeps the pool fixed at --threads", cxxopts::value<std::string>()->default_value("0"), "INT")
+        ("pool-grow-wait-us", "Grow the pool when the oldest queued job waited this long", cxxopts::value<std::string>()->default_value("500"), "US")
+        ("pool-grow-depth", "Grow the pool when this many jobs are queued", cxxopts::value<std::string>()->default_value("8"), "INT")
+        ("pool-idle-ms", "Idle time after which a worker above --min-threads exits", cxxopts::value<std::string>()->default_value("5000"), "MS")
+        ("router-cpus", "CPU list for the ROUTER loop, e.g. 0 or 0-1", cxxopts::value<std::string>()->default_value(""), "LIST")
+        ("worker-cpus", "CPU list shared by the worker threads, e.g. 2-7", cxxopts::value<std::string>()->default_value(""), "LIST")
+        ("io-cpus", "CPU list for the ZeroMQ I/O thread", cxxopts::value<std::string>()->default_value(""), "LIST")
+        ("router-sched-fifo", "SCHED_FIFO priority for the ROUTER loop, 0 disables", cxxopts::value<std::string>()->default_value("0"), "PRIO")
+        ("busy-poll-us", "Spin on non-blocking receives this long before blocking, 0 disables", cxxopts::value<std::string>()->default_value("0"), "US")
+        ("numa-node", "NUMA node for allocations (and CPUs of roles without a list), -1 disables", cxxopts::value<std::string>()->default_value("-1"), "NODE")
+        ("frontend", "zmq (ROUTER), tcp (epoll, length-prefixed frames on --port) or unix:<path>", cxxopts::value<std::string>()->default_value("zmq"), "KIND")
+        ("op-plugins", "Comma-separated shared objects adding operations (see includes/ipc_ops.h)", cxxopts::value<std::string>()->default_value(""), "PATHS")
+        ("client-weights", "Worker share by client name, e.g. teamA=4,teamB=1,*=1", cxxopts::value<std::string>()->default_value(""), "LIST")
+        ("client-rates", "Submit rate limits by client name, e.g. teamA=1000:200,*=500 (per second[:burst])", cxxopts::value<std::string>()->default_value(""), "LIST")
+        ("class-threads", "Separate worker pools per op class, e.g. math=2,string=4,bulk=2", cxxopts::value<std::string>()->default_value(""), "LIST")
+        ("reduce-parallel-min", "Split reductions over arrays this long across the workers, 0 disables", cxxopts::value<std::string>()->default_value("262144"), "N")
+        ("pattern-cache-mb", "Memory budget for compiled FIND_ANY pattern sets", cxxopts::value<std::string>()->default_value("64"), "MB")
+        ("trace-dir", "Directory for Chrome trace dumps (PROFILE_APPLICATION builds)", cxxopts::value<std::string>()->default_value("."), "PATH")
+        ("inline-max-cost", "Answer NONBLOCKING submits up to this cost (input bytes) inline, 0 queues all", cxxopts::value<std::string>()->default_value("0"), "BYTES")
+        ("offload-min-cost", "Run BLOCKING submits from this cost (input bytes) on a worker, 0 runs all inline", cxxopts::value<std::string>()->default_value("65536"), "BYTES")
+        ("capture-dir", "Record received requests here for ipc_replay, empty disables", cxxopts::value<std::string>()->default_value(""), "PATH")
+        ("capture-file-mb", "Size of each capture file before rotating", cxxopts::value<std::string>()->default_value("64"), "MB")
+        ("capture-max-files", "Capture files written before recording stops", cxxopts::value<std::string>()->default_value("16"), "INT")
+        ("slow-request-us", "Keep the context of submits slower than this, by op, e.g. find=2000,*=500; SIGUSR1 logs them",
+            cxxopts::value<std::string>()->default_value(""), "LIST")
+        ("slow-log-size", "Slow requests kept, the oldest are overwritten", cxxopts::value<std::string>()->default_value("256"), "INT")
+        ("spill-dir", "Move results unfetched for --spill-after-ms to a memory-mapped file here, empty disables",
+            cxxopts::value<std::string>()->default_value(""), "PATH")
+        ("spill-file-mb", "Size of the spill file; results that do not fit stay in memory", cxxopts::value<std::string>()->default_value("256"), "MB")
+        ("spill-after-ms", "Age of a finished, unfetched result before it is spilled", cxxopts::value<std::string>()->default_value("1000"), "MS")
         ("h,help", "Print usage");
 
     auto resultParser = options.parse(argc, argv);
@@ -32,6 +63,48 @@ int main(int argc, char *argv[]) {
     GOOGLE_PROTOBUF_VERIFY_VERSION;
     std::signal(SIGINT, stopHandleServer);
     std::signal(SIGTERM, stopHandleServer);
+    std::signal(SIGUSR1, slowLogHandleServer);
+
+    const std::pair<const char*, const char*> settings[] = {
+        {"pattern_cache_mb", "pattern-cache-mb"},
+        {"trace_dir", "trace-dir"},
+        {"min_threads", "min-threads"},
+        {"pool_grow_wait_us", "pool-grow-wait-us"},
+        {"pool_grow_depth", "pool-grow-depth"},
+        {"pool_idle_ms", "pool-idle-ms"},
+        {"router_cpus", "router-cpus"},
+        {"worker_cpus", "worker-cpus"},
+        {"io_cpus", "io-cpus"},
+        {"router_sched_fifo", "router-sched-fifo"},
+        {"numa_node", "numa-node"},
+        {"busy_poll_us", "busy-poll-us"},
+        {"frontend", "frontend"},
+        {"op_plugins", "op-plugins"},
+        {"class_threads", "class-threads"},
+        {"reduce_parallel_min", "reduce-parallel-min"},
+        {"client_weights", "client-weights"},
+        {"client_rates", "client-rates"},
+        {"inline_max_cost", "inline-max-cost"},
+        {"offload_min_cost", "offload-min-cost"},
+        {"capture_dir", "capture-dir"},
+        {"capture_file_mb", "capture-file-mb"},
+        {"capture_max_files", "capture-max-files"},
+        {"slow_request_us", "slow-request-us"},
+        {"slow_log_size", "slow-log-size"},
+        {"spill_dir", "spill-dir"},
+        {"spill_file_mb", "spill-file-mb"},
+        {"spill_after_ms", "spill-after-ms"},
+    };
+    for (const auto& [name, flag] : settings) {
+        result = serverSetOption(name, resultParser[flag].as<std::string>().c_str());
+        if (result != EC_SUCCESS) {
+            break;
+        }
+    }
+    if (result != EC_SUCCESS) {
+        deinitializeLogging();
+        return result;
+    }
 
     const int threads = resultParser["threads"].as<int>();
     const int port = resultParser["port"].as<int>();
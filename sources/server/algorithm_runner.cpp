@@ -1,31 +1,74 @@
 #include "algorithm_runner.h"
+#include "stream_search.h"
+#include "pattern_set.h"
+#include "expression.h"
+#include "op_registry.h"
+#include "reduce.h"
+#include "result_spill.h"
+#include "slow_log.h"
+#include "stats.h"
+#include "worker_pool.h"
+#include "trace.h"
 #include "error_handling.h"
 #include <functional>
 #include <spdlog/spdlog.h>
 
+#include <algorithm>
 #include <atomic>
-#include <unordered_map>
+#include <cerrno>
+#include <cstring>
 #include <deque>
+#include <iterator>
+#include <unordered_map>
 #include <vector>
 #include <memory>
 #include <chrono>
 #include <pthread.h>
+#include <sys/eventfd.h>
 #include <time.h>
+#include <unistd.h>
 
 using namespace server;
 
 namespace server {
     struct AlgoRunnerIpml {
     private:
+        /// `WorkerPool::Task::kind` of the queued task types.
+        enum TaskKind : uint8_t {
+            TASK_JOB = 0,
+            TASK_CHUNK = 1,
+            TASK_COMPILE = 2
+        };
+
+        /// A client connection's weight, rate limit and queue counters.
+        struct ClientFlow {
+            uint64_t flow = 0;
+            std::string name;
+            uint32_t weight = 1;
+            ClientRate rate;                                 ///< `perSecond` 0 disables the token bucket.
+            double tokens = 0;                               ///< Guarded by `clientsMtx`, like `lastRefill`.
+            std::chrono::steady_clock::time_point lastRefill;
+            std::atomic<uint32_t> queued{0};
+            std::atomic<uint64_t> submitted{0};
+            std::atomic<uint64_t> served{0};
+            std::atomic<uint64_t> rateLimited{0};
+        };
+
         /// Only waiters on this Job wake up when it finishes.
-        struct Job {
+        struct Job : WorkerPool::Task {
             uint64_t id = 0;
             ipc::SubmitRequest req;
+            std::shared_ptr<ClientFlow> client; ///< nullptr for the shared flow 0.
+            StatsOp op = StatsOp::INVALID;
+            OpClass cls = OpClass::MATH; ///< Pool the job runs in.
             ipc::Status status = ipc::ST_NOT_FINISHED;
             ipc::Result result;
+            std::chrono::steady_clock::time_point startedAt;  ///< Set with `done`, for RequestTiming.
+            std::chrono::steady_clock::time_point finishedAt;
             pthread_mutex_t m;
             pthread_cond_t cv;
             bool done = false;
+            bool taken = false; ///< The result was handed out or spilled; the job is on its way out of `jobs`.
 
             Job() {
                 pthread_mutex_init(&m, nullptr);
@@ -37,6 +80,66 @@ namespace server {
             }
         };
 
+        /// An offloaded BLOCKING submit, by wait id.
+        struct Offloaded {
+            uint64_t jobId = 0;
+            bool traced = false; ///< Its response gets the job's RequestTiming stages.
+        };
+
+        /// Chunks of one split reduction. The submitting thread and the workers claim chunks
+        /// through `next`, so the work is done even if no worker is free, and the submitter
+        /// waits for `remaining` to reach zero before `body` and its captures go out of scope.
+        struct ReduceSplit {
+            std::function<void(std::size_t chunk)> body;
+            std::size_t chunks = 0;
+            std::atomic<std::size_t> next{0};
+            std::size_t remaining = 0; ///< Guarded by `m`.
+            pthread_mutex_t m;
+            pthread_cond_t cv;
+
+            ReduceSplit() {
+                pthread_mutex_init(&m, nullptr);
+                pthread_cond_init(&cv, nullptr);
+            }
+            ~ReduceSplit() {
+                pthread_cond_destroy(&cv);
+                pthread_mutex_destroy(&m);
+            }
+        };
+
+        /// Lets one more thread help with a ReduceSplit.
+        struct ChunkTask : WorkerPool::Task {
+            std::shared_ptr<ReduceSplit> split;
+        };
+
+        /// A pattern set too large to compile on the router thread, parked by wait id.
+        struct CompileTask : WorkerPool::Task {
+            std::vector<std::string> patterns;
+            ipc::RegisterPatternsResponse response; ///< Written by the worker before `done`.
+            std::atomic<bool> done{false};
+        };
+
+        /// A parked GetMany request.
+        struct ManyWait {
+            ipc::GetManyResponse response;                  ///< Results taken so far.
+            std::vector<uint64_t> pending;                  ///< Tickets not finished at the last look.
+            ipc::GetManyWaitMode mode = ipc::GET_MANY_NO_WAIT;
+            std::chrono::steady_clock::time_point started;
+            std::chrono::steady_clock::time_point deadline;
+        };
+
+        /// A streamed search, only touched by the thread that owns the ticket's requests.
+        struct StreamJob {
+            StreamSearch search;
+            std::chrono::steady_clock::time_point lastActive;
+            uint64_t flow;  // the client that opened it; chunks from any other one are rejected
+
+            StreamJob(std::string needle, const uint64_t owner)
+            : search(std::move(needle))
+            , lastActive(std::chrono::steady_clock::now())
+            , flow(owner) {}
+        };
+
         ipc::Status runMath(
             const ipc::MathArgs& request,
             ipc::Result& response
@@ -47,58 +150,345 @@ namespace server {
             ipc::Result& response
         ) const;
 
-        static void* workerCExecution(void* arg) {
-            auto* self = reinterpret_cast<AlgoRunnerIpml*>(arg);
-            self->workerLoop();
-            return nullptr;
-        }
+        ipc::Status runFindAny(
+            const ipc::FindAnyArgs& request,
+            ipc::Result& response
+        ) const;
 
-        void workerLoop();
+        ipc::Status runCall(
+            const ipc::OpCallArgs& request,
+            ipc::Result& response
+        ) const;
+
+        ipc::Status runReduce(
+            const ipc::ReduceArgs& request,
+            ipc::Result& response
+        );
+
+        /// Number of chunks an `n` element reduction is split into, 1 below `reduceParallelMin`.
+        std::size_t chunksFor(const std::size_t n) const;
+
+        /// Calls `body(chunk, begin, end)` for `chunks` consecutive ranges of [0, n) and returns when all
+        /// of them are done. Ranges start at multiples of 16 elements; the trailing ones may be empty.
+        void parallelFor(
+            const std::size_t n,
+            const std::size_t chunks,
+            const std::function<void(std::size_t chunk, std::size_t begin, std::size_t end)>& body
+        );
+
+        /// Folds `kernel(begin, end)` over the chunks of [0, n) with `combine`.
+        template<typename T, typename Kernel, typename Combine>
+        T splitReduce(
+            const std::size_t n,
+            const T identity,
+            Kernel kernel,
+            Combine combine
+        );
+
+        /// Runs the chunks of `split` that no other thread claimed yet.
+        static void drainSplit(ReduceSplit& split);
+
+        /// Compiles or reuses a pattern set and fills in the status and handle.
+        void compilePatterns(
+            const std::vector<std::string>& patterns,
+            ipc::RegisterPatternsResponse& response
+        );
+
+        /// Runs whichever payload the request carries.
+        ipc::Status execute(
+            const ipc::SubmitRequest& request,
+            ipc::Result& response
+        );
+
+        /// Runs a queued job on a pool thread and wakes its waiters.
+        void runJob(std::shared_ptr<WorkerPool::Task>& task);
+
+        /// Queues a job for a worker; `timing`, if given, receives the enqueue time.
+        /// @param cost The request's `estimateCost`, which sets its share of its flow's turns.
+        uint64_t enqueue(
+            const ipc::SubmitRequest& req,
+            const std::shared_ptr<ClientFlow>& client,
+            const uint64_t cost,
+            ipc::RequestTiming* timing
+        );
+
+        std::shared_ptr<ClientFlow> findClient(const uint64_t flow);
 
-        uint64_t enqueue(const ipc::SubmitRequest& req);
+        /// Takes one token from the client's bucket, false if it is empty.
+        bool admit(ClientFlow& client);
 
         std::shared_ptr<Job> findJobById(uint64_t id);
+
+        /// Copies the queue and execution stages of a finished job; `job.m` must be held.
+        static void stampJob(const Job& job, ipc::RequestTiming& timing);
+
+        /// Moves results that finished more than `spillAfterMs` ago and were not fetched into `spill`.
+        /// Runs at most every kSpillInterval, on whichever thread submits or fetches, and moves at
+        /// most kSpillBatch results or kSpillBatchBytes per run so the caller is not held up.
+        void spillAged();
+
+        /// Serves a ticket whose job left `jobs` for the spill file.
+        /// @return false if the ticket is not there either.
+        bool takeSpilled(
+            const uint64_t id,
+            ipc::Status& status,
+            ipc::Result& result,
+            ipc::RequestTiming* timing
+        );
+
+        /// Moves the result of an offloaded BLOCKING job into `response` once it is done.
+        /// @param timing Receives the job's stages if not nullptr.
+        /// @return false while the job is still running.
+        bool takeOffloaded(
+            const uint64_t id,
+            ipc::SubmitResponse& response,
+            ipc::RequestTiming* timing
+        );
+
+        /// Moves the finished and unknown tickets of `wait.pending` into `wait.response`.
+        void takeFinished(ManyWait& wait);
+
+        /// Lists the pending tickets, sets the status and records the request.
+        void finishWait(
+            ManyWait& wait,
+            const std::chrono::steady_clock::time_point now
+        );
+
+        /// The pool that runs jobs of `cls`: its own one, or the one all classes share.
+        WorkerPool& poolFor(const OpClass cls) {
+            return pools.size() == 1 ? *pools.front() : *pools[static_cast<std::size_t>(cls)];
+        }
+
+        /// The context every slow-request record starts from.
+        static SlowRequest slowContext(
+            const ipc::SubmitRequest& req,
+            const ClientFlow* client,
+            const StatsOp op,
+            const ipc::Status status
+        );
+
+        /// Wakes the router if GetMany requests are parked; called after a job is done.
+        void signalCompletion();
+
+        void evictIdleStreams();
     public:
-        AlgoRunnerIpml(const int threads);
+        AlgoRunnerIpml(const int threads, const Config& config);
 
         int init();
 
         int deinit();
 
+        uint64_t openClient(const std::string& name);
+
+        void closeClient(const uint64_t flow);
+
         int run(
             const ipc::SubmitRequest& request,
-            ipc::SubmitResponse& response
+            ipc::SubmitResponse& response,
+            const uint64_t flow,
+            uint64_t* waitId,
+            ipc::RequestTiming* timing
         );
 
         int get(
             const ipc::GetRequest& request,
-            ipc::GetResponse& response
+            ipc::GetResponse& response,
+            ipc::RequestTiming* timing
+        );
+
+        int getMany(
+            const ipc::GetManyRequest& request,
+            ipc::GetManyResponse& response,
+            uint64_t& waitId
+        );
+
+        int collectWaits(std::vector<std::pair<uint64_t, ipc::EnvelopeResp>>& ready);
+
+        int completionFd() const { return wakeFd; }
+
+        int stream(
+            const ipc::StreamRequest& request,
+            ipc::StreamResponse& response,
+            const uint64_t flow
+        );
+
+        int registerPatterns(
+            const ipc::RegisterPatternsRequest& request,
+            ipc::RegisterPatternsResponse& response,
+            uint64_t* waitId
         );
+
+        int stats(
+            const ipc::StatsRequest& request,
+            ipc::StatsResponse& response
+        );
+
+        int listOps(ipc::ListOpsResponse& response) const;
+
+        int slowLog(ipc::SlowLogResponse& response);
     private:
+        const Config config;
+        const std::size_t maxThreads; ///< Of the pool that runs reductions, which bounds their split.
+
         pthread_mutex_t jobsMtx = PTHREAD_MUTEX_INITIALIZER;
         std::unordered_map<uint64_t, std::shared_ptr<Job>> jobs;
 
-        pthread_mutex_t qMtx = PTHREAD_MUTEX_INITIALIZER;
-        pthread_cond_t qCv = PTHREAD_COND_INITIALIZER;
-        std::deque<std::shared_ptr<Job>> jobQueue;
-        std::vector<pthread_t> workers;
+        ResultSpill spill;                            ///< Active when `spillDir` is set.
+        pthread_mutex_t finishedMtx = PTHREAD_MUTEX_INITIALIZER;
+        std::deque<std::pair<std::chrono::steady_clock::time_point, std::weak_ptr<Job>>> finishedJobs; ///< By finish time, while `spill` is active.
+        std::atomic<int64_t> nextSpillNs{0};
+
+        pthread_mutex_t clientsMtx = PTHREAD_MUTEX_INITIALIZER;
+        std::unordered_map<uint64_t, std::shared_ptr<ClientFlow>> clients;
+        std::atomic<uint64_t> nextFlow{1};
+
+        std::unordered_map<uint64_t, ManyWait> waits; ///< Parked GetMany requests, router thread only.
+        std::unordered_map<uint64_t, Offloaded> offloaded; ///< Offloaded BLOCKING submits by wait id, router thread only.
+        std::unordered_map<uint64_t, std::shared_ptr<CompileTask>> compiles; ///< Offloaded pattern compiles by wait id, router thread only.
+        uint64_t nextWaitId = 1;
+        std::chrono::steady_clock::time_point nextDeadline = std::chrono::steady_clock::time_point::max();
+        int wakeFd = -1;                              ///< eventfd behind `completionFd`.
+        std::atomic<uint32_t> parkedWaits{0};         ///< Workers only touch `wakeFd` while this is not 0...
+        std::atomic<bool> wakePending{false};         ///< ...and only once until the router looks again.
+
+        pthread_mutex_t streamsMtx = PTHREAD_MUTEX_INITIALIZER;
+        std::unordered_map<uint64_t, std::shared_ptr<StreamJob>> streams;
+
+        mutable PatternSetCache patternSets;
+
+        OpRegistry ops; ///< Filled in `init`, read-only once the workers run.
+
+        Stats stats_;
+        SlowLog slowLog_;
 
         std::atomic<uint64_t> nextId{1};
-        const int maxThreads;
         std::atomic<bool> running{false};
+
+        /// One pool shared by every class, or one per OpClass in enum order when `classThreads` is set.
+        /// Declared last so their threads stop before the state they use is destroyed.
+        std::vector<std::unique_ptr<WorkerPool>> pools;
     };
 };
 
-AlgoRunnerIpml::AlgoRunnerIpml(const int threads)
-: maxThreads(threads) {}
+static constexpr std::size_t kMaxStreamNeedle = 64u * 1024u;
+static constexpr std::size_t kMaxStreamChunk = 4u * 1024u * 1024u;
+static constexpr std::size_t kMaxOpenStreams = 1024;
+static constexpr std::chrono::seconds kStreamIdleTimeout{60};
+static constexpr int kMaxGetManyTickets = 4096;
+/// Further waiting GetMany requests are answered right away with what is finished,
+/// further expensive BLOCKING submits run inline.
+static constexpr std::size_t kMaxParkedWaits = 4096;
+/// Pattern lists of at least this many bytes are compiled on a worker, the router serves other clients meanwhile.
+static constexpr std::size_t kOffloadPatternBytes = 64u * 1024u;
+/// How often the finished jobs are checked for results old enough to spill.
+static constexpr std::chrono::milliseconds kSpillInterval{10};
+/// Bound one sweep; a backlog drains over several intervals instead of stalling one request.
+static constexpr std::size_t kSpillBatch = 64;
+static constexpr std::size_t kSpillBatchBytes = 4u << 20;
+
+static int64_t elapsedNs(
+    std::chrono::steady_clock::time_point from,
+    std::chrono::steady_clock::time_point to
+) {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(to - from).count();
+}
+
+/// Records a get/stream/register call that runs on the router thread, with the status it left in the response.
+template<typename Response>
+struct ScopedStatsRecord {
+    ScopedStatsRecord(Stats& stats, StatsOp op, const Response& response)
+    : mStats(stats), mOp(op), mResponse(response), mStart(std::chrono::steady_clock::now()) {}
+
+    ~ScopedStatsRecord() {
+        const int64_t ns = elapsedNs(mStart, std::chrono::steady_clock::now());
+        mStats.record(mOp, mResponse.status(), -1, ns, ns);
+    }
+
+private:
+    Stats& mStats;
+    const StatsOp mOp;
+    const Response& mResponse;
+    const std::chrono::steady_clock::time_point mStart;
+};
+
+/// Estimated cost of a submit, roughly the bytes of input it works through; the dispatch
+/// thresholds `inlineMaxCost` and `offloadMinCost` are compared with it.
+static uint64_t estimateCost(const ipc::SubmitRequest& request) {
+    switch (request.payload_case()) {
+    case ipc::SubmitRequest::kMath:
+        return 1;
+    case ipc::SubmitRequest::kStr:
+        return request.str().s1().size() + request.str().s2().size();
+    case ipc::SubmitRequest::kFindAny:
+        return request.find_any().haystack().size();
+    case ipc::SubmitRequest::kReduce:
+        return request.reduce().values().size() + request.reduce().other().size();
+    case ipc::SubmitRequest::kExpr:
+    case ipc::SubmitRequest::kCall:
+    default:
+        // Programs and plugin arguments are small; their encoded size is a fair stand-in.
+        return request.ByteSizeLong();
+    }
+}
+
+/// Input bytes per unit of fair-queue credit, and the most units one job takes. A turn earns a
+/// flow its weight in units, so a 4 MiB search waits for as many turns as 1024 adds would take.
+static constexpr uint64_t kCostUnitBytes = 4096;
+static constexpr uint64_t kMaxTaskCost = 1024;
+
+/// @return The `WorkerPool::Task::cost` of a request of `estimateCost` `cost`.
+static uint32_t taskCost(const uint64_t cost) {
+    return static_cast<uint32_t>(std::min(1 + cost / kCostUnitBytes, kMaxTaskCost));
+}
+
+static uint64_t nextTicketId() {
+    using namespace std::chrono;
+    static std::atomic<uint64_t> seq{0};
+    auto now = steady_clock::now();
+    uint64_t ts = duration_cast<nanoseconds>(now.time_since_epoch()).count();
+    return (ts << 16) | (seq.fetch_add(1) & 0xFFFF);
+}
+
+static bool hasClassPools(const Config& config) {
+    return std::any_of(std::begin(config.classThreads), std::end(config.classThreads),
+        [] (uint32_t n) { return n > 0; });
+}
+
+/// Maximum workers of the pool that runs `cls`.
+static int classMaxThreads(const int threads, const Config& config, const OpClass cls) {
+    if (hasClassPools(config) == false) {
+        return threads;
+    }
+    const uint32_t own = config.classThreads[static_cast<int>(cls)];
+    return own > 0 ? static_cast<int>(own) : threads;
+}
+
+AlgoRunnerIpml::AlgoRunnerIpml(const int threads, const Config& config)
+: config(config)
+, maxThreads(static_cast<std::size_t>(classMaxThreads(threads, config, OpClass::BULK)))
+, patternSets(config.patternCacheBytes)
+, slowLog_(config) {
+    auto handler = [this] (std::shared_ptr<WorkerPool::Task>& task) { runJob(task); };
+    if (hasClassPools(config) == false) {
+        pools.push_back(std::make_unique<WorkerPool>(
+            "", config.minThreads > 0 ? config.minThreads : threads, threads, config, handler));
+        return;
+    }
+    for (int c = 0; c < static_cast<int>(OpClass::COUNT); ++c) {
+        const OpClass cls = static_cast<OpClass>(c);
+        const int max = classMaxThreads(threads, config, cls);
+        pools.push_back(std::make_unique<WorkerPool>(
+            opClassName(cls), config.minThreads > 0 ? std::min(config.minThreads, max) : max, max, config, handler));
+    }
+}
 
 // PUBLIC CLASS METHODS
-int AlgoRunner::init(const int threads) {
+int AlgoRunner::init(const int threads, const Config& config) {
     if (outImpl != nullptr) {
         spdlog::error("AlgoRunner is already initialized");
         return EC_SUCCESS;
     }
-    outImpl = new std::unique_ptr<AlgoRunnerIpml>(new AlgoRunnerIpml(threads));
+    outImpl = new std::unique_ptr<AlgoRunnerIpml>(new AlgoRunnerIpml(threads, config));
     return (*outImpl)->init();
 }
 
@@ -113,26 +503,132 @@ int AlgoRunner::deinit() {
     return result;
 }
 
+uint64_t AlgoRunner::openClient(const std::string& name) const {
+    if (outImpl == nullptr) {
+        spdlog::error("AlgoRunner is not initialized");
+        return 0;
+    }
+    return (*outImpl)->openClient(name);
+}
+
+void AlgoRunner::closeClient(const uint64_t flow) const {
+    if (outImpl == nullptr) {
+        spdlog::error("AlgoRunner is not initialized");
+        return;
+    }
+    (*outImpl)->closeClient(flow);
+}
+
 int AlgoRunner::run(
     const ipc::SubmitRequest& request,
-    ipc::SubmitResponse& response
+    ipc::SubmitResponse& response,
+    const uint64_t flow,
+    uint64_t* waitId,
+    ipc::RequestTiming* timing
 ) const {
+    if (waitId != nullptr) {
+        *waitId = 0;
+    }
     if (outImpl == nullptr) {
         spdlog::error("AlgoRunner is not initialized");
         return EC_FAILURE;
     }
-    return (*outImpl)->run(request, response);
+    return (*outImpl)->run(request, response, flow, waitId, timing);
 }
 
 int AlgoRunner::get(
     const ipc::GetRequest& request,
-    ipc::GetResponse& response
+    ipc::GetResponse& response,
+    ipc::RequestTiming* timing
 ) const {
     if (outImpl == nullptr) {
         spdlog::error("AlgoRunner is not initialized");
         return EC_FAILURE;
     }
-    return (*outImpl)->get(request, response);
+    return (*outImpl)->get(request, response, timing);
+}
+
+int AlgoRunner::getMany(
+    const ipc::GetManyRequest& request,
+    ipc::GetManyResponse& response,
+    uint64_t& waitId
+) const {
+    waitId = 0;
+    if (outImpl == nullptr) {
+        spdlog::error("AlgoRunner is not initialized");
+        return EC_FAILURE;
+    }
+    return (*outImpl)->getMany(request, response, waitId);
+}
+
+int AlgoRunner::collectWaits(std::vector<std::pair<uint64_t, ipc::EnvelopeResp>>& ready) const {
+    if (outImpl == nullptr) {
+        spdlog::error("AlgoRunner is not initialized");
+        return -1;
+    }
+    return (*outImpl)->collectWaits(ready);
+}
+
+int AlgoRunner::completionFd() const {
+    if (outImpl == nullptr) {
+        spdlog::error("AlgoRunner is not initialized");
+        return -1;
+    }
+    return (*outImpl)->completionFd();
+}
+
+int AlgoRunner::stream(
+    const ipc::StreamRequest& request,
+    ipc::StreamResponse& response,
+    const uint64_t flow
+) const {
+    if (outImpl == nullptr) {
+        spdlog::error("AlgoRunner is not initialized");
+        return EC_FAILURE;
+    }
+    return (*outImpl)->stream(request, response, flow);
+}
+
+int AlgoRunner::registerPatterns(
+    const ipc::RegisterPatternsRequest& request,
+    ipc::RegisterPatternsResponse& response,
+    uint64_t* waitId
+) const {
+    if (waitId != nullptr) {
+        *waitId = 0;
+    }
+    if (outImpl == nullptr) {
+        spdlog::error("AlgoRunner is not initialized");
+        return EC_FAILURE;
+    }
+    return (*outImpl)->registerPatterns(request, response, waitId);
+}
+
+int AlgoRunner::stats(
+    const ipc::StatsRequest& request,
+    ipc::StatsResponse& response
+) const {
+    if (outImpl == nullptr) {
+        spdlog::error("AlgoRunner is not initialized");
+        return EC_FAILURE;
+    }
+    return (*outImpl)->stats(request, response);
+}
+
+int AlgoRunner::listOps(ipc::ListOpsResponse& response) const {
+    if (outImpl == nullptr) {
+        spdlog::error("AlgoRunner is not initialized");
+        return EC_FAILURE;
+    }
+    return (*outImpl)->listOps(response);
+}
+
+int AlgoRunner::slowLog(ipc::SlowLogResponse& response) const {
+    if (outImpl == nullptr) {
+        spdlog::error("AlgoRunner is not initialized");
+        return EC_FAILURE;
+    }
+    return (*outImpl)->slowLog(response);
 }
 // ~ PUBLIC CLASS METHODS
 
@@ -141,110 +637,456 @@ ipc::Status AlgoRunnerIpml::runMath(
     const ipc::MathArgs& request,
     ipc::Result& response
 ) const {
-    switch (request.op()) {
-    case ipc::MATH_ADD:
-        response.set_int_result(request.a() + request.b());
-        break;
-    case ipc::MATH_SUB:
-        response.set_int_result(request.a() - request.b());
-        break;
-    case ipc::MATH_MUL:
-        response.set_int_result(request.a() * request.b());
-        break;
-    case ipc::MATH_DIV:
-        if (request.b() == 0) {
-            return ipc::ST_ERROR_DIV_BY_ZERO;
-        }
-        response.set_int_result(request.a() / request.b());
-        break;
-    default:
-        return ipc::ST_ERROR_INVALID_INPUT;
-    }
-    return ipc::ST_SUCCESS;
+    IPC_TRACE_SCOPE("runMath");
+    const int32_t ints[2] = {request.a(), request.b()};
+    const IpcOpArgs args{ints, 2, nullptr, 0};
+    return ops.call(opIdFor(request.op()), args, response);
 }
 
 ipc::Status AlgoRunnerIpml::runStr(
     const ipc::StrArgs& request,
     ipc::Result& response
 ) const {
-    if (request.op() == ipc::STR_CONCAT) {
-        std::string r = request.s1() + request.s2();
-        if (r.size() > 32) {
-            return ipc::Status::ST_ERROR_STRING_TOO_LONG;
-        }
-        response.set_str_result(r);
-    } else if (request.op() == ipc::STR_FIND_START) {
-        std::size_t pos = request.s1().find(request.s2());
-        if (pos == std::string::npos) {
-            return ipc::ST_ERROR_SUBSTR_NOT_FOUND;
-        }
-        response.set_position(static_cast<int32_t>(pos));
-    } else {
-        return ipc::ST_ERROR_INVALID_INPUT;
+    IPC_TRACE_SCOPE("runStr");
+    const IpcBytes strs[2] = {
+        {request.s1().data(), request.s1().size()},
+        {request.s2().data(), request.s2().size()},
+    };
+    const IpcOpArgs args{nullptr, 0, strs, 2};
+    return ops.call(opIdFor(request.op()), args, response);
+}
+
+ipc::Status AlgoRunnerIpml::runFindAny(
+    const ipc::FindAnyArgs& request,
+    ipc::Result& response
+) const {
+    IPC_TRACE_SCOPE("runFindAny");
+    std::shared_ptr<const PatternSet> set = patternSets.find(request.handle());
+    if (set == nullptr) {
+        return ipc::ST_ERROR_UNKNOWN_HANDLE;
+    }
+    if (request.haystack().size() > static_cast<std::size_t>(INT32_MAX)) {
+        return ipc::ST_ERROR_STRING_TOO_LONG;
+    }
+    thread_local std::vector<PatternSet::Match> found;
+    found.clear();
+    set->find(request.haystack(), request.all_matches(), found);
+    if (found.empty()) {
+        return ipc::ST_ERROR_SUBSTR_NOT_FOUND;
     }
-    return ipc::Status::ST_SUCCESS;
+    ipc::Matches* matches = response.mutable_matches();
+    matches->mutable_matches()->Reserve(static_cast<int>(found.size()));
+    for (const PatternSet::Match& m : found) {
+        ipc::Match* out = matches->add_matches();
+        out->set_position(static_cast<int32_t>(m.position));
+        out->set_pattern(m.pattern);
+    }
+    return ipc::ST_SUCCESS;
 }
 
-void AlgoRunnerIpml::workerLoop() {
-    while (running.load()) {
-        std::shared_ptr<AlgoRunnerIpml::Job> job;
-        {
-            pthread_mutex_lock(&qMtx);
-            while (running.load() && jobQueue.empty()) {
-                pthread_cond_wait(&qCv, &qMtx);
-            }
-            if (running.load() == false && jobQueue.empty()) {
-                pthread_mutex_unlock(&qMtx);
-                break;
-            }
-            job = std::move(jobQueue.front());
-            jobQueue.pop_front();
-            pthread_mutex_unlock(&qMtx);
+ipc::Status AlgoRunnerIpml::runCall(
+    const ipc::OpCallArgs& request,
+    ipc::Result& response
+) const {
+    IPC_TRACE_SCOPE("runCall");
+    thread_local std::vector<IpcBytes> strs;
+    strs.clear();
+    for (const std::string& s : request.strs()) {
+        strs.push_back(IpcBytes{s.data(), s.size()});
+    }
+    const IpcOpArgs args{request.ints().data(), static_cast<std::size_t>(request.ints_size()), strs.data(), strs.size()};
+    return ops.call(request.op(), args, response);
+}
+
+std::size_t AlgoRunnerIpml::chunksFor(const std::size_t n) const {
+    if (config.reduceParallelMin == 0 || n < config.reduceParallelMin) {
+        return 1;
+    }
+    // Every chunk keeps at least half the threshold; the submitting thread works too.
+    const std::size_t minChunk = std::max<std::size_t>(config.reduceParallelMin / 2, 1);
+    return std::max<std::size_t>(1, std::min(n / minChunk, maxThreads + 1));
+}
+
+void AlgoRunnerIpml::drainSplit(ReduceSplit& split) {
+    for (;;) {
+        const std::size_t chunk = split.next.fetch_add(1);
+        if (chunk >= split.chunks) {
+            return;
+        }
+        split.body(chunk);
+        pthread_mutex_lock(&split.m);
+        const bool last = --split.remaining == 0;
+        pthread_mutex_unlock(&split.m);
+        if (last) {
+            pthread_cond_broadcast(&split.cv);
         }
+    }
+}
 
-        ipc::Result result;
-        ipc::Status status = ipc::ST_ERROR_INVALID_INPUT;
+void AlgoRunnerIpml::parallelFor(
+    const std::size_t n,
+    const std::size_t chunks,
+    const std::function<void(std::size_t chunk, std::size_t begin, std::size_t end)>& body
+) {
+    const std::size_t step = ((n + chunks - 1) / chunks + 15) & ~static_cast<std::size_t>(15);
+    auto runChunk = [&] (std::size_t chunk) {
+        const std::size_t begin = std::min(n, chunk * step);
+        body(chunk, begin, std::min(n, begin + step));
+    };
+    if (chunks <= 1) {
+        runChunk(0);
+        return;
+    }
+    IPC_TRACE_SCOPE("splitReduce");
+    std::shared_ptr<ReduceSplit> split = std::make_shared<ReduceSplit>();
+    split->body = runChunk;
+    split->chunks = chunks;
+    split->remaining = chunks;
+    // One helper per chunk beyond our own; helpers that find nothing left return at once.
+    const auto now = std::chrono::steady_clock::now();
+    for (std::size_t i = 1; i < chunks; ++i) {
+        std::shared_ptr<ChunkTask> task = std::make_shared<ChunkTask>();
+        task->kind = TASK_CHUNK;
+        task->urgent = true;
+        task->enqueuedAt = now;
+        task->split = split;
+        poolFor(OpClass::BULK).submit(std::move(task));
+    }
+    drainSplit(*split);
+    pthread_mutex_lock(&split->m);
+    while (split->remaining > 0) {
+        pthread_cond_wait(&split->cv, &split->m);
+    }
+    pthread_mutex_unlock(&split->m);
+}
+
+template<typename T, typename Kernel, typename Combine>
+T AlgoRunnerIpml::splitReduce(
+    const std::size_t n,
+    const T identity,
+    Kernel kernel,
+    Combine combine
+) {
+    const std::size_t chunks = chunksFor(n);
+    if (chunks == 1) {
+        return kernel(0, n);
+    }
+    std::vector<T> partials(chunks, identity);
+    parallelFor(n, chunks, [&] (std::size_t chunk, std::size_t begin, std::size_t end) {
+        partials[chunk] = kernel(begin, end);
+    });
+    T result = identity;
+    for (const T& partial : partials) {
+        result = combine(result, partial);
+    }
+    return result;
+}
+
+ipc::Status AlgoRunnerIpml::runReduce(
+    const ipc::ReduceArgs& request,
+    ipc::Result& response
+) {
+    IPC_TRACE_SCOPE("runReduce");
+    const std::string& values = request.values();
+    const std::string& other = request.other();
+    if (values.size() % 4 != 0 || values.size() / 4 > reduce::kMaxValues) {
+        return ipc::ST_ERROR_INVALID_INPUT;
+    }
+    const bool isDot = request.op() == ipc::REDUCE_DOT;
+    if (isDot ? other.size() != values.size() : other.empty() == false) {
+        return ipc::ST_ERROR_INVALID_INPUT;
+    }
+    const std::size_t n = values.size() / 4;
+    const char* a = values.data();
+    const char* b = other.data();
+    const reduce::Kernels& k = reduce::kernels();
+    const bool wide = request.wide();
+    auto wrapAdd = [] (uint32_t x, uint32_t y) { return x + y; };
+    auto wideAdd = [] (int64_t x, int64_t y) {
+        return static_cast<int64_t>(static_cast<uint64_t>(x) + static_cast<uint64_t>(y));
+    };
 
-        if (job->req.has_math()) {
-            status = runMath(job->req.math(), result);
-        } else if (job->req.has_str()) {
-            status = runStr(job->req.str(), result);
+    switch (request.op()) {
+    case ipc::REDUCE_SUM:
+        if (wide) {
+            response.set_long_result(splitReduce<int64_t>(n, 0,
+                [&] (std::size_t begin, std::size_t end) { return k.sum64(a + 4 * begin, end - begin); }, wideAdd));
+        } else {
+            response.set_int_result(static_cast<int32_t>(splitReduce<uint32_t>(n, 0,
+                [&] (std::size_t begin, std::size_t end) { return k.sum32(a + 4 * begin, end - begin); }, wrapAdd)));
+        }
+        return ipc::ST_SUCCESS;
+    case ipc::REDUCE_MIN:
+    case ipc::REDUCE_MAX: {
+        if (n == 0) {
+            return ipc::ST_ERROR_INVALID_INPUT;
+        }
+        const bool isMin = request.op() == ipc::REDUCE_MIN;
+        auto kernel = isMin ? k.min : k.max;
+        response.set_int_result(splitReduce<int32_t>(n, isMin ? INT32_MAX : INT32_MIN,
+            [&] (std::size_t begin, std::size_t end) { return kernel(a + 4 * begin, end - begin); },
+            [isMin] (int32_t x, int32_t y) { return isMin ? std::min(x, y) : std::max(x, y); }));
+        return ipc::ST_SUCCESS;
+    }
+    case ipc::REDUCE_DOT:
+        if (wide) {
+            response.set_long_result(splitReduce<int64_t>(n, 0,
+                [&] (std::size_t begin, std::size_t end) { return k.dot64(a + 4 * begin, b + 4 * begin, end - begin); },
+                wideAdd));
         } else {
-            status = ipc::ST_ERROR_INVALID_INPUT;
+            response.set_int_result(static_cast<int32_t>(splitReduce<uint32_t>(n, 0,
+                [&] (std::size_t begin, std::size_t end) { return k.dot32(a + 4 * begin, b + 4 * begin, end - begin); },
+                wrapAdd)));
         }
+        return ipc::ST_SUCCESS;
+    case ipc::REDUCE_PREFIX_SUM: {
+        const std::size_t width = wide ? 8 : 4;
+        std::string* out = wide ? response.mutable_long_values() : response.mutable_values();
+        out->resize(n * width);
+        char* dst = out->data();
+        const std::size_t chunks = chunksFor(n);
+        if (chunks == 1) {
+            wide ? k.prefix64(a, n, 0, dst) : k.prefix32(a, n, 0, dst);
+            return ipc::ST_SUCCESS;
+        }
+        // Two passes: chunk totals, then each chunk's scan starting from the sum of the chunks before it.
+        std::vector<int64_t> carries(chunks, 0);
+        parallelFor(n, chunks, [&] (std::size_t chunk, std::size_t begin, std::size_t end) {
+            carries[chunk] = wide ? k.sum64(a + 4 * begin, end - begin)
+                                  : static_cast<int64_t>(k.sum32(a + 4 * begin, end - begin));
+        });
+        int64_t carry = 0;
+        for (int64_t& c : carries) {
+            const int64_t total = c;
+            c = carry;
+            carry = wideAdd(carry, total);
+        }
+        parallelFor(n, chunks, [&] (std::size_t chunk, std::size_t begin, std::size_t end) {
+            if (wide) {
+                k.prefix64(a + 4 * begin, end - begin, carries[chunk], dst + 8 * begin);
+            } else {
+                k.prefix32(a + 4 * begin, end - begin, static_cast<uint32_t>(carries[chunk]), dst + 4 * begin);
+            }
+        });
+        return ipc::ST_SUCCESS;
+    }
+    default:
+        return ipc::ST_ERROR_INVALID_INPUT;
+    }
+}
 
-        pthread_mutex_lock(&job->m);
-        job->status = status;
-        job->result.Swap(&result);
-        job->done = true;
-        pthread_mutex_unlock(&job->m);
-        pthread_cond_broadcast(&job->cv);
+ipc::Status AlgoRunnerIpml::execute(
+    const ipc::SubmitRequest& request,
+    ipc::Result& response
+) {
+    switch (request.payload_case()) {
+    case ipc::SubmitRequest::kMath:    return runMath(request.math(), response);
+    case ipc::SubmitRequest::kStr:     return runStr(request.str(), response);
+    case ipc::SubmitRequest::kFindAny: return runFindAny(request.find_any(), response);
+    case ipc::SubmitRequest::kExpr:    return evaluateExpression(request.expr(), response);
+    case ipc::SubmitRequest::kCall:    return runCall(request.call(), response);
+    case ipc::SubmitRequest::kReduce:  return runReduce(request.reduce(), response);
+    case ipc::SubmitRequest::PAYLOAD_NOT_SET:
+    default:
+        return ipc::ST_ERROR_INVALID_INPUT;
     }
 }
 
-uint64_t AlgoRunnerIpml::enqueue(const ipc::SubmitRequest& req) {
-    using namespace std::chrono;
+void AlgoRunnerIpml::runJob(std::shared_ptr<WorkerPool::Task>& task) {
+    if (task->kind == TASK_COMPILE) {
+        CompileTask* compile = static_cast<CompileTask*>(task.get());
+        const auto started = std::chrono::steady_clock::now();
+        compilePatterns(compile->patterns, compile->response);
+        const auto finished = std::chrono::steady_clock::now();
+        stats_.record(StatsOp::PATTERNS, compile->response.status(), elapsedNs(compile->enqueuedAt, started),
+            elapsedNs(started, finished), elapsedNs(compile->enqueuedAt, finished));
+        stats_.addBusy(elapsedNs(started, finished), OpClass::BULK);
+        compile->done.store(true, std::memory_order_release);
+        signalCompletion();
+        return;
+    }
+    if (task->kind == TASK_CHUNK) {
+        // Chunk time is busy time, but the request it belongs to is recorded by its submitter.
+        const auto started = std::chrono::steady_clock::now();
+        drainSplit(*static_cast<ChunkTask*>(task.get())->split);
+        stats_.addBusy(elapsedNs(started, std::chrono::steady_clock::now()), OpClass::BULK);
+        return;
+    }
+    Job* job = static_cast<Job*>(task.get());
+    if (job->client != nullptr) {
+        job->client->queued.fetch_sub(1, std::memory_order_relaxed);
+    }
+    const auto started = std::chrono::steady_clock::now();
+    IPC_TRACE_SPAN("queue_wait", trace::toNs(job->enqueuedAt), trace::toNs(started));
+    ipc::Result result;
+    const ipc::Status status = execute(job->req, result);
+    const auto finished = std::chrono::steady_clock::now();
+    const int64_t queueNs = elapsedNs(job->enqueuedAt, started);
+    const int64_t execNs = elapsedNs(started, finished);
+    const int64_t totalNs = elapsedNs(job->enqueuedAt, finished);
+    stats_.record(job->op, status, queueNs, execNs, totalNs);
+    stats_.addBusy(execNs, job->cls);
+    if (slowLog_.isSlow(job->op, totalNs)) {
+        SlowRequest slow = slowContext(job->req, job->client.get(), job->op, status);
+        slow.queueDepth = job->queuedAhead;
+        slow.worker = fmt::format("{}-{}", poolFor(job->cls).threadPrefix(), job->worker);
+        slow.queueNs = queueNs;
+        slow.execNs = execNs;
+        slow.totalNs = totalNs;
+        slowLog_.record(std::move(slow));
+    }
+    if (job->client != nullptr) {
+        job->client->served.fetch_add(1, std::memory_order_relaxed);
+    }
 
+    pthread_mutex_lock(&job->m);
+    job->status = status;
+    job->result.Swap(&result);
+    job->startedAt = started;
+    job->finishedAt = finished;
+    job->done = true;
+    pthread_mutex_unlock(&job->m);
+    pthread_cond_broadcast(&job->cv);
+    if (spill.active()) {
+        pthread_mutex_lock(&finishedMtx);
+        finishedJobs.emplace_back(finished, std::static_pointer_cast<Job>(task));
+        pthread_mutex_unlock(&finishedMtx);
+    }
+    signalCompletion();
+}
+
+void AlgoRunnerIpml::signalCompletion() {
+    if (parkedWaits.load() == 0 || wakePending.exchange(true)) {
+        return;
+    }
+    const uint64_t one = 1;
+    // A full counter is still readable, so a failed write loses no wakeup.
+    ssize_t written = write(wakeFd, &one, sizeof(one));
+    (void)written;
+}
+
+uint64_t AlgoRunnerIpml::enqueue(
+    const ipc::SubmitRequest& req,
+    const std::shared_ptr<ClientFlow>& client,
+    const uint64_t cost,
+    ipc::RequestTiming* timing
+) {
+    IPC_TRACE_SCOPE("enqueue");
     std::shared_ptr<Job> job = std::make_shared<Job>();
-    static std::atomic<uint64_t> seq{0};
-    auto now = steady_clock::now();
-    uint64_t ts = duration_cast<nanoseconds>(now.time_since_epoch()).count();
-    uint64_t id = (ts << 16) | (seq.fetch_add(1) & 0xFFFF);
+    const uint64_t id = nextTicketId();
     job->id = id;
     job->req = req;
+    if (client != nullptr) {
+        job->client = client;
+        job->flow = client->flow;
+        job->weight = client->weight;
+        client->queued.fetch_add(1, std::memory_order_relaxed);
+    }
+    job->op = statsOpFor(req);
+    job->cls = opClassFor(req);
+    job->cost = taskCost(cost);
+    job->enqueuedAt = std::chrono::steady_clock::now();
+    if (timing != nullptr) {
+        timing->set_enqueue_ns(static_cast<uint64_t>(trace::toNs(job->enqueuedAt)));
+    }
 
     pthread_mutex_lock(&jobsMtx);
     jobs[id] = job;
     pthread_mutex_unlock(&jobsMtx);
 
-    pthread_mutex_lock(&qMtx);
-    jobQueue.emplace_back(std::move(job));
-    pthread_mutex_unlock(&qMtx);
-
-    pthread_cond_signal(&qCv);
+    WorkerPool& pool = poolFor(job->cls);
+    pool.submit(std::move(job));
     return id;
 }
 
+void AlgoRunnerIpml::stampJob(const Job& job, ipc::RequestTiming& timing) {
+    timing.set_enqueue_ns(static_cast<uint64_t>(trace::toNs(job.enqueuedAt)));
+    timing.set_exec_start_ns(static_cast<uint64_t>(trace::toNs(job.startedAt)));
+    timing.set_exec_end_ns(static_cast<uint64_t>(trace::toNs(job.finishedAt)));
+}
+
+void AlgoRunnerIpml::spillAged() {
+    if (spill.active() == false) {
+        return;
+    }
+    const int64_t nowNs = trace::nowNs();
+    int64_t due = nextSpillNs.load(std::memory_order_relaxed);
+    // One thread per interval does the sweep; the others carry on.
+    if (nowNs < due || nextSpillNs.compare_exchange_strong(due,
+            nowNs + std::chrono::nanoseconds(kSpillInterval).count(), std::memory_order_relaxed) == false) {
+        return;
+    }
+    const auto now = std::chrono::steady_clock::now();
+    const auto cutoff = now - std::chrono::milliseconds(config.spillAfterMs);
+    std::vector<std::weak_ptr<Job>> aged;
+    pthread_mutex_lock(&finishedMtx);
+    while (aged.size() < kSpillBatch && finishedJobs.empty() == false && finishedJobs.front().first <= cutoff) {
+        aged.push_back(std::move(finishedJobs.front().second));
+        finishedJobs.pop_front();
+    }
+    pthread_mutex_unlock(&finishedMtx);
+
+    std::size_t bytes = 0;
+    std::size_t next = 0;
+    bool full = false;
+    for (; next < aged.size() && bytes < kSpillBatchBytes && full == false; ++next) {
+        std::shared_ptr<Job> job = aged[next].lock();
+        if (job == nullptr) {
+            continue; // Fetched and gone already.
+        }
+        pthread_mutex_lock(&job->m);
+        bool spilled = false;
+        if (job->taken == false) {
+            const SpilledOutcome outcome{job->status, job->enqueuedAt, job->startedAt, job->finishedAt};
+            bytes += job->result.ByteSizeLong();
+            // A full file leaves the result where it is; it is served from memory meanwhile.
+            spilled = spill.put(job->id, job->result, outcome);
+            job->taken = spilled;
+            full = spilled == false;
+            if (spilled) {
+                job->result.Clear();
+            }
+        }
+        pthread_mutex_unlock(&job->m);
+        if (spilled) {
+            // In the file before it leaves `jobs`, so a get never finds it in neither.
+            pthread_mutex_lock(&jobsMtx);
+            jobs.erase(job->id);
+            pthread_mutex_unlock(&jobsMtx);
+        }
+    }
+
+    // Whatever the budget left over goes back to the front; a result the file turned away is
+    // tried again once another `spillAfterMs` has passed, by when fetches may have freed room.
+    pthread_mutex_lock(&finishedMtx);
+    if (full) {
+        finishedJobs.emplace_back(now, std::move(aged[next - 1]));
+    }
+    for (std::size_t i = aged.size(); i > next; --i) {
+        finishedJobs.emplace_front(cutoff, std::move(aged[i - 1]));
+    }
+    pthread_mutex_unlock(&finishedMtx);
+}
+
+bool AlgoRunnerIpml::takeSpilled(
+    const uint64_t id,
+    ipc::Status& status,
+    ipc::Result& result,
+    ipc::RequestTiming* timing
+) {
+    SpilledOutcome outcome;
+    if (spill.take(id, result, outcome) == false) {
+        return false;
+    }
+    status = outcome.status;
+    if (timing != nullptr) {
+        timing->set_enqueue_ns(static_cast<uint64_t>(trace::toNs(outcome.enqueuedAt)));
+        timing->set_exec_start_ns(static_cast<uint64_t>(trace::toNs(outcome.startedAt)));
+        timing->set_exec_end_ns(static_cast<uint64_t>(trace::toNs(outcome.finishedAt)));
+    }
+    return true;
+}
+
 std::shared_ptr<AlgoRunnerIpml::Job> AlgoRunnerIpml::findJobById(uint64_t id) {
     pthread_mutex_lock(&jobsMtx);
     auto it = jobs.find(id);
@@ -257,17 +1099,35 @@ int AlgoRunnerIpml::init() {
     if (running.load()) {
         return EC_SUCCESS;
     }
-    running.store(true);
-
-    workers.reserve(maxThreads);
-    for (int i = 0; i < maxThreads; ++i) {
-        pthread_t tid;
-        if (pthread_create(&tid, nullptr, &AlgoRunnerIpml::workerCExecution, this) == 0) {
-            workers.emplace_back(tid);
-        } else {
-            spdlog::error("Failed to create pthread {}", i);
+    for (const std::string& path : config.opPlugins) {
+        int result = ops.loadPlugin(path);
+        RETURN_IF_ERROR(ErrorType::DEFAULT, result, "Failed to load an op plugin");
+    }
+    if (config.spillDir.empty() == false) {
+        int result = spill.open(config.spillDir, config.spillFileBytes);
+        RETURN_IF_ERROR(ErrorType::DEFAULT, result, "Failed to create the result spill file");
+    }
+    for (std::size_t i = 0; i < pools.size(); ++i) {
+        if (pools[i]->start() != EC_SUCCESS) {
+            for (std::size_t j = 0; j < i; ++j) {
+                pools[j]->stop();
+            }
+            spill.close();
+            spdlog::error("Failed to start the worker pool");
+            return EC_FAILURE;
         }
     }
+    // Workers only write it once a GetMany is parked, which needs `running`.
+    wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (wakeFd < 0) {
+        spdlog::error("Cannot create the completion eventfd: {}", std::strerror(errno));
+        for (const std::unique_ptr<WorkerPool>& pool : pools) {
+            pool->stop();
+        }
+        spill.close();
+        return EC_FAILURE;
+    }
+    running.store(true);
     return EC_SUCCESS;
 }
 
@@ -276,11 +1136,17 @@ int AlgoRunnerIpml::deinit() {
         return EC_SUCCESS;
     }
     running.store(false);
-    pthread_cond_broadcast(&qCv);
-    for (pthread_t& t : workers) {
-        pthread_join(t, nullptr);
+    for (const std::unique_ptr<WorkerPool>& pool : pools) {
+        pool->stop();
+    }
+    if (wakeFd >= 0) {
+        close(wakeFd);
+        wakeFd = -1;
     }
-    workers.clear();
+    spill.close();
+    pthread_mutex_lock(&finishedMtx);
+    finishedJobs.clear();
+    pthread_mutex_unlock(&finishedMtx);
     return EC_SUCCESS;
 }
 
@@ -294,51 +1160,166 @@ static void addMsToTimespec(timespec& ts, uint32_t ms) {
     ts.tv_nsec = duration_cast<nanoseconds>(total % seconds(1)).count();
 }
 
+/// Looks `name` up in a per-client setting, falling back to the "*" entry.
+template<typename T>
+static const T* lookupClientSetting(
+    const std::unordered_map<std::string, T>& settings,
+    const std::string& name
+) {
+    auto it = settings.find(name);
+    if (it == settings.end()) {
+        it = settings.find("*");
+    }
+    return it == settings.end() ? nullptr : &it->second;
+}
+
+uint64_t AlgoRunnerIpml::openClient(const std::string& name) {
+    std::shared_ptr<ClientFlow> client = std::make_shared<ClientFlow>();
+    client->flow = nextFlow.fetch_add(1);
+    client->name = name;
+    if (const uint32_t* weight = lookupClientSetting(config.clientWeights, name)) {
+        client->weight = *weight;
+    }
+    if (const ClientRate* rate = lookupClientSetting(config.clientRates, name)) {
+        client->rate = *rate;
+    }
+    client->tokens = client->rate.burst;
+    client->lastRefill = std::chrono::steady_clock::now();
+    const uint64_t flow = client->flow;
+    spdlog::info("Client {} got flow {} (weight {}, rate {}/s burst {})", name, flow, client->weight,
+        client->rate.perSecond, client->rate.burst);
+    pthread_mutex_lock(&clientsMtx);
+    clients[flow] = std::move(client);
+    pthread_mutex_unlock(&clientsMtx);
+    return flow;
+}
+
+void AlgoRunnerIpml::closeClient(const uint64_t flow) {
+    pthread_mutex_lock(&clientsMtx);
+    clients.erase(flow);
+    pthread_mutex_unlock(&clientsMtx);
+}
+
+std::shared_ptr<AlgoRunnerIpml::ClientFlow> AlgoRunnerIpml::findClient(const uint64_t flow) {
+    if (flow == 0) {
+        return nullptr;
+    }
+    pthread_mutex_lock(&clientsMtx);
+    auto it = clients.find(flow);
+    std::shared_ptr<ClientFlow> client = (it == clients.end()) ? nullptr : it->second;
+    pthread_mutex_unlock(&clientsMtx);
+    return client;
+}
+
+bool AlgoRunnerIpml::admit(ClientFlow& client) {
+    if (client.rate.perSecond <= 0) {
+        return true;
+    }
+    const auto now = std::chrono::steady_clock::now();
+    pthread_mutex_lock(&clientsMtx);
+    const double elapsed = std::chrono::duration<double>(now - client.lastRefill).count();
+    client.tokens = std::min(client.rate.burst, client.tokens + elapsed * client.rate.perSecond);
+    client.lastRefill = now;
+    const bool admitted = client.tokens >= 1.0;
+    if (admitted) {
+        client.tokens -= 1.0;
+    }
+    pthread_mutex_unlock(&clientsMtx);
+    return admitted;
+}
+
 int AlgoRunnerIpml::run(
     const ipc::SubmitRequest& request,
-    ipc::SubmitResponse& response
+    ipc::SubmitResponse& response,
+    const uint64_t flow,
+    uint64_t* waitId,
+    ipc::RequestTiming* timing
 ) {
     const ipc::SubmitMode mode = request.mode();
-    if (mode == ipc::SubmitMode::BLOCKING) {
-        ipc::Status result = ipc::ST_SUCCESS;
-        ipc::Result* out = response.mutable_result();
-        if (request.has_math()) {
-            result = runMath(request.math(), *out);
-            response.set_status(result);
-            PRINT_ERROR_NO_RET(ErrorType::IPC, result, "Failed to run math operation");
-        } else if (request.has_str()) {
-            result = runStr(request.str(), *out);
-            response.set_status(result);
-            PRINT_ERROR_NO_RET(ErrorType::IPC, result, "Failed to run string operation");
-        } else {
-            response.set_status(ipc::ST_ERROR_INVALID_INPUT);
-        }
+    std::shared_ptr<ClientFlow> client = findClient(flow);
+    if (client != nullptr && admit(*client) == false) {
+        client->rateLimited.fetch_add(1, std::memory_order_relaxed);
+        stats_.record(statsOpFor(request), ipc::ST_ERROR_RATE_LIMITED, -1, 0, 0);
+        response.set_status(ipc::ST_ERROR_RATE_LIMITED);
         return EC_SUCCESS;
     }
-    if (mode == ipc::SubmitMode::NONBLOCKING) {
-        if (request.has_math() == false && request.has_str() == false) {
-            response.set_status(ipc::ST_ERROR_INVALID_INPUT);
-            return EC_SUCCESS;
+    if (mode != ipc::SubmitMode::BLOCKING && mode != ipc::SubmitMode::NONBLOCKING) {
+        response.set_status(ipc::ST_ERROR_INVALID_INPUT);
+        return EC_SUCCESS;
+    }
+    if (request.payload_case() == ipc::SubmitRequest::PAYLOAD_NOT_SET) {
+        stats_.record(StatsOp::INVALID, ipc::ST_ERROR_INVALID_INPUT, -1, 0, 0);
+        response.set_status(ipc::ST_ERROR_INVALID_INPUT);
+        return EC_SUCCESS;
+    }
+    if (client != nullptr) {
+        client->submitted.fetch_add(1, std::memory_order_relaxed);
+    }
+    const bool blocking = mode == ipc::SubmitMode::BLOCKING;
+    const uint64_t cost = estimateCost(request);
+    if (blocking && waitId != nullptr && config.offloadMinCost > 0 && cost >= config.offloadMinCost &&
+        offloaded.size() < kMaxParkedWaits) {
+        // Counted before the job is queued, so its completion already wakes the router.
+        parkedWaits.fetch_add(1);
+        const uint64_t id = enqueue(request, client, cost, timing);
+        *waitId = nextWaitId++;
+        offloaded.emplace(*waitId, Offloaded{id, timing != nullptr});
+        stats_.addDispatch(DispatchPath::OFFLOADED);
+        return EC_SUCCESS;
+    }
+    if (blocking || (config.inlineMaxCost > 0 && cost <= config.inlineMaxCost)) {
+        const auto started = std::chrono::steady_clock::now();
+        const ipc::Status result = execute(request, *response.mutable_result());
+        const auto finished = std::chrono::steady_clock::now();
+        const int64_t execNs = elapsedNs(started, finished);
+        const StatsOp op = statsOpFor(request);
+        stats_.record(op, result, -1, execNs, execNs);
+        if (slowLog_.isSlow(op, execNs)) {
+            SlowRequest slow = slowContext(request, client.get(), op, result);
+            slow.worker = "router";
+            slow.execNs = execNs;
+            slow.totalNs = execNs;
+            slowLog_.record(std::move(slow));
         }
-        const uint64_t id = enqueue(request);
-        response.set_status(ipc::ST_NOT_FINISHED);
-
-        response.mutable_ticket()->set_req_id(id);
+        if (timing != nullptr) {
+            timing->set_exec_start_ns(static_cast<uint64_t>(trace::toNs(started)));
+            timing->set_exec_end_ns(static_cast<uint64_t>(trace::toNs(finished)));
+        }
+        stats_.addDispatch(blocking ? DispatchPath::INLINE : DispatchPath::INLINE_NONBLOCKING);
+        if (client != nullptr) {
+            client->served.fetch_add(1, std::memory_order_relaxed);
+        }
+        response.set_status(result);
+        PRINT_ERROR_NO_RET(ErrorType::IPC, result, "Failed to run operation");
         return EC_SUCCESS;
     }
-    response.set_status(ipc::ST_ERROR_INVALID_INPUT);
+    spillAged();
+    const uint64_t id = enqueue(request, client, cost, timing);
+    stats_.addDispatch(DispatchPath::QUEUED);
+    response.set_status(ipc::ST_NOT_FINISHED);
+    response.mutable_ticket()->set_req_id(id);
     return EC_SUCCESS;
 }
 
 int AlgoRunnerIpml::get(
     const ipc::GetRequest& request,
-    ipc::GetResponse& response
+    ipc::GetResponse& response,
+    ipc::RequestTiming* timing
 ) {
+    ScopedStatsRecord<ipc::GetResponse> record(stats_, StatsOp::GET, response);
+    spillAged();
     const uint64_t id = request.ticket().req_id();
+    auto fromSpill = [&] () {
+        ipc::Status status = ipc::ST_ERROR_INVALID_INPUT;
+        if (takeSpilled(id, status, *response.mutable_result(), timing) == false) {
+            response.clear_result();
+        }
+        response.set_status(status);
+        return EC_SUCCESS;
+    };
     std::shared_ptr<server::AlgoRunnerIpml::Job> job = findJobById(id);
     if (job == nullptr) {
-        response.set_status(ipc::ST_ERROR_INVALID_INPUT);
-        return EC_SUCCESS;
+        return fromSpill();
     }
 
     if (request.wait_mode() == ipc::NO_WAIT) {
@@ -348,8 +1329,16 @@ int AlgoRunnerIpml::get(
             response.set_status(ipc::ST_NOT_FINISHED);
             return EC_SUCCESS;
         }
+        if (job->taken) {
+            pthread_mutex_unlock(&job->m);
+            return fromSpill();
+        }
+        job->taken = true;
         response.set_status(job->status);
         response.mutable_result()->Swap(&job->result);
+        if (timing != nullptr) {
+            stampJob(*job, *timing);
+        }
         pthread_mutex_unlock(&job->m);
         pthread_mutex_lock(&jobsMtx);
         jobs.erase(id);
@@ -375,8 +1364,16 @@ int AlgoRunnerIpml::get(
             response.set_status(ipc::ST_NOT_FINISHED);
             return EC_SUCCESS;
         }
+        if (job->taken) {
+            pthread_mutex_unlock(&job->m);
+            return fromSpill();
+        }
+        job->taken = true;
         response.set_status(job->status);
         response.mutable_result()->Swap(&job->result);
+        if (timing != nullptr) {
+            stampJob(*job, *timing);
+        }
         pthread_mutex_unlock(&job->m);
 
         pthread_mutex_lock(&jobsMtx);
@@ -388,4 +1385,454 @@ int AlgoRunnerIpml::get(
     response.set_status(ipc::ST_ERROR_INVALID_INPUT);
     return EC_SUCCESS;
 }
-// ~ PRIVATE CLASS METHODS
\ No newline at end of file
+
+void AlgoRunnerIpml::takeFinished(ManyWait& wait) {
+    std::vector<uint64_t> finished;
+    std::size_t kept = 0;
+    auto fromSpill = [&wait, this] (const uint64_t id) {
+        ipc::TicketResult* out = wait.response.add_results();
+        out->mutable_ticket()->set_req_id(id);
+        ipc::Status status = ipc::ST_ERROR_INVALID_INPUT;
+        if (takeSpilled(id, status, *out->mutable_result(), nullptr) == false) {
+            out->clear_result();
+        }
+        out->set_status(status);
+    };
+    for (const uint64_t id : wait.pending) {
+        std::shared_ptr<Job> job = findJobById(id);
+        if (job == nullptr) {
+            fromSpill(id);
+            continue;
+        }
+        pthread_mutex_lock(&job->m);
+        if (job->done == false) {
+            pthread_mutex_unlock(&job->m);
+            wait.pending[kept++] = id;
+            continue;
+        }
+        if (job->taken) {
+            pthread_mutex_unlock(&job->m);
+            fromSpill(id);
+            continue;
+        }
+        job->taken = true;
+        ipc::TicketResult* out = wait.response.add_results();
+        out->mutable_ticket()->set_req_id(id);
+        out->set_status(job->status);
+        out->mutable_result()->Swap(&job->result);
+        pthread_mutex_unlock(&job->m);
+        finished.push_back(id);
+    }
+    wait.pending.resize(kept);
+    if (finished.empty() == false) {
+        pthread_mutex_lock(&jobsMtx);
+        for (const uint64_t id : finished) {
+            jobs.erase(id);
+        }
+        pthread_mutex_unlock(&jobsMtx);
+    }
+}
+
+/// WAIT_ANY is met by any result, including an unknown ticket; the client has to hear about that too.
+static bool waitMet(
+    const ipc::GetManyWaitMode mode,
+    const ipc::GetManyResponse& response,
+    const std::size_t pending
+) {
+    return pending == 0 || mode == ipc::GET_MANY_NO_WAIT || (mode == ipc::WAIT_ANY && response.results_size() > 0);
+}
+
+void AlgoRunnerIpml::finishWait(
+    ManyWait& wait,
+    const std::chrono::steady_clock::time_point now
+) {
+    for (const uint64_t id : wait.pending) {
+        wait.response.add_pending()->set_req_id(id);
+    }
+    wait.response.set_status(wait.pending.empty() ? ipc::ST_SUCCESS : ipc::ST_NOT_FINISHED);
+    const int64_t ns = elapsedNs(wait.started, now);
+    stats_.record(StatsOp::GET_MANY, wait.response.status(), -1, ns, ns);
+}
+
+int AlgoRunnerIpml::getMany(
+    const ipc::GetManyRequest& request,
+    ipc::GetManyResponse& response,
+    uint64_t& waitId
+) {
+    ManyWait wait;
+    wait.started = std::chrono::steady_clock::now();
+    wait.mode = request.wait_mode();
+    if (request.tickets_size() == 0 || request.tickets_size() > kMaxGetManyTickets ||
+        ipc::GetManyWaitMode_IsValid(wait.mode) == false) {
+        stats_.record(StatsOp::GET_MANY, ipc::ST_ERROR_INVALID_INPUT, -1, 0, 0);
+        response.set_status(ipc::ST_ERROR_INVALID_INPUT);
+        return EC_SUCCESS;
+    }
+    wait.pending.reserve(static_cast<std::size_t>(request.tickets_size()));
+    for (const ipc::Ticket& ticket : request.tickets()) {
+        wait.pending.push_back(ticket.req_id());
+    }
+    const bool mayPark = wait.mode != ipc::GET_MANY_NO_WAIT && request.timeout_ms() > 0 && waits.size() < kMaxParkedWaits;
+    if (mayPark) {
+        // Counted before the first look, so a job finishing right after it still wakes the router.
+        parkedWaits.fetch_add(1);
+    }
+    takeFinished(wait);
+    if (mayPark && waitMet(wait.mode, wait.response, wait.pending.size()) == false) {
+        wait.deadline = wait.started + std::chrono::milliseconds(request.timeout_ms());
+        nextDeadline = std::min(nextDeadline, wait.deadline);
+        waitId = nextWaitId++;
+        waits.emplace(waitId, std::move(wait));
+        return EC_SUCCESS;
+    }
+    if (mayPark) {
+        parkedWaits.fetch_sub(1);
+    }
+    finishWait(wait, std::chrono::steady_clock::now());
+    response.Swap(&wait.response);
+    return EC_SUCCESS;
+}
+
+bool AlgoRunnerIpml::takeOffloaded(
+    const uint64_t id,
+    ipc::SubmitResponse& response,
+    ipc::RequestTiming* timing
+) {
+    // The router normally claims it right after it finishes, but a busy one may find it spilled.
+    auto fromSpill = [&] () {
+        ipc::Status status = ipc::ST_ERROR_INTERNAL;
+        if (takeSpilled(id, status, *response.mutable_result(), timing) == false) {
+            response.clear_result();
+        }
+        response.set_status(status);
+        return true;
+    };
+    std::shared_ptr<Job> job = findJobById(id);
+    if (job == nullptr) {
+        return fromSpill();
+    }
+    pthread_mutex_lock(&job->m);
+    if (job->done == false) {
+        pthread_mutex_unlock(&job->m);
+        return false;
+    }
+    if (job->taken) {
+        pthread_mutex_unlock(&job->m);
+        return fromSpill();
+    }
+    job->taken = true;
+    response.set_status(job->status);
+    response.mutable_result()->Swap(&job->result);
+    if (timing != nullptr) {
+        stampJob(*job, *timing);
+    }
+    pthread_mutex_unlock(&job->m);
+    pthread_mutex_lock(&jobsMtx);
+    jobs.erase(id);
+    pthread_mutex_unlock(&jobsMtx);
+    return true;
+}
+
+int AlgoRunnerIpml::collectWaits(std::vector<std::pair<uint64_t, ipc::EnvelopeResp>>& ready) {
+    if (waits.empty() && offloaded.empty() && compiles.empty()) {
+        return -1;
+    }
+    const auto now = std::chrono::steady_clock::now();
+    const bool completed = wakePending.exchange(false);
+    if (completed) {
+        uint64_t count = 0;
+        ssize_t got = read(wakeFd, &count, sizeof(count));
+        (void)got;
+        for (auto it = offloaded.begin(); it != offloaded.end();) {
+            ipc::EnvelopeResp response;
+            const Offloaded& job = it->second;
+            if (takeOffloaded(job.jobId, *response.mutable_submit(), job.traced ? response.mutable_timing() : nullptr) == false) {
+                ++it;
+                continue;
+            }
+            ready.emplace_back(it->first, std::move(response));
+            it = offloaded.erase(it);
+            parkedWaits.fetch_sub(1);
+        }
+        for (auto it = compiles.begin(); it != compiles.end();) {
+            if (it->second->done.load(std::memory_order_acquire) == false) {
+                ++it;
+                continue;
+            }
+            ipc::EnvelopeResp response;
+            response.mutable_patterns()->Swap(&it->second->response);
+            ready.emplace_back(it->first, std::move(response));
+            it = compiles.erase(it);
+            parkedWaits.fetch_sub(1);
+        }
+    }
+    if (waits.empty() == false && (completed || now >= nextDeadline)) {
+        nextDeadline = std::chrono::steady_clock::time_point::max();
+        for (auto it = waits.begin(); it != waits.end();) {
+            ManyWait& wait = it->second;
+            takeFinished(wait);
+            if (waitMet(wait.mode, wait.response, wait.pending.size()) || now >= wait.deadline) {
+                finishWait(wait, now);
+                ipc::EnvelopeResp response;
+                response.mutable_get_many()->Swap(&wait.response);
+                ready.emplace_back(it->first, std::move(response));
+                it = waits.erase(it);
+                parkedWaits.fetch_sub(1);
+                continue;
+            }
+            nextDeadline = std::min(nextDeadline, wait.deadline);
+            ++it;
+        }
+    }
+    if (waits.empty()) {
+        return -1;
+    }
+    // Rounded up, so the router does not wake just before the deadline and spin.
+    const auto left = std::chrono::ceil<std::chrono::milliseconds>(nextDeadline - now);
+    return static_cast<int>(std::max<int64_t>(left.count(), 0));
+}
+
+void AlgoRunnerIpml::evictIdleStreams() {
+    const auto now = std::chrono::steady_clock::now();
+    pthread_mutex_lock(&streamsMtx);
+    for (auto it = streams.begin(); it != streams.end();) {
+        if (now - it->second->lastActive > kStreamIdleTimeout) {
+            spdlog::warn("Evicting idle stream {}", it->first);
+            it = streams.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    pthread_mutex_unlock(&streamsMtx);
+}
+
+int AlgoRunnerIpml::stream(
+    const ipc::StreamRequest& request,
+    ipc::StreamResponse& response,
+    const uint64_t flow
+) {
+    ScopedStatsRecord<ipc::StreamResponse> record(stats_, StatsOp::STREAM, response);
+    if (request.has_open()) {
+        const std::string& needle = request.open().needle();
+        if (needle.size() > kMaxStreamNeedle) {
+            response.set_status(ipc::ST_ERROR_STRING_TOO_LONG);
+            return EC_SUCCESS;
+        }
+        evictIdleStreams();
+        const uint64_t id = nextTicketId();
+        pthread_mutex_lock(&streamsMtx);
+        if (streams.size() >= kMaxOpenStreams) {
+            pthread_mutex_unlock(&streamsMtx);
+            spdlog::error("Too many open streams ({})", streams.size());
+            response.set_status(ipc::ST_ERROR_INTERNAL);
+            return EC_SUCCESS;
+        }
+        streams[id] = std::make_shared<StreamJob>(needle, flow);
+        pthread_mutex_unlock(&streamsMtx);
+        response.set_status(ipc::ST_NOT_FINISHED);
+        response.mutable_ticket()->set_req_id(id);
+        return EC_SUCCESS;
+    }
+
+    if (request.has_chunk() == false) {
+        response.set_status(ipc::ST_ERROR_INVALID_INPUT);
+        return EC_SUCCESS;
+    }
+    const ipc::StreamChunk& chunk = request.chunk();
+    const uint64_t id = chunk.ticket().req_id();
+    pthread_mutex_lock(&streamsMtx);
+    auto it = streams.find(id);
+    std::shared_ptr<StreamJob> job = (it == streams.end()) ? nullptr : it->second;
+    pthread_mutex_unlock(&streamsMtx);
+    // Ticket ids are guessable, so a chunk from another client must not feed or close this stream.
+    if (job == nullptr || job->flow != flow) {
+        response.set_status(ipc::ST_ERROR_INVALID_INPUT);
+        return EC_SUCCESS;
+    }
+
+    auto finish = [&] (ipc::Status status) {
+        pthread_mutex_lock(&streamsMtx);
+        streams.erase(id);
+        pthread_mutex_unlock(&streamsMtx);
+        response.set_status(status);
+    };
+    if (chunk.data().size() > kMaxStreamChunk) {
+        finish(ipc::ST_ERROR_INVALID_INPUT);
+        return EC_SUCCESS;
+    }
+    job->lastActive = std::chrono::steady_clock::now();
+    if (job->search.feed(chunk.data())) {
+        finish(ipc::ST_SUCCESS);
+        response.mutable_result()->set_offset(job->search.position());
+        return EC_SUCCESS;
+    }
+    if (chunk.last()) {
+        finish(ipc::ST_ERROR_SUBSTR_NOT_FOUND);
+        return EC_SUCCESS;
+    }
+    response.set_status(ipc::ST_NOT_FINISHED);
+    response.mutable_ticket()->set_req_id(id);
+    return EC_SUCCESS;
+}
+
+void AlgoRunnerIpml::compilePatterns(
+    const std::vector<std::string>& patterns,
+    ipc::RegisterPatternsResponse& response
+) {
+    uint64_t handle = 0;
+    if (patternSets.add(patterns, handle) != EC_SUCCESS) {
+        response.set_status(ipc::ST_ERROR_INVALID_INPUT);
+        return;
+    }
+    response.set_status(ipc::ST_SUCCESS);
+    response.set_handle(handle);
+}
+
+int AlgoRunnerIpml::registerPatterns(
+    const ipc::RegisterPatternsRequest& request,
+    ipc::RegisterPatternsResponse& response,
+    uint64_t* waitId
+) {
+    std::size_t bytes = 0;
+    for (const std::string& pattern : request.patterns()) {
+        bytes += pattern.size();
+    }
+    if (waitId != nullptr && bytes >= kOffloadPatternBytes && compiles.size() < kMaxParkedWaits) {
+        // Counted before the task is queued, so its completion already wakes the router.
+        parkedWaits.fetch_add(1);
+        std::shared_ptr<CompileTask> task = std::make_shared<CompileTask>();
+        task->kind = TASK_COMPILE;
+        task->patterns.assign(request.patterns().begin(), request.patterns().end());
+        task->enqueuedAt = std::chrono::steady_clock::now();
+        *waitId = nextWaitId++;
+        compiles.emplace(*waitId, task);
+        poolFor(OpClass::BULK).submit(std::move(task));
+        return EC_SUCCESS;
+    }
+    ScopedStatsRecord<ipc::RegisterPatternsResponse> record(stats_, StatsOp::PATTERNS, response);
+    std::vector<std::string> patterns(request.patterns().begin(), request.patterns().end());
+    compilePatterns(patterns, response);
+    return EC_SUCCESS;
+}
+int AlgoRunnerIpml::stats(
+    const ipc::StatsRequest& request,
+    ipc::StatsResponse& response
+) {
+    WorkerPoolSnapshot poolState;
+    StatsGauges gauges;
+    if (pools.size() == 1) {
+        pools.front()->snapshot(poolState);
+    } else {
+        // The totals sum the class pools; each size history only makes sense on its own.
+        for (std::size_t i = 0; i < pools.size(); ++i) {
+            WorkerPoolSnapshot classState;
+            pools[i]->snapshot(classState);
+            poolState.workers += classState.workers;
+            poolState.minWorkers += classState.minWorkers;
+            poolState.maxWorkers += classState.maxWorkers;
+            poolState.peakWorkers += classState.peakWorkers;
+            poolState.queueDepth += classState.queueDepth;
+            poolState.grows += classState.grows;
+            poolState.retires += classState.retires;
+            poolState.workerAliveNs += classState.workerAliveNs;
+            gauges.classPools.push_back(StatsGauges::ClassPool{static_cast<OpClass>(i), classState.workers,
+                classState.maxWorkers, classState.peakWorkers, classState.queueDepth, classState.workerAliveNs});
+        }
+    }
+    gauges.queueDepth = poolState.queueDepth;
+    pthread_mutex_lock(&jobsMtx);
+    gauges.jobsRetained = static_cast<uint32_t>(jobs.size());
+    pthread_mutex_unlock(&jobsMtx);
+    spill.usage(gauges.resultsSpilled, gauges.spillBytes, gauges.spillRejected);
+    pthread_mutex_lock(&streamsMtx);
+    gauges.openStreams = static_cast<uint32_t>(streams.size());
+    pthread_mutex_unlock(&streamsMtx);
+    gauges.workers = poolState.workers;
+    gauges.workerAliveNs = poolState.workerAliveNs;
+
+    stats_.fill(gauges, response);
+    response.set_workers_min(poolState.minWorkers);
+    response.set_workers_max(poolState.maxWorkers);
+    response.set_workers_peak(poolState.peakWorkers);
+    response.set_pool_grows(poolState.grows);
+    response.set_pool_retires(poolState.retires);
+    for (const WorkerPoolSnapshot::Resize& resize : poolState.resizes) {
+        ipc::PoolResize* out = response.add_pool_resizes();
+        out->set_at_ms(static_cast<uint64_t>(resize.atNs / 1000000));
+        out->set_workers(resize.workers);
+    }
+    pthread_mutex_lock(&clientsMtx);
+    for (const auto& [flow, client] : clients) {
+        ipc::ClientQueueStats* out = response.add_client_queues();
+        out->set_name(client->name);
+        out->set_flow(flow);
+        out->set_weight(client->weight);
+        out->set_queued(client->queued.load(std::memory_order_relaxed));
+        out->set_submitted(client->submitted.load(std::memory_order_relaxed));
+        out->set_served(client->served.load(std::memory_order_relaxed));
+        out->set_rate_limited(client->rateLimited.load(std::memory_order_relaxed));
+        if (request.reset()) {
+            client->submitted.store(0, std::memory_order_relaxed);
+            client->served.store(0, std::memory_order_relaxed);
+            client->rateLimited.store(0, std::memory_order_relaxed);
+        }
+    }
+    pthread_mutex_unlock(&clientsMtx);
+    std::sort(response.mutable_client_queues()->begin(), response.mutable_client_queues()->end(),
+        [] (const ipc::ClientQueueStats& a, const ipc::ClientQueueStats& b) { return a.flow() < b.flow(); });
+    if (request.reset()) {
+        stats_.reset();
+        for (const std::unique_ptr<WorkerPool>& pool : pools) {
+            pool->resetWindow();
+        }
+    }
+    return EC_SUCCESS;
+}
+
+int AlgoRunnerIpml::listOps(ipc::ListOpsResponse& response) const {
+    ops.list(response);
+    return EC_SUCCESS;
+}
+
+SlowRequest AlgoRunnerIpml::slowContext(
+    const ipc::SubmitRequest& req,
+    const ClientFlow* client,
+    const StatsOp op,
+    const ipc::Status status
+) {
+    SlowRequest slow;
+    slow.op = op;
+    slow.status = status;
+    slow.payloadBytes = static_cast<uint32_t>(req.ByteSizeLong());
+    if (client != nullptr) {
+        slow.client = client->name;
+    }
+    return slow;
+}
+
+int AlgoRunnerIpml::slowLog(ipc::SlowLogResponse& response) {
+    if (slowLog_.enabled() == false) {
+        response.set_status(ipc::ST_ERROR_INVALID_INPUT);
+        return EC_SUCCESS;
+    }
+    std::vector<SlowRequest> records;
+    uint64_t recorded = 0;
+    slowLog_.snapshot(records, recorded);
+    for (const SlowRequest& slow : records) {
+        ipc::SlowRequest* out = response.add_requests();
+        out->set_op(statsOpName(slow.op));
+        out->set_status(slow.status);
+        out->set_payload_bytes(slow.payloadBytes);
+        out->set_client(slow.client);
+        out->set_queue_depth(slow.queueDepth);
+        out->set_worker(slow.worker);
+        out->set_queue_ns(static_cast<uint64_t>(slow.queueNs));
+        out->set_exec_ns(static_cast<uint64_t>(slow.execNs));
+        out->set_total_ns(static_cast<uint64_t>(slow.totalNs));
+        out->set_at_ms(slow.atMs);
+    }
+    response.set_recorded(recorded);
+    response.set_status(ipc::ST_SUCCESS);
+    return EC_SUCCESS;
+}
+// ~ PRIVATE CLASS METHODS
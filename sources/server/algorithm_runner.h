@@ -1,6 +1,10 @@
 #pragma once
 #include "ipc.pb.h"
+#include "config.h"
 #include <memory> //Used for std::unique_ptr.
+#include <string>
+#include <utility>
+#include <vector>
 
 // The server namespace encapsulates all related server-side code.
 namespace server {
@@ -14,33 +18,122 @@ namespace server {
 
         /// @brief Initializes the AlgoRunner and its internal thread pool.
         /// @param threads The number of threads to create for the thread pool.
+        /// @param config Additional tunables, e.g. the pattern set cache budget.
         /// @return An error code; 0 for success.
-        int init(const int threads);
+        int init(const int threads, const Config& config);
 
         /// @brief Deinitializes the AlgoRunner, stopping all threads and cleaning up resources.
         /// @return An error code; 0 for success.
         int deinit();
 
+        /// @brief Registers a client connection; its NONBLOCKING jobs get their own fair share of the workers.
+        /// @param name The FirstHandshake client_name, which selects the weight and the rate limit in the Config.
+        /// @return The flow to pass to `run`, never 0.
+        uint64_t openClient(const std::string& name) const;
+
+        /// @brief Forgets a client connection. Jobs it already queued still run.
+        void closeClient(const uint64_t flow) const;
+
         /// @brief Submits a computational request for execution.
+        ///
+        /// Where it runs depends on its estimated cost, roughly the input bytes. A NONBLOCKING request
+        /// up to `Config::inlineMaxCost` runs right away and its result is returned instead of a ticket;
+        /// others are queued and get a ticket. A BLOCKING request runs right away unless it costs at least
+        /// `Config::offloadMinCost` and `waitId` is given: then a worker runs it and `collectWaits`
+        /// hands out the response, so the caller's thread is free meanwhile.
         /// @param request A Protocol Buffer message containing the request details (e.g., math or string operation).
-        /// If a non-blocking operation is requested, a ticket ID will be generated and returned in the response.
-        /// If a blocking operation is requested, the result will be computed and returned in the response.
         /// @param response A Protocol Buffer message where the result of the request will be stored.
+        /// @param flow The submitting client from `openClient`, or 0 for a shared flow without a rate limit.
+        /// @param waitId The router thread's out-parameter: 0 if `response` is complete, else the id
+        /// `collectWaits` reports the response under. nullptr runs every BLOCKING request inline.
+        /// @param timing For a traced request: receives the enqueue time or the inline execution, and an
+        /// offloaded request's response from `collectWaits` carries its job's stages. nullptr otherwise.
         /// @return An error code; 0 for success.
         int run(
             const ipc::SubmitRequest& request,
-            ipc::SubmitResponse& response
+            ipc::SubmitResponse& response,
+            const uint64_t flow = 0,
+            uint64_t* waitId = nullptr,
+            ipc::RequestTiming* timing = nullptr
         ) const;
 
         /// @brief Retrieves the result of a previously submitted non-blocking request.
         /// @param request A Protocol Buffer message containing the ticket ID of the request to retrieve.
         /// @param response A Protocol Buffer message where the result will be stored.
+        /// @param timing For a traced request: receives the queue and execution stages of the finished job.
         /// @return An error code; 0 for success.
         int get(
             const ipc::GetRequest& request,
-            ipc::GetResponse& response
+            ipc::GetResponse& response,
+            ipc::RequestTiming* timing = nullptr
         ) const ;
 
+        /// @brief Collects the results of several tickets, or parks the request until its wait mode is met.
+        ///
+        /// Finished tickets are taken at once. A WAIT_ANY/WAIT_ALL request with a timeout that is not
+        /// met yet is parked instead of blocking; `collectWaits` hands out its response later.
+        /// Only the router thread may call this and `collectWaits`.
+        /// @param response The results, filled unless `waitId` is set.
+        /// @param waitId 0 if `response` is complete, else the id `collectWaits` reports the response under.
+        /// @return An error code; 0 for success.
+        int getMany(
+            const ipc::GetManyRequest& request,
+            ipc::GetManyResponse& response,
+            uint64_t& waitId
+        ) const;
+
+        /// @brief Hands out the parked GetMany responses whose wait mode is met or whose timeout passed,
+        /// and the responses of offloaded BLOCKING submits and pattern compiles that finished.
+        /// @param ready Receives (waitId, response) pairs.
+        /// @return Milliseconds until the next parked GetMany times out, -1 if none has a deadline.
+        int collectWaits(std::vector<std::pair<uint64_t, ipc::EnvelopeResp>>& ready) const;
+
+        /// @brief An eventfd that becomes readable when a job finishes while responses are parked.
+        /// The router waits on it next to its socket; `collectWaits` resets it.
+        int completionFd() const;
+
+        /// @brief Opens a streamed FIND_START search or feeds it the next chunk of the haystack.
+        /// @param request A Protocol Buffer message with either the needle (open) or a chunk under a ticket.
+        /// @param response The ticket while more chunks are expected, or the final status and offset.
+        /// @param flow The client from `openClient`. Only the client that opened a stream may feed or close it.
+        /// @return An error code; 0 for success.
+        int stream(
+            const ipc::StreamRequest& request,
+            ipc::StreamResponse& response,
+            const uint64_t flow = 0
+        ) const;
+
+        /// @brief Compiles a FIND_ANY pattern set, or reuses an identical one registered by any client.
+        /// @param request A Protocol Buffer message with the list of patterns.
+        /// @param response The status and the handle to pass in FindAnyArgs, filled unless `waitId` is set.
+        /// @param waitId If given, large sets are compiled on a worker: it receives the id `collectWaits`
+        /// reports the response under, or 0 if `response` is complete. Only from the router thread then.
+        /// @return An error code; 0 for success.
+        int registerPatterns(
+            const ipc::RegisterPatternsRequest& request,
+            ipc::RegisterPatternsResponse& response,
+            uint64_t* waitId = nullptr
+        ) const;
+
+        /// @brief Reports per-operation counts and latencies plus the current queue gauges.
+        /// @param request A Protocol Buffer message; `reset` starts a new window after the snapshot.
+        /// @param response The counters since the last reset. `clients` is left for the caller.
+        /// @return An error code; 0 for success.
+        int stats(
+            const ipc::StatsRequest& request,
+            ipc::StatsResponse& response
+        ) const;
+
+        /// @brief Describes the built-in and plugin operations that OpCallArgs can call.
+        /// @param response The operations ordered by id.
+        /// @return An error code; 0 for success.
+        int listOps(ipc::ListOpsResponse& response) const;
+
+        /// @brief Lists the submits that took longer than their op's `Config::slowRequestUs`.
+        /// @param response The records oldest first, or ST_ERROR_INVALID_INPUT if the log is off.
+        /// @return An error code; 0 for success.
+        int slowLog(ipc::SlowLogResponse& response) const;
+
     private:
         // The implementation is defined in the .cpp file.
         std::unique_ptr<AlgoRunnerIpml>* outImpl = nullptr;
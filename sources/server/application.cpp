@@ -1,24 +1,33 @@
 #include "application.h"
-#include <zmq_addon.hpp> // For zmq::recv_multipart
 #include "signal.h"
 #include "error_handling.h"
+#include "log.h"
+#include "trace.h"
+#include "affinity.h"
+#include "inproc.h"
 #include <spdlog/spdlog.h>
 #include <fmt/format.h>
 #include "algorithm_runner.h"
+#include "wire_format.h"
 #include "ipc.h"
+#include <algorithm>
+#include <unistd.h>
 using namespace server;
 
 static std::shared_ptr<server::Application> appPtr = nullptr;
+static std::atomic<bool> slowLogDumpRequested{false};
 
 Application::Application(
     const std::atomic<bool>& sigStop,
     const char* address,
     const int port,
-    const int threads
+    const int threads,
+    const Config& config
 ) noexcept
 : mAddress(address)
 , mPort(port)
 , mThreads(threads)
+, mConfig(config)
 , mSigStop(sigStop)
 {}
 
@@ -31,19 +40,15 @@ int Application::create(
     const std::atomic<bool>& sigStop,
     const char* address,
     const int port,
-    const int threads
+    const int threads,
+    const Config& config
 ) noexcept {
-    static int instanceCount = 0;
-    if (instanceCount >= 1) {
-        spdlog::error("Only one instance of Application is allowed");
-        return EC_FAILURE;
-    }
-    instanceCount++;
+    // One at a time; `deinit` releases it, so an embedded server can be created again.
     if (appPtr != nullptr) {
         spdlog::error("Application instance is already created");
         return EC_FAILURE;
     }
-    appPtr = std::shared_ptr<Application>(new Application(sigStop, address, port, threads));
+    appPtr = std::shared_ptr<Application>(new Application(sigStop, address, port, threads, config));
     return EC_SUCCESS;
 }
 
@@ -57,10 +62,50 @@ int Application::init() {
         return EC_FAILURE;
     }
     spdlog::info("Initializing Application at {}:{}", mAddress, mPort);
-    int result = mAlgoRunner.init(mThreads);
+    int result = mAlgoRunner.init(mThreads, mConfig);
     RETURN_IF_ERROR(ErrorType::DEFAULT, result, "Failed to initialize AlgoRunner");
+    if (mConfig.captureDir.empty() == false) {
+        result = mCapture.open(mConfig.captureDir, mConfig.captureFileBytes, mConfig.captureMaxFiles);
+        RETURN_IF_ERROR(ErrorType::DEFAULT, result, "Failed to start the request capture");
+    }
+    if (mConfig.frontend.transport == framing::Transport::INPROC) {
+        // The shared inproc context has no I/O thread, so there is nothing to pin.
+        const std::string bindAddress = inproc::address(mConfig.frontend.inprocName);
+        try {
+            mRouter = zmq::socket_t(inproc::context(), zmq::socket_type::router);
+            mRouter.bind(bindAddress);
+        } catch (const zmq::error_t& e) {
+            spdlog::error("Failed to bind ROUTER socket at {}: {} (errno={})", bindAddress, e.what(), e.num());
+            return EC_FAILURE;
+        }
+        spdlog::info("Embedded server listening on {}", bindAddress);
+        mInitialized.store(true);
+        return EC_SUCCESS;
+    }
+    if (framing::isStream(mConfig.frontend.transport)) {
+        // No ZeroMQ socket is created, so the context never starts its I/O thread.
+        result = mStream.init(mConfig.frontend, mAddress, mPort);
+        RETURN_IF_ERROR(ErrorType::DEFAULT, result, "Failed to start the stream frontend");
+        result = mStream.watch(mAlgoRunner.completionFd());
+        RETURN_IF_ERROR(ErrorType::DEFAULT, result, "Failed to watch for finished jobs");
+        mInitialized.store(true);
+        return EC_SUCCESS;
+    }
+    // The I/O thread starts with the first socket, so its CPUs must be set before that.
+    for (int cpu : mConfig.ioCpus) {
+#ifdef ZMQ_THREAD_AFFINITY_CPU_ADD
+        if (zmq_ctx_set(mCtx.handle(), ZMQ_THREAD_AFFINITY_CPU_ADD, cpu) != 0) {
+            spdlog::error("Cannot pin the ZeroMQ I/O thread to CPU {}: {}", cpu, zmq_strerror(zmq_errno()));
+            return EC_FAILURE;
+        }
+#else
+        spdlog::warn("io_cpus is ignored, this libzmq has no ZMQ_THREAD_AFFINITY_CPU_ADD");
+        break;
+#endif
+    }
     const std::string bindAddress = fmt::format("tcp://{}:{}", mAddress, mPort);
     try {
+        mRouter = zmq::socket_t(mCtx, zmq::socket_type::router);
         mRouter.bind(bindAddress);
     } catch (const zmq::error_t& e) {
         spdlog::error("Failed to bind ROUTER socket at {}: {} (errno={})", bindAddress, e.what(), e.num());
@@ -76,6 +121,13 @@ int Application::deinit() {
         spdlog::error("Application instance is not created");
         return EC_SUCCESS;
     }
+    const int result = shutdown();
+    // Last: this may destroy the instance, so nothing below may touch a member.
+    std::shared_ptr<Application> self = (appPtr.get() == this) ? std::move(appPtr) : nullptr;
+    return result;
+}
+
+int Application::shutdown() {
     if (mInitialized == false) {
         spdlog::error("Application is not initialized");
         return EC_FAILURE;
@@ -84,64 +136,228 @@ int Application::deinit() {
     int result = mAlgoRunner.deinit();
     RETURN_IF_ERROR(ErrorType::DEFAULT, result, "Failed to deinitialize AlgoRunner");
 
+    if (trace::enabled()) {
+        std::string path;
+        uint64_t events = 0;
+        result = dumpTrace(path, events);
+        PRINT_ERROR_NO_RET(ErrorType::DEFAULT, result, "Failed to write the trace on shutdown");
+    }
+
+    if (mCapture.enabled()) {
+        mCapture.close();
+        spdlog::info("Captured {} frames in {} file(s), dropped {}", mCapture.records(), mCapture.files(), mCapture.dropped());
+    }
+
     mInitialized.store(false);
+    if (mConfig.frontend.transport == framing::Transport::INPROC && mRouter.handle() != nullptr) {
+        // Closing releases the name asynchronously; unbinding frees it for the next embedded server now.
+        try {
+            mRouter.unbind(inproc::address(mConfig.frontend.inprocName));
+        } catch (const zmq::error_t& e) {
+            spdlog::warn("Cannot unbind the embedded endpoint: {}", e.what());
+        }
+    }
     mRouter.close();
+    mStream.close();
 
     spdlog::info("Deinitializing Application");
     return EC_SUCCESS;
 }
 
+/// @return The ticket or pattern set handle a response hands out, 0 for none; recorded for `ipc_replay`.
+static uint64_t issuedId(const ipc::EnvelopeResp& response) {
+    switch (response.resp_case()) {
+    case ipc::EnvelopeResp::kSubmit:
+        return response.submit().ticket().req_id();
+    case ipc::EnvelopeResp::kStream:
+        return response.stream().ticket().req_id();
+    case ipc::EnvelopeResp::kPatterns:
+        return response.patterns().handle();
+    default:
+        return 0;
+    }
+}
+
 static bool clientHasCapabilityFor(
     const ipc::SubmitRequest& sreq,
-    uint8_t clientCaps
+    const OpCaps& clientCaps
 ) {
-    uint8_t required = 0;
-
-    if (sreq.has_math()) {
-        switch (sreq.math().op()) {
-        case ipc::MATH_ADD: required = ExecFunFlags::ADD; break;
-        case ipc::MATH_SUB: required = ExecFunFlags::SUB; break;
-        case ipc::MATH_MUL: required = ExecFunFlags::MULT; break;
-        case ipc::MATH_DIV: required = ExecFunFlags::DIV;  break;
-        default: return false;
-        }
-    } else if (sreq.has_str()) {
-        switch (sreq.str().op()) {
-        case ipc::STR_CONCAT:     required = ExecFunFlags::CONCAT;     break;
-        case ipc::STR_FIND_START: required = ExecFunFlags::FIND_START; break;
-        default: return false;
-        }
-    } else {
+    switch (sreq.payload_case()) {
+    case ipc::SubmitRequest::kMath:    return clientCaps.has(opIdFor(sreq.math().op()));
+    case ipc::SubmitRequest::kStr:     return clientCaps.has(opIdFor(sreq.str().op()));
+    case ipc::SubmitRequest::kFindAny: return clientCaps.has(OP_FIND_ANY);
+    case ipc::SubmitRequest::kCall:    return clientCaps.has(sreq.call().op());
+    case ipc::SubmitRequest::kReduce:  return clientCaps.has(opIdFor(sreq.reduce().op()));
+    case ipc::SubmitRequest::kExpr:
+        // Every operator of the program needs its own capability; values need none.
+        for (const ipc::ExprNode& node : sreq.expr().nodes()) {
+            if ((node.has_math() && clientCaps.has(opIdFor(node.math())) == false) ||
+                (node.has_str() && clientCaps.has(opIdFor(node.str())) == false)) {
+                return false;
+            }
+        }
+        return true;
+    case ipc::SubmitRequest::PAYLOAD_NOT_SET:
+    default:
+        return false;
+    }
+}
+
+/// @brief Reads the client's capabilities: the legacy ExecFunFlags plus the wide bitmap.
+/// @return false if `exec_functions` has unknown bits, the bitmap is too wide, or no operation is allowed.
+static bool capsFromHandshake(
+    const ipc::FirstHandshake& handshake,
+    OpCaps& caps
+) {
+    const uint32_t flags = handshake.exec_functions();
+    if (flags > UINT8_MAX || (flags != 0 && verifyExecCaps(static_cast<uint8_t>(flags)) == false)) {
+        return false;
+    }
+    if (handshake.capabilities_size() > static_cast<int>(caps.words.size())) {
         return false;
     }
-    return (clientCaps & required) != 0;
+    caps.words[0] = flags;
+    for (int i = 0; i < handshake.capabilities_size(); ++i) {
+        caps.words[i] |= handshake.capabilities(i);
+    }
+    return caps.empty() == false;
+}
+
+bool Application::decodeRequest(
+    const ClientInfo& client,
+    const void* data,
+    const std::size_t size,
+    ipc::EnvelopeReq& request
+) const {
+    if (client.wireFormat == ipc::WIRE_COMPACT) {
+        return wire::decodeRequest(data, size, request);
+    }
+    return request.ParseFromArray(data, static_cast<int>(size));
+}
+
+bool Application::encodeResponse(
+    const ClientInfo& client,
+    const ipc::EnvelopeResp& response,
+    std::string& out
+) const {
+    if (client.wireFormat == ipc::WIRE_COMPACT) {
+        return wire::encodeResponse(response, out);
+    }
+    return response.SerializeToString(&out);
+}
+
+int Application::dumpTrace(
+    std::string& path,
+    uint64_t& events
+) const {
+    static std::atomic<uint32_t> sequence{0};
+    path = fmt::format("{}/ipc-trace-{}-{}.json", mConfig.traceDir, static_cast<int>(getpid()), sequence.fetch_add(1));
+    return trace::dumpChromeTrace(path, events);
 }
 
 int Application::handleEnvelope(
     const ipc::EnvelopeReq& request,
-    const uint8_t clientExecCaps,
-    ipc::EnvelopeResp& response
-) const {
+    const ClientInfo& client,
+    ipc::EnvelopeResp& response,
+    uint64_t& waitId,
+    ipc::RequestTiming* timing
+) {
+    waitId = 0;
+    const OpCaps& clientCaps = client.caps;
     switch (request.req_case()) {
     case ipc::EnvelopeReq::kSubmit: {
         const ipc::SubmitRequest& sreq = request.submit();
-        bool capValid = clientHasCapabilityFor(sreq, clientExecCaps);
+        bool capValid = false;
+        {
+            IPC_TRACE_SCOPE("capability_check");
+            capValid = clientHasCapabilityFor(sreq, clientCaps);
+        }
         if (capValid == false) {
             response.mutable_submit()->set_status(ipc::ST_ERROR_INVALID_INPUT);
             return EC_SUCCESS;
         }
         ipc::SubmitResponse sresp;
-        int result = mAlgoRunner.run(sreq, sresp);
+        int result = mAlgoRunner.run(sreq, sresp, client.flow, &waitId, timing);
         *response.mutable_submit() = std::move(sresp);
         return result;
     }
     case ipc::EnvelopeReq::kGet: {
         const ipc::GetRequest& greq = request.get();
         ipc::GetResponse gresp;
-        int result = mAlgoRunner.get(greq, gresp);
+        int result = mAlgoRunner.get(greq, gresp, timing);
         *response.mutable_get() = std::move(gresp);
         return result;
     }
+    case ipc::EnvelopeReq::kGetMany: {
+        ipc::GetManyResponse gresp;
+        int result = mAlgoRunner.getMany(request.get_many(), gresp, waitId);
+        *response.mutable_get_many() = std::move(gresp);
+        return result;
+    }
+    case ipc::EnvelopeReq::kStream: {
+        if (clientCaps.has(OP_FIND_START) == false) {
+            response.mutable_stream()->set_status(ipc::ST_ERROR_INVALID_INPUT);
+            return EC_SUCCESS;
+        }
+        ipc::StreamResponse stresp;
+        int result = mAlgoRunner.stream(request.stream(), stresp, client.flow);
+        *response.mutable_stream() = std::move(stresp);
+        return result;
+    }
+    case ipc::EnvelopeReq::kPatterns: {
+        if (clientCaps.has(OP_FIND_ANY) == false) {
+            response.mutable_patterns()->set_status(ipc::ST_ERROR_INVALID_INPUT);
+            return EC_SUCCESS;
+        }
+        ipc::RegisterPatternsResponse presp;
+        int result = mAlgoRunner.registerPatterns(request.patterns(), presp, &waitId);
+        *response.mutable_patterns() = std::move(presp);
+        return result;
+    }
+    case ipc::EnvelopeReq::kStats: {
+        ipc::StatsResponse statsResp;
+        int result = mAlgoRunner.stats(request.stats(), statsResp);
+        statsResp.set_clients(static_cast<uint32_t>(mClients.size()));
+        ipc::BusyPollStats* poll = statsResp.mutable_router_poll();
+        poll->set_budget_us(mConfig.busyPollUs);
+        poll->set_hits(mPollCounters.hits - mPollBaseline.hits);
+        poll->set_misses(mPollCounters.misses - mPollBaseline.misses);
+        poll->set_spin_ns(mPollCounters.spinNs - mPollBaseline.spinNs);
+        if (request.stats().reset()) {
+            mPollBaseline = mPollCounters;
+        }
+        *response.mutable_stats() = std::move(statsResp);
+        return result;
+    }
+    case ipc::EnvelopeReq::kTraceDump: {
+        ipc::TraceDumpResponse* dump = response.mutable_trace_dump();
+        if (trace::enabled() == false) {
+            dump->set_status(ipc::ST_ERROR_INVALID_INPUT);
+            return EC_SUCCESS;
+        }
+        std::string path;
+        uint64_t events = 0;
+        if (dumpTrace(path, events) != EC_SUCCESS) {
+            dump->set_status(ipc::ST_ERROR_INTERNAL);
+            return EC_SUCCESS;
+        }
+        dump->set_status(ipc::ST_SUCCESS);
+        dump->set_path(path);
+        dump->set_events(events);
+        return EC_SUCCESS;
+    }
+    case ipc::EnvelopeReq::kSlowLog: {
+        ipc::SlowLogResponse slowResp;
+        int result = mAlgoRunner.slowLog(slowResp);
+        *response.mutable_slow_log() = std::move(slowResp);
+        return result;
+    }
+    case ipc::EnvelopeReq::kListOps: {
+        ipc::ListOpsResponse opsResp;
+        int result = mAlgoRunner.listOps(opsResp);
+        *response.mutable_list_ops() = std::move(opsResp);
+        return result;
+    }
     case ipc::EnvelopeReq::REQ_NOT_SET:
     default:
         response.mutable_get()->set_status(ipc::ST_ERROR_INVALID_INPUT);
@@ -149,76 +365,294 @@ int Application::handleEnvelope(
     }
 }
 
+bool Application::processFrame(
+    const std::string& clientId,
+    const void* data,
+    const std::size_t size,
+    std::string& reply
+) {
+    auto badResponse = [&] (const ClientInfo& client) {
+        ipc::EnvelopeResp err;
+        err.mutable_get()->set_status(ipc::ST_ERROR_INVALID_INPUT);
+        return encodeResponse(client, err, reply);
+    };
+    auto clientIt = mClients.find(clientId);
+    if (clientIt == mClients.end()) {
+        spdlog::info("New client connected: {}", clientId);
+        ipc::FirstHandshake handshake;
+        if (handshake.ParseFromArray(data, static_cast<int>(size)) == false) {
+            spdlog::error("Bad FirstHandshake from client {}", clientId);
+            return badResponse(ClientInfo{});
+        }
+        ClientInfo client;
+        bool capsOk = capsFromHandshake(handshake, client.caps);
+        bool replied = false;
+        if (capsOk == false) {
+            replied = badResponse(client);
+        }
+        if (ipc::WireFormat_IsValid(handshake.wire_format())) {
+            client.wireFormat = handshake.wire_format();
+        }
+        spdlog::info("Client {} uses {} wire format", clientId, ipc::WireFormat_Name(client.wireFormat));
+        if (mCapture.enabled()) {
+            mCapture.append(capture::RecordKind::HANDSHAKE, static_cast<uint64_t>(trace::nowNs()), clientId,
+                static_cast<uint8_t>(client.wireFormat), data, size);
+        }
+        client.flow = mAlgoRunner.openClient(handshake.client_name());
+        mClients[clientId] = client;
+        if (capsOk && framing::isStream(mConfig.frontend.transport)) {
+            mStream.admit(clientId);
+        }
+        return replied;
+    }
+    const ClientInfo& client = clientIt->second;
+    // Whether the request is traced is only known once it is decoded; reading the clock is cheap.
+    const int64_t arrivalNs = trace::nowNs();
+    capture::RecordHeader* captured = mCapture.enabled()
+        ? mCapture.append(capture::RecordKind::ENVELOPE, static_cast<uint64_t>(arrivalNs), clientId,
+            static_cast<uint8_t>(client.wireFormat), data, size)
+        : nullptr;
+
+    google::protobuf::ArenaOptions arenaOptions;
+    arenaOptions.initial_block = mArenaScratch;
+    arenaOptions.initial_block_size = sizeof(mArenaScratch);
+    google::protobuf::Arena arena(arenaOptions);
+    ipc::EnvelopeReq* request = google::protobuf::Arena::CreateMessage<ipc::EnvelopeReq>(&arena);
+    bool decoded = false;
+    {
+        IPC_TRACE_SCOPE("parse");
+        decoded = decodeRequest(client, data, size, *request);
+    }
+    if (decoded == false) {
+        IPC_LOG_RATE_LIMITED(1000, spdlog::level::err, "Bad EnvelopeReq from client {}", clientId);
+        return badResponse(client);
+    }
+    ipc::EnvelopeResp* envelopeResp = google::protobuf::Arena::CreateMessage<ipc::EnvelopeResp>(&arena);
+    ipc::RequestTiming* timing = nullptr;
+    if (request->trace()) {
+        timing = envelopeResp->mutable_timing();
+        timing->set_recv_ns(static_cast<uint64_t>(arrivalNs));
+        timing->set_dispatch_ns(static_cast<uint64_t>(trace::nowNs()));
+    }
+    envelopeResp->set_correlation_id(request->correlation_id());
+    uint64_t waitId = 0;
+    int result = handleEnvelope(*request, client, *envelopeResp, waitId, timing);
+    PRINT_ERROR_NO_RET(ErrorType::DEFAULT, result, "Failed to handle EnvelopeReq");
+    if (captured != nullptr && waitId == 0) {
+        const int64_t serviceUs = (trace::nowNs() - arrivalNs) / 1000;
+        captured->serviceUs = static_cast<uint32_t>(std::min<int64_t>(serviceUs, capture::kServiceDeferred - 1));
+        captured->issuedId = issuedId(*envelopeResp);
+    }
+    if (waitId != 0) {
+        ParkedReply parked{clientId};
+        parked.correlationId = request->correlation_id();
+        if (timing != nullptr) {
+            parked.recvNs = static_cast<int64_t>(timing->recv_ns());
+            parked.dispatchNs = static_cast<int64_t>(timing->dispatch_ns());
+        }
+        mWaitClients.emplace(waitId, std::move(parked));
+        return false;
+    }
+    if (timing != nullptr) {
+        timing->set_send_ns(static_cast<uint64_t>(trace::nowNs()));
+    }
+    bool encoded = false;
+    {
+        IPC_TRACE_SCOPE("serialize");
+        encoded = encodeResponse(client, *envelopeResp, reply);
+    }
+    if (encoded == false) {
+        spdlog::error("Failed to serialize response for client {}", clientId);
+        return false;
+    }
+    return true;
+}
+
 int Application::run() {
     if (mInitialized == false) {
         spdlog::error("Application is not initialized");
         return EC_FAILURE;
     }
     spdlog::info("Server running at {}", mAddress);
+    IPC_TRACE_THREAD_NAME("router");
+    const affinity::Placement placement{mConfig.routerCpus, mConfig.numaNode, mConfig.routerFifoPriority};
+    int result = affinity::applyToCurrentThread(placement, "router");
+    RETURN_IF_ERROR(ErrorType::DEFAULT, result, "Failed to place the router thread");
+    const int64_t busyPollNs = static_cast<int64_t>(mConfig.busyPollUs) * 1000;
+    if (busyPollNs > 0) {
+        spdlog::info("Router busy-polls for {} us before blocking", mConfig.busyPollUs);
+        if (mConfig.routerCpus.empty()) {
+            spdlog::warn("busy_poll_us without router_cpus: the spinning router shares its cores with other threads");
+        }
+    }
+    if (framing::isStream(mConfig.frontend.transport) == false) {
+        return runRouter(busyPollNs);
+    }
+    return mStream.run(mSigStop, busyPollNs, mPollCounters,
+        [this] (const std::string& clientId, const char* data, std::size_t size, std::string& reply) {
+            return processFrame(clientId, data, size, reply);
+        },
+        [this] (const std::string& clientId) {
+            spdlog::info("Client disconnected: {}", clientId);
+            auto it = mClients.find(clientId);
+            if (it != mClients.end()) {
+                mAlgoRunner.closeClient(it->second.flow);
+                mClients.erase(it);
+            }
+        },
+        [this] () {
+            pollSlowLogDump();
+            return flushWaits();
+        });
+}
+
+int Application::flushWaits() {
+    if (mWaitClients.empty()) {
+        return -1;
+    }
+    mReadyWaits.clear();
+    const int timeoutMs = mAlgoRunner.collectWaits(mReadyWaits);
+    for (auto& [waitId, waitResp] : mReadyWaits) {
+        auto waitIt = mWaitClients.find(waitId);
+        if (waitIt == mWaitClients.end()) {
+            continue;
+        }
+        const ParkedReply parked = std::move(waitIt->second);
+        const std::string& clientId = parked.clientId;
+        mWaitClients.erase(waitIt);
+        auto clientIt = mClients.find(clientId);
+        if (clientIt == mClients.end()) {
+            continue; // Disconnected while waiting; the results are gone with the request.
+        }
+        waitResp.set_correlation_id(parked.correlationId);
+        if (parked.recvNs != 0) {
+            ipc::RequestTiming* timing = waitResp.mutable_timing();
+            timing->set_recv_ns(static_cast<uint64_t>(parked.recvNs));
+            timing->set_dispatch_ns(static_cast<uint64_t>(parked.dispatchNs));
+            timing->set_send_ns(static_cast<uint64_t>(trace::nowNs()));
+        }
+        if (encodeResponse(clientIt->second, waitResp, mReply) == false) {
+            spdlog::error("Failed to serialize response for client {}", clientId);
+            continue;
+        }
+        if (sendReply(clientId, mReply) == false) {
+            IPC_LOG_RATE_LIMITED(1000, spdlog::level::warn, "Cannot send a parked response to client {}", clientId);
+        }
+    }
+    return timeoutMs;
+}
+
+bool Application::sendReply(
+    const std::string& clientId,
+    const std::string& reply
+) {
+    if (framing::isStream(mConfig.frontend.transport)) {
+        return mStream.sendTo(clientId, reply);
+    }
+    IPC_TRACE_SCOPE("send");
+    zmq::message_t routingId(clientId.data(), clientId.size());
+    zmq::message_t body(reply.data(), reply.size());
+    return mRouter.send(routingId, zmq::send_flags::sndmore).has_value() &&
+        mRouter.send(body, zmq::send_flags::none).has_value();
+}
+
+void Application::interrupt() {
+    switch (mConfig.frontend.transport) {
+    case framing::Transport::TCP:
+    case framing::Transport::UNIX:
+        mStream.interrupt();
+        break;
+    case framing::Transport::INPROC:
+        // The context is shared with the sessions of the process and outlives this server, so
+        // wake the router with an empty frame instead; it sees the stop flag and returns.
+        try {
+            zmq::socket_t waker(inproc::context(), zmq::socket_type::dealer);
+            waker.connect(inproc::address(mConfig.frontend.inprocName));
+            waker.send(zmq::message_t(), zmq::send_flags::none);
+        } catch (const zmq::error_t& e) {
+            spdlog::error("Cannot wake the embedded server: {}", e.what());
+        }
+        break;
+    case framing::Transport::ZMQ:
+    default:
+        mCtx.shutdown();
+        break;
+    }
+}
+
+void Application::requestSlowLogDump() noexcept {
+    slowLogDumpRequested.store(true, std::memory_order_relaxed);
+}
+
+void Application::pollSlowLogDump() {
+    if (slowLogDumpRequested.load(std::memory_order_relaxed) == false) {
+        return;
+    }
+    slowLogDumpRequested.store(false, std::memory_order_relaxed);
+    ipc::SlowLogResponse slow;
+    mAlgoRunner.slowLog(slow);
+    if (slow.status() != ipc::ST_SUCCESS) {
+        spdlog::info("Slow-request log is off, set slow_request_us to enable it");
+        return;
+    }
+    spdlog::info("Slow-request log: {} recorded, {} kept", slow.recorded(), slow.requests_size());
+    for (const ipc::SlowRequest& r : slow.requests()) {
+        spdlog::info("slow op={} status={} client={} bytes={} queue_depth={} worker={} queue_us={:.1f} "
+            "exec_us={:.1f} total_us={:.1f} at_ms={}", r.op(), ipc::Status_Name(r.status()), r.client(),
+            r.payload_bytes(), r.queue_depth(), r.worker(), r.queue_ns() / 1e3, r.exec_ns() / 1e3,
+            r.total_ns() / 1e3, r.at_ms());
+    }
+}
+
+int Application::runRouter(const int64_t busyPollNs) {
     int result = EC_SUCCESS;
     while (
         mInitialized.load(std::memory_order_relaxed) &&
         mSigStop.load(std::memory_order_relaxed) == false
     ) {
         try {
-            std::vector<zmq::message_t> recvMsgs;
-            zmq::recv_result_t zmqResult = zmq::recv_multipart(mRouter, std::back_inserter(recvMsgs));
-            if (zmqResult.has_value() == false) {
-                continue;
-            }
-            std::string clientId = recvMsgs[0].to_string();
-            std::string payload = recvMsgs.back().to_string();
-            auto sendBadResponse = [&] () {
-                ipc::EnvelopeResp err;
-                err.mutable_get()->set_status(ipc::ST_ERROR_INVALID_INPUT);
-                std::string buf; err.SerializeToString(&buf);
-                zmq::message_t reply(buf.size());
-                memcpy(reply.data(), buf.data(), buf.size());
-                zmq::send_result_t resultSend = mRouter.send(recvMsgs[0], zmq::send_flags::sndmore);
-                PRINT_ERROR_NO_RET(ErrorType::ZMQ_SEND, resultSend, "Failed to send error response to client");
-                resultSend = mRouter.send(reply, zmq::send_flags::none);
-                PRINT_ERROR_NO_RET(ErrorType::ZMQ_SEND, resultSend, "Failed to send error response to client");
-            };
-            if (mClientExecCaps.find(clientId) == mClientExecCaps.end()) {
-                spdlog::info("New client connected: {}", clientId);
-                ipc::FirstHandshake handshake;
-                if (handshake.ParseFromString(payload) == false) {
-                    spdlog::error("Bad FirstHandshake from client {}", clientId);
-                    sendBadResponse();
+            pollSlowLogDump();
+            const int waitMs = flushWaits();
+            if (mWaitClients.empty() == false) {
+                // Responses are parked: wake up for a request, a finished job or the next GetMany timeout.
+                zmq::pollitem_t items[] = {
+                    {mRouter.handle(), 0, ZMQ_POLLIN, 0},
+                    {nullptr, mAlgoRunner.completionFd(), ZMQ_POLLIN, 0}
+                };
+                zmq::poll(items, 2, std::chrono::milliseconds(waitMs));
+                if ((items[0].revents & ZMQ_POLLIN) == 0) {
                     continue;
                 }
-                // The cast can happen "automatically", but I want to show that we are casting from uint32 to uint8
-                uint8_t funcFlags = static_cast<uint8_t>(handshake.exec_functions());
-                bool capsOk = verifyExecCaps(funcFlags);
-                if (capsOk == false) {
-                    sendBadResponse();
-                }
-                mClientExecCaps[clientId] = funcFlags;
-                continue;
             }
-            ipc::EnvelopeReq request;
-            if (request.ParseFromString(payload) == false) {
-                spdlog::error("Bad EnvelopeReq from client {}", clientId);
-                sendBadResponse();
+            std::vector<zmq::message_t> recvMsgs;
+            zmq::recv_result_t zmqResult;
+            {
+                IPC_TRACE_SCOPE("recv");
+                zmqResult = busypoll::recvMultipart(mRouter, recvMsgs, busyPollNs, mPollCounters);
+            }
+            if (zmqResult.has_value() == false) {
                 continue;
             }
-            ipc::EnvelopeResp envelopeResp;
-            result = handleEnvelope(request, mClientExecCaps[clientId], envelopeResp);
-            PRINT_ERROR_NO_RET(ErrorType::DEFAULT, result, "Failed to handle EnvelopeReq");
-            std::string serializedResponse;
-            if (envelopeResp.SerializeToString(&serializedResponse) == false) {
-                spdlog::error("Failed to serialize response for client {}", clientId);
+            if (mSigStop.load(std::memory_order_relaxed)) {
+                break; // Woken by `interrupt`, or a request that arrived while stopping.
+            }
+            const std::string clientId = recvMsgs[0].to_string();
+            const zmq::message_t& payload = recvMsgs.back();
+            if (processFrame(clientId, payload.data(), payload.size(), mReply) == false) {
                 continue;
             }
-            zmq::message_t idFrame(clientId.data(), clientId.size());
-            zmq::message_t body(serializedResponse.data(), serializedResponse.size());
+            IPC_TRACE_SCOPE("send");
+            zmq::message_t body(mReply.data(), mReply.size());
 
-            zmq::send_result_t bytesSend = mRouter.send(idFrame, zmq::send_flags::sndmore);
+            zmq::send_result_t bytesSend = mRouter.send(recvMsgs[0], zmq::send_flags::sndmore);
             RETURN_IF_ERROR(ErrorType::ZMQ_SEND, bytesSend, "Failed to send response to client");
 
             bytesSend = mRouter.send(body, zmq::send_flags::none);
             RETURN_IF_ERROR(ErrorType::ZMQ_SEND, bytesSend, "Failed to send response to client");
         } catch (const zmq::error_t& e) {
+            if (e.num() == EINTR && mSigStop.load(std::memory_order_relaxed) == false) {
+                continue; // A signal that does not stop the server, such as the slow-log dump.
+            }
             if (e.num() == EINTR || e.num() == ETERM) {
                 spdlog::info("ROUTER interrupted (errno={}), shutting down", e.num());
                 break;
@@ -237,13 +671,13 @@ int Application::run() {
             break;
         }
     }
-    return EC_SUCCESS;
+    return result;
 }
 
 Application::~Application() {
     if (mInitialized == true) {
         spdlog::warn("Application is being deinitialized in destructor");
-        int result = deinit();
+        int result = shutdown();
         PRINT_ERROR_NO_RET(ErrorType::DEFAULT, result, "Failed to deinitialize Application in destructor");
     }
 }
@@ -3,6 +3,11 @@
 #include "zmq.hpp"
 #include <vector>
 #include "algorithm_runner.h" // The header for the AlgoRunner, which performs computational tasks.
+#include "config.h"
+#include "busy_poll.h"
+#include "stream_frontend.h"
+#include "op_registry.h"
+#include "capture_log.h"
 
 namespace server {
     /// @brief A singleton class representing the server application.
@@ -11,20 +16,98 @@ namespace server {
     /// running the main message loop, and deinitialization.
     struct Application {
     private:
+        /// @brief Per-connection state recorded from the client's FirstHandshake.
+        struct ClientInfo {
+            OpCaps caps;                                   ///< Operations the client may call.
+            ipc::WireFormat wireFormat = ipc::WIRE_PROTOBUF; ///< Encoding of every frame after the handshake.
+            uint64_t flow = 0;                             ///< The client's fair-queueing flow in the AlgoRunner.
+        };
+
+        /// @brief A response that `flushWaits` sends once it is ready.
+        struct ParkedReply {
+            std::string clientId;
+            int64_t recvNs = 0;     ///< RequestTiming stages taken on the router, both 0 unless traced.
+            int64_t dispatchNs = 0;
+            uint64_t correlationId = 0; ///< Echoed in the response, see EnvelopeReq.correlation_id.
+        };
+
+        /// @brief Decodes a request frame according to the client's negotiated wire format.
+        /// @return true if the frame was decoded into `request`.
+        bool decodeRequest(
+            const ClientInfo& client,
+            const void* data,
+            const std::size_t size,
+            ipc::EnvelopeReq& request
+        ) const;
+
+        /// @brief Encodes a response according to the client's negotiated wire format.
+        /// @return true if the response was encoded into `out`.
+        bool encodeResponse(
+            const ClientInfo& client,
+            const ipc::EnvelopeResp& response,
+            std::string& out
+        ) const;
+
+        /// @brief Writes the PROFILE_APPLICATION probes to a new file in the configured trace directory.
+        /// @param path Receives the path of the written file.
+        /// @param events Receives the number of spans written.
+        /// @return An error code, 0 for success.
+        int dumpTrace(
+            std::string& path,
+            uint64_t& events
+        ) const;
+
         /// @brief Handles an incoming client request encapsulated in an Envelope.
         ///
         /// This method is responsible for routing the request to the appropriate
         /// handler (e.g., AlgoRunner) and preparing the response. It also
         /// checks if the client has the necessary execution capabilities.
         /// @param request The incoming request message.
-        /// @param clientExecCaps A bitmask of the client's execution capabilities.
+        /// @param client The sender: the operations it may call and its queue flow.
         /// @param response The outgoing response message.
+        /// @param waitId Set if the request was parked (a waiting GetMany or an offloaded BLOCKING submit);
+        /// the response is sent by `flushWaits`.
+        /// @param timing The stages of a traced request the runner fills in, nullptr if not traced.
         /// @return An error code, 0 for success.
         int handleEnvelope(
             const ipc::EnvelopeReq& request,
-            const uint8_t clientExecCaps,
-            ipc::EnvelopeResp& response
-        ) const;
+            const ClientInfo& client,
+            ipc::EnvelopeResp& response,
+            uint64_t& waitId,
+            ipc::RequestTiming* timing
+        );
+
+        /// @brief Sends the parked responses that are ready.
+        /// @return How long the receive loop may block in ms, -1 for no limit. While `mWaitClients` is
+        /// not empty the loop must also wake up for the AlgoRunner's completion fd.
+        int flushWaits();
+
+        /// @brief Sends a reply outside the request it answers, on whichever frontend is in use.
+        /// @return true if it was handed to the transport.
+        bool sendReply(
+            const std::string& clientId,
+            const std::string& reply
+        );
+
+        /// @brief Handles one frame of a client, independent of the transport it came in on.
+        ///
+        /// The first frame of an unknown client is its FirstHandshake, every later one an EnvelopeReq.
+        /// @param clientId The ROUTER routing id or the stream frontend's connection id.
+        /// @param reply Receives the encoded response.
+        /// @return true if `reply` should be sent back.
+        bool processFrame(
+            const std::string& clientId,
+            const void* data,
+            const std::size_t size,
+            std::string& reply
+        );
+
+        /// @brief Writes the slow-request log to the server log if `requestSlowLogDump` was called since.
+        void pollSlowLogDump();
+
+        /// @brief The ZMQ ROUTER receive loop of `run`.
+        /// @return An error code, 0 for success.
+        int runRouter(const int64_t busyPollNs);
 
         /// @brief Private constructor to enforce the singleton pattern.
         ///
@@ -34,7 +117,8 @@ namespace server {
             const std::atomic<bool>& sigStop,
             const char* address,
             const int port,
-            const int theads
+            const int theads,
+            const Config& config
         ) noexcept;
 
         // Disabling copy constructor and assignment operator to enforce singleton.
@@ -54,15 +138,17 @@ namespace server {
         /// @param address The network address to bind to.
         /// @param port The port number to bind to.
         /// @param threads The number of threads for the algorithm runner's pool.
+        /// @param config Additional tunables, see `serverSetOption`.
         /// @return An error code, 0 for success.
         static int create(
             const std::atomic<bool>& sigStop,
             const char* address,
             const int port,
-            const int threads
+            const int threads,
+            const Config& config
         ) noexcept;
 
-        /// @brief Initializes the server, including its ZeroMQ socket and algorithm runner. In this case the Socket is a ROUTER.
+        /// @brief Initializes the server, including its frontend (the ROUTER socket or the stream listener) and algorithm runner.
         /// @return An error code, 0 for success.
         int init();
 
@@ -73,7 +159,21 @@ namespace server {
         /// @return An error code, 0 for success.
         int run();
 
-        /// @brief Deinitializes the server, closing the socket and cleaning up resources.
+        /// @brief Makes `run` on another thread return, for a server embedded with `serverStart`.
+        ///
+        /// Set the stop flag first. A zmq frontend is woken by shutting its own context down, an
+        /// inproc one by a frame to its ROUTER, since the inproc context is shared with the
+        /// sessions of the process and must stay usable for the next embedded server.
+        void interrupt();
+
+        /// @brief Asks the router to write the slow-request log to the server log; async-signal-safe.
+        ///
+        /// The router does so before it waits for the next request. A signal that interrupts its
+        /// receive makes that happen right away.
+        static void requestSlowLogDump() noexcept;
+
+        /// @brief Deinitializes the server, closing the socket and cleaning up resources, and
+        /// releases the instance, so `create` can make a new one. References from `get` are invalid afterwards.
         /// @return An error code, 0 for success.
         int deinit();
 
@@ -81,14 +181,26 @@ namespace server {
         ~Application();
 
     private:
+        /// @brief `deinit` without releasing the instance, also run by the destructor.
+        int shutdown();
+
         zmq::context_t mCtx{1};                     ///< The ZeroMQ context for the application.
-        zmq::socket_t mRouter{mCtx, zmq::socket_type::router}; ///< The main ZeroMQ ROUTER socket for IPC.
-        std::unordered_map<std::string, uint8_t> mClientExecCaps; ///< Stores client capabilities indexed by client ID.
+        zmq::socket_t mRouter;                      ///< The main ZeroMQ ROUTER socket, created in `init` after the context options.
+        StreamFrontend mStream;                     ///< Replaces the ROUTER when `Config::frontend` is tcp or unix.
+        CaptureLog mCapture;                        ///< Records received frames when `Config::captureDir` is set.
+        std::unordered_map<std::string, ClientInfo> mClients; ///< Stores client capabilities and wire format indexed by client ID.
         AlgoRunner mAlgoRunner;                     ///< The component for running computational algorithms.
         const char* mAddress;                       ///< The network address the server is bound to.
         const int mPort;                            ///< The port number the server is bound to.
         const int mThreads;                         ///< The number of threads for the AlgoRunner.
+        const Config mConfig;                       ///< Additional tunables, see `serverSetOption`.
         const std::atomic<bool>& mSigStop;          ///< Reference to the external stop signal flag.
         std::atomic<bool> mInitialized{false};      ///< A flag to track the initialization state of the application.
+        busypoll::Counters mPollCounters;           ///< Receive spinning, only touched by the router thread.
+        busypoll::Counters mPollBaseline;           ///< Counters at the last `stats reset`.
+        std::string mReply;                         ///< Encoded ROUTER response, reused so steady-state replies do not allocate.
+        std::unordered_map<uint64_t, ParkedReply> mWaitClients; ///< Client of each parked response, by wait id.
+        std::vector<std::pair<uint64_t, ipc::EnvelopeResp>> mReadyWaits; ///< Scratch of `flushWaits`.
+        alignas(8) char mArenaScratch[4096];        ///< Initial arena block, so decoding a typical request does not touch the heap.
     };
 } // namespace server
\ No newline at end of file
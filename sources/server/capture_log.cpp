@@ -0,0 +1,138 @@
+#include "capture_log.h"
+#include "error_handling.h"
+#include <spdlog/spdlog.h>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace server {
+
+CaptureLog::~CaptureLog() {
+    close();
+}
+
+int CaptureLog::open(const std::string& dir, const std::size_t fileBytes, const uint32_t maxFiles) {
+    if (fileBytes < sizeof(capture::FileHeader) + sizeof(capture::RecordHeader)) {
+        spdlog::error("Capture files of {} bytes are too small", fileBytes);
+        return EC_FAILURE;
+    }
+    if (maxFiles == 0) {
+        spdlog::error("A capture needs at least one file");
+        return EC_FAILURE;
+    }
+    close();
+    mDir = dir;
+    mFileBytes = fileBytes;
+    mMaxFiles = maxFiles;
+    mStartS = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::seconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count());
+    mSequence = 0;
+    mFailed = false;
+    const int result = openNext();
+    mEnabled = result == EC_SUCCESS;
+    return result;
+}
+
+int CaptureLog::openNext() {
+    if (mSequence >= mMaxFiles) {
+        spdlog::warn("Capture stopped after {} files of {} bytes", mSequence, mFileBytes);
+        return EC_FAILURE;
+    }
+    char name[64];
+    std::snprintf(name, sizeof(name), "capture-%010llu-%06llu%s",
+        static_cast<unsigned long long>(mStartS), static_cast<unsigned long long>(mSequence), capture::kExtension);
+    const std::string path = mDir + "/" + name;
+    const int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        spdlog::error("Cannot create capture file {}: {}", path, std::strerror(errno));
+        return EC_FAILURE;
+    }
+    // The blocks are reserved so a full disk fails here rather than with SIGBUS on a later
+    // store; they read as zeros, which is what marks the end of the records if the server dies.
+    const int rc = posix_fallocate(fd, 0, static_cast<off_t>(mFileBytes));
+    if (rc != 0) {
+        spdlog::error("Cannot reserve {} bytes for capture file {}: {}", mFileBytes, path, std::strerror(rc));
+        ::close(fd);
+        unlink(path.c_str());
+        return EC_FAILURE;
+    }
+    void* mapped = mmap(nullptr, mFileBytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (mapped == MAP_FAILED) {
+        spdlog::error("Cannot map capture file {}: {}", path, std::strerror(errno));
+        ::close(fd);
+        unlink(path.c_str());
+        return EC_FAILURE;
+    }
+    mFd = fd;
+    mBase = static_cast<char*>(mapped);
+    capture::FileHeader header{};
+    std::memcpy(header.magic, capture::kMagic, sizeof(header.magic));
+    header.sequence = mSequence;
+    std::memcpy(mBase, &header, sizeof(header));
+    mUsed = sizeof(header);
+    ++mSequence;
+    spdlog::info("Capturing requests to {}", path);
+    return EC_SUCCESS;
+}
+
+capture::RecordHeader* CaptureLog::append(
+    const capture::RecordKind kind,
+    const uint64_t arrivalNs,
+    const std::string& clientId,
+    const uint8_t wireFormat,
+    const void* data,
+    const std::size_t size
+) {
+    if (mBase == nullptr) {
+        mDropped += mFailed ? 1 : 0;
+        return nullptr;
+    }
+    const std::size_t bytes = capture::recordBytes(clientId.size(), size);
+    if (clientId.size() > UINT16_MAX || bytes > mFileBytes - sizeof(capture::FileHeader)) {
+        ++mDropped;
+        return nullptr;
+    }
+    if (mUsed + bytes > mFileBytes) {
+        close();
+        if (mFailed || openNext() != EC_SUCCESS) {
+            mFailed = true;
+            ++mDropped;
+            return nullptr;
+        }
+    }
+    char* at = mBase + mUsed;
+    capture::RecordHeader header{};
+    header.arrivalNs = arrivalNs;
+    header.serviceUs = capture::kServiceDeferred;
+    header.payloadSize = static_cast<uint32_t>(size);
+    header.clientIdSize = static_cast<uint16_t>(clientId.size());
+    header.kind = static_cast<uint8_t>(kind);
+    header.wireFormat = wireFormat;
+    std::memcpy(at + sizeof(header), clientId.data(), clientId.size());
+    std::memcpy(at + sizeof(header) + clientId.size(), data, size);
+    // The header goes in last: a non-zero arrivalNs is what makes the record visible to a reader.
+    std::memcpy(at, &header, sizeof(header));
+    mUsed += bytes;
+    ++mRecords;
+    return reinterpret_cast<capture::RecordHeader*>(at);
+}
+
+void CaptureLog::close() {
+    if (mBase == nullptr) {
+        return;
+    }
+    munmap(mBase, mFileBytes);
+    if (ftruncate(mFd, static_cast<off_t>(mUsed)) != 0) {
+        spdlog::warn("Cannot trim capture file: {}", std::strerror(errno));
+    }
+    ::close(mFd);
+    mBase = nullptr;
+    mFd = -1;
+    mUsed = 0;
+}
+
+} // namespace server
@@ -0,0 +1,74 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include "capture_file.h"
+
+namespace server {
+
+    /// @brief Append-only, memory-mapped log of the frames the router receives, read back by `ipc_replay`.
+    ///
+    /// Each file is preallocated to `fileBytes` and mapped once, so recording a frame is a bounds
+    /// check and two copies into the mapping with no system call; the kernel writes the pages back.
+    /// When a record does not fit, the file is truncated to its used size and the next one is opened;
+    /// after `maxFiles` files the capture stops and further frames are counted as dropped, so a
+    /// forgotten capture cannot fill the disk. Only the router thread may use it.
+    struct CaptureLog {
+        CaptureLog() = default;
+        CaptureLog(const CaptureLog&) = delete;
+        CaptureLog& operator=(const CaptureLog&) = delete;
+
+        /// @brief Closes the current file.
+        ~CaptureLog();
+
+        /// @brief Creates the first file in `dir`, which must exist.
+        /// @param fileBytes Size of every file; larger records are dropped.
+        /// @param maxFiles Files written before the capture stops.
+        /// @return An error code, 0 for success.
+        int open(const std::string& dir, const std::size_t fileBytes, const uint32_t maxFiles);
+
+        /// @return true between a successful `open` and `close`.
+        bool active() const { return mBase != nullptr; }
+
+        /// @return true once `open` succeeded, also after the capture stopped: `append` must still
+        /// be called then, so the frames it can no longer record are counted as dropped.
+        bool enabled() const { return mEnabled; }
+
+        /// @brief Appends one frame.
+        /// @return The record's header, valid until the next `append`, so the caller can fill in
+        /// `serviceUs` and `issuedId` once the reply is known; nullptr if the frame was dropped.
+        capture::RecordHeader* append(
+            const capture::RecordKind kind,
+            const uint64_t arrivalNs,
+            const std::string& clientId,
+            const uint8_t wireFormat,
+            const void* data,
+            const std::size_t size
+        );
+
+        /// @brief Truncates the current file to its records and unmaps it.
+        void close();
+
+        uint64_t records() const { return mRecords; }
+        uint64_t dropped() const { return mDropped; }
+        uint64_t files() const { return mSequence; }
+
+    private:
+        /// @brief Maps the next file of the capture.
+        int openNext();
+
+        std::string mDir;
+        std::size_t mFileBytes = 0;
+        uint32_t mMaxFiles = 0;
+        uint64_t mStartS = 0;        ///< Wall-clock start, part of every file name.
+        uint64_t mSequence = 0;      ///< Files opened so far.
+        int mFd = -1;
+        char* mBase = nullptr;       ///< Mapping of the current file.
+        std::size_t mUsed = 0;       ///< Bytes written to the current file, header included.
+        uint64_t mRecords = 0;
+        uint64_t mDropped = 0;
+        bool mEnabled = false;
+        bool mFailed = false;        ///< A rotation failed or hit `mMaxFiles`; stop recording instead of retrying per frame.
+    };
+
+} // namespace server
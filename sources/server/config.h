@@ -0,0 +1,60 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "framing.h"
+
+namespace server {
+
+    /// @brief Token bucket of one client: `perSecond` submits on average, up to `burst` at once.
+    struct ClientRate {
+        double perSecond = 0;
+        double burst = 0;
+    };
+
+    /// @brief Kinds of submit that get a worker pool of their own when `Config::classThreads` is set.
+    enum class OpClass : uint8_t {
+        MATH = 0, ///< MathArgs and expressions: short, fixed-cost jobs.
+        STRING,   ///< StrArgs and FIND_ANY searches, whose cost grows with the input.
+        BULK,     ///< ReduceArgs and plugin calls, which may run long or split across workers.
+        COUNT
+    };
+
+    /// @brief Server tunables that are not part of the `serverInitialize` signature.
+    ///
+    /// They are collected through `serverSetOption` before `serverInitialize` and
+    /// handed to the Application and its components when they are created.
+    struct Config {
+        std::size_t patternCacheBytes = 64u * 1024u * 1024u; ///< Memory budget for compiled FIND_ANY pattern sets.
+        std::string traceDir = ".";                          ///< Where PROFILE_APPLICATION trace dumps are written.
+        int minThreads = 0;                                  ///< Smallest worker pool; 0 keeps the pool fixed at `threads`.
+        uint32_t poolGrowWaitUs = 500;                       ///< Grow when the oldest queued job waited this long...
+        uint32_t poolGrowDepth = 8;                          ///< ...or when this many jobs are queued.
+        uint32_t poolIdleMs = 5000;                          ///< Idle time after which a worker above the minimum exits.
+        std::vector<int> routerCpus;                         ///< CPUs for the ROUTER loop; empty leaves it to the scheduler.
+        std::vector<int> workerCpus;                         ///< CPUs shared by the AlgoRunner workers.
+        std::vector<int> ioCpus;                             ///< CPUs for the ZeroMQ I/O thread.
+        int routerFifoPriority = 0;                          ///< SCHED_FIFO priority of the router thread, 0 keeps SCHED_OTHER.
+        uint32_t busyPollUs = 0;                             ///< Spin on non-blocking receives this long before blocking; 0 disables.
+        int numaNode = -1;                                   ///< Node the router and workers allocate on, and run on unless their CPUs are set; -1 disables.
+        framing::Endpoint frontend;                          ///< ZMQ ROUTER (default), or the epoll stream frontend on TCP or a Unix socket.
+        std::vector<std::string> opPlugins;                  ///< Shared objects adding operations to the registry, see includes/ipc_ops.h.
+        std::size_t reduceParallelMin = 256u * 1024u;        ///< ReduceArgs arrays this long are split across the workers; 0 disables.
+        std::unordered_map<std::string, uint32_t> clientWeights;  ///< Queue weight by client name, "*" for the rest; default 1.
+        std::unordered_map<std::string, ClientRate> clientRates;  ///< Submit rate limit by client name, "*" for the rest; default none.
+        uint64_t inlineMaxCost = 0;                          ///< NONBLOCKING submits up to this cost run inline and return their result; 0 queues all.
+        uint64_t offloadMinCost = 64u * 1024u;               ///< BLOCKING submits from this cost on run on a worker with a deferred reply; 0 runs all inline.
+        std::string captureDir;                              ///< Where received frames are recorded for `ipc_replay`; empty disables.
+        std::size_t captureFileBytes = 64u * 1024u * 1024u;  ///< Size of each capture file before the next one is started.
+        uint32_t captureMaxFiles = 16;                       ///< Capture files written before recording stops.
+        uint32_t classThreads[static_cast<int>(OpClass::COUNT)] = {}; ///< Maximum workers of each class's own pool, 0 for `threads`; all 0 shares one pool.
+        std::unordered_map<std::string, uint32_t> slowRequestUs;  ///< Slow-request threshold by op name (see `statsOpName`), "*" for the rest; empty disables.
+        std::size_t slowLogSize = 256;                       ///< Slow requests kept, the oldest are overwritten.
+        std::string spillDir;                                ///< Where results unfetched for `spillAfterMs` are moved out of memory; empty disables.
+        std::size_t spillFileBytes = 256u * 1024u * 1024u;   ///< Size of the spill file; results that do not fit stay in memory.
+        uint32_t spillAfterMs = 1000;                        ///< Age of a finished, unfetched result before it is spilled.
+    };
+
+} // namespace server
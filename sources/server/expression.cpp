@@ -0,0 +1,191 @@
+#include "expression.h"
+#include "trace.h"
+#include <vector>
+
+using namespace server;
+
+namespace {
+    /// Static type of a stack slot. POSITION is an int that came from FIND_START.
+    enum class ValueType : uint8_t { INT, POSITION, STR };
+
+    /// Stacks kept per worker thread so evaluation reuses their capacity, strings included.
+    struct ExprStacks {
+        std::vector<ValueType> types;
+        std::vector<int32_t> ints;
+        std::vector<std::string> strs;
+        std::size_t strTop = 0;
+
+        std::string& pushStr() {
+            if (strTop == strs.size()) {
+                strs.emplace_back();
+            }
+            return strs[strTop++];
+        }
+    };
+}
+
+ipc::Status server::applyMath(
+    const ipc::MathOp op,
+    const int32_t a,
+    const int32_t b,
+    int32_t& out
+) {
+    // Unsigned arithmetic wraps instead of overflowing.
+    const uint32_t ua = static_cast<uint32_t>(a);
+    const uint32_t ub = static_cast<uint32_t>(b);
+    switch (op) {
+    case ipc::MATH_ADD:
+        out = static_cast<int32_t>(ua + ub);
+        return ipc::ST_SUCCESS;
+    case ipc::MATH_SUB:
+        out = static_cast<int32_t>(ua - ub);
+        return ipc::ST_SUCCESS;
+    case ipc::MATH_MUL:
+        out = static_cast<int32_t>(ua * ub);
+        return ipc::ST_SUCCESS;
+    case ipc::MATH_DIV:
+        if (b == 0) {
+            return ipc::ST_ERROR_DIV_BY_ZERO;
+        }
+        if (a == INT32_MIN && b == -1) {
+            return ipc::ST_ERROR_INVALID_INPUT;
+        }
+        out = a / b;
+        return ipc::ST_SUCCESS;
+    default:
+        return ipc::ST_ERROR_INVALID_INPUT;
+    }
+}
+
+ipc::Status server::applyConcat(
+    std::string& s1,
+    const std::string& s2
+) {
+    if (s1.size() + s2.size() > kMaxConcatBytes) {
+        return ipc::ST_ERROR_STRING_TOO_LONG;
+    }
+    s1 += s2;
+    return ipc::ST_SUCCESS;
+}
+
+ipc::Status server::applyFindStart(
+    const std::string& haystack,
+    const std::string& needle,
+    int32_t& out
+) {
+    const std::size_t pos = haystack.find(needle);
+    if (pos == std::string::npos) {
+        return ipc::ST_ERROR_SUBSTR_NOT_FOUND;
+    }
+    out = static_cast<int32_t>(pos);
+    return ipc::ST_SUCCESS;
+}
+
+/// @brief Checks the program and returns the type of the value it leaves, or false if it is malformed.
+static bool typeCheck(
+    const ipc::ExprArgs& expr,
+    std::vector<ValueType>& types,
+    ValueType& resultType
+) {
+    types.clear();
+    for (const ipc::ExprNode& node : expr.nodes()) {
+        switch (node.node_case()) {
+        case ipc::ExprNode::kIntValue:
+            types.push_back(ValueType::INT);
+            break;
+        case ipc::ExprNode::kStrValue:
+            types.push_back(ValueType::STR);
+            break;
+        case ipc::ExprNode::kMath: {
+            if (ipc::MathOp_IsValid(node.math()) == false || types.size() < 2 ||
+                types[types.size() - 1] == ValueType::STR || types[types.size() - 2] == ValueType::STR) {
+                return false;
+            }
+            types.pop_back();
+            types.back() = ValueType::INT;
+            break;
+        }
+        case ipc::ExprNode::kStr: {
+            if (ipc::StrOp_IsValid(node.str()) == false || types.size() < 2 ||
+                types[types.size() - 1] != ValueType::STR || types[types.size() - 2] != ValueType::STR) {
+                return false;
+            }
+            types.pop_back();
+            types.back() = node.str() == ipc::STR_CONCAT ? ValueType::STR : ValueType::POSITION;
+            break;
+        }
+        case ipc::ExprNode::NODE_NOT_SET:
+        default:
+            return false;
+        }
+    }
+    if (types.size() != 1) {
+        return false;
+    }
+    resultType = types.front();
+    return true;
+}
+
+ipc::Status server::evaluateExpression(
+    const ipc::ExprArgs& expr,
+    ipc::Result& result
+) {
+    IPC_TRACE_SCOPE("runExpr");
+    if (expr.nodes_size() == 0 || expr.nodes_size() > kMaxExprNodes) {
+        return ipc::ST_ERROR_INVALID_INPUT;
+    }
+    thread_local ExprStacks stacks;
+    ValueType resultType = ValueType::INT;
+    if (typeCheck(expr, stacks.types, resultType) == false) {
+        return ipc::ST_ERROR_INVALID_INPUT;
+    }
+
+    std::vector<int32_t>& ints = stacks.ints;
+    std::vector<std::string>& strs = stacks.strs;
+    ints.clear();
+    stacks.strTop = 0;
+    for (const ipc::ExprNode& node : expr.nodes()) {
+        ipc::Status status = ipc::ST_SUCCESS;
+        switch (node.node_case()) {
+        case ipc::ExprNode::kIntValue:
+            ints.push_back(node.int_value());
+            break;
+        case ipc::ExprNode::kStrValue:
+            stacks.pushStr().assign(node.str_value());
+            break;
+        case ipc::ExprNode::kMath: {
+            const int32_t b = ints.back();
+            ints.pop_back();
+            status = applyMath(node.math(), ints.back(), b, ints.back());
+            break;
+        }
+        case ipc::ExprNode::kStr: {
+            std::string& s1 = strs[stacks.strTop - 2];
+            const std::string& s2 = strs[stacks.strTop - 1];
+            if (node.str() == ipc::STR_CONCAT) {
+                status = applyConcat(s1, s2);
+                stacks.strTop -= 1;
+            } else {
+                int32_t position = 0;
+                status = applyFindStart(s1, s2, position);
+                stacks.strTop -= 2;
+                ints.push_back(position);
+            }
+            break;
+        }
+        case ipc::ExprNode::NODE_NOT_SET:
+        default:
+            return ipc::ST_ERROR_INVALID_INPUT; // Ruled out by typeCheck.
+        }
+        if (status != ipc::ST_SUCCESS) {
+            return status;
+        }
+    }
+
+    switch (resultType) {
+    case ValueType::INT:      result.set_int_result(ints.back()); break;
+    case ValueType::POSITION: result.set_position(ints.back()); break;
+    case ValueType::STR:      result.set_str_result(strs[0]); break;
+    }
+    return ipc::ST_SUCCESS;
+}
@@ -0,0 +1,49 @@
+#pragma once
+#include "ipc.pb.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace server {
+
+    /// Longest CONCAT result; longer ones fail with ST_ERROR_STRING_TOO_LONG.
+    constexpr std::size_t kMaxConcatBytes = 32;
+    /// Longest ExprArgs program.
+    constexpr int kMaxExprNodes = 256;
+
+    /// @brief One math operation, shared by MathArgs requests and expressions so both report the same statuses.
+    /// Results wrap around on overflow; INT32_MIN / -1 is ST_ERROR_INVALID_INPUT instead of a trap.
+    ipc::Status applyMath(
+        const ipc::MathOp op,
+        const int32_t a,
+        const int32_t b,
+        int32_t& out
+    );
+
+    /// @brief Appends `s2` to `s1` unless the result would exceed `kMaxConcatBytes`.
+    ipc::Status applyConcat(
+        std::string& s1,
+        const std::string& s2
+    );
+
+    /// @brief Position of the first `needle` in `haystack`, or ST_ERROR_SUBSTR_NOT_FOUND.
+    ipc::Status applyFindStart(
+        const std::string& haystack,
+        const std::string& needle,
+        int32_t& out
+    );
+
+    /// @brief Evaluates a postfix program.
+    ///
+    /// The program is type-checked first (every value type follows from the node kinds), so
+    /// malformed programs fail with ST_ERROR_INVALID_INPUT before anything runs and the
+    /// evaluation loop keeps ints and strings on separate stacks without checking tags.
+    /// The first failing operator ends the evaluation with its own status. Capabilities
+    /// are checked by the caller.
+    /// @param result Receives int_result, position (FIND_START last) or str_result.
+    ipc::Status evaluateExpression(
+        const ipc::ExprArgs& expr,
+        ipc::Result& result
+    );
+
+} // namespace server
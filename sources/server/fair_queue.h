@@ -0,0 +1,115 @@
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <unordered_map>
+
+namespace server {
+
+    /// @brief Deficit round robin over per-flow FIFO queues, the job queue of `WorkerPool`.
+    ///
+    /// Every backlogged flow sits in a ring. The flow at the head earns its weight in credit
+    /// once per turn and runs jobs while the credit covers their cost, then moves to the back,
+    /// so over a busy period flows get worker time in proportion to their weights no matter how
+    /// many jobs each one queued. A flow is forgotten when its queue drains. Urgent jobs skip
+    /// the ring; they are work a running job waits for. Not thread safe, the pool locks it.
+    ///
+    /// `Task` provides `flow`, `weight`, `cost`, `urgent` and `enqueuedAt`, see `WorkerPool::Task`.
+    template<typename Task>
+    class FairQueue {
+    public:
+        /// @brief Appends `task` to the queue of its flow, starting a turn for the flow if it was idle.
+        void push(std::shared_ptr<Task> task) {
+            ++mSize;
+            if (task->urgent) {
+                mUrgent.emplace_back(std::move(task));
+                return;
+            }
+            Flow& state = mFlows[task->flow];
+            if (state.jobs.empty()) {
+                state.id = task->flow;
+                state.weight = task->weight > 0 ? task->weight : 1;
+                state.deficit = 0;
+                state.credited = false;
+                mRing.push_back(&state);
+            }
+            state.jobs.emplace_back(std::move(task));
+        }
+
+        /// @brief Removes the next job by urgency, then deficit round robin. The queue must not be empty.
+        std::shared_ptr<Task> pop() {
+            --mSize;
+            if (mUrgent.empty() == false) {
+                std::shared_ptr<Task> task = std::move(mUrgent.front());
+                mUrgent.pop_front();
+                return task;
+            }
+            for (;;) {
+                Flow* head = mRing.front();
+                if (head->credited == false) {
+                    head->deficit += head->weight;
+                    head->credited = true;
+                }
+                const uint64_t cost = costOf(*head->jobs.front());
+                if (head->deficit < cost) {
+                    // Not enough credit this turn; a costly job waits for a later one.
+                    head->credited = false;
+                    mRing.pop_front();
+                    mRing.push_back(head);
+                    continue;
+                }
+                head->deficit -= cost;
+                std::shared_ptr<Task> task = std::move(head->jobs.front());
+                head->jobs.pop_front();
+                if (head->jobs.empty()) {
+                    mRing.pop_front();
+                    mFlows.erase(head->id);
+                } else if (head->deficit < costOf(*head->jobs.front())) {
+                    head->credited = false;
+                    mRing.pop_front();
+                    mRing.push_back(head);
+                }
+                return task;
+            }
+        }
+
+        bool empty() const { return mSize == 0; }
+
+        std::size_t size() const { return mSize; }
+
+        /// @brief Enqueue time of the longest waiting job; O(backlogged flows). The queue must not be empty.
+        std::chrono::steady_clock::time_point oldestEnqueuedAt() const {
+            std::chrono::steady_clock::time_point oldest = std::chrono::steady_clock::time_point::max();
+            if (mUrgent.empty() == false) {
+                oldest = mUrgent.front()->enqueuedAt;
+            }
+            for (const Flow* flow : mRing) {
+                oldest = std::min(oldest, flow->jobs.front()->enqueuedAt);
+            }
+            return oldest;
+        }
+
+    private:
+        /// A free job would let its flow keep the head of the ring forever.
+        static uint64_t costOf(const Task& task) {
+            return std::max<uint64_t>(task.cost, 1);
+        }
+
+        struct Flow {
+            uint64_t id = 0;
+            uint32_t weight = 1;
+            uint64_t deficit = 0;  ///< Credit left in the current turn.
+            bool credited = false; ///< The weight for the current turn was added.
+            std::deque<std::shared_ptr<Task>> jobs;
+        };
+
+        std::unordered_map<uint64_t, Flow> mFlows; ///< Backlogged flows; node based, so `mRing` pointers stay valid.
+        std::deque<Flow*> mRing;
+        std::deque<std::shared_ptr<Task>> mUrgent;
+        std::size_t mSize = 0;
+    };
+
+} // namespace server
@@ -0,0 +1,200 @@
+#include "op_registry.h"
+#include "expression.h"
+#include "error_handling.h"
+#include "trace.h"
+#include <spdlog/spdlog.h>
+#include <cstring>
+#include <string_view>
+#include <dlfcn.h>
+
+using namespace server;
+
+static_assert(static_cast<int>(IPC_OP_SUCCESS) == static_cast<int>(ipc::ST_SUCCESS));
+static_assert(static_cast<int>(IPC_OP_INVALID_INPUT) == static_cast<int>(ipc::ST_ERROR_INVALID_INPUT));
+static_assert(static_cast<int>(IPC_OP_DIV_BY_ZERO) == static_cast<int>(ipc::ST_ERROR_DIV_BY_ZERO));
+static_assert(static_cast<int>(IPC_OP_SUBSTR_NOT_FOUND) == static_cast<int>(ipc::ST_ERROR_SUBSTR_NOT_FOUND));
+static_assert(static_cast<int>(IPC_OP_STRING_TOO_LONG) == static_cast<int>(ipc::ST_ERROR_STRING_TOO_LONG));
+static_assert(static_cast<int>(IPC_OP_INTERNAL) == static_cast<int>(ipc::ST_ERROR_INTERNAL));
+static_assert(IPC_OPS_MAX % 64 == 0);
+
+namespace {
+    template<ipc::MathOp Op>
+    int32_t mathKernel(const IpcOpArgs* args, IpcOpResult* result) {
+        int32_t value = 0;
+        const ipc::Status status = applyMath(Op, args->ints[0], args->ints[1], value);
+        result->kind = IPC_OP_RESULT_INT;
+        result->intValue = value;
+        return status;
+    }
+
+    int32_t concatKernel(const IpcOpArgs* args, IpcOpResult* result) {
+        const IpcBytes& s1 = args->strs[0];
+        const IpcBytes& s2 = args->strs[1];
+        if (s1.size + s2.size > kMaxConcatBytes) {
+            return IPC_OP_STRING_TOO_LONG;
+        }
+        if (s1.size > 0) {
+            std::memcpy(result->str, s1.data, s1.size);
+        }
+        if (s2.size > 0) {
+            std::memcpy(result->str + s1.size, s2.data, s2.size);
+        }
+        result->kind = IPC_OP_RESULT_STR;
+        result->strSize = s1.size + s2.size;
+        return IPC_OP_SUCCESS;
+    }
+
+    int32_t findStartKernel(const IpcOpArgs* args, IpcOpResult* result) {
+        const std::string_view haystack(args->strs[0].data, args->strs[0].size);
+        const std::string_view needle(args->strs[1].data, args->strs[1].size);
+        const std::size_t pos = haystack.find(needle);
+        if (pos == std::string_view::npos) {
+            return IPC_OP_SUBSTR_NOT_FOUND;
+        }
+        result->kind = IPC_OP_RESULT_POSITION;
+        result->intValue = static_cast<int32_t>(pos);
+        return IPC_OP_SUCCESS;
+    }
+
+    constexpr IpcOpDescriptor kBuiltinOps[] = {
+        {OP_ADD,        "add",        2, 0, &mathKernel<ipc::MATH_ADD>},
+        {OP_SUB,        "sub",        2, 0, &mathKernel<ipc::MATH_SUB>},
+        {OP_MUL,        "mult",       2, 0, &mathKernel<ipc::MATH_MUL>},
+        {OP_DIV,        "div",        2, 0, &mathKernel<ipc::MATH_DIV>},
+        {OP_CONCAT,     "concat",     0, 2, &concatKernel},
+        {OP_FIND_START, "find",       0, 2, &findStartKernel},
+    };
+    static_assert(kMaxConcatBytes <= OpRegistry::kMaxStrResult);
+}
+
+OpRegistry::OpRegistry() {
+    for (const IpcOpDescriptor& op : kBuiltinOps) {
+        add(op, true);
+    }
+}
+
+OpRegistry::~OpRegistry() {
+    for (void* handle : mHandles) {
+        dlclose(handle);
+    }
+}
+
+int OpRegistry::add(
+    const IpcOpDescriptor& op,
+    const bool builtin
+) {
+    const uint32_t first = builtin ? 0 : IPC_OPS_FIRST_PLUGIN;
+    if (op.id < first || op.id >= IPC_OPS_MAX) {
+        spdlog::error("Op id {} is outside {}..{}", op.id, first, IPC_OPS_MAX - 1);
+        return EC_FAILURE;
+    }
+    if (op.kernel == nullptr || op.name == nullptr || op.name[0] == '\0') {
+        spdlog::error("Op {} has no kernel or name", op.id);
+        return EC_FAILURE;
+    }
+    if (mTable[op.id].kernel != nullptr) {
+        spdlog::error("Op id {} ({}) is already taken by {}", op.id, op.name, mTable[op.id].name);
+        return EC_FAILURE;
+    }
+    for (const Entry& entry : mTable) {
+        if (entry.kernel != nullptr && entry.name == op.name) {
+            spdlog::error("Op name {} is already registered", op.name);
+            return EC_FAILURE;
+        }
+    }
+    Entry& entry = mTable[op.id];
+    entry.kernel = op.kernel;
+    entry.intArgs = op.intArgs;
+    entry.strArgs = op.strArgs;
+    entry.builtin = builtin;
+    entry.name = op.name;
+    return EC_SUCCESS;
+}
+
+int OpRegistry::loadPlugin(const std::string& path) {
+    void* handle = dlopen(path.c_str(), RTLD_NOW | RTLD_LOCAL);
+    if (handle == nullptr) {
+        spdlog::error("Cannot load op plugin {}: {}", path, dlerror());
+        return EC_FAILURE;
+    }
+    auto fail = [&] {
+        dlclose(handle);
+        return EC_FAILURE;
+    };
+    auto registerOps = reinterpret_cast<IpcRegisterOpsFn>(dlsym(handle, IPC_OPS_ENTRY));
+    if (registerOps == nullptr) {
+        spdlog::error("Op plugin {} does not export {}", path, IPC_OPS_ENTRY);
+        return fail();
+    }
+    const IpcOpDescriptor* ops = nullptr;
+    std::size_t count = 0;
+    if (registerOps(IPC_OPS_ABI_VERSION, &ops, &count) != 0 || (count > 0 && ops == nullptr)) {
+        spdlog::error("Op plugin {} refused ABI version {}", path, IPC_OPS_ABI_VERSION);
+        return fail();
+    }
+    // Roll back on a bad descriptor so a rejected plugin does not stay half registered.
+    const std::array<Entry, IPC_OPS_MAX> before = mTable;
+    for (std::size_t i = 0; i < count; ++i) {
+        if (add(ops[i], false) != EC_SUCCESS) {
+            mTable = before;
+            spdlog::error("Rejected op plugin {}", path);
+            return fail();
+        }
+    }
+    mHandles.push_back(handle);
+    for (std::size_t i = 0; i < count; ++i) {
+        spdlog::info("Loaded op {} ({}) from {}", ops[i].id, ops[i].name, path);
+    }
+    return EC_SUCCESS;
+}
+
+ipc::Status OpRegistry::call(
+    const uint32_t id,
+    const IpcOpArgs& args,
+    ipc::Result& result
+) const {
+    IPC_TRACE_SCOPE("runOp");
+    if (id >= IPC_OPS_MAX) {
+        return ipc::ST_ERROR_INVALID_INPUT;
+    }
+    const Entry& entry = mTable[id];
+    if (entry.kernel == nullptr || args.intCount != entry.intArgs || args.strCount != entry.strArgs) {
+        return ipc::ST_ERROR_INVALID_INPUT;
+    }
+    thread_local std::string strBuffer(kMaxStrResult, '\0');
+    IpcOpResult out{IPC_OP_RESULT_NONE, 0, strBuffer.data(), strBuffer.size(), 0};
+    const int32_t status = entry.kernel(&args, &out);
+    if (status != IPC_OP_SUCCESS) {
+        return ipc::Status_IsValid(status) ? static_cast<ipc::Status>(status) : ipc::ST_ERROR_INTERNAL;
+    }
+    switch (out.kind) {
+    case IPC_OP_RESULT_INT:      result.set_int_result(out.intValue); break;
+    case IPC_OP_RESULT_POSITION: result.set_position(out.intValue); break;
+    case IPC_OP_RESULT_STR:
+        if (out.strSize > out.strCapacity) {
+            return ipc::ST_ERROR_INTERNAL;
+        }
+        result.set_str_result(out.str, out.strSize);
+        break;
+    case IPC_OP_RESULT_NONE:
+    default:
+        break;
+    }
+    return ipc::ST_SUCCESS;
+}
+
+void OpRegistry::list(ipc::ListOpsResponse& response) const {
+    for (uint32_t id = 0; id < IPC_OPS_MAX; ++id) {
+        const Entry& entry = mTable[id];
+        if (entry.kernel == nullptr) {
+            continue;
+        }
+        ipc::OpInfo* info = response.add_ops();
+        info->set_id(id);
+        info->set_name(entry.name);
+        info->set_int_args(entry.intArgs);
+        info->set_str_args(entry.strArgs);
+        info->set_builtin(entry.builtin);
+    }
+    response.set_status(ipc::ST_SUCCESS);
+}
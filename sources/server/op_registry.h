@@ -0,0 +1,118 @@
+#pragma once
+#include "ipc.pb.h"
+#include "ipc_ops.h"
+#include <array>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace server {
+
+    /// @brief Ids of the built-in operations. The first seven are the bit positions of `ExecFunFlags`,
+    /// so a legacy `exec_functions` mask is the first word of the capability bitmap as is.
+    enum OpId : uint32_t {
+        OP_ADD        = 0,
+        OP_SUB        = 1,
+        OP_MUL        = 2,
+        OP_DIV        = 3,
+        OP_CONCAT     = 4,
+        OP_FIND_START = 5, ///< Also required for streamed searches.
+        OP_FIND_ANY   = 6, ///< Pattern sets; runs outside the kernel table because it needs the set cache.
+        OP_REDUCE_SUM    = 7,  ///< ReduceArgs ops also run outside the table, split across the workers.
+        OP_REDUCE_MIN    = 8,
+        OP_REDUCE_MAX    = 9,
+        OP_REDUCE_DOT    = 10,
+        OP_REDUCE_PREFIX = 11,
+        OP_INVALID    = IPC_OPS_MAX
+    };
+
+    /// Op id of each MathOp, StrOp and ReduceOp, indexed by the enum value.
+    constexpr uint32_t kMathOpIds[] = {OP_ADD, OP_SUB, OP_MUL, OP_DIV};
+    constexpr uint32_t kStrOpIds[] = {OP_CONCAT, OP_FIND_START};
+    constexpr uint32_t kReduceOpIds[] = {OP_REDUCE_SUM, OP_REDUCE_MIN, OP_REDUCE_MAX, OP_REDUCE_DOT, OP_REDUCE_PREFIX};
+
+    constexpr uint32_t opIdFor(const ipc::MathOp op) {
+        return static_cast<uint32_t>(op) < std::size(kMathOpIds) ? kMathOpIds[op] : OP_INVALID;
+    }
+
+    constexpr uint32_t opIdFor(const ipc::StrOp op) {
+        return static_cast<uint32_t>(op) < std::size(kStrOpIds) ? kStrOpIds[op] : OP_INVALID;
+    }
+
+    constexpr uint32_t opIdFor(const ipc::ReduceOp op) {
+        return static_cast<uint32_t>(op) < std::size(kReduceOpIds) ? kReduceOpIds[op] : OP_INVALID;
+    }
+
+    /// @brief The operations a client may call, one bit per op id.
+    struct OpCaps {
+        std::array<uint64_t, IPC_OPS_MAX / 64> words{};
+
+        bool has(const uint32_t id) const {
+            return id < IPC_OPS_MAX && ((words[id / 64] >> (id % 64)) & 1u) != 0;
+        }
+
+        bool empty() const {
+            for (uint64_t word : words) {
+                if (word != 0) {
+                    return false;
+                }
+            }
+            return true;
+        }
+    };
+
+    /// @brief Operation kernels indexed by op id.
+    ///
+    /// Built-ins come from a constexpr descriptor table, extensions from shared objects
+    /// exporting `IPC_OPS_ENTRY` (see includes/ipc_ops.h). Everything is registered before
+    /// the workers start; afterwards the table is read-only, so calls take no lock and
+    /// dispatch is one bounds check and one indirect call.
+    class OpRegistry {
+    public:
+        /// Longest string result a kernel may produce.
+        static constexpr std::size_t kMaxStrResult = 64u * 1024u;
+
+        struct Entry {
+            IpcOpKernel kernel = nullptr; ///< nullptr for unused ids.
+            uint32_t intArgs = 0;
+            uint32_t strArgs = 0;
+            bool builtin = false;
+            std::string name;
+        };
+
+        /// @brief Registers the built-in kernels.
+        OpRegistry();
+
+        /// @brief Unloads the plugins.
+        ~OpRegistry();
+
+        OpRegistry(const OpRegistry&) = delete;
+        OpRegistry& operator=(const OpRegistry&) = delete;
+
+        /// @brief dlopens a plugin and registers its operations. A plugin with a bad descriptor
+        /// (reserved or taken id, duplicate name, no kernel) is rejected as a whole.
+        /// @return An error code, 0 for success.
+        int loadPlugin(const std::string& path);
+
+        /// @brief Runs operation `id`; unknown ids and wrong argument counts are ST_ERROR_INVALID_INPUT.
+        /// @param result Receives int_result, position or str_result as the kernel reports it.
+        ipc::Status call(
+            const uint32_t id,
+            const IpcOpArgs& args,
+            ipc::Result& result
+        ) const;
+
+        /// @brief Describes every registered operation, ordered by id.
+        void list(ipc::ListOpsResponse& response) const;
+
+    private:
+        int add(
+            const IpcOpDescriptor& op,
+            const bool builtin
+        );
+
+        std::array<Entry, IPC_OPS_MAX> mTable;
+        std::vector<void*> mHandles; ///< dlopen handles, closed in the destructor.
+    };
+
+} // namespace server
@@ -0,0 +1,260 @@
+#include "pattern_set.h"
+#include "error_handling.h"
+#include <spdlog/spdlog.h>
+#include <algorithm>
+#include <deque>
+
+using namespace server;
+
+static constexpr std::size_t kMaxPatterns = 1u << 20;
+static constexpr std::size_t kMaxPatternBytes = 16u * 1024u * 1024u;
+
+std::shared_ptr<const PatternSet> PatternSet::compile(
+    const std::vector<std::string>& patterns,
+    const std::size_t maxBytes
+) {
+    if (patterns.empty() || patterns.size() > kMaxPatterns) {
+        return nullptr;
+    }
+    std::size_t totalBytes = 0;
+    bool used[256] = {};
+    for (const std::string& p : patterns) {
+        if (p.empty()) {
+            return nullptr;
+        }
+        totalBytes += p.size();
+        for (unsigned char c : p) {
+            used[c] = true;
+        }
+    }
+    if (totalBytes > kMaxPatternBytes) {
+        return nullptr;
+    }
+
+    auto set = std::make_shared<PatternSet>();
+    // Every byte used by a pattern gets its own class, the remaining bytes share one extra class.
+    uint32_t classes = 0;
+    for (int b = 0; b < 256; ++b) {
+        if (used[b]) {
+            set->mByteClass[b] = static_cast<uint8_t>(classes++);
+        }
+    }
+    if (classes < 256) {
+        for (int b = 0; b < 256; ++b) {
+            if (used[b] == false) {
+                set->mByteClass[b] = static_cast<uint8_t>(classes);
+            }
+        }
+        ++classes;
+    }
+    set->mClasses = classes;
+    const uint32_t C = classes;
+    // Every state takes a table row plus its output, dictionary and failure links. The budget is
+    // enforced per created state, so an oversized set fails before its table is built; reserving the
+    // most the trie can need (one state per pattern byte) keeps the table from doubling past it.
+    const std::size_t stateBytes = (static_cast<std::size_t>(C) + 3) * sizeof(int32_t);
+    const std::size_t maxStates = maxBytes / stateBytes;
+    if (maxStates == 0) {
+        return nullptr;
+    }
+
+    std::vector<int32_t>& next = set->mNext;
+    std::vector<int32_t>& output = set->mOutput;
+    const std::size_t reservedStates = std::min(totalBytes + 1, maxStates);
+    next.reserve(reservedStates * C);
+    output.reserve(reservedStates);
+    next.assign(C, -1);
+    output.assign(1, -1);
+    set->mPatternLen.reserve(patterns.size());
+
+    for (std::size_t i = 0; i < patterns.size(); ++i) {
+        int32_t state = 0;
+        for (unsigned char c : patterns[i]) {
+            const std::size_t slot = static_cast<std::size_t>(state) * C + set->mByteClass[c];
+            if (next[slot] == -1) {
+                if (output.size() >= maxStates) {
+                    spdlog::error("Pattern set needs more than {} states, the cache budget of {} bytes allows no more",
+                        maxStates, maxBytes);
+                    return nullptr;
+                }
+                const int32_t created = static_cast<int32_t>(output.size());
+                next[slot] = created;
+                next.resize(next.size() + C, -1);
+                output.push_back(-1);
+            }
+            state = next[static_cast<std::size_t>(state) * C + set->mByteClass[c]];
+        }
+        if (output[state] == -1) {
+            output[state] = static_cast<int32_t>(i);
+        }
+        set->mPatternLen.push_back(static_cast<uint32_t>(patterns[i].size()));
+    }
+
+    // Breadth-first pass: resolve missing transitions through the failure links so the
+    // table becomes a complete DFA, and link every state to the nearest output on its failure chain.
+    const std::size_t states = output.size();
+    std::vector<int32_t> fail(states, 0);
+    set->mDictLink.assign(states, -1);
+    std::deque<int32_t> queue;
+    for (uint32_t c = 0; c < C; ++c) {
+        if (next[c] == -1) {
+            next[c] = 0;
+        } else {
+            fail[next[c]] = 0;
+            queue.push_back(next[c]);
+        }
+    }
+    while (queue.empty() == false) {
+        const int32_t u = queue.front();
+        queue.pop_front();
+        const std::size_t row = static_cast<std::size_t>(u) * C;
+        const std::size_t failRow = static_cast<std::size_t>(fail[u]) * C;
+        for (uint32_t c = 0; c < C; ++c) {
+            const int32_t v = next[row + c];
+            if (v == -1) {
+                next[row + c] = next[failRow + c];
+                continue;
+            }
+            fail[v] = next[failRow + c];
+            set->mDictLink[v] = (output[fail[v]] != -1) ? fail[v] : set->mDictLink[fail[v]];
+            queue.push_back(v);
+        }
+    }
+    next.shrink_to_fit();
+    output.shrink_to_fit();
+    return set;
+}
+
+void PatternSet::find(std::string_view haystack, bool all, std::vector<Match>& out) const {
+    const int32_t* next = mNext.data();
+    const uint32_t C = mClasses;
+    int32_t state = 0;
+    for (std::size_t i = 0; i < haystack.size(); ++i) {
+        const uint8_t cls = mByteClass[static_cast<unsigned char>(haystack[i])];
+        state = next[static_cast<std::size_t>(state) * C + cls];
+        int32_t hit = (mOutput[state] != -1) ? state : mDictLink[state];
+        while (hit != -1) {
+            const uint32_t pattern = static_cast<uint32_t>(mOutput[hit]);
+            out.push_back(Match{static_cast<uint32_t>(i + 1 - mPatternLen[pattern]), pattern});
+            if (all == false) {
+                return;
+            }
+            hit = mDictLink[hit];
+        }
+    }
+}
+
+std::size_t PatternSet::memoryBytes() const {
+    return sizeof(PatternSet)
+        + mNext.capacity() * sizeof(int32_t)
+        + mOutput.capacity() * sizeof(int32_t)
+        + mDictLink.capacity() * sizeof(int32_t)
+        + mPatternLen.capacity() * sizeof(uint32_t);
+}
+
+static void hashPatterns(const std::vector<std::string>& patterns, uint64_t& handle, uint64_t& check) {
+    // Two independent FNV-1a style hashes over length-prefixed patterns.
+    uint64_t h1 = 14695981039346656037ull;
+    uint64_t h2 = 0x9E3779B97F4A7C15ull;
+    auto mix = [&] (unsigned char byte) {
+        h1 = (h1 ^ byte) * 1099511628211ull;
+        h2 = (h2 ^ byte) * 0x100000001B3ull + 0x632BE59BD9B4E019ull;
+    };
+    for (const std::string& p : patterns) {
+        const uint32_t len = static_cast<uint32_t>(p.size());
+        for (int i = 0; i < 4; ++i) {
+            mix(static_cast<unsigned char>(len >> (8 * i)));
+        }
+        for (unsigned char c : p) {
+            mix(c);
+        }
+    }
+    handle = h1 == 0 ? 1 : h1;
+    check = h2;
+}
+
+PatternSetCache::PatternSetCache(std::size_t budgetBytes)
+: mBudgetBytes(budgetBytes) {}
+
+PatternSetCache::~PatternSetCache() {
+    pthread_mutex_destroy(&mMtx);
+}
+
+int PatternSetCache::add(const std::vector<std::string>& patterns, uint64_t& handle) {
+    uint64_t check = 0;
+    hashPatterns(patterns, handle, check);
+
+    pthread_mutex_lock(&mMtx);
+    auto it = mSets.find(handle);
+    if (it != mSets.end()) {
+        const bool same = it->second.check == check;
+        if (same) {
+            it->second.lastUse = ++mClock;
+        }
+        pthread_mutex_unlock(&mMtx);
+        if (same == false) {
+            spdlog::error("Pattern set handle collision for {}", handle);
+            return EC_FAILURE;
+        }
+        return EC_SUCCESS;
+    }
+    pthread_mutex_unlock(&mMtx);
+
+    // Compiling can take a while for large sets, so it runs outside the lock.
+    std::shared_ptr<const PatternSet> set = PatternSet::compile(patterns, mBudgetBytes);
+    if (set == nullptr) {
+        return EC_FAILURE;
+    }
+    const std::size_t bytes = set->memoryBytes();
+    if (bytes > mBudgetBytes) {
+        spdlog::error("Pattern set needs {} bytes, cache budget is {}", bytes, mBudgetBytes);
+        return EC_FAILURE;
+    }
+
+    pthread_mutex_lock(&mMtx);
+    if (mSets.find(handle) == mSets.end()) {
+        evictLocked(bytes);
+        Entry entry;
+        entry.set = std::move(set);
+        entry.check = check;
+        entry.lastUse = ++mClock;
+        mSets.emplace(handle, std::move(entry));
+        mUsedBytes += bytes;
+    }
+    pthread_mutex_unlock(&mMtx);
+    spdlog::info("Registered pattern set {} ({} patterns, {} bytes)", handle, patterns.size(), bytes);
+    return EC_SUCCESS;
+}
+
+std::shared_ptr<const PatternSet> PatternSetCache::find(uint64_t handle) {
+    pthread_mutex_lock(&mMtx);
+    auto it = mSets.find(handle);
+    std::shared_ptr<const PatternSet> res;
+    if (it != mSets.end()) {
+        it->second.lastUse = ++mClock;
+        res = it->second.set;
+    }
+    pthread_mutex_unlock(&mMtx);
+    return res;
+}
+
+std::size_t PatternSetCache::usedBytes() {
+    pthread_mutex_lock(&mMtx);
+    const std::size_t used = mUsedBytes;
+    pthread_mutex_unlock(&mMtx);
+    return used;
+}
+
+void PatternSetCache::evictLocked(std::size_t needed) {
+    while (mSets.empty() == false && mUsedBytes + needed > mBudgetBytes) {
+        auto oldest = mSets.begin();
+        for (auto it = mSets.begin(); it != mSets.end(); ++it) {
+            if (it->second.lastUse < oldest->second.lastUse) {
+                oldest = it;
+            }
+        }
+        spdlog::info("Evicting pattern set {}", oldest->first);
+        mUsedBytes -= oldest->second.set->memoryBytes();
+        mSets.erase(oldest);
+    }
+}
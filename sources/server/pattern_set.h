@@ -0,0 +1,90 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include <pthread.h>
+
+namespace server {
+
+    /// @brief A set of patterns compiled into an Aho-Corasick automaton.
+    ///
+    /// Input bytes are first mapped to equivalence classes (every byte that appears in no
+    /// pattern shares one class), and the goto/failure functions are resolved into a single
+    /// flat DFA table of `states x classes` entries. Scanning a haystack is one table load
+    /// per byte with no branches on failure links.
+    struct PatternSet {
+        struct Match {
+            uint32_t position; ///< Offset of the first byte of the match in the haystack.
+            uint32_t pattern;  ///< Index of the pattern in the registered list.
+        };
+
+        /// @brief Compiles the patterns. Patterns must be non-empty; a repeated pattern reports the index of its first occurrence.
+        /// @param maxBytes Memory the automaton may take; compiling stops as soon as its states would exceed it.
+        /// @return nullptr if the input is invalid or too large.
+        static std::shared_ptr<const PatternSet> compile(
+            const std::vector<std::string>& patterns,
+            const std::size_t maxBytes
+        );
+
+        /// @brief Scans the haystack in a single pass.
+        /// @param haystack The bytes to search.
+        /// @param all If false, stops at the first match (the one that ends first).
+        /// @param out Receives the matches in the order they end in the haystack.
+        void find(std::string_view haystack, bool all, std::vector<Match>& out) const;
+
+        /// @return Approximate heap bytes owned by the automaton.
+        std::size_t memoryBytes() const;
+
+    private:
+        uint8_t mByteClass[256] = {};
+        uint32_t mClasses = 1;
+        std::vector<int32_t> mNext;        ///< DFA transitions, `state * mClasses + class`.
+        std::vector<int32_t> mOutput;      ///< Pattern ending in each state, or -1.
+        std::vector<int32_t> mDictLink;    ///< Nearest state on the failure chain with an output, or -1.
+        std::vector<uint32_t> mPatternLen; ///< Length of every pattern.
+    };
+
+    /// @brief Compiled pattern sets shared by every client and evicted in LRU order under a memory budget.
+    ///
+    /// Handles are derived from the pattern list, so clients registering the same list share one automaton.
+    /// Sets that are evicted while a search is running stay alive until that search finishes.
+    struct PatternSetCache {
+        explicit PatternSetCache(std::size_t budgetBytes);
+        ~PatternSetCache();
+
+        PatternSetCache(const PatternSetCache&) = delete;
+        PatternSetCache& operator=(const PatternSetCache&) = delete;
+
+        /// @brief Compiles (or reuses) a pattern set.
+        /// @param patterns The patterns, their order defines the pattern indices reported in matches.
+        /// @param handle Receives the handle for later lookups.
+        /// @return EC_SUCCESS, or EC_FAILURE if the patterns are invalid or exceed the budget on their own.
+        int add(const std::vector<std::string>& patterns, uint64_t& handle);
+
+        /// @return The compiled set, or nullptr if the handle is unknown or was evicted.
+        std::shared_ptr<const PatternSet> find(uint64_t handle);
+
+        /// @return Bytes currently accounted to cached sets.
+        std::size_t usedBytes();
+
+    private:
+        struct Entry {
+            std::shared_ptr<const PatternSet> set;
+            uint64_t check = 0;   ///< Second hash of the patterns, guards against handle collisions.
+            uint64_t lastUse = 0; ///< Value of mClock at the last add/find.
+        };
+
+        void evictLocked(std::size_t needed);
+
+        const std::size_t mBudgetBytes;
+        pthread_mutex_t mMtx = PTHREAD_MUTEX_INITIALIZER;
+        std::unordered_map<uint64_t, Entry> mSets;
+        std::size_t mUsedBytes = 0;
+        uint64_t mClock = 0;
+    };
+
+} // namespace server
@@ -0,0 +1,256 @@
+#include "reduce.h"
+#include <bit>
+#include <climits>
+#include <cstring>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define IPC_REDUCE_X86 1
+#endif
+
+using namespace server;
+
+// ReduceArgs arrays are little-endian and are read in place.
+static_assert(std::endian::native == std::endian::little, "reduce kernels assume a little-endian host");
+
+static inline int32_t load32(const char* p) {
+    int32_t v;
+    std::memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+// Portable kernels. They read through memcpy so unaligned input is fine; GCC and Clang
+// vectorize the simple loops for the baseline ISA.
+static uint32_t sum32Generic(const char* values, std::size_t n) {
+    uint32_t sum = 0;
+    for (std::size_t i = 0; i < n; ++i) {
+        sum += static_cast<uint32_t>(load32(values + 4 * i));
+    }
+    return sum;
+}
+
+static int64_t sum64Generic(const char* values, std::size_t n) {
+    int64_t sum = 0;
+    for (std::size_t i = 0; i < n; ++i) {
+        sum += load32(values + 4 * i);
+    }
+    return sum;
+}
+
+static int32_t minGeneric(const char* values, std::size_t n) {
+    int32_t m = INT32_MAX;
+    for (std::size_t i = 0; i < n; ++i) {
+        const int32_t v = load32(values + 4 * i);
+        m = v < m ? v : m;
+    }
+    return m;
+}
+
+static int32_t maxGeneric(const char* values, std::size_t n) {
+    int32_t m = INT32_MIN;
+    for (std::size_t i = 0; i < n; ++i) {
+        const int32_t v = load32(values + 4 * i);
+        m = v > m ? v : m;
+    }
+    return m;
+}
+
+static uint32_t dot32Generic(const char* a, const char* b, std::size_t n) {
+    uint32_t sum = 0;
+    for (std::size_t i = 0; i < n; ++i) {
+        sum += static_cast<uint32_t>(load32(a + 4 * i)) * static_cast<uint32_t>(load32(b + 4 * i));
+    }
+    return sum;
+}
+
+static int64_t dot64Generic(const char* a, const char* b, std::size_t n) {
+    uint64_t sum = 0; // Wraps instead of overflowing.
+    for (std::size_t i = 0; i < n; ++i) {
+        sum += static_cast<uint64_t>(static_cast<int64_t>(load32(a + 4 * i)) * load32(b + 4 * i));
+    }
+    return static_cast<int64_t>(sum);
+}
+
+static void prefix32Generic(const char* values, std::size_t n, uint32_t carry, char* out) {
+    for (std::size_t i = 0; i < n; ++i) {
+        carry += static_cast<uint32_t>(load32(values + 4 * i));
+        std::memcpy(out + 4 * i, &carry, sizeof(carry));
+    }
+}
+
+static void prefix64Generic(const char* values, std::size_t n, int64_t carry, char* out) {
+    for (std::size_t i = 0; i < n; ++i) {
+        carry += load32(values + 4 * i);
+        std::memcpy(out + 8 * i, &carry, sizeof(carry));
+    }
+}
+
+static constexpr reduce::Kernels kGeneric = {
+    "generic",
+    &sum32Generic, &sum64Generic, &minGeneric, &maxGeneric,
+    &dot32Generic, &dot64Generic, &prefix32Generic, &prefix64Generic,
+};
+
+#ifdef IPC_REDUCE_X86
+// AVX2 kernels: 8 int32 (or 4 widened int64) per instruction, two accumulators to hide the
+// add latency, then the generic kernel for the tail.
+#define IPC_AVX2 __attribute__((target("avx2")))
+
+IPC_AVX2 static inline __m256i loadu8(const char* p) {
+    return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+}
+
+IPC_AVX2 static inline __m128i loadu4(const char* p) {
+    return _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+}
+
+IPC_AVX2 static uint32_t horizontalSum32(__m256i v) {
+    uint32_t lanes[8];
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(lanes), v);
+    uint32_t sum = 0;
+    for (uint32_t lane : lanes) {
+        sum += lane;
+    }
+    return sum;
+}
+
+IPC_AVX2 static int64_t horizontalSum64(__m256i v) {
+    uint64_t lanes[4];
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(lanes), v);
+    return static_cast<int64_t>(lanes[0] + lanes[1] + lanes[2] + lanes[3]);
+}
+
+IPC_AVX2 static uint32_t sum32Avx2(const char* values, std::size_t n) {
+    __m256i acc0 = _mm256_setzero_si256();
+    __m256i acc1 = _mm256_setzero_si256();
+    std::size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        acc0 = _mm256_add_epi32(acc0, loadu8(values + 4 * i));
+        acc1 = _mm256_add_epi32(acc1, loadu8(values + 4 * (i + 8)));
+    }
+    return horizontalSum32(_mm256_add_epi32(acc0, acc1)) + sum32Generic(values + 4 * i, n - i);
+}
+
+IPC_AVX2 static int64_t sum64Avx2(const char* values, std::size_t n) {
+    __m256i acc0 = _mm256_setzero_si256();
+    __m256i acc1 = _mm256_setzero_si256();
+    std::size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        acc0 = _mm256_add_epi64(acc0, _mm256_cvtepi32_epi64(loadu4(values + 4 * i)));
+        acc1 = _mm256_add_epi64(acc1, _mm256_cvtepi32_epi64(loadu4(values + 4 * (i + 4))));
+    }
+    return horizontalSum64(_mm256_add_epi64(acc0, acc1)) + sum64Generic(values + 4 * i, n - i);
+}
+
+IPC_AVX2 static int32_t minAvx2(const char* values, std::size_t n) {
+    __m256i acc = _mm256_set1_epi32(INT32_MAX);
+    std::size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        acc = _mm256_min_epi32(acc, loadu8(values + 4 * i));
+    }
+    int32_t lanes[8];
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(lanes), acc);
+    int32_t m = minGeneric(values + 4 * i, n - i);
+    for (int32_t lane : lanes) {
+        m = lane < m ? lane : m;
+    }
+    return m;
+}
+
+IPC_AVX2 static int32_t maxAvx2(const char* values, std::size_t n) {
+    __m256i acc = _mm256_set1_epi32(INT32_MIN);
+    std::size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        acc = _mm256_max_epi32(acc, loadu8(values + 4 * i));
+    }
+    int32_t lanes[8];
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(lanes), acc);
+    int32_t m = maxGeneric(values + 4 * i, n - i);
+    for (int32_t lane : lanes) {
+        m = lane > m ? lane : m;
+    }
+    return m;
+}
+
+IPC_AVX2 static uint32_t dot32Avx2(const char* a, const char* b, std::size_t n) {
+    __m256i acc0 = _mm256_setzero_si256();
+    __m256i acc1 = _mm256_setzero_si256();
+    std::size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        acc0 = _mm256_add_epi32(acc0, _mm256_mullo_epi32(loadu8(a + 4 * i), loadu8(b + 4 * i)));
+        acc1 = _mm256_add_epi32(acc1, _mm256_mullo_epi32(loadu8(a + 4 * (i + 8)), loadu8(b + 4 * (i + 8))));
+    }
+    return horizontalSum32(_mm256_add_epi32(acc0, acc1)) + dot32Generic(a + 4 * i, b + 4 * i, n - i);
+}
+
+IPC_AVX2 static int64_t dot64Avx2(const char* a, const char* b, std::size_t n) {
+    __m256i acc0 = _mm256_setzero_si256();
+    __m256i acc1 = _mm256_setzero_si256();
+    std::size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        // _mm256_mul_epi32 multiplies the sign-extended low halves of each 64-bit lane.
+        const __m256i a0 = _mm256_cvtepi32_epi64(loadu4(a + 4 * i));
+        const __m256i b0 = _mm256_cvtepi32_epi64(loadu4(b + 4 * i));
+        const __m256i a1 = _mm256_cvtepi32_epi64(loadu4(a + 4 * (i + 4)));
+        const __m256i b1 = _mm256_cvtepi32_epi64(loadu4(b + 4 * (i + 4)));
+        acc0 = _mm256_add_epi64(acc0, _mm256_mul_epi32(a0, b0));
+        acc1 = _mm256_add_epi64(acc1, _mm256_mul_epi32(a1, b1));
+    }
+    const uint64_t head = static_cast<uint64_t>(horizontalSum64(_mm256_add_epi64(acc0, acc1)));
+    return static_cast<int64_t>(head + static_cast<uint64_t>(dot64Generic(a + 4 * i, b + 4 * i, n - i)));
+}
+
+IPC_AVX2 static void prefix32Avx2(const char* values, std::size_t n, uint32_t carry, char* out) {
+    __m256i running = _mm256_set1_epi32(static_cast<int32_t>(carry));
+    std::size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256i x = loadu8(values + 4 * i);
+        // Scan inside each 128-bit half, then add the low half's total to the high half.
+        x = _mm256_add_epi32(x, _mm256_slli_si256(x, 4));
+        x = _mm256_add_epi32(x, _mm256_slli_si256(x, 8));
+        const __m256i lowTotal = _mm256_shuffle_epi32(x, _MM_SHUFFLE(3, 3, 3, 3));
+        x = _mm256_add_epi32(x, _mm256_permute2x128_si256(lowTotal, lowTotal, 0x08));
+        x = _mm256_add_epi32(x, running);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + 4 * i), x);
+        running = _mm256_permutevar8x32_epi32(x, _mm256_set1_epi32(7));
+    }
+    prefix32Generic(values + 4 * i, n - i, static_cast<uint32_t>(_mm256_extract_epi32(running, 0)), out + 4 * i);
+}
+
+IPC_AVX2 static void prefix64Avx2(const char* values, std::size_t n, int64_t carry, char* out) {
+    __m256i running = _mm256_set1_epi64x(carry);
+    std::size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m256i x = _mm256_cvtepi32_epi64(loadu4(values + 4 * i));
+        x = _mm256_add_epi64(x, _mm256_slli_si256(x, 8));
+        const __m256i lowTotal = _mm256_shuffle_epi32(x, _MM_SHUFFLE(3, 2, 3, 2));
+        x = _mm256_add_epi64(x, _mm256_permute2x128_si256(lowTotal, lowTotal, 0x08));
+        x = _mm256_add_epi64(x, running);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + 8 * i), x);
+        running = _mm256_permute4x64_epi64(x, _MM_SHUFFLE(3, 3, 3, 3));
+    }
+    prefix64Generic(values + 4 * i, n - i, _mm256_extract_epi64(running, 0), out + 8 * i);
+}
+
+static constexpr reduce::Kernels kAvx2 = {
+    "avx2",
+    &sum32Avx2, &sum64Avx2, &minAvx2, &maxAvx2,
+    &dot32Avx2, &dot64Avx2, &prefix32Avx2, &prefix64Avx2,
+};
+#endif
+
+const reduce::Kernels& reduce::kernels() {
+    static const Kernels* const selected = [] {
+#ifdef IPC_REDUCE_X86
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2")) {
+            return &kAvx2;
+        }
+#endif
+        return &kGeneric;
+    }();
+    return *selected;
+}
+
+const reduce::Kernels& reduce::genericKernels() {
+    return kGeneric;
+}
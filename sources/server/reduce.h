@@ -0,0 +1,36 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+namespace server {
+namespace reduce {
+
+    /// Longest ReduceArgs array; PREFIX_SUM replies with up to twice as many bytes.
+    constexpr std::size_t kMaxValues = 4u * 1024u * 1024u;
+
+    /// @brief Kernels over packed little-endian int32 arrays for one instruction set.
+    ///
+    /// Inputs are the raw bytes of a ReduceArgs field, so they may be unaligned. The 32-bit
+    /// variants wrap around like int32 arithmetic; the 64-bit ones widen every element first.
+    struct Kernels {
+        const char* isa;
+        uint32_t (*sum32)(const char* values, std::size_t n);
+        int64_t (*sum64)(const char* values, std::size_t n);
+        /// `n` may be 0, the result is then INT32_MAX (min) or INT32_MIN (max).
+        int32_t (*min)(const char* values, std::size_t n);
+        int32_t (*max)(const char* values, std::size_t n);
+        uint32_t (*dot32)(const char* a, const char* b, std::size_t n);
+        int64_t (*dot64)(const char* a, const char* b, std::size_t n);
+        /// Inclusive prefix sums starting from `carry`, written as packed int32 (int64) to `out`.
+        void (*prefix32)(const char* values, std::size_t n, uint32_t carry, char* out);
+        void (*prefix64)(const char* values, std::size_t n, int64_t carry, char* out);
+    };
+
+    /// @brief The fastest kernels the CPU supports, selected on first use.
+    const Kernels& kernels();
+
+    /// @brief The portable kernels, for comparisons in benchmarks.
+    const Kernels& genericKernels();
+
+} // namespace reduce
+} // namespace server
@@ -0,0 +1,200 @@
+#include "result_spill.h"
+#include "error_handling.h"
+#include <spdlog/spdlog.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace server {
+
+namespace {
+    /// Every record starts with this; `next` is the following record of the chain plus one, 0 ends it.
+    struct RecordHeader {
+        uint64_t id = 0; ///< Ticket the record belongs to, checked when reading back.
+        uint32_t next = 0;
+        uint32_t used = 0; ///< Payload bytes in this record.
+    };
+    static_assert(sizeof(RecordHeader) == 16, "RecordHeader is part of the file layout");
+
+    constexpr std::size_t kRecordBytes = 256;
+    constexpr std::size_t kPayloadBytes = kRecordBytes - sizeof(RecordHeader);
+}
+
+ResultSpill::~ResultSpill() {
+    close();
+    pthread_mutex_destroy(&mMtx);
+}
+
+int ResultSpill::open(const std::string& dir, const std::size_t fileBytes) {
+    const std::size_t records = std::min<std::size_t>(fileBytes / kRecordBytes, UINT32_MAX - 1);
+    if (records == 0) {
+        spdlog::error("A spill file of {} bytes is too small", fileBytes);
+        return EC_FAILURE;
+    }
+    close();
+    char name[64];
+    std::snprintf(name, sizeof(name), "results-%ld.spill", static_cast<long>(getpid()));
+    mPath = dir + "/" + name;
+    const int fd = ::open(mPath.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if (fd < 0) {
+        spdlog::error("Cannot create spill file {}: {}", mPath, std::strerror(errno));
+        return EC_FAILURE;
+    }
+    const std::size_t bytes = records * kRecordBytes;
+    // Reserve the blocks now: a store into a sparse mapping on a full disk raises SIGBUS,
+    // while this fails cleanly and the server starts without spilling.
+    const int rc = posix_fallocate(fd, 0, static_cast<off_t>(bytes));
+    if (rc != 0) {
+        spdlog::error("Cannot reserve {} bytes for spill file {}: {}", bytes, mPath, std::strerror(rc));
+        ::close(fd);
+        unlink(mPath.c_str());
+        return EC_FAILURE;
+    }
+    void* mapped = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (mapped == MAP_FAILED) {
+        spdlog::error("Cannot map spill file {}: {}", mPath, std::strerror(errno));
+        ::close(fd);
+        unlink(mPath.c_str());
+        return EC_FAILURE;
+    }
+    pthread_mutex_lock(&mMtx);
+    mFd = fd;
+    mBase = static_cast<char*>(mapped);
+    mCapacity = static_cast<uint32_t>(records);
+    mTail = 0;
+    mUsedRecords = 0;
+    mRejected = 0;
+    pthread_mutex_unlock(&mMtx);
+    spdlog::info("Spilling unclaimed results to {} ({} records)", mPath, records);
+    return EC_SUCCESS;
+}
+
+uint32_t ResultSpill::allocate() {
+    if (mFree.empty() == false) {
+        const uint32_t record = mFree.back();
+        mFree.pop_back();
+        return record;
+    }
+    return mTail++;
+}
+
+bool ResultSpill::put(
+    const uint64_t id,
+    const ipc::Result& result,
+    const SpilledOutcome& outcome
+) {
+    pthread_mutex_lock(&mMtx);
+    if (mBase == nullptr || mIndex.count(id) != 0) {
+        pthread_mutex_unlock(&mMtx);
+        return false;
+    }
+    mScratch.clear();
+    result.AppendToString(&mScratch);
+    // An empty result still takes one record, so every entry owns a chain.
+    const std::size_t needed = std::max<std::size_t>(1, (mScratch.size() + kPayloadBytes - 1) / kPayloadBytes);
+    const std::size_t available = mFree.size() + (mCapacity - mTail);
+    if (needed > available || mScratch.size() > UINT32_MAX) {
+        ++mRejected;
+        pthread_mutex_unlock(&mMtx);
+        return false;
+    }
+    Entry entry;
+    entry.bytes = static_cast<uint32_t>(mScratch.size());
+    entry.outcome = outcome;
+    entry.first = allocate();
+    uint32_t record = entry.first;
+    std::size_t offset = 0;
+    for (std::size_t i = 0; i < needed; ++i) {
+        char* at = mBase + static_cast<std::size_t>(record) * kRecordBytes;
+        RecordHeader header;
+        header.id = id;
+        header.used = static_cast<uint32_t>(std::min(kPayloadBytes, mScratch.size() - offset));
+        const uint32_t next = (i + 1 < needed) ? allocate() : 0;
+        header.next = (i + 1 < needed) ? next + 1 : 0;
+        std::memcpy(at, &header, sizeof(header));
+        std::memcpy(at + sizeof(header), mScratch.data() + offset, header.used);
+        offset += header.used;
+        record = next;
+    }
+    mUsedRecords += needed;
+    mIndex.emplace(id, entry);
+    pthread_mutex_unlock(&mMtx);
+    return true;
+}
+
+bool ResultSpill::take(
+    const uint64_t id,
+    ipc::Result& result,
+    SpilledOutcome& outcome
+) {
+    pthread_mutex_lock(&mMtx);
+    auto it = (mBase == nullptr) ? mIndex.end() : mIndex.find(id);
+    if (it == mIndex.end()) {
+        pthread_mutex_unlock(&mMtx);
+        return false;
+    }
+    const Entry entry = it->second;
+    mIndex.erase(it);
+    mScratch.clear();
+    mScratch.reserve(entry.bytes);
+    bool intact = true;
+    uint32_t next = entry.first + 1;
+    while (next != 0) {
+        const uint32_t record = next - 1;
+        const char* at = mBase + static_cast<std::size_t>(record) * kRecordBytes;
+        RecordHeader header;
+        std::memcpy(&header, at, sizeof(header));
+        intact = intact && header.id == id && header.used <= kPayloadBytes;
+        if (intact) {
+            mScratch.append(at + sizeof(header), header.used);
+        }
+        mFree.push_back(record);
+        --mUsedRecords;
+        next = intact ? header.next : 0;
+    }
+    outcome = entry.outcome;
+    const bool parsed = intact && mScratch.size() == entry.bytes && result.ParseFromString(mScratch);
+    pthread_mutex_unlock(&mMtx);
+    if (parsed == false) {
+        spdlog::error("Spilled result {} is damaged", id);
+        result.Clear();
+        outcome.status = ipc::ST_ERROR_INTERNAL;
+    }
+    return true;
+}
+
+void ResultSpill::usage(uint32_t& results, uint64_t& bytes, uint64_t& rejected) {
+    pthread_mutex_lock(&mMtx);
+    results = static_cast<uint32_t>(mIndex.size());
+    bytes = mUsedRecords * kRecordBytes;
+    rejected = mRejected;
+    pthread_mutex_unlock(&mMtx);
+}
+
+void ResultSpill::close() {
+    pthread_mutex_lock(&mMtx);
+    if (mBase == nullptr) {
+        pthread_mutex_unlock(&mMtx);
+        return;
+    }
+    munmap(mBase, static_cast<std::size_t>(mCapacity) * kRecordBytes);
+    ::close(mFd);
+    if (unlink(mPath.c_str()) != 0) {
+        spdlog::warn("Cannot remove spill file {}: {}", mPath, std::strerror(errno));
+    }
+    mBase = nullptr;
+    mFd = -1;
+    mCapacity = 0;
+    mIndex.clear();
+    mFree.clear();
+    mFree.shrink_to_fit();
+    mTail = 0;
+    mUsedRecords = 0;
+    pthread_mutex_unlock(&mMtx);
+}
+
+} // namespace server
@@ -0,0 +1,93 @@
+#pragma once
+#include "ipc.pb.h"
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <pthread.h>
+
+namespace server {
+
+    /// @brief What a spilled ticket keeps in memory besides its result: the status and the job's stages.
+    struct SpilledOutcome {
+        ipc::Status status = ipc::ST_NOT_FINISHED;
+        std::chrono::steady_clock::time_point enqueuedAt;
+        std::chrono::steady_clock::time_point startedAt;
+        std::chrono::steady_clock::time_point finishedAt;
+    };
+
+    /// @brief Finished results nobody fetched yet, moved out of the heap into a memory-mapped file.
+    ///
+    /// The file is cut into fixed records; a result is serialized into a chain of them, so any
+    /// free record can take any part of any result and no space is lost to fragmentation. Records
+    /// are handed out from the never-used tail of the file first, then from those freed by `take`.
+    /// The kernel writes the pages back and may drop them from memory, which is the point: only
+    /// the small per-ticket index stays resident. The file is scratch space, it is created empty
+    /// and removed again by `close`. Safe to use from any thread.
+    struct ResultSpill {
+        ResultSpill() = default;
+        ResultSpill(const ResultSpill&) = delete;
+        ResultSpill& operator=(const ResultSpill&) = delete;
+
+        /// @brief Closes and removes the file.
+        ~ResultSpill();
+
+        /// @brief Creates the spill file in `dir`, which must exist, and reserves its disk space.
+        /// @param fileBytes Size of the file; rounded down to whole records. Fails if the disk cannot hold it.
+        /// @return An error code, 0 for success.
+        int open(const std::string& dir, const std::size_t fileBytes);
+
+        /// @return true between a successful `open` and `close`.
+        bool active() const { return mBase != nullptr; }
+
+        /// @brief Stores a result under its ticket id.
+        /// @return false if the file has no room left; the caller keeps the result.
+        bool put(
+            const uint64_t id,
+            const ipc::Result& result,
+            const SpilledOutcome& outcome
+        );
+
+        /// @brief Reads a result back and frees its records.
+        /// @return false if `id` was not spilled, or was taken already.
+        bool take(
+            const uint64_t id,
+            ipc::Result& result,
+            SpilledOutcome& outcome
+        );
+
+        /// @brief Current contents, for the statistics.
+        /// @param rejected Receives the results `put` turned away for lack of room so far.
+        void usage(uint32_t& results, uint64_t& bytes, uint64_t& rejected);
+
+        /// @brief Unmaps and removes the file; spilled results are lost.
+        void close();
+
+    private:
+        /// A spilled result: where its chain starts and how long it is.
+        struct Entry {
+            uint32_t first = 0;
+            uint32_t bytes = 0;
+            SpilledOutcome outcome;
+        };
+
+        /// Takes one record, from the free list or the unused tail; `mMtx` must be held.
+        uint32_t allocate();
+
+        std::string mPath;
+        int mFd = -1;
+        char* mBase = nullptr;       ///< Mapping of the whole file.
+        uint32_t mCapacity = 0;      ///< Records in the file.
+
+        pthread_mutex_t mMtx = PTHREAD_MUTEX_INITIALIZER; ///< Guards everything below.
+        std::unordered_map<uint64_t, Entry> mIndex;
+        std::vector<uint32_t> mFree; ///< Records freed by `take`, reused first.
+        uint32_t mTail = 0;          ///< Records below it were handed out at least once.
+        uint64_t mUsedRecords = 0;
+        uint64_t mRejected = 0;
+        std::string mScratch;        ///< Serialized result being written or read.
+    };
+
+} // namespace server
@@ -0,0 +1,56 @@
+#include "slow_log.h"
+#include <chrono>
+#include <utility>
+
+namespace server {
+
+SlowLog::SlowLog(const Config& config)
+: mCapacity(config.slowLogSize) {
+    // Only submits are recorded; get, stream and the other router-side calls keep 0.
+    for (int op = 0; mCapacity > 0 && op <= static_cast<int>(StatsOp::REDUCE); ++op) {
+        auto it = config.slowRequestUs.find(statsOpName(static_cast<StatsOp>(op)));
+        if (it == config.slowRequestUs.end()) {
+            it = config.slowRequestUs.find("*");
+        }
+        if (it != config.slowRequestUs.end() && it->second > 0) {
+            mThresholdNs[op] = static_cast<int64_t>(it->second) * 1000;
+            mEnabled = true;
+        }
+    }
+    if (mEnabled) {
+        mRing.reserve(mCapacity);
+    }
+}
+
+SlowLog::~SlowLog() {
+    pthread_mutex_destroy(&mMtx);
+}
+
+void SlowLog::record(SlowRequest request) {
+    request.atMs = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+    pthread_mutex_lock(&mMtx);
+    if (mRing.size() < mCapacity) {
+        mRing.push_back(std::move(request));
+    } else {
+        mRing[mNext] = std::move(request);
+    }
+    mNext = (mNext + 1) % mCapacity;
+    ++mRecorded;
+    pthread_mutex_unlock(&mMtx);
+}
+
+void SlowLog::snapshot(std::vector<SlowRequest>& out, uint64_t& recorded) {
+    pthread_mutex_lock(&mMtx);
+    out.clear();
+    out.reserve(mRing.size());
+    // Before the ring wraps the oldest record is at 0, afterwards at `mNext`.
+    const std::size_t oldest = (mRing.size() < mCapacity) ? 0 : mNext;
+    for (std::size_t i = 0; i < mRing.size(); ++i) {
+        out.push_back(mRing[(oldest + i) % mRing.size()]);
+    }
+    recorded = mRecorded;
+    pthread_mutex_unlock(&mMtx);
+}
+
+} // namespace server
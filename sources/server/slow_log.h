@@ -0,0 +1,66 @@
+#pragma once
+#include "config.h"
+#include "stats.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <pthread.h>
+
+namespace server {
+
+    /// @brief Context of one submit that took longer than its op's threshold.
+    struct SlowRequest {
+        int64_t atMs = 0;             ///< Wall-clock completion time, to match the record with logs.
+        StatsOp op = StatsOp::INVALID;
+        ipc::Status status = ipc::ST_NOT_FINISHED;
+        uint32_t payloadBytes = 0;    ///< Serialized size of the SubmitRequest.
+        std::string client;           ///< Client name of the flow, empty for the shared flow.
+        uint32_t queueDepth = 0;      ///< Jobs already queued in its pool when it was enqueued.
+        std::string worker;           ///< Thread that ran it, "router" for inline execution.
+        int64_t queueNs = 0;          ///< Enqueue to execution start, 0 when run inline.
+        int64_t execNs = 0;
+        int64_t totalNs = 0;          ///< Enqueue (or execution start) to execution end.
+    };
+
+    /// @brief Bounded ring of the slowest-path submits, for requests behind tail latency spikes.
+    ///
+    /// Checking a request is one array load and a compare against the time the runner already
+    /// measured for its statistics; only a request over its threshold builds a record and takes
+    /// the lock. When the ring is full the oldest record is overwritten.
+    struct SlowLog {
+        /// @param config Reads `slowRequestUs` and `slowLogSize`.
+        explicit SlowLog(const Config& config);
+        ~SlowLog();
+
+        SlowLog(const SlowLog&) = delete;
+        SlowLog& operator=(const SlowLog&) = delete;
+
+        /// @return true if a request of `op` that took `totalNs` belongs in the log.
+        bool isSlow(const StatsOp op, const int64_t totalNs) const {
+            const int64_t threshold = mThresholdNs[static_cast<int>(op)];
+            return threshold > 0 && totalNs >= threshold;
+        }
+
+        /// @brief Stores a record; `request.atMs` is filled in here.
+        void record(SlowRequest request);
+
+        /// @brief Copies the records, oldest first.
+        /// @param recorded Receives the number of records ever stored, overwritten ones included.
+        void snapshot(std::vector<SlowRequest>& out, uint64_t& recorded);
+
+        /// @return true if any op has a threshold.
+        bool enabled() const { return mEnabled; }
+
+    private:
+        const std::size_t mCapacity;
+        int64_t mThresholdNs[static_cast<int>(StatsOp::COUNT)] = {}; ///< 0 leaves the op out.
+        bool mEnabled = false;
+
+        pthread_mutex_t mMtx = PTHREAD_MUTEX_INITIALIZER; ///< Guards everything below.
+        std::vector<SlowRequest> mRing;                   ///< Grows to `mCapacity` once, then wraps.
+        std::size_t mNext = 0;                            ///< Slot the next record goes to.
+        uint64_t mRecorded = 0;
+    };
+
+} // namespace server
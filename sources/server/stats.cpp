@@ -0,0 +1,374 @@
+#include "stats.h"
+#include <unordered_map>
+#include <utility>
+
+using namespace server;
+
+static constexpr int kOps = static_cast<int>(StatsOp::COUNT);
+static constexpr int kPhases = static_cast<int>(StatsPhase::COUNT);
+static constexpr int kStatuses = ipc::Status_ARRAYSIZE;
+static constexpr int kPaths = static_cast<int>(DispatchPath::COUNT);
+static constexpr int kClasses = static_cast<int>(OpClass::COUNT);
+
+/// One thread's counters. Only the owning thread writes, everyone else only reads.
+struct alignas(64) Stats::Slab {
+    std::atomic<uint64_t> statuses[kOps][kStatuses] = {};
+    std::atomic<uint64_t> buckets[kOps][kPhases][LatencyBuckets::kCount] = {};
+    std::atomic<uint64_t> sumNs[kOps][kPhases] = {};
+    std::atomic<uint64_t> workerBusyNs{0};
+    std::atomic<uint64_t> classBusyNs[kClasses] = {};
+    std::atomic<uint64_t> dispatched[kPaths] = {};
+};
+
+/// Single-writer increment, cheaper than fetch_add because it needs no locked instruction.
+static inline void bump(std::atomic<uint64_t>& counter, uint64_t by) {
+    counter.store(counter.load(std::memory_order_relaxed) + by, std::memory_order_relaxed);
+}
+
+StatsOp server::statsOpFor(const ipc::SubmitRequest& request) {
+    switch (request.payload_case()) {
+    case ipc::SubmitRequest::kMath:
+        switch (request.math().op()) {
+        case ipc::MATH_ADD: return StatsOp::ADD;
+        case ipc::MATH_SUB: return StatsOp::SUB;
+        case ipc::MATH_MUL: return StatsOp::MUL;
+        case ipc::MATH_DIV: return StatsOp::DIV;
+        default: return StatsOp::INVALID;
+        }
+    case ipc::SubmitRequest::kStr:
+        switch (request.str().op()) {
+        case ipc::STR_CONCAT:     return StatsOp::CONCAT;
+        case ipc::STR_FIND_START: return StatsOp::FIND_START;
+        default: return StatsOp::INVALID;
+        }
+    case ipc::SubmitRequest::kFindAny:
+        return StatsOp::FIND_ANY;
+    case ipc::SubmitRequest::kExpr:
+        return StatsOp::EXPR;
+    case ipc::SubmitRequest::kCall:
+        return StatsOp::CALL;
+    case ipc::SubmitRequest::kReduce:
+        return StatsOp::REDUCE;
+    case ipc::SubmitRequest::PAYLOAD_NOT_SET:
+    default:
+        return StatsOp::INVALID;
+    }
+}
+
+const char* server::statsOpName(StatsOp op) {
+    switch (op) {
+    case StatsOp::ADD:        return "add";
+    case StatsOp::SUB:        return "sub";
+    case StatsOp::MUL:        return "mult";
+    case StatsOp::DIV:        return "div";
+    case StatsOp::CONCAT:     return "concat";
+    case StatsOp::FIND_START: return "find";
+    case StatsOp::FIND_ANY:   return "findany";
+    case StatsOp::EXPR:       return "expr";
+    case StatsOp::CALL:       return "call";
+    case StatsOp::REDUCE:     return "reduce";
+    case StatsOp::GET:        return "get";
+    case StatsOp::GET_MANY:   return "getmany";
+    case StatsOp::STREAM:     return "stream";
+    case StatsOp::PATTERNS:   return "patterns";
+    case StatsOp::INVALID:
+    case StatsOp::COUNT:
+    default:                  return "invalid";
+    }
+}
+
+OpClass server::opClassFor(StatsOp op) {
+    switch (op) {
+    case StatsOp::CONCAT:
+    case StatsOp::FIND_START:
+    case StatsOp::FIND_ANY:
+        return OpClass::STRING;
+    case StatsOp::CALL:
+    case StatsOp::REDUCE:
+        return OpClass::BULK;
+    default:
+        return OpClass::MATH;
+    }
+}
+
+OpClass server::opClassFor(const ipc::SubmitRequest& request) {
+    if (request.has_expr() == false) {
+        return opClassFor(statsOpFor(request));
+    }
+    for (const ipc::ExprNode& node : request.expr().nodes()) {
+        if (node.has_str()) {
+            return OpClass::STRING;
+        }
+    }
+    return OpClass::MATH;
+}
+
+const char* server::opClassName(OpClass cls) {
+    switch (cls) {
+    case OpClass::STRING: return "string";
+    case OpClass::BULK:   return "bulk";
+    case OpClass::MATH:
+    default:              return "math";
+    }
+}
+
+void StatsSnapshot::subtract(const StatsSnapshot& other) {
+    for (int op = 0; op < kOps; ++op) {
+        for (int s = 0; s < kStatuses; ++s) {
+            statuses[op][s] -= other.statuses[op][s];
+        }
+        for (int ph = 0; ph < kPhases; ++ph) {
+            for (uint32_t b = 0; b < LatencyBuckets::kCount; ++b) {
+                buckets[op][ph][b] -= other.buckets[op][ph][b];
+            }
+            sumNs[op][ph] -= other.sumNs[op][ph];
+        }
+    }
+    workerBusyNs -= other.workerBusyNs;
+    for (int c = 0; c < kClasses; ++c) {
+        classBusyNs[c] -= other.classBusyNs[c];
+    }
+    for (int p = 0; p < kPaths; ++p) {
+        dispatched[p] -= other.dispatched[p];
+    }
+}
+
+static uint64_t nextGeneration() {
+    static std::atomic<uint64_t> generation{1};
+    return generation.fetch_add(1, std::memory_order_relaxed);
+}
+
+/// Live instances by generation, so an exiting thread can tell whether the instance its slab
+/// belongs to still exists. Never freed: threads may exit during static destruction.
+static pthread_mutex_t gLiveMtx = PTHREAD_MUTEX_INITIALIZER;
+static std::unordered_map<uint64_t, Stats*>* gLive = nullptr;
+
+/// The slabs a thread records into, one per instance; returns them when the thread exits.
+struct Stats::SlabCache {
+    std::vector<std::pair<uint64_t, Slab*>> entries;
+
+    ~SlabCache() {
+        pthread_mutex_lock(&gLiveMtx);
+        for (const auto& entry : entries) {
+            auto it = gLive->find(entry.first);
+            if (it != gLive->end()) {
+                Stats& stats = *it->second;
+                pthread_mutex_lock(&stats.mMtx);
+                stats.mFreeSlabs.push_back(entry.second);
+                pthread_mutex_unlock(&stats.mMtx);
+            }
+        }
+        pthread_mutex_unlock(&gLiveMtx);
+    }
+};
+
+Stats::Stats()
+: mGeneration(nextGeneration())
+, mBaseline(std::make_unique<StatsSnapshot>())
+, mWindowStart(std::chrono::steady_clock::now()) {
+    pthread_mutex_lock(&gLiveMtx);
+    if (gLive == nullptr) {
+        gLive = new std::unordered_map<uint64_t, Stats*>();
+    }
+    gLive->emplace(mGeneration, this);
+    pthread_mutex_unlock(&gLiveMtx);
+}
+
+Stats::~Stats() {
+    pthread_mutex_lock(&gLiveMtx);
+    gLive->erase(mGeneration);
+    pthread_mutex_unlock(&gLiveMtx);
+    pthread_mutex_destroy(&mMtx);
+}
+
+Stats::Slab& Stats::local() {
+    // A thread usually records into one Stats instance, so this stays a one-entry scan.
+    thread_local SlabCache cache;
+    for (const auto& entry : cache.entries) {
+        if (entry.first == mGeneration) {
+            return *entry.second;
+        }
+    }
+    Slab* raw = nullptr;
+    pthread_mutex_lock(&mMtx);
+    if (mFreeSlabs.empty() == false) {
+        // Taking it under the mutex orders the previous owner's stores before ours.
+        raw = mFreeSlabs.back();
+        mFreeSlabs.pop_back();
+    } else {
+        mSlabs.emplace_back(std::make_unique<Slab>());
+        raw = mSlabs.back().get();
+    }
+    pthread_mutex_unlock(&mMtx);
+    cache.entries.emplace_back(mGeneration, raw);
+    return *raw;
+}
+
+void Stats::record(StatsOp op, ipc::Status status, int64_t queueWaitNs, int64_t execNs, int64_t totalNs) {
+    Slab& slab = local();
+    const int o = static_cast<int>(op);
+    const int s = (status >= 0 && status < kStatuses) ? static_cast<int>(status) : static_cast<int>(ipc::ST_ERROR_INTERNAL);
+    bump(slab.statuses[o][s], 1);
+
+    auto sample = [&] (StatsPhase phase, int64_t ns) {
+        const uint64_t value = ns > 0 ? static_cast<uint64_t>(ns) : 0;
+        const int ph = static_cast<int>(phase);
+        bump(slab.buckets[o][ph][LatencyBuckets::index(value)], 1);
+        bump(slab.sumNs[o][ph], value);
+    };
+    if (queueWaitNs >= 0) {
+        sample(StatsPhase::QUEUE_WAIT, queueWaitNs);
+    }
+    sample(StatsPhase::EXEC, execNs);
+    sample(StatsPhase::TOTAL, totalNs);
+}
+
+void Stats::addBusy(int64_t ns, OpClass cls) {
+    if (ns > 0) {
+        Slab& slab = local();
+        bump(slab.workerBusyNs, static_cast<uint64_t>(ns));
+        bump(slab.classBusyNs[static_cast<int>(cls)], static_cast<uint64_t>(ns));
+    }
+}
+
+void Stats::addDispatch(DispatchPath path) {
+    bump(local().dispatched[static_cast<int>(path)], 1);
+}
+
+void Stats::sumLocked(StatsSnapshot& out) {
+    for (const std::unique_ptr<Slab>& slab : mSlabs) {
+        for (int op = 0; op < kOps; ++op) {
+            for (int s = 0; s < kStatuses; ++s) {
+                out.statuses[op][s] += slab->statuses[op][s].load(std::memory_order_relaxed);
+            }
+            for (int ph = 0; ph < kPhases; ++ph) {
+                for (uint32_t b = 0; b < LatencyBuckets::kCount; ++b) {
+                    out.buckets[op][ph][b] += slab->buckets[op][ph][b].load(std::memory_order_relaxed);
+                }
+                out.sumNs[op][ph] += slab->sumNs[op][ph].load(std::memory_order_relaxed);
+            }
+        }
+        out.workerBusyNs += slab->workerBusyNs.load(std::memory_order_relaxed);
+        for (int c = 0; c < kClasses; ++c) {
+            out.classBusyNs[c] += slab->classBusyNs[c].load(std::memory_order_relaxed);
+        }
+        for (int p = 0; p < kPaths; ++p) {
+            out.dispatched[p] += slab->dispatched[p].load(std::memory_order_relaxed);
+        }
+    }
+}
+
+static void fillHistogram(const uint64_t* buckets, uint64_t sumNs, ipc::LatencyHistogram& out) {
+    uint64_t count = 0;
+    for (uint32_t b = 0; b < LatencyBuckets::kCount; ++b) {
+        count += buckets[b];
+    }
+    out.set_count(count);
+    out.set_sum_ns(sumNs);
+    if (count == 0) {
+        return;
+    }
+    // Ranks are rounded up so p99.9 of a small sample is its maximum, not an earlier bucket.
+    auto rank = [count] (uint64_t perMille) {
+        return (count * perMille + 999) / 1000;
+    };
+    const uint64_t p50 = rank(500), p90 = rank(900), p99 = rank(990), p999 = rank(999);
+    uint64_t seen = 0;
+    for (uint32_t b = 0; b < LatencyBuckets::kCount; ++b) {
+        if (buckets[b] == 0) {
+            continue;
+        }
+        const uint64_t before = seen;
+        seen += buckets[b];
+        const uint64_t upper = LatencyBuckets::upperBound(b);
+        if (before < p50 && seen >= p50)   { out.set_p50_ns(upper); }
+        if (before < p90 && seen >= p90)   { out.set_p90_ns(upper); }
+        if (before < p99 && seen >= p99)   { out.set_p99_ns(upper); }
+        if (before < p999 && seen >= p999) { out.set_p999_ns(upper); }
+        out.set_max_ns(upper);
+        ipc::LatencyBucket* bucket = out.add_buckets();
+        bucket->set_upper_ns(upper);
+        bucket->set_count(buckets[b]);
+    }
+}
+
+void Stats::fill(const StatsGauges& gauges, ipc::StatsResponse& response) {
+    auto snapshot = std::make_unique<StatsSnapshot>();
+    pthread_mutex_lock(&mMtx);
+    sumLocked(*snapshot);
+    snapshot->subtract(*mBaseline);
+    const auto windowStart = mWindowStart;
+    pthread_mutex_unlock(&mMtx);
+
+    const int64_t windowNs = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - windowStart).count();
+    response.set_status(ipc::ST_SUCCESS);
+    response.set_window_ms(static_cast<uint64_t>(windowNs / 1000000));
+    response.set_queue_depth(gauges.queueDepth);
+    response.set_jobs_retained(gauges.jobsRetained);
+    response.set_results_spilled(gauges.resultsSpilled);
+    response.set_spill_bytes(gauges.spillBytes);
+    response.set_spill_rejected(gauges.spillRejected);
+    response.set_open_streams(gauges.openStreams);
+    response.set_workers(gauges.workers);
+    const double capacityNs = gauges.workerAliveNs > 0
+        ? static_cast<double>(gauges.workerAliveNs)
+        : static_cast<double>(windowNs) * gauges.workers;
+    if (capacityNs > 0) {
+        response.set_worker_utilization(static_cast<double>(snapshot->workerBusyNs) / capacityNs);
+    }
+    for (const StatsGauges::ClassPool& pool : gauges.classPools) {
+        ipc::ClassPoolStats* out = response.add_class_pools();
+        out->set_name(opClassName(pool.cls));
+        out->set_workers(pool.workers);
+        out->set_workers_max(pool.maxWorkers);
+        out->set_workers_peak(pool.peakWorkers);
+        out->set_queue_depth(pool.queueDepth);
+        const double poolCapacityNs = pool.workerAliveNs > 0
+            ? static_cast<double>(pool.workerAliveNs)
+            : static_cast<double>(windowNs) * pool.workers;
+        if (poolCapacityNs > 0) {
+            out->set_utilization(static_cast<double>(snapshot->classBusyNs[static_cast<int>(pool.cls)]) / poolCapacityNs);
+        }
+    }
+    ipc::DispatchStats* dispatch = response.mutable_dispatch();
+    dispatch->set_inline_blocking(snapshot->dispatched[static_cast<int>(DispatchPath::INLINE)]);
+    dispatch->set_inline_nonblocking(snapshot->dispatched[static_cast<int>(DispatchPath::INLINE_NONBLOCKING)]);
+    dispatch->set_queued(snapshot->dispatched[static_cast<int>(DispatchPath::QUEUED)]);
+    dispatch->set_offloaded(snapshot->dispatched[static_cast<int>(DispatchPath::OFFLOADED)]);
+
+    for (int op = 0; op < kOps; ++op) {
+        uint64_t count = 0;
+        for (int s = 0; s < kStatuses; ++s) {
+            count += snapshot->statuses[op][s];
+        }
+        if (count == 0) {
+            continue;
+        }
+        ipc::OpStats* opStats = response.add_ops();
+        opStats->set_op(statsOpName(static_cast<StatsOp>(op)));
+        opStats->set_count(count);
+        for (int s = 0; s < kStatuses; ++s) {
+            if (snapshot->statuses[op][s] != 0) {
+                ipc::StatusCount* sc = opStats->add_statuses();
+                sc->set_status(static_cast<ipc::Status>(s));
+                sc->set_count(snapshot->statuses[op][s]);
+            }
+        }
+        const int q = static_cast<int>(StatsPhase::QUEUE_WAIT);
+        const int e = static_cast<int>(StatsPhase::EXEC);
+        const int t = static_cast<int>(StatsPhase::TOTAL);
+        fillHistogram(snapshot->buckets[op][q], snapshot->sumNs[op][q], *opStats->mutable_queue_wait());
+        fillHistogram(snapshot->buckets[op][e], snapshot->sumNs[op][e], *opStats->mutable_exec());
+        fillHistogram(snapshot->buckets[op][t], snapshot->sumNs[op][t], *opStats->mutable_total());
+    }
+}
+
+void Stats::reset() {
+    auto baseline = std::make_unique<StatsSnapshot>();
+    pthread_mutex_lock(&mMtx);
+    sumLocked(*baseline);
+    mBaseline = std::move(baseline);
+    mWindowStart = std::chrono::steady_clock::now();
+    pthread_mutex_unlock(&mMtx);
+}
@@ -0,0 +1,182 @@
+#pragma once
+#include "ipc.pb.h"
+#include "config.h"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include <pthread.h>
+
+namespace server {
+
+    /// @brief Operations that are counted separately in the STATS response.
+    enum class StatsOp : uint8_t {
+        ADD = 0,
+        SUB,
+        MUL,
+        DIV,
+        CONCAT,
+        FIND_START,
+        FIND_ANY,
+        EXPR,
+        CALL,
+        REDUCE,
+        GET,
+        GET_MANY,
+        STREAM,
+        PATTERNS,
+        INVALID,
+        COUNT
+    };
+
+    /// @brief Which latency a sample belongs to.
+    enum class StatsPhase : uint8_t {
+        QUEUE_WAIT = 0, ///< From enqueue until a worker picks the job up (NONBLOCKING only).
+        EXEC,           ///< Time spent computing the result.
+        TOTAL,          ///< From arrival at the runner until the result is available.
+        COUNT
+    };
+
+    /// @brief Where a submit was run, see `AlgoRunner::run`.
+    enum class DispatchPath : uint8_t {
+        INLINE = 0,         ///< BLOCKING, run by the calling thread.
+        INLINE_NONBLOCKING, ///< NONBLOCKING but cheap, run by the calling thread and answered with its result.
+        QUEUED,             ///< NONBLOCKING, queued for a worker and answered with a ticket.
+        OFFLOADED,          ///< BLOCKING but expensive, run by a worker and answered when it is done.
+        COUNT
+    };
+
+    /// @return The STATS operation a submit request is counted under.
+    StatsOp statsOpFor(const ipc::SubmitRequest& request);
+
+    /// @return A stable lower-case name for the operation.
+    const char* statsOpName(StatsOp op);
+
+    /// @return The class whose worker pool runs the operation; invalid requests count as MATH.
+    OpClass opClassFor(StatsOp op);
+
+    /// @return The class whose worker pool runs the submit. An expression goes by its most expensive
+    /// node: STRING if it contains a string op, MATH otherwise.
+    OpClass opClassFor(const ipc::SubmitRequest& request);
+
+    /// @return "math", "string" or "bulk", also the names the class_threads setting takes.
+    const char* opClassName(OpClass cls);
+
+    /// @brief Log-linear latency buckets in the style of an HDR histogram.
+    ///
+    /// Values below 8 ns get one bucket each, every following power of two is split into
+    /// 8 sub-buckets, so a bucket's width is at most 12.5% of its lower bound. Values above
+    /// ~2^40 ns (18 minutes) share the last bucket.
+    struct LatencyBuckets {
+        static constexpr uint32_t kSubBuckets = 8;
+        static constexpr uint32_t kMaxExponent = 40;
+        static constexpr uint32_t kCount = (kMaxExponent - 2) * kSubBuckets + kSubBuckets;
+
+        /// @return The bucket a value in nanoseconds is counted in.
+        static uint32_t index(uint64_t ns) {
+            if (ns < kSubBuckets) {
+                return static_cast<uint32_t>(ns);
+            }
+            uint32_t exponent = 63u - static_cast<uint32_t>(__builtin_clzll(ns));
+            if (exponent > kMaxExponent) {
+                return kCount - 1;
+            }
+            const uint32_t sub = static_cast<uint32_t>(ns >> (exponent - 3)) & (kSubBuckets - 1);
+            return (exponent - 2) * kSubBuckets + sub;
+        }
+
+        /// @return The largest value in nanoseconds that lands in the bucket.
+        static uint64_t upperBound(uint32_t bucket) {
+            if (bucket < kSubBuckets) {
+                return bucket;
+            }
+            const uint32_t exponent = bucket / kSubBuckets + 2;
+            const uint64_t sub = bucket % kSubBuckets;
+            const uint64_t lower = (kSubBuckets + sub) << (exponent - 3);
+            return lower + (uint64_t{1} << (exponent - 3)) - 1;
+        }
+    };
+
+    /// @brief Plain copy of every counter, used for baselines and for building the response.
+    struct StatsSnapshot {
+        uint64_t statuses[static_cast<int>(StatsOp::COUNT)][ipc::Status_ARRAYSIZE] = {};
+        uint64_t buckets[static_cast<int>(StatsOp::COUNT)][static_cast<int>(StatsPhase::COUNT)][LatencyBuckets::kCount] = {};
+        uint64_t sumNs[static_cast<int>(StatsOp::COUNT)][static_cast<int>(StatsPhase::COUNT)] = {};
+        uint64_t workerBusyNs = 0;
+        uint64_t classBusyNs[static_cast<int>(OpClass::COUNT)] = {};
+        uint64_t dispatched[static_cast<int>(DispatchPath::COUNT)] = {};
+
+        void subtract(const StatsSnapshot& other);
+    };
+
+    /// @brief Point-in-time values that are read when the STATS request arrives.
+    struct StatsGauges {
+        uint32_t queueDepth = 0;
+        uint32_t jobsRetained = 0;   ///< Held in memory; spilled ones are counted below.
+        uint32_t resultsSpilled = 0;
+        uint64_t spillBytes = 0;
+        uint64_t spillRejected = 0;  ///< Results that stayed in memory because the spill file was full.
+        uint32_t openStreams = 0;
+        uint32_t workers = 0;
+        int64_t workerAliveNs = 0; ///< Summed worker lifetime in the window; 0 assumes `workers` ran throughout.
+
+        /// One class's own pool, listed when the classes do not share one.
+        struct ClassPool {
+            OpClass cls = OpClass::MATH;
+            uint32_t workers = 0;
+            uint32_t maxWorkers = 0;
+            uint32_t peakWorkers = 0;
+            uint32_t queueDepth = 0;
+            int64_t workerAliveNs = 0;
+        };
+        std::vector<ClassPool> classPools;
+    };
+
+    /// @brief Per-thread, always-on request statistics.
+    ///
+    /// Every recording thread owns one slab of counters and is its only writer, so recording
+    /// is a relaxed load and store per counter: no locks, no read-modify-write and no shared
+    /// cache lines. Readers sum the slabs. When a thread exits its slab goes back to the instance
+    /// with its counts intact and the next new thread continues counting in it, so nothing is
+    /// lost and the number of slabs stays at the peak number of recording threads. `reset` never
+    /// touches the slabs, it stores a baseline that later reads subtract.
+    struct Stats {
+        Stats();
+        ~Stats();
+
+        Stats(const Stats&) = delete;
+        Stats& operator=(const Stats&) = delete;
+
+        /// @brief Counts one finished operation.
+        /// @param queueWaitNs Pass a negative value if the operation was not queued.
+        void record(StatsOp op, ipc::Status status, int64_t queueWaitNs, int64_t execNs, int64_t totalNs);
+
+        /// @brief Adds time a worker spent executing jobs of `cls`, for the utilization gauges.
+        void addBusy(int64_t ns, OpClass cls);
+
+        /// @brief Counts one submit that took `path`.
+        void addDispatch(DispatchPath path);
+
+        /// @brief Fills the response with the counters since the last reset.
+        void fill(const StatsGauges& gauges, ipc::StatsResponse& response);
+
+        /// @brief Starts a new window; counters read as zero afterwards.
+        void reset();
+
+    private:
+        struct Slab;
+        struct SlabCache;
+
+        Slab& local();
+        void sumLocked(StatsSnapshot& out);
+
+        const uint64_t mGeneration;                   ///< Distinguishes this instance in thread-local caches.
+        pthread_mutex_t mMtx = PTHREAD_MUTEX_INITIALIZER; ///< Guards the slab list and the baseline, never taken while recording.
+        std::vector<std::unique_ptr<Slab>> mSlabs;
+        std::vector<Slab*> mFreeSlabs;                ///< Slabs of exited threads, handed out before new ones.
+        std::unique_ptr<StatsSnapshot> mBaseline;
+        std::chrono::steady_clock::time_point mWindowStart;
+    };
+
+} // namespace server
@@ -0,0 +1,384 @@
+#include "stream_frontend.h"
+#include "error_handling.h"
+#include "log.h"
+#include "trace.h"
+#include <spdlog/spdlog.h>
+#include <fmt/format.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+using namespace server;
+
+/// Events taken per epoll_wait; one wakeup can carry requests from this many connections.
+static constexpr int kMaxEvents = 64;
+/// Receive buffer growth step and the least free space offered to each read.
+static constexpr std::size_t kReadChunk = 64 * 1024;
+/// Reads per connection and wakeup, so one busy connection cannot starve the others.
+static constexpr int kReadsPerWakeup = 4;
+/// Largest frame, and read step, of a connection that has not passed the handshake, so an
+/// unauthenticated peer cannot make the server commit memory with a large frame header.
+static constexpr std::size_t kMaxHandshakeBytes = 4 * 1024;
+
+StreamFrontend::~StreamFrontend() {
+    close();
+}
+
+int StreamFrontend::init(
+    const framing::Endpoint& endpoint,
+    const char* address,
+    const int port
+) {
+    mTransport = endpoint.transport;
+    if (mTransport == framing::Transport::UNIX) {
+        sockaddr_un addr{};
+        addr.sun_family = AF_UNIX;
+        std::strncpy(addr.sun_path, endpoint.unixPath.c_str(), sizeof(addr.sun_path) - 1);
+        mListenFd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (mListenFd < 0) {
+            spdlog::error("Cannot create the Unix socket: {}", std::strerror(errno));
+            return EC_FAILURE;
+        }
+        // A socket file left behind by a previous run would make bind fail with EADDRINUSE.
+        unlink(endpoint.unixPath.c_str());
+        if (bind(mListenFd, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr)) != 0) {
+            spdlog::error("Cannot bind the Unix socket {}: {}", endpoint.unixPath, std::strerror(errno));
+            close();
+            return EC_FAILURE;
+        }
+        mUnixPath = endpoint.unixPath;
+    } else {
+        addrinfo hints{};
+        hints.ai_family = AF_INET;
+        hints.ai_socktype = SOCK_STREAM;
+        hints.ai_flags = AI_PASSIVE;
+        addrinfo* info = nullptr;
+        const std::string service = std::to_string(port);
+        const int rc = getaddrinfo(address, service.c_str(), &hints, &info);
+        if (rc != 0) {
+            spdlog::error("Cannot resolve {}: {}", address, gai_strerror(rc));
+            return EC_FAILURE;
+        }
+        mListenFd = socket(info->ai_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        const int one = 1;
+        const bool bound = mListenFd >= 0 &&
+            setsockopt(mListenFd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one)) == 0 &&
+            bind(mListenFd, info->ai_addr, info->ai_addrlen) == 0;
+        const int error = errno;
+        freeaddrinfo(info);
+        if (bound == false) {
+            spdlog::error("Cannot bind the TCP frontend at {}:{}: {}", address, port, std::strerror(error));
+            close();
+            return EC_FAILURE;
+        }
+    }
+    if (listen(mListenFd, SOMAXCONN) != 0) {
+        spdlog::error("Cannot listen on the {} frontend: {}", framing::transportName(mTransport), std::strerror(errno));
+        close();
+        return EC_FAILURE;
+    }
+    mEpollFd = epoll_create1(EPOLL_CLOEXEC);
+    epoll_event event{};
+    event.events = EPOLLIN;
+    event.data.fd = mListenFd;
+    if (mEpollFd < 0 || epoll_ctl(mEpollFd, EPOLL_CTL_ADD, mListenFd, &event) != 0) {
+        spdlog::error("Cannot set up epoll: {}", std::strerror(errno));
+        close();
+        return EC_FAILURE;
+    }
+    mWakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    event.data.fd = mWakeFd;
+    if (mWakeFd < 0 || epoll_ctl(mEpollFd, EPOLL_CTL_ADD, mWakeFd, &event) != 0) {
+        spdlog::error("Cannot set up the wakeup eventfd: {}", std::strerror(errno));
+        close();
+        return EC_FAILURE;
+    }
+    spdlog::info("Stream frontend listening on {}", mTransport == framing::Transport::UNIX
+        ? fmt::format("unix:{}", mUnixPath) : fmt::format("tcp://{}:{}", address, port));
+    return EC_SUCCESS;
+}
+
+void StreamFrontend::close() {
+    for (auto& [fd, connection] : mConnections) {
+        ::close(fd);
+    }
+    mConnections.clear();
+    mFds.clear();
+    mWatchFd = -1;
+    if (mWakeFd >= 0) {
+        ::close(mWakeFd);
+        mWakeFd = -1;
+    }
+    if (mEpollFd >= 0) {
+        ::close(mEpollFd);
+        mEpollFd = -1;
+    }
+    if (mListenFd >= 0) {
+        ::close(mListenFd);
+        mListenFd = -1;
+    }
+    if (mUnixPath.empty() == false) {
+        unlink(mUnixPath.c_str());
+        mUnixPath.clear();
+    }
+}
+
+int StreamFrontend::watch(const int fd) {
+    epoll_event event{};
+    event.events = EPOLLIN;
+    event.data.fd = fd;
+    if (epoll_ctl(mEpollFd, EPOLL_CTL_ADD, fd, &event) != 0) {
+        spdlog::error("Cannot watch fd {}: {}", fd, std::strerror(errno));
+        return EC_FAILURE;
+    }
+    mWatchFd = fd;
+    return EC_SUCCESS;
+}
+
+void StreamFrontend::interrupt() {
+    const uint64_t one = 1;
+    // Stays readable until `close`, so every later wait returns at once too.
+    ssize_t written = write(mWakeFd, &one, sizeof(one));
+    (void)written;
+}
+
+int StreamFrontend::run(
+    const std::atomic<bool>& stop,
+    const int64_t busyPollNs,
+    busypoll::Counters& pollCounters,
+    const FrameHandler& onFrame,
+    const CloseHandler& onClose,
+    const IdleHandler& onIdle
+) {
+    epoll_event events[kMaxEvents];
+    while (stop.load(std::memory_order_relaxed) == false) {
+        const int timeoutMs = onIdle();
+        int ready = 0;
+        {
+            IPC_TRACE_SCOPE("recv");
+            if (busyPollNs > 0) {
+                busypoll::spin(busyPollNs, pollCounters, [&] {
+                    ready = epoll_wait(mEpollFd, events, kMaxEvents, 0);
+                    return ready != 0;
+                });
+            }
+            if (ready == 0) {
+                ready = epoll_wait(mEpollFd, events, kMaxEvents, timeoutMs);
+            }
+        }
+        if (ready < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            spdlog::error("epoll_wait failed: {}", std::strerror(errno));
+            return EC_FAILURE;
+        }
+        for (int i = 0; i < ready; ++i) {
+            const int fd = events[i].data.fd;
+            if (fd == mListenFd) {
+                acceptAll();
+                continue;
+            }
+            if (fd == mWatchFd || fd == mWakeFd) {
+                continue; // `onIdle` and the stop flag are checked before the next wait.
+            }
+            auto it = mConnections.find(fd);
+            if (it == mConnections.end()) {
+                continue;
+            }
+            Connection& connection = it->second;
+            bool alive = true;
+            if ((events[i].events & EPOLLOUT) != 0) {
+                alive = flush(connection);
+            }
+            if (alive && connection.writeBlocked == false && (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) != 0) {
+                alive = readFrames(connection, onFrame) && flush(connection);
+            }
+            if (alive == false) {
+                drop(fd, onClose);
+            }
+        }
+    }
+    spdlog::info("Stream frontend stopped with {} open connections", mConnections.size());
+    return EC_SUCCESS;
+}
+
+void StreamFrontend::acceptAll() {
+    for (;;) {
+        const int fd = accept4(mListenFd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                IPC_LOG_RATE_LIMITED(1000, spdlog::level::err, "accept failed: {}", std::strerror(errno));
+            }
+            return;
+        }
+        if (mTransport == framing::Transport::TCP) {
+            // Replies are complete frames; waiting for more data to coalesce only adds latency.
+            const int one = 1;
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        }
+        epoll_event event{};
+        event.events = EPOLLIN;
+        event.data.fd = fd;
+        if (epoll_ctl(mEpollFd, EPOLL_CTL_ADD, fd, &event) != 0) {
+            spdlog::error("Cannot watch a new connection: {}", std::strerror(errno));
+            ::close(fd);
+            continue;
+        }
+        Connection connection;
+        connection.fd = fd;
+        connection.id = fmt::format("{}#{}", framing::transportName(mTransport), ++mAccepted);
+        IPC_LOG_DEBUG("Accepted {} (fd {})", connection.id, fd);
+        mFds.emplace(connection.id, fd);
+        mConnections.emplace(fd, std::move(connection));
+    }
+}
+
+bool StreamFrontend::readFrames(
+    Connection& connection,
+    const FrameHandler& onFrame
+) {
+    const std::size_t chunk = connection.admitted ? kReadChunk : kMaxHandshakeBytes;
+    for (int reads = 0; reads < kReadsPerWakeup; ++reads) {
+        if (connection.in.size() - connection.inEnd < chunk) {
+            // Grows with the bytes that actually arrived, doubling so a large frame is not copied chunk by chunk.
+            connection.in.resize(std::max(connection.inEnd + chunk, connection.admitted ? 2 * connection.in.size() : 0));
+        }
+        const std::size_t space = connection.in.size() - connection.inEnd;
+        const ssize_t n = recv(connection.fd, connection.in.data() + connection.inEnd, space, 0);
+        if (n > 0) {
+            connection.inEnd += static_cast<std::size_t>(n);
+            if (static_cast<std::size_t>(n) < space) {
+                break; // Drained.
+            }
+            continue;
+        }
+        if (n == 0) {
+            IPC_LOG_DEBUG("{} closed the connection", connection.id);
+            return false;
+        }
+        if (errno == EINTR) {
+            continue;
+        }
+        if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            break;
+        }
+        IPC_LOG_RATE_LIMITED(1000, spdlog::level::warn, "Receive from {} failed: {}", connection.id, std::strerror(errno));
+        return false;
+    }
+
+    std::size_t pos = 0;
+    while (connection.inEnd - pos >= framing::kHeaderBytes) {
+        const uint32_t size = framing::readHeader(connection.in.data() + pos);
+        if (size > (connection.admitted ? framing::kMaxFrameBytes : kMaxHandshakeBytes)) {
+            IPC_LOG_RATE_LIMITED(1000, spdlog::level::err, "Frame of {} bytes from {} exceeds the limit, closing", size, connection.id);
+            return false;
+        }
+        if (connection.inEnd - pos - framing::kHeaderBytes < size) {
+            break;
+        }
+        mReply.clear();
+        if (onFrame(connection.id, connection.in.data() + pos + framing::kHeaderBytes, size, mReply)) {
+            framing::appendHeader(connection.out, static_cast<uint32_t>(mReply.size()));
+            connection.out.append(mReply);
+        }
+        pos += framing::kHeaderBytes + size;
+    }
+    if (pos > 0) {
+        std::memmove(connection.in.data(), connection.in.data() + pos, connection.inEnd - pos);
+        connection.inEnd -= pos;
+    }
+    return true;
+}
+
+bool StreamFrontend::flush(Connection& connection) {
+    IPC_TRACE_SCOPE("send");
+    while (connection.outOffset < connection.out.size()) {
+        const ssize_t n = send(connection.fd, connection.out.data() + connection.outOffset,
+            connection.out.size() - connection.outOffset, MSG_NOSIGNAL);
+        if (n >= 0) {
+            connection.outOffset += static_cast<std::size_t>(n);
+            continue;
+        }
+        if (errno == EINTR) {
+            continue;
+        }
+        if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            if (connection.writeBlocked == false) {
+                epoll_event event{};
+                event.events = EPOLLOUT;
+                event.data.fd = connection.fd;
+                epoll_ctl(mEpollFd, EPOLL_CTL_MOD, connection.fd, &event);
+                connection.writeBlocked = true;
+            }
+            return true;
+        }
+        IPC_LOG_RATE_LIMITED(1000, spdlog::level::warn, "Send to {} failed: {}", connection.id, std::strerror(errno));
+        return false;
+    }
+    connection.out.clear();
+    connection.outOffset = 0;
+    if (connection.writeBlocked) {
+        epoll_event event{};
+        event.events = EPOLLIN;
+        event.data.fd = connection.fd;
+        epoll_ctl(mEpollFd, EPOLL_CTL_MOD, connection.fd, &event);
+        connection.writeBlocked = false;
+    }
+    return true;
+}
+
+void StreamFrontend::drop(
+    int fd,
+    const CloseHandler& onClose
+) {
+    auto it = mConnections.find(fd);
+    if (it == mConnections.end()) {
+        return;
+    }
+    onClose(it->second.id);
+    mFds.erase(it->second.id);
+    epoll_ctl(mEpollFd, EPOLL_CTL_DEL, fd, nullptr);
+    ::close(fd);
+    mConnections.erase(it);
+}
+
+void StreamFrontend::admit(const std::string& clientId) {
+    auto fdIt = mFds.find(clientId);
+    if (fdIt != mFds.end()) {
+        mConnections.at(fdIt->second).admitted = true;
+    }
+}
+
+bool StreamFrontend::sendTo(
+    const std::string& clientId,
+    const std::string& reply
+) {
+    auto fdIt = mFds.find(clientId);
+    if (fdIt == mFds.end()) {
+        return false;
+    }
+    Connection& connection = mConnections.at(fdIt->second);
+    framing::appendHeader(connection.out, static_cast<uint32_t>(reply.size()));
+    connection.out.append(reply);
+    if (connection.writeBlocked) {
+        return true; // EPOLLOUT sends it with the rest.
+    }
+    if (flush(connection) == false) {
+        // Dropping needs the close handler of `run`; a shut down socket reports EPOLLHUP there.
+        shutdown(connection.fd, SHUT_RDWR);
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,124 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include "framing.h"
+#include "busy_poll.h"
+
+namespace server {
+
+    /// @brief epoll frontend for TCP and Unix stream sockets speaking `framing` frames.
+    ///
+    /// An alternative to the ZMQ ROUTER: the router thread reads and writes the sockets itself,
+    /// so requests skip ZeroMQ's I/O thread, its internal pipes and the per-frame message copies.
+    /// All frames that arrived on a connection are handled in one pass and their replies leave
+    /// with one send. Each connection keeps its input and output buffers for its lifetime, so a
+    /// steady request stream does not allocate. Single-threaded like the ROUTER loop it replaces.
+    struct StreamFrontend {
+        /// @brief Called for every complete frame.
+        /// @param reply Receives the reply payload, without the frame header.
+        /// @return true if `reply` should be sent.
+        using FrameHandler = std::function<bool(const std::string& clientId, const char* data, std::size_t size, std::string& reply)>;
+        /// @brief Called when a connection is gone, so per-client state can be dropped.
+        using CloseHandler = std::function<void(const std::string& clientId)>;
+        /// @brief Called before every wait, and when the fd passed to `watch` is readable.
+        /// @return How long the wait may block in ms, -1 for no limit.
+        using IdleHandler = std::function<int()>;
+
+        StreamFrontend() = default;
+        StreamFrontend(const StreamFrontend&) = delete;
+        StreamFrontend& operator=(const StreamFrontend&) = delete;
+
+        /// @brief Closes every socket and removes the Unix socket file.
+        ~StreamFrontend();
+
+        /// @brief Binds and listens.
+        /// @param endpoint Transport::TCP binds to address:port, Transport::UNIX to the socket path.
+        /// @return An error code, 0 for success.
+        int init(
+            const framing::Endpoint& endpoint,
+            const char* address,
+            const int port
+        );
+
+        /// @brief Makes a readable `fd` end the wait of `run`, e.g. an eventfd of another thread. `fd` stays owned by the caller.
+        /// @return An error code, 0 for success.
+        int watch(const int fd);
+
+        /// @brief Serves connections until `stop` is set (a signal interrupts the wait).
+        /// @param busyPollNs Polls epoll without blocking this long before each blocking wait, see `busypoll`.
+        /// @return An error code, 0 for a requested stop.
+        int run(
+            const std::atomic<bool>& stop,
+            const int64_t busyPollNs,
+            busypoll::Counters& pollCounters,
+            const FrameHandler& onFrame,
+            const CloseHandler& onClose,
+            const IdleHandler& onIdle
+        );
+
+        /// @brief Sends a reply that was not produced by `onFrame`, e.g. a deferred one. Only from the `run` thread.
+        /// @return false if the client is gone or its connection broke; it is closed on the next wakeup.
+        bool sendTo(
+            const std::string& clientId,
+            const std::string& reply
+        );
+
+        /// @brief Lifts the small frame limit of a connection once its client passed the handshake.
+        /// Only from the `run` thread, e.g. inside `onFrame`.
+        void admit(const std::string& clientId);
+
+        /// @brief Wakes `run` from another thread so it sees its stop flag.
+        void interrupt();
+
+        /// @brief Closes every socket, safe to call more than once.
+        void close();
+
+    private:
+        struct Connection {
+            int fd = -1;
+            std::string id;            ///< Client id handed to the handlers, e.g. "tcp#3".
+            std::string in;            ///< Received bytes; only the first `inEnd` are valid.
+            std::size_t inEnd = 0;
+            std::string out;           ///< Framed replies not yet accepted by the kernel.
+            std::size_t outOffset = 0;
+            bool writeBlocked = false; ///< Waiting for EPOLLOUT; reading pauses so a client that does not read gets backpressure.
+            bool admitted = false;     ///< Passed the handshake, see `admit`; frames are capped at a few KB until then.
+        };
+
+        /// @brief Accepts every pending connection.
+        void acceptAll();
+
+        /// @brief Reads what is available and hands every complete frame to `onFrame`.
+        /// @return false if the connection has to be closed.
+        bool readFrames(
+            Connection& connection,
+            const FrameHandler& onFrame
+        );
+
+        /// @brief Sends the pending replies, switching to EPOLLOUT when the socket is full.
+        /// @return false if the connection has to be closed.
+        bool flush(Connection& connection);
+
+        /// @brief Closes the connection and forgets it.
+        void drop(
+            int fd,
+            const CloseHandler& onClose
+        );
+
+        framing::Transport mTransport = framing::Transport::TCP;
+        std::string mUnixPath;                               ///< Removed again in `close`.
+        int mListenFd = -1;
+        int mEpollFd = -1;
+        uint64_t mAccepted = 0;                              ///< Numbers the client ids.
+        int mWatchFd = -1;                                   ///< See `watch`.
+        int mWakeFd = -1;                                    ///< eventfd behind `interrupt`.
+        std::unordered_map<int, Connection> mConnections;    ///< Indexed by socket.
+        std::unordered_map<std::string, int> mFds;           ///< Socket of each client id, for `sendTo`.
+        std::string mReply;                                  ///< Reply scratch, reused so encoding does not allocate.
+    };
+
+} // namespace server
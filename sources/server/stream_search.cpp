@@ -0,0 +1,48 @@
+#include "stream_search.h"
+
+using namespace server;
+
+StreamSearch::StreamSearch(std::string needle)
+: mNeedle(std::move(needle)) {
+    if (mNeedle.empty()) {
+        mPosition = 0;
+    }
+    mTail.reserve(mNeedle.size());
+    mWindow.reserve(2 * mNeedle.size());
+}
+
+bool StreamSearch::feed(std::string_view chunk) {
+    if (found()) {
+        return true;
+    }
+    const std::size_t overlap = mNeedle.size() - 1;
+
+    // Matches that start in the carried tail and end in this chunk.
+    if (mTail.empty() == false) {
+        mWindow.assign(mTail);
+        mWindow.append(chunk.substr(0, overlap));
+        const std::size_t pos = mWindow.find(mNeedle);
+        if (pos != std::string::npos) {
+            mPosition = static_cast<int64_t>(mConsumed - mTail.size() + pos);
+            return true;
+        }
+    }
+
+    // Matches fully inside this chunk.
+    const std::size_t pos = chunk.find(mNeedle);
+    if (pos != std::string_view::npos) {
+        mPosition = static_cast<int64_t>(mConsumed + pos);
+        return true;
+    }
+
+    if (chunk.size() >= overlap) {
+        mTail.assign(chunk.substr(chunk.size() - overlap));
+    } else {
+        mTail.append(chunk);
+        if (mTail.size() > overlap) {
+            mTail.erase(0, mTail.size() - overlap);
+        }
+    }
+    mConsumed += chunk.size();
+    return false;
+}
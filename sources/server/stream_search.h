@@ -0,0 +1,37 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace server {
+
+    /// @brief Incremental substring search over a haystack that arrives in chunks.
+    ///
+    /// Only the last `needle.size() - 1` bytes of the previous chunks are kept, so memory
+    /// stays bounded by the needle length no matter how large the haystack is.
+    struct StreamSearch {
+        explicit StreamSearch(std::string needle);
+
+        /// @brief Searches the next chunk of the haystack.
+        /// @param chunk The next bytes of the haystack, in order.
+        /// @return true once the needle has been found, `position()` is valid from then on.
+        bool feed(std::string_view chunk);
+
+        /// @return true if the needle has been found.
+        bool found() const { return mPosition >= 0; }
+
+        /// @return The offset of the first match in the whole haystack, or -1.
+        int64_t position() const { return mPosition; }
+
+        /// @return The number of haystack bytes consumed so far.
+        uint64_t consumed() const { return mConsumed; }
+
+    private:
+        const std::string mNeedle;
+        std::string mTail;       ///< Overlap carried into the next chunk, at most needle.size() - 1 bytes.
+        std::string mWindow;     ///< Scratch buffer for the boundary search, reused between chunks.
+        uint64_t mConsumed = 0;  ///< Haystack bytes consumed before the current chunk.
+        int64_t mPosition = -1;
+    };
+
+} // namespace server
@@ -0,0 +1,302 @@
+#include "worker_pool.h"
+#include "trace.h"
+#include "error_handling.h"
+#include <spdlog/spdlog.h>
+#include <fmt/format.h>
+#include <algorithm>
+#include <cerrno>
+#include <utility>
+#include <time.h>
+
+using namespace server;
+
+/// steady_clock is CLOCK_MONOTONIC on Linux, so its time points can be used as condvar deadlines.
+static timespec toTimespec(std::chrono::steady_clock::time_point tp) {
+    using namespace std::chrono;
+    const auto ns = duration_cast<nanoseconds>(tp.time_since_epoch()).count();
+    timespec ts;
+    ts.tv_sec = static_cast<time_t>(ns / 1000000000);
+    ts.tv_nsec = static_cast<long>(ns % 1000000000);
+    return ts;
+}
+
+static void initMonotonicCond(pthread_cond_t& cv) {
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&cv, &attr);
+    pthread_condattr_destroy(&attr);
+}
+
+WorkerPool::WorkerPool(const std::string& name, int minThreads, int maxThreads, const Config& config, Handler handler)
+: mThreadPrefix(name.empty() ? "worker" : name)
+, mLogName(name.empty() ? "Worker pool" : "Worker pool " + name)
+, mMinThreads(static_cast<uint32_t>(std::clamp(minThreads, 1, std::max(maxThreads, 1))))
+, mMaxThreads(static_cast<uint32_t>(std::max(maxThreads, 1)))
+, mGrowWait(std::chrono::microseconds(config.poolGrowWaitUs))
+, mGrowDepth(std::max<uint32_t>(config.poolGrowDepth, 1))
+, mIdleTimeout(config.poolIdleMs)
+, mHandler(std::move(handler))
+, mPlacement{config.workerCpus, config.numaNode, 0} {
+    initMonotonicCond(mWorkCv);
+    initMonotonicCond(mControlCv);
+}
+
+WorkerPool::~WorkerPool() {
+    stop();
+    pthread_cond_destroy(&mControlCv);
+    pthread_cond_destroy(&mWorkCv);
+}
+
+void* WorkerPool::workerCExecution(void* arg) {
+    static_cast<WorkerPool*>(arg)->workerLoop();
+    return nullptr;
+}
+
+void* WorkerPool::controllerCExecution(void* arg) {
+    static_cast<WorkerPool*>(arg)->controllerLoop();
+    return nullptr;
+}
+
+int WorkerPool::start() {
+    pthread_mutex_lock(&mMtx);
+    if (mRunning) {
+        pthread_mutex_unlock(&mMtx);
+        return EC_SUCCESS;
+    }
+    mRunning = true;
+    const auto now = std::chrono::steady_clock::now();
+    mWindowStart = now;
+    mLastResize = now;
+    for (uint32_t i = 0; i < mMinThreads; ++i) {
+        if (spawnLocked() == false) {
+            break;
+        }
+    }
+    const std::size_t workers = mWorkers.size();
+    const bool started = workers > 0;
+    if (started && mMinThreads < mMaxThreads) {
+        mControllerStarted = pthread_create(&mController, nullptr, &WorkerPool::controllerCExecution, this) == 0;
+        if (mControllerStarted == false) {
+            spdlog::error("Failed to create the controller of {}, the pool stays at {} threads", mLogName, workers);
+        }
+    }
+    // Growth before this point is the initial size, not a resize.
+    mGrows = 0;
+    mPeak = static_cast<uint32_t>(workers);
+    mResizes.clear();
+    pthread_mutex_unlock(&mMtx);
+    if (started == false) {
+        stop();
+        spdlog::error("{}: failed to create any worker thread", mLogName);
+        return EC_FAILURE;
+    }
+    spdlog::info("{} started with {} threads (min {}, max {})", mLogName, workers, mMinThreads, mMaxThreads);
+    return EC_SUCCESS;
+}
+
+void WorkerPool::stop() {
+    pthread_mutex_lock(&mMtx);
+    mRunning = false;
+    pthread_mutex_unlock(&mMtx);
+    pthread_cond_broadcast(&mWorkCv);
+    pthread_cond_broadcast(&mControlCv);
+
+    if (mControllerStarted) {
+        pthread_join(mController, nullptr);
+        mControllerStarted = false;
+    }
+    // Workers exit once the queue is empty; the controller is gone, so nobody else touches the lists.
+    pthread_mutex_lock(&mMtx);
+    std::vector<pthread_t> threads = std::move(mWorkers);
+    threads.insert(threads.end(), mExited.begin(), mExited.end());
+    mWorkers.clear();
+    mExited.clear();
+    pthread_mutex_unlock(&mMtx);
+    for (pthread_t& t : threads) {
+        pthread_join(t, nullptr);
+    }
+}
+
+void WorkerPool::submit(std::shared_ptr<Task> task) {
+    pthread_mutex_lock(&mMtx);
+    task->queuedAhead = static_cast<uint32_t>(mQueue.size());
+    mQueue.push(std::move(task));
+    const bool wakeController = needsWorkerLocked();
+    pthread_mutex_unlock(&mMtx);
+
+    pthread_cond_signal(&mWorkCv);
+    if (wakeController) {
+        pthread_cond_signal(&mControlCv);
+    }
+}
+
+void WorkerPool::snapshot(WorkerPoolSnapshot& out) {
+    const auto now = std::chrono::steady_clock::now();
+    pthread_mutex_lock(&mMtx);
+    const uint32_t workers = static_cast<uint32_t>(mWorkers.size());
+    out.workers = workers;
+    out.minWorkers = mMinThreads;
+    out.maxWorkers = mMaxThreads;
+    out.peakWorkers = std::max(mPeak, workers);
+    out.queueDepth = static_cast<uint32_t>(mQueue.size());
+    out.grows = mGrows;
+    out.retires = mRetires;
+    out.workerAliveNs = mAliveNs + std::chrono::duration_cast<std::chrono::nanoseconds>(now - mLastResize).count() * workers;
+    out.resizes.assign(mResizes.begin(), mResizes.end());
+    pthread_mutex_unlock(&mMtx);
+}
+
+void WorkerPool::resetWindow() {
+    const auto now = std::chrono::steady_clock::now();
+    pthread_mutex_lock(&mMtx);
+    mWindowStart = now;
+    mLastResize = now;
+    mAliveNs = 0;
+    mGrows = 0;
+    mRetires = 0;
+    mPeak = static_cast<uint32_t>(mWorkers.size());
+    mResizes.clear();
+    pthread_mutex_unlock(&mMtx);
+}
+
+/// Queued jobs outnumber the workers that are idle or about to wake up for them.
+bool WorkerPool::needsWorkerLocked() const {
+    return mRunning && mQueue.size() > mIdle && mWorkers.size() < mMaxThreads;
+}
+
+void WorkerPool::resizedLocked(uint32_t workers, std::chrono::steady_clock::time_point now) {
+    mLastResize = now;
+    mPeak = std::max(mPeak, workers);
+    if (mResizes.size() == kMaxResizes) {
+        mResizes.pop_front();
+    }
+    mResizes.push_back({std::chrono::duration_cast<std::chrono::nanoseconds>(now - mWindowStart).count(), workers});
+}
+
+bool WorkerPool::spawnLocked() {
+    const auto now = std::chrono::steady_clock::now();
+    pthread_t tid;
+    if (pthread_create(&tid, nullptr, &WorkerPool::workerCExecution, this) != 0) {
+        spdlog::error("{}: failed to create worker thread {}", mLogName, mWorkers.size());
+        return false;
+    }
+    mAliveNs += std::chrono::duration_cast<std::chrono::nanoseconds>(now - mLastResize).count() * mWorkers.size();
+    mWorkers.emplace_back(tid);
+    ++mGrows;
+    resizedLocked(static_cast<uint32_t>(mWorkers.size()), now);
+    return true;
+}
+
+void WorkerPool::workerLoop() {
+    pthread_mutex_lock(&mMtx);
+    uint32_t number = mNextWorker;
+    if (mFreeNumbers.empty() == false) {
+        number = mFreeNumbers.back();
+        mFreeNumbers.pop_back();
+    } else {
+        ++mNextWorker;
+    }
+    pthread_mutex_unlock(&mMtx);
+    IPC_TRACE_THREAD_NAME(fmt::format("{}-{}", mThreadPrefix, number).c_str());
+    // A misplaced worker still serves jobs; the failure is logged.
+    (void)affinity::applyToCurrentThread(mPlacement, mThreadPrefix.c_str());
+
+    pthread_mutex_lock(&mMtx);
+    while (true) {
+        if (mQueue.empty()) {
+            if (mRunning == false) {
+                break;
+            }
+            const timespec deadline = toTimespec(std::chrono::steady_clock::now() + mIdleTimeout);
+            int rc = 0;
+            ++mIdle;
+            while (mRunning && mQueue.empty() && rc != ETIMEDOUT) {
+                rc = pthread_cond_timedwait(&mWorkCv, &mMtx, &deadline);
+            }
+            --mIdle;
+            if (mQueue.empty() == false || mRunning == false) {
+                continue;
+            }
+            if (mWorkers.size() > mMinThreads) {
+                const auto now = std::chrono::steady_clock::now();
+                mAliveNs += std::chrono::duration_cast<std::chrono::nanoseconds>(now - mLastResize).count() * mWorkers.size();
+                mWorkers.erase(std::find_if(mWorkers.begin(), mWorkers.end(),
+                    [] (pthread_t t) { return pthread_equal(t, pthread_self()); }));
+                mExited.emplace_back(pthread_self());
+                mFreeNumbers.push_back(number);
+                ++mRetires;
+                resizedLocked(static_cast<uint32_t>(mWorkers.size()), now);
+                const uint32_t workers = static_cast<uint32_t>(mWorkers.size());
+                pthread_mutex_unlock(&mMtx);
+                pthread_cond_signal(&mControlCv);
+                spdlog::info("{} shrank to {} threads after {} ms idle", mLogName, workers, mIdleTimeout.count());
+                return;
+            }
+            continue;
+        }
+        std::shared_ptr<Task> task = mQueue.pop();
+        pthread_mutex_unlock(&mMtx);
+        task->worker = number;
+        mHandler(task);
+        task.reset();
+        pthread_mutex_lock(&mMtx);
+    }
+    pthread_mutex_unlock(&mMtx);
+}
+
+void WorkerPool::controllerLoop() {
+    IPC_TRACE_THREAD_NAME("pool-controller");
+    std::vector<pthread_t> exited;
+    pthread_mutex_lock(&mMtx);
+    while (mRunning) {
+        if (mExited.empty() == false) {
+            exited.swap(mExited);
+            pthread_mutex_unlock(&mMtx);
+            for (pthread_t& t : exited) {
+                pthread_join(t, nullptr);
+            }
+            exited.clear();
+            pthread_mutex_lock(&mMtx);
+            continue;
+        }
+
+        bool hasDeadline = false;
+        timespec deadline{};
+        if (needsWorkerLocked()) {
+            const auto now = std::chrono::steady_clock::now();
+            const auto oldest = mQueue.oldestEnqueuedAt();
+            const auto growAt = oldest + mGrowWait;
+            if (mQueue.size() >= mGrowDepth || now >= growAt) {
+                // One thread per job that has no worker coming, within the bound.
+                const std::size_t missing = std::min<std::size_t>(mQueue.size() - mIdle, mMaxThreads - mWorkers.size());
+                std::size_t started = 0;
+                while (started < missing && spawnLocked()) {
+                    ++started;
+                }
+                const uint32_t workers = static_cast<uint32_t>(mWorkers.size());
+                const std::size_t depth = mQueue.size();
+                const auto waitedUs = std::chrono::duration_cast<std::chrono::microseconds>(now - oldest).count();
+                pthread_mutex_unlock(&mMtx);
+                if (started == 0) {
+                    // Creating threads fails; back off instead of spinning on the same decision.
+                    timespec pause = toTimespec(std::chrono::steady_clock::now() + mIdleTimeout);
+                    pthread_mutex_lock(&mMtx);
+                    pthread_cond_timedwait(&mControlCv, &mMtx, &pause);
+                    continue;
+                }
+                spdlog::info("{} grew to {} threads (queue depth {}, oldest job waited {} us)", mLogName, workers, depth, waitedUs);
+                pthread_mutex_lock(&mMtx);
+                continue;
+            }
+            deadline = toTimespec(growAt);
+            hasDeadline = true;
+        }
+        if (hasDeadline) {
+            pthread_cond_timedwait(&mControlCv, &mMtx, &deadline);
+        } else {
+            pthread_cond_wait(&mControlCv, &mMtx);
+        }
+    }
+    pthread_mutex_unlock(&mMtx);
+}
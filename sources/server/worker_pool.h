@@ -0,0 +1,134 @@
+#pragma once
+#include "config.h"
+#include "affinity.h"
+#include "fair_queue.h"
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+#include <pthread.h>
+
+namespace server {
+
+    /// @brief Pool size and resize history over the current window, see `WorkerPool::snapshot`.
+    struct WorkerPoolSnapshot {
+        struct Resize {
+            int64_t atNs = 0;     ///< Since the start of the window.
+            uint32_t workers = 0; ///< Pool size after the change.
+        };
+
+        uint32_t workers = 0;
+        uint32_t minWorkers = 0;
+        uint32_t maxWorkers = 0;
+        uint32_t peakWorkers = 0;  ///< Largest size seen in the window.
+        uint32_t queueDepth = 0;
+        uint64_t grows = 0;        ///< Threads started in the window.
+        uint64_t retires = 0;      ///< Idle threads that exited in the window.
+        int64_t workerAliveNs = 0; ///< Sum of every worker's lifetime in the window.
+        std::vector<Resize> resizes; ///< The most recent changes in the window, oldest first.
+    };
+
+    /// @brief A job queue served by between `minThreads` and `maxThreads` pthreads.
+    ///
+    /// Jobs are grouped into flows, one per client, and the flows share the workers by deficit
+    /// round robin in proportion to their weights (see `FairQueue`), so a client that floods
+    /// the queue only delays its own jobs.
+    ///
+    /// A controller thread starts workers while queued jobs outnumber the idle workers and either
+    /// the queue holds `poolGrowDepth` jobs or the oldest job has waited `poolGrowWaitUs`. It sleeps
+    /// until the next such deadline instead of polling. A worker that finds no job for `poolIdleMs`
+    /// exits as long as the pool stays at or above `minThreads`. With equal bounds the pool is fixed.
+    /// A new worker takes the number, statistics slab and trace ring of a retired one, so a pool
+    /// that keeps growing and shrinking holds per-thread state only for its peak size.
+    /// Workers run on `workerCpus` and allocate on `numaNode` when those are configured.
+    struct WorkerPool {
+        /// @brief Base of every queued job; the pool reads the enqueue time and the scheduling fields
+        /// and fills in where the job ran.
+        struct Task {
+            std::chrono::steady_clock::time_point enqueuedAt;
+            uint64_t flow = 0;    ///< Client the job is queued for; one flow's jobs start in FIFO order.
+            uint32_t weight = 1;  ///< Share of the workers `flow` gets while other flows are backlogged too.
+            uint32_t cost = 1;    ///< Credit the job takes from its flow's turn, in units of work; see `FairQueue`.
+            bool urgent = false;  ///< Runs before every flow, for work that a running job waits on.
+            uint8_t kind = 0;     ///< Lets the handler tell its task types apart; the pool ignores it.
+            uint32_t queuedAhead = 0; ///< Set by `submit`: jobs already queued in the pool.
+            uint32_t worker = 0;      ///< Set before the handler runs: number of the worker, see `threadPrefix`.
+        };
+
+        /// Runs one job on a worker thread, without any pool lock held.
+        using Handler = std::function<void(std::shared_ptr<Task>& task)>;
+
+        /// @param name Names the pool in logs and its threads in traces; empty for "worker".
+        WorkerPool(const std::string& name, int minThreads, int maxThreads, const Config& config, Handler handler);
+        ~WorkerPool();
+
+        WorkerPool(const WorkerPool&) = delete;
+        WorkerPool& operator=(const WorkerPool&) = delete;
+
+        /// @brief Starts `minThreads` workers and the controller.
+        /// @return EC_SUCCESS, or EC_FAILURE if no thread could be started.
+        int start();
+
+        /// @brief Lets the workers drain the queue, then joins every thread.
+        void stop();
+
+        /// @brief Queues a job; `enqueuedAt` must already be set.
+        void submit(std::shared_ptr<Task> task);
+
+        /// @brief Copies the current size and the counters since the last `resetWindow`.
+        void snapshot(WorkerPoolSnapshot& out);
+
+        /// @brief Starts a new window for the counters and the resize history.
+        void resetWindow();
+
+        /// @return The name prefix of the worker threads, which are `<prefix>-<Task::worker>`.
+        const std::string& threadPrefix() const { return mThreadPrefix; }
+
+    private:
+        static constexpr std::size_t kMaxResizes = 64;
+
+        static void* workerCExecution(void* arg);
+        static void* controllerCExecution(void* arg);
+
+        void workerLoop();
+        void controllerLoop();
+        bool spawnLocked();
+        void resizedLocked(uint32_t workers, std::chrono::steady_clock::time_point now);
+        bool needsWorkerLocked() const;
+
+        const std::string mThreadPrefix; ///< Worker threads are named `<prefix>-<number>`.
+        const std::string mLogName;      ///< "Worker pool" or "Worker pool <name>".
+        const uint32_t mMinThreads;
+        const uint32_t mMaxThreads;
+        const std::chrono::nanoseconds mGrowWait;
+        const uint32_t mGrowDepth;
+        const std::chrono::milliseconds mIdleTimeout;
+        const Handler mHandler;
+        const affinity::Placement mPlacement; ///< Applied by every worker when it starts.
+
+        pthread_mutex_t mMtx = PTHREAD_MUTEX_INITIALIZER; ///< Guards everything below.
+        pthread_cond_t mWorkCv;    ///< Workers wait here for jobs, CLOCK_MONOTONIC.
+        pthread_cond_t mControlCv; ///< The controller waits here, CLOCK_MONOTONIC.
+        FairQueue<Task> mQueue;
+        std::vector<pthread_t> mWorkers; ///< Live workers.
+        std::vector<pthread_t> mExited;  ///< Retired workers the controller has not joined yet.
+        pthread_t mController{};
+        bool mControllerStarted = false;
+        bool mRunning = false;
+        uint32_t mIdle = 0;              ///< Workers waiting for a job.
+        uint32_t mNextWorker = 0;        ///< Numbers the workers in logs and trace dumps.
+        std::vector<uint32_t> mFreeNumbers; ///< Numbers of retired workers, taken by new ones first.
+
+        std::chrono::steady_clock::time_point mWindowStart;
+        std::chrono::steady_clock::time_point mLastResize;
+        int64_t mAliveNs = 0;            ///< Worker lifetime up to mLastResize, since the window start.
+        uint64_t mGrows = 0;
+        uint64_t mRetires = 0;
+        uint32_t mPeak = 0;
+        std::deque<WorkerPoolSnapshot::Resize> mResizes;
+    };
+
+} // namespace server
@@ -100,14 +100,13 @@ def _probe_tcp(host: str, port: int, timeout_s=6.0) -> bool:
         time.sleep(0.05)
     return False
 
-@pytest.fixture(scope="session")
-def server(tmp_path_factory):
+def _launch_server(argv, default_port=DEFAULT_PORT):
     """
-    A Pytest fixture that starts the server process before tests run and stops it afterwards.
-    The scope is "session", meaning the server is started once for all tests in the session.
+    Starts a server process with the given arguments and waits until it accepts connections.
+    Returns a dictionary with the process, host, port, and output reader.
     """
     proc = subprocess.Popen(
-        [str(SERVER_BIN)],
+        [str(SERVER_BIN), *argv],
         stdout=subprocess.PIPE,
         stderr=subprocess.STDOUT,
         text=True
@@ -128,23 +127,44 @@ def server(tmp_path_factory):
             raise RuntimeError(f"Parsed endpoint '{endpoint}' but port didn’t open.\n{rd.dump()}")
     else:
         # Fallback to a default host and port if the output doesn't match the regex.
-        host, port = "127.0.0.1", DEFAULT_PORT
+        host, port = "127.0.0.1", default_port
         if not _probe_tcp(host, port, timeout_s=8.0):
             proc.kill()
             raise RuntimeError(f"Server failed to report address and default port {port} not open.\n{rd.dump()}")
+    return {"proc": proc, "host": host, "port": port, "reader": rd}
 
-    # The 'yield' keyword makes this a teardown fixture.
-    # The dictionary containing the process, host, port, and reader is passed to tests.
-    yield {"proc": proc, "host": host, "port": port, "reader": rd}
-
-    # Teardown logic:
-    # Terminate the process gracefully, then kill it if it doesn't exit.
+def _stop_server(srv):
+    """Terminates a server process gracefully, then kills it if it doesn't exit."""
+    proc = srv["proc"]
     proc.terminate()
     try:
         proc.wait(timeout=5)
     except subprocess.TimeoutExpired:
         proc.kill()
 
+@pytest.fixture(scope="session")
+def server(tmp_path_factory):
+    """
+    A Pytest fixture that starts the server process before tests run and stops it afterwards.
+    The scope is "session", meaning the server is started once for all tests in the session.
+    """
+    srv = _launch_server([])
+    # The 'yield' keyword makes this a teardown fixture.
+    # The dictionary containing the process, host, port, and reader is passed to tests.
+    yield srv
+    _stop_server(srv)
+
+@pytest.fixture
+def spill_server(tmp_path):
+    """
+    A second server on its own port that spills every finished, unfetched result right away.
+    """
+    port = DEFAULT_PORT + 10
+    srv = _launch_server(["--port", str(port), "--spill-dir", str(tmp_path), "--spill-after-ms", "0",
+                          "--spill-file-mb", "1"], default_port=port)
+    yield srv
+    _stop_server(srv)
+
 class InteractiveProc:
     """
     A class to manage and interact with a command-line process.
@@ -246,4 +266,37 @@ def client2(server):
     banner = ip.until_prompt(timeout=5)
     assert "Client started" in banner
     yield ip
-    ip.close()
\ No newline at end of file
+    ip.close()
+
+def _start_client(binary, srv):
+    """Starts a client connected to `srv` and waits for its prompt."""
+    ip = InteractiveProc([str(binary), "--address", srv["host"], "--port", str(srv["port"])])
+    banner = ip.until_prompt(timeout=5)
+    assert "Client started" in banner
+    return ip
+
+@pytest.fixture
+def spill_client1(spill_server):
+    """The first client, connected to `spill_server`."""
+    ip = _start_client(CLIENT1_BIN, spill_server)
+    yield ip
+    ip.close()
+
+@pytest.fixture
+def class_server():
+    """
+    A server on its own port with one worker pool per op class that logs every queued submit
+    as slow, so the slow log shows which pool ran it.
+    """
+    port = DEFAULT_PORT + 11
+    srv = _launch_server(["--port", str(port), "--class-threads", "math=1,string=1,bulk=1",
+                          "--slow-request-us", "*=1"], default_port=port)
+    yield srv
+    _stop_server(srv)
+
+@pytest.fixture
+def class_client1(class_server):
+    """The first client, connected to `class_server`."""
+    ip = _start_client(CLIENT1_BIN, class_server)
+    yield ip
+    ip.close()
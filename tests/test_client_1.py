@@ -1,4 +1,4 @@
-import re, pytest
+import re, time, pytest
 pytestmark = pytest.mark.timeout(30)
 
 def send_and_capture(cli, line, expect=None, timeout=5):
@@ -37,3 +37,82 @@ def test_concat_limit_ok_and_error(client1):
     long1 = "X"*20
     long2 = "Y"*20
     out = send_and_capture(client1, f"block concat {long1} {long2}", r"(error|invalid|too\s*long)")
+
+def test_stats_counts_and_reset(client1):
+    send_and_capture(client1, "stats reset", r"Stats:\s*window=")
+    send_and_capture(client1, "block add 1 2", r"Result:\s*Int=3")
+    send_and_capture(client1, "block add 3 4", r"Result:\s*Int=7")
+    out = send_and_capture(client1, "stats", r"^\s*add count=2 ST_SUCCESS=2")
+    assert re.search(r"exec\s+n=2", out), out
+    out = send_and_capture(client1, "stats", r"Stats:\s*window=")
+    assert re.search(r"^\s*add count=2", out, re.M), out
+    assert re.search(r"^\s*client client_1 flow=\d+ weight=1 queued=0 submitted=2 served=2", out, re.M), out
+    assert re.search(r"^\s*dispatch inline=2 inline_nonblocking=0 queued=0 offloaded=0", out, re.M), out
+
+def test_expr_one_round_trip(client1):
+    send_and_capture(client1, "block expr 2 3 add 4 mult", r"Result:\s*Int=20")
+    send_and_capture(client1, "block expr foo bar concat", r"Result:\s*Str=foobar")
+    # Client 1 has no SUB capability, so the whole program is rejected.
+    send_and_capture(client1, "block expr 5 3 sub 2 add", r"INVALID_INPUT")
+    send_and_capture(client1, "block expr 1 add", r"INVALID_INPUT")
+
+def test_ops_list_and_call_by_id(client1):
+    out = send_and_capture(client1, "ops", r"^\s*0 add\s+ints=2 strs=0")
+    assert re.search(r"^\s*4 concat\s+ints=0 strs=2", out, re.M), out
+    send_and_capture(client1, "block call 0 2 3", r"Result:\s*Int=5")
+    send_and_capture(client1, "block call 4 foo bar", r"Result:\s*Str=foobar")
+    # Client 1 has no SUB capability, and an unregistered id or a wrong argument count is invalid too.
+    send_and_capture(client1, "block call 1 5 3", r"INVALID_INPUT")
+    send_and_capture(client1, "block call 0 2", r"INVALID_INPUT")
+
+
+def test_reduce_sum_wide_and_prefix(client1):
+    send_and_capture(client1, "block reduce sum 1 2 3 4", r"Result:\s*Int=10")
+    # int32 wraps around, wide accumulates in 64 bits.
+    send_and_capture(client1, "block reduce sum 2147483647 1", r"Result:\s*Int=-2147483648")
+    send_and_capture(client1, "block reduce sum wide 2147483647 1", r"Result:\s*Long=2147483648")
+    send_and_capture(client1, "block reduce max 3 -7 5", r"Result:\s*Int=5")
+    send_and_capture(client1, "block reduce dot 1 2 3 | 4 5 6", r"Result:\s*Int=32")
+    send_and_capture(client1, "block reduce prefix 1 2 3 4", r"Result:\s*Values=1,3,6,10 \(4 values\)")
+    send_and_capture(client1, "block reduce sum wide seq 1000000", r"Result:\s*Long=500000500000")
+    send_and_capture(client1, "block reduce dot 1 2 | 3", r"INVALID_INPUT")
+
+def test_getmany_wait_all(client1):
+    for a in (10, 20, 30):
+        client1.send(f"non-block add {a} 1")
+        client1.until_re(r"ticket=(\d+)", timeout=5)
+    out = send_and_capture(client1, "getmany all 2000", r"Finished:\s*3 Pending:\s*0")
+    for v in (11, 21, 31):
+        assert re.search(rf"ticket=\d+ Result:\s*Int={v}\b", out), out
+    send_and_capture(client1, "getmany any 100", r"No pending tickets")
+
+def test_slowlog_off_by_default(client1):
+    # The test server sets no slow_request_us threshold.
+    send_and_capture(client1, "slowlog", r"Slow-request log is off")
+
+def test_spilled_results_served_by_get_and_getmany(spill_client1):
+    tickets = []
+    for a in (1, 3):
+        spill_client1.send(f"non-block add {a} {a + 1}")
+        out = spill_client1.until_re(r"ticket=(\d+)", timeout=5)
+        tickets.append(re.search(r"ticket=(\d+)", out).group(1))
+    time.sleep(0.2)
+    # The next submit sweeps both finished results into the spill file.
+    spill_client1.send("non-block add 5 6")
+    spill_client1.until_re(r"ticket=(\d+)", timeout=5)
+    send_and_capture(spill_client1, "stats", r"^\s*spill results=[23] bytes=\d+ rejected=0")
+    send_and_capture(spill_client1, f"get {tickets[0]} nowait", r"Result:\s*Int=3")
+    out = send_and_capture(spill_client1, "getmany all 2000", r"Finished:\s*2 Pending:\s*0")
+    for v in (7, 11):
+        assert re.search(rf"ticket=\d+ Result:\s*Int={v}\b", out), out
+
+def test_expr_runs_in_the_pool_of_its_most_expensive_op(class_client1):
+    for expr, expect in (("foo bar concat", r"Str=foobar"), ("2 3 add", r"Int=5")):
+        class_client1.send(f"non-block expr {expr}")
+        out = class_client1.until_re(r"ticket=(\d+)", timeout=5)
+        ticket = re.search(r"ticket=(\d+)", out).group(1)
+        send_and_capture(class_client1, f"get {ticket} wait 2000", expect)
+    out = send_and_capture(class_client1, "slowlog", r"Slow requests: 2 recorded")
+    workers = re.findall(r"^\s*expr\s+ST_SUCCESS .* worker=(\w+)-\d+", out, re.M)
+    # A string op makes the whole expression a string job.
+    assert workers == ["string", "math"], out
@@ -14,3 +14,22 @@ def test_block_sub_and_findstart(client2):
 
 def test_div_by_zero_error(client2):
     send_and_capture(client2, "block div 6 0", r"(ERROR_DIV_BY_ZERO|div\s*by\s*0|invalid)")
+
+def test_expr_keeps_per_op_statuses(client2):
+    send_and_capture(client2, "block expr abracadabra cad find 10 sub", r"Result:\s*Int=-6")
+    send_and_capture(client2, "block expr 8 2 2 sub div", r"ERROR_DIV_BY_ZERO")
+    send_and_capture(client2, "block expr abc z find", r"ERROR_SUBSTR_NOT_FOUND")
+
+def test_stream_find_across_chunks(client2, tmp_path):
+    # The needle straddles the 1 MiB chunk boundary used by the client.
+    hay = tmp_path / "hay.bin"
+    hay.write_bytes(b"a" * (1024 * 1024 - 3) + b"needle" + b"b" * 1000)
+    send_and_capture(client2, f"stream {hay} needle", r"Result:\s*Offset=1048573")
+    send_and_capture(client2, f"stream {hay} missing", r"ERROR_SUBSTR_NOT_FOUND")
+
+def test_patterns_findany(client2):
+    out = send_and_capture(client2, "patterns he she hers", r"handle=(\d+)")
+    handle = re.search(r"handle=(\d+)", out).group(1)
+    send_and_capture(client2, f"block findany {handle} ushers", r"Result:\s*Matches=1:1\s*$")
+    send_and_capture(client2, f"block findany {handle} ushers all", r"Result:\s*Matches=1:1 2:0 2:2")
+    send_and_capture(client2, "block findany 12345 ushers", r"ERROR_UNKNOWN_HANDLE")
@@ -0,0 +1,81 @@
+import os, re, signal, subprocess, time, pytest
+from conftest import DEFAULT_PORT, _find_bin, _launch_server, _stop_server
+pytestmark = pytest.mark.timeout(60)
+
+IPC_BENCH_BIN = _find_bin("ipc_bench")
+
+def run_bench(*args, timeout=45):
+    proc = subprocess.run([str(IPC_BENCH_BIN), *args], stdout=subprocess.PIPE, stderr=subprocess.STDOUT,
+                          text=True, timeout=timeout)
+    return proc.returncode, proc.stdout
+
+def test_embedded_server_restarts():
+    # Three runs: the embedded server is started once and restarted twice, stop and deinitialize in between.
+    rc, out = run_bench("--embedded", "1", "--embedded-restart", "--sizes", "16,32,64", "--mix", "add",
+                        "-c", "1", "-d", "0.3", "--warmup", "0")
+    assert rc == 0, out
+    for size in (16, 32, 64):
+        m = re.search(rf"^all\s+{size}\s+(\d+)\s+(\d+)\s", out, re.M)
+        assert m, out
+        assert int(m.group(1)) > 0 and int(m.group(2)) == 0, out
+
+@pytest.fixture
+def hedge_servers():
+    """A primary and a hedge server on their own ports."""
+    servers = [_launch_server(["--port", str(port)], default_port=port)
+               for port in (DEFAULT_PORT + 12, DEFAULT_PORT + 13)]
+    yield servers
+    for srv in servers:
+        _stop_server(srv)
+
+def test_hedge_wins_over_a_stalled_server(hedge_servers):
+    primary, backup = hedge_servers
+    bench = subprocess.Popen([str(IPC_BENCH_BIN), "--address", primary["host"], "--port", str(primary["port"]),
+                              "--hedge", f"{backup['host']}:{backup['port']}", "--hedge-budget-pct", "1",
+                              "--mix", "add", "-c", "1", "-d", "2", "--warmup", "0"],
+                             stdout=subprocess.PIPE, stderr=subprocess.STDOUT, text=True)
+    # Let the session learn its latency and save up the full credit of 10 hedges, then stall the
+    # primary for far longer than 10 hedged round trips take.
+    time.sleep(0.8)
+    os.kill(primary["proc"].pid, signal.SIGSTOP)
+    time.sleep(0.3)
+    os.kill(primary["proc"].pid, signal.SIGCONT)
+    out, _ = bench.communicate(timeout=30)
+    assert bench.returncode == 0, out
+
+    m = re.search(r"^all\s+16\s+(\d+)\s+(\d+)\s", out, re.M)
+    assert m and int(m.group(1)) > 0, out
+    # The primary's late replies were not taken for answers to later requests.
+    assert int(m.group(2)) == 0, out
+    m = re.search(r"^hedge size=16 requests=(\d+) hedged=(\d+) wins=(\d+) denied=(\d+) stale=(\d+)", out, re.M)
+    assert m, out
+    requests, hedged, wins, denied, stale = map(int, m.groups())
+    assert wins >= 1, out
+    # Each won hedge leaves a late reply on the primary's socket, dropped with the next request.
+    assert stale >= 1, out
+    # The stall outlasts the saved credit: later hedges were refused.
+    assert denied >= 1, out
+    assert hedged <= 10 + requests // 100 + 1, out
+
+def test_capture_counts_frames_after_the_file_cap_as_dropped(tmp_path):
+    port = DEFAULT_PORT + 14
+    srv = _launch_server(["--port", str(port), "--capture-dir", str(tmp_path), "--capture-file-mb", "1",
+                          "--capture-max-files", "1"], default_port=port)
+    try:
+        rc, out = run_bench("--address", srv["host"], "--port", str(port), "--mix", "add",
+                            "-c", "2", "-d", "2", "--warmup", "0")
+        assert rc == 0, out
+        m = re.search(r"^all\s+16\s+(\d+)\s", out, re.M)
+        assert m, out
+        sent = int(m.group(1))
+    finally:
+        _stop_server(srv)
+    srv["reader"].t.join(timeout=2)  # The shutdown summary is among the last lines.
+    log = srv["reader"].dump()
+    m = re.search(r"Captured (\d+) frames in (\d+) file\(s\), dropped (\d+)", log)
+    assert m, log
+    records, files, dropped = map(int, m.groups())
+    assert files == 1, log
+    # Every frame after the single file filled up is counted, not just the one that hit the cap.
+    assert dropped > 1 and records + dropped >= sent, log
+    assert len(list(tmp_path.iterdir())) == 1